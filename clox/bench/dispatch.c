@@ -0,0 +1,226 @@
+// VM dispatch microbenchmark: the time it takes the VM to execute a compiled chunk, per instruction. It's built
+// once per dispatch mode (see CLOX_VM_DISPATCH in CMakeLists.txt), as dispatch-<mode>.bench.
+//
+// There are no jumps yet, so every instruction of a chunk is executed exactly once per run. The chunk is timed as
+// compiled, then again after the peephole pass fused it into superinstructions, then compiled to register code
+// and timed on the register VM.
+//
+// usage: dispatch-<mode>.bench [n] [script]
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STB_DS_IMPLEMENTATION
+#include <clox/stb_ds.h>
+
+#include <clox/scanner.h>
+#include <clox/parser.h>
+#include <clox/ast/program.h>
+#include <clox/vm/chunk.h>
+#include <clox/vm/compiler.h>
+#include <clox/vm/peephole.h>
+#include <clox/vm/reg-compiler.h>
+#include <clox/vm/reg-vm.h>
+#include <clox/vm/vm.h>
+
+/**
+ * @brief How many times the statements of the default script are repeated
+ */
+#define DEFAULT_SCRIPT_BLOCKS 500
+
+static const char default_block[] =
+    "{\n"
+    "    var a = x + 1;\n"
+    "    var b = a * 2 - y;\n"
+    "    a = (a + b) / 2 - -b;\n"
+    "    var c = a < b == !(b >= 3);\n"
+    "    x = x + a - b * 0.5;\n"
+    "    y = -y;\n"
+    "    print c != (x <= y);\n"
+    "}\n";
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @return char* the default script: globals used by many copies of a block. It must be freed
+ */
+static char* default_script(size_t* len) {
+    const char prologue[] = "var x = 1.5;\nvar y = 2;\n";
+    *len = sizeof(prologue) - 1 + DEFAULT_SCRIPT_BLOCKS * (sizeof(default_block) - 1);
+    char* src = malloc(*len + 1);
+    char* end = src;
+    memcpy(end, prologue, sizeof(prologue) - 1);
+    end += sizeof(prologue) - 1;
+    for (size_t i = 0; i < DEFAULT_SCRIPT_BLOCKS; i++) {
+        memcpy(end, default_block, sizeof(default_block) - 1);
+        end += sizeof(default_block) - 1;
+    }
+    *end = '\0';
+    return src;
+}
+
+static char* read_file(const char* path, size_t* len) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "error: can't open '%s'\n", path);
+        exit(1);
+    }
+    fseek(file, 0, SEEK_END);
+    *len = (size_t) ftell(file);
+    rewind(file);
+    char* src = malloc(*len + 1);
+    if (fread(src, 1, *len, file) != *len) {
+        fprintf(stderr, "error: can't read '%s'\n", path);
+        exit(1);
+    }
+    src[*len] = '\0';
+    fclose(file);
+    return src;
+}
+
+/**
+ * @return size_t how many instructions the chunk holds
+ */
+static size_t chunk_instructions(const struct clox_vm_chunk* chunk) {
+    size_t count = 0;
+    for (size_t offset = 0; offset < chunk->codes_count; offset += clox_vm_op_code_length(chunk->codes[offset])) {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @return size_t how many instructions the register code chunk holds
+ */
+static size_t reg_chunk_instructions(const struct clox_vm_chunk* chunk) {
+    size_t count = 0;
+    for (size_t offset = 0; offset < chunk->codes_count; offset += clox_vm_reg_op_code_length(chunk->codes[offset])) {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @return double the best time out of 5 rounds of running the chunk n times, or a negative value on error
+ */
+static double run_best(struct clox_vm* vm, struct clox_vm_chunk* chunk, int n) {
+    double best = 0;
+    for (int round = 0; round < 5; round++) {
+        double start = now();
+        for (int i = 0; i < n; i++) {
+            if (clox_vm_interpret(vm, chunk) != CLOX_VM_INTERPRET_RESULT_OK) {
+                return -1;
+            }
+        }
+        double elapsed = now() - start;
+        if (round == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Same as run_best, on the register VM
+ */
+static double run_best_register(struct clox_vm_reg_vm* vm, struct clox_vm_chunk* chunk, int n) {
+    double best = 0;
+    for (int round = 0; round < 5; round++) {
+        double start = now();
+        for (int i = 0; i < n; i++) {
+            if (clox_vm_reg_vm_interpret(vm, chunk) != CLOX_VM_INTERPRET_RESULT_OK) {
+                return -1;
+            }
+        }
+        double elapsed = now() - start;
+        if (round == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+static void report(const char* label, size_t instructions, int n, double best) {
+    printf("%-14s %-9s %9zu instructions x %d: %8.3fms, %6.2fns/instruction\n", CLOX_VM_DISPATCH_NAME, label,
+        instructions, n, best * 1e3, best * 1e9 / ((double) instructions * n));
+}
+
+int main(int argc, char** argv) {
+    int n = (argc > 1) ? atoi(argv[1]) : 200;
+    const char* path = (argc > 2) ? argv[2] : NULL;
+
+    size_t len;
+    char* src = (path != NULL) ? read_file(path, &len) : default_script(&len);
+
+    struct scanner scanner = {0};
+    scanner_scan_all_from_cstr(&scanner, src, len);
+    struct parser parser;
+    parser_init(&parser, scanner.tokens);
+    struct clox_ast_program* prog = parser_parse(&parser);
+    if (prog == NULL) {
+        return 1;
+    }
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+    struct clox_vm_chunk reg_chunk;
+    clox_vm_chunk_init(&reg_chunk);
+    if (clox_vm_compile(prog, &chunk) != 0 || clox_vm_reg_compile(prog, &reg_chunk) != 0) {
+        return 1;
+    }
+    clox_ast_program_free(prog);
+    scanner_free(&scanner);
+
+    // the prints would measure the terminal
+    int devnull = open("/dev/null", O_WRONLY);
+    struct clox_vm vm;
+    clox_vm_init(&vm);
+    clox_output_free(&vm.output);
+    clox_output_init(&vm.output, devnull, CLOX_OUTPUT_DEFAULT_CAP);
+
+    double best = run_best(&vm, &chunk, n);
+    if (best < 0) {
+        return 1;
+    }
+    report("compiled", chunk_instructions(&chunk), n, best);
+
+    struct clox_vm_peephole_report peephole;
+    clox_vm_peephole_optimize(&chunk, &peephole);
+    double best_optimized = run_best(&vm, &chunk, n);
+    if (best_optimized < 0) {
+        return 1;
+    }
+    report("peephole", peephole.instructions_after, n, best_optimized);
+    printf("%-14s %-9s %9zu superinstructions, %.1f%% fewer dispatches, %.2fx as fast\n", CLOX_VM_DISPATCH_NAME, "",
+        peephole.fused, 100.0 * (1 - (double) peephole.instructions_after / peephole.instructions_before),
+        best / best_optimized);
+
+    struct clox_vm_reg_vm reg_vm;
+    clox_vm_reg_vm_init(&reg_vm);
+    clox_output_free(&reg_vm.output);
+    clox_output_init(&reg_vm.output, devnull, CLOX_OUTPUT_DEFAULT_CAP);
+    double best_register = run_best_register(&reg_vm, &reg_chunk, n);
+    if (best_register < 0) {
+        return 1;
+    }
+    const size_t reg_instructions = reg_chunk_instructions(&reg_chunk);
+    report("register", reg_instructions, n, best_register);
+    printf("%-14s %-9s %9zu instructions fewer, %.1f%% fewer dispatches, %.2fx as fast as compiled, %.2fx as fast"
+        " as peephole\n", CLOX_VM_DISPATCH_NAME, "", peephole.instructions_before - reg_instructions,
+        100.0 * (1 - (double) reg_instructions / peephole.instructions_before), best / best_register,
+        best_optimized / best_register);
+
+    clox_vm_reg_vm_free(&reg_vm);
+    clox_vm_free(&vm);
+    close(devnull);
+    clox_vm_chunk_free(&reg_chunk);
+    clox_vm_chunk_free(&chunk);
+    free(src);
+    return 0;
+}
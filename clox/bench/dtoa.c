@@ -0,0 +1,85 @@
+// Number formatting microbenchmark: clox_dtoa against printf-style formatting.
+//
+// usage: dtoa.bench [n]
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <clox/dtoa.h>
+
+struct sample_set {
+    const char* name;
+    double* values;
+};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// xorshift64*
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * UINT64_C(2685821657736338717);
+}
+
+static size_t format_dtoa(double value, char* buf) {
+    return clox_dtoa(value, buf);
+}
+
+static size_t format_lf(double value, char* buf) {
+    // %lf may need up to 309 integral digits
+    return (size_t) snprintf(buf, 512, "%lf", value);
+}
+
+static size_t format_g17(double value, char* buf) {
+    return (size_t) snprintf(buf, 512, "%.17g", value);
+}
+
+static void run(const char* name, size_t (*format)(double, char*), const struct sample_set* set, size_t n) {
+    char buf[512];
+    size_t total = 0;
+
+    double start = now();
+    for (size_t i = 0; i < n; i++) {
+        total += format(set->values[i], buf);
+    }
+    double elapsed = now() - start;
+
+    printf("%-10s %-8s %8.1f ns/number  %6.2f bytes/number\n", set->name, name, elapsed * 1e9 / n, (double) total / n);
+}
+
+int main(int argc, char* argv[]) {
+    size_t n = (argc > 1) ? strtoull(argv[1], NULL, 10) : 1000000;
+
+    struct sample_set sets[] = {
+        { .name = "integers" },
+        { .name = "decimals" },
+        { .name = "random" },
+    };
+    uint64_t state = UINT64_C(88172645463325252);
+    for (size_t s = 0; s < sizeof(sets) / sizeof(sets[0]); s++) {
+        sets[s].values = malloc(n * sizeof(double));
+    }
+    for (size_t i = 0; i < n; i++) {
+        uint64_t r = next_random(&state);
+        sets[0].values[i] = (double) (r % 1000000);
+        sets[1].values[i] = (double) (r % 100000) / 100;
+        // finite doubles uniformly spread over the exponents
+        r &= ~(UINT64_C(0x7ff) << 52);
+        r |= (uint64_t) (1 + next_random(&state) % 2046) << 52;
+        memcpy(&sets[2].values[i], &r, sizeof(double));
+    }
+
+    for (size_t s = 0; s < sizeof(sets) / sizeof(sets[0]); s++) {
+        run("dtoa", format_dtoa, &sets[s], n);
+        run("%lf", format_lf, &sets[s], n);
+        run("%.17g", format_g17, &sets[s], n);
+        free(sets[s].values);
+    }
+}
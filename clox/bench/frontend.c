@@ -0,0 +1,149 @@
+// Front end microbenchmark: the time it takes to get a small script ready to run, i.e. the startup latency of each
+// engine before the first statement is executed.
+//
+// usage: frontend.bench [n] [script]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STB_DS_IMPLEMENTATION
+#include <clox/stb_ds.h>
+
+#include <clox/scanner.h>
+#include <clox/parser.h>
+#include <clox/optimizer.h>
+#include <clox/ast/program.h>
+#include <clox/vm/chunk.h>
+#include <clox/vm/compiler.h>
+#include <clox/vm/compiler-single-pass.h>
+
+static const char default_script[] =
+    "var greeting = \"hello\";\n"
+    "var count = 3;\n"
+    "var ratio = count / 4 + 0.5;\n"
+    "print greeting + \" world\";\n"
+    "{\n"
+    "    var local = count * 2 - 1;\n"
+    "    var label = \"local: \";\n"
+    "    print local >= 5;\n"
+    "    count = local + count;\n"
+    "    {\n"
+    "        var inner = -(local + ratio);\n"
+    "        print !(inner < 0) == false;\n"
+    "    }\n"
+    "}\n"
+    "print count != 8;\n"
+    "var done = nil;\n"
+    "print done == nil;\n";
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief What the ast engine does before executing: parse and optimize
+ */
+static size_t frontend_ast(const char* src, size_t len) {
+    struct scanner scanner = {0};
+    scanner_scan_all_from_cstr(&scanner, src, len);
+    struct parser parser;
+    parser_init(&parser, scanner.tokens);
+    struct clox_ast_program* prog = parser_parse(&parser);
+
+    struct clox_optimizer_report report;
+    clox_optimizer_propagate_constants(prog, &report);
+    clox_optimizer_flatten_concats(prog, &report);
+    clox_optimizer_report_free(&report);
+
+    size_t statements = arrlen(prog->statements);
+    // the AST is freed once the program is done. That's part of its cost too
+    clox_ast_program_free(prog);
+    scanner_free(&scanner);
+    return statements;
+}
+
+/**
+ * @brief What the vm engine does before executing: parse, optimize and compile the AST
+ */
+static size_t frontend_vm_ast(const char* src, size_t len) {
+    struct scanner scanner = {0};
+    scanner_scan_all_from_cstr(&scanner, src, len);
+    struct parser parser;
+    parser_init(&parser, scanner.tokens);
+    struct clox_ast_program* prog = parser_parse(&parser);
+
+    struct clox_optimizer_report report;
+    clox_optimizer_propagate_constants(prog, &report);
+    clox_optimizer_report_free(&report);
+
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+    clox_vm_compile(prog, &chunk);
+    clox_ast_program_free(prog);
+    scanner_free(&scanner);
+
+    size_t codes = chunk.codes_count;
+    clox_vm_chunk_free(&chunk);
+    return codes;
+}
+
+/**
+ * @brief What the vm-single-pass engine does before executing: compile the tokens
+ */
+static size_t frontend_vm_single_pass(const char* src, size_t len) {
+    struct scanner scanner = {0};
+    scanner_scan_all_from_cstr(&scanner, src, len);
+
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+    clox_vm_compile_tokens(scanner.tokens, &chunk);
+    scanner_free(&scanner);
+
+    size_t codes = chunk.codes_count;
+    clox_vm_chunk_free(&chunk);
+    return codes;
+}
+
+static void run(const char* name, size_t (*frontend)(const char*, size_t), const char* src, size_t len, size_t n) {
+    size_t total = 0;
+
+    double start = now();
+    for (size_t i = 0; i < n; i++) {
+        total += frontend(src, len);
+    }
+    double elapsed = now() - start;
+
+    printf("%-16s %8.2f us/script  %8.1f ns/byte  (checksum %zu)\n", name, elapsed * 1e6 / n, elapsed * 1e9 / n / len, total);
+}
+
+int main(int argc, char* argv[]) {
+    size_t n = (argc > 1) ? strtoull(argv[1], NULL, 10) : 100000;
+
+    const char* src = default_script;
+    size_t len = sizeof(default_script) - 1;
+    char* contents = NULL;
+    if (argc > 2) {
+        FILE* file = fopen(argv[2], "rb");
+        if (file == NULL) {
+            fprintf(stderr, "error: can't open '%s'\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+        fseek(file, 0, SEEK_END);
+        len = (size_t) ftell(file);
+        rewind(file);
+        contents = malloc(len + 1);
+        len = fread(contents, 1, len, file);
+        contents[len] = '\0';
+        fclose(file);
+        src = contents;
+    }
+
+    run("ast", frontend_ast, src, len, n);
+    run("vm", frontend_vm_ast, src, len, n);
+    run("vm-single-pass", frontend_vm_single_pass, src, len, n);
+
+    free(contents);
+}
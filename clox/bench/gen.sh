@@ -0,0 +1,101 @@
+#!/bin/sh
+# Generates synthetic Lox workloads for benchmarking.
+# Lox doesn't have loops yet, so workloads are unrolled into N statements.
+#
+# usage: gen.sh <workload> <n>
+set -eu
+
+if [ $# -ne 2 ]; then
+    echo "usage: $0 <workload> <n>" >&2
+    exit 1
+fi
+
+workload="$1"
+n="$2"
+
+case "$workload" in
+strings)
+    # string literals, global string reads, copies and concatenations
+    awk -v n="$n" 'BEGIN {
+        print "var sep = \", \";"
+        print "var name = \"World\";"
+        for (i = 0; i < n; i++) {
+            printf "var k%d = \"key\" + sep + name;\n", i
+            printf "var c%d = k%d;\n", i, i
+            printf "var l%d = \"label\";\n", i
+            printf "print c%d + sep + name;\n", i
+            printf "print name;\n"
+        }
+    }'
+    ;;
+report)
+    # a report built by repeated `s = s + piece`
+    awk -v n="$n" 'BEGIN {
+        print "var name = \"World\";"
+        print "var report = \"\";"
+        for (i = 0; i < n; i++) {
+            printf "report = report + \"row %d: \" + name + \"; \";\n", i
+        }
+        print "print report;"
+    }'
+    ;;
+numbers)
+    # arithmetic, comparisons and logic over global numbers
+    awk -v n="$n" 'BEGIN {
+        print "var x = 1.5;"
+        print "var y = 2;"
+        for (i = 0; i < n; i++) {
+            printf "var n%d = (x + %d) * y - x / y;\n", i, i
+            printf "x = n%d - x * 0.5;\n", i
+            printf "var b%d = !(n%d < x) == (y >= 2);\n", i, i
+            printf "print -n%d;\n", i
+        }
+    }'
+    ;;
+integers)
+    # counters and index arithmetic, all integral
+    awk -v n="$n" 'BEGIN {
+        print "var i = 0;"
+        print "var total = 0;"
+        print "var stride = 3;"
+        for (i = 0; i < n; i++) {
+            printf "i = i + 1;\n"
+            printf "total = total + i * stride - (i - 1);\n"
+            printf "var idx%d = (total - i) * 2 + %d;\n", i, i
+            printf "var in%d = idx%d < total == (i <= %d);\n", i, i, n
+        }
+        print "print total;"
+    }'
+    ;;
+locals)
+    # block scoped locals, read and assigned in nested blocks
+    awk -v n="$n" 'BEGIN {
+        print "var total = 0;"
+        for (i = 0; i < n; i++) {
+            printf "{\n"
+            printf "    var x = %d;\n", i
+            printf "    var name = \"row\";\n"
+            printf "    { var y = x * 2; var label = name + \" \" + name; x = x + y; }\n"
+            printf "    total = total + x;\n"
+            printf "}\n"
+        }
+        print "print total;"
+    }'
+    ;;
+prints)
+    # lots of small prints of every kind of value
+    awk -v n="$n" 'BEGIN {
+        print "var name = \"World\";"
+        for (i = 0; i < n; i++) {
+            printf "print %d;\n", i
+            printf "print name;\n"
+            printf "print %d < 10;\n", i
+            printf "print nil;\n"
+        }
+    }'
+    ;;
+*)
+    echo "error: unknown workload '$workload'" >&2
+    exit 1
+    ;;
+esac
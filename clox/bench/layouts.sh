@@ -0,0 +1,23 @@
+#!/bin/sh
+# Builds clox with each value layout (tagged union and NaN-boxed) and runs every workload against both.
+#
+# usage: layouts.sh [n]
+set -eu
+
+n="${1:-10000}"
+here="$(cd "$(dirname "$0")" && pwd)"
+tmp="$(mktemp -d)"
+trap 'rm -rf "$tmp"' EXIT
+
+for layout in tagged nanbox; do
+    case "$layout" in
+    tagged) nan_boxing=OFF ;;
+    nanbox) nan_boxing=ON ;;
+    esac
+
+    cmake -S "$here/.." -B "$tmp/$layout" -DCLOX_DISABLE_CUSTOM_FLAGS=ON -DCMAKE_C_FLAGS="-O2 -DNDEBUG" -DCLOX_NAN_BOXING="$nan_boxing" > /dev/null
+    cmake --build "$tmp/$layout" --target clox-cli > /dev/null 2>&1
+
+    echo "# $layout"
+    "$here/run.sh" "$tmp/$layout/clox" "$n"
+done
@@ -0,0 +1,27 @@
+#!/bin/sh
+# Runs every workload from gen.sh against a clox binary, reporting wall time and runtime allocation counters.
+#
+# usage: run.sh <clox-binary> [n]
+set -eu
+
+if [ $# -lt 1 ]; then
+    echo "usage: $0 <clox-binary> [n]" >&2
+    exit 1
+fi
+
+clox="$1"
+n="${2:-10000}"
+here="$(cd "$(dirname "$0")" && pwd)"
+tmp="$(mktemp -d)"
+trap 'rm -rf "$tmp"' EXIT
+
+for workload in strings report numbers integers locals prints; do
+    script="$tmp/$workload.lox"
+    "$here/gen.sh" "$workload" "$n" > "$script"
+
+    start=$(date +%s.%N)
+    "$clox" --mem-stats "$script" > /dev/null 2> "$tmp/$workload.stats"
+    end=$(date +%s.%N)
+
+    printf "%-12s %8.3fs  %s\n" "$workload" "$(awk -v s="$start" -v e="$end" 'BEGIN { print e - s }')" "$(tail -n 1 "$tmp/$workload.stats")"
+done
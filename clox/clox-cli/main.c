@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <string.h>
 #include <assert.h>
 
@@ -11,6 +12,7 @@
 
 #include <clox/str.h>
 #include <clox/commons.h>
+#include <clox/mem.h>
 #include <clox/token.h>
 #include <clox/scanner.h>
 #include <clox/ast/expr.h>
@@ -19,6 +21,14 @@
 #include <clox/interpreter.h>
 #include <clox/value.h>
 #include <clox/ast/program.h>
+#include <clox/vm/chunk.h>
+#include <clox/vm/compiler.h>
+#include <clox/vm/compiler-single-pass.h>
+#include <clox/vm/peephole.h>
+#include <clox/vm/profile.h>
+#include <clox/vm/reg-compiler.h>
+#include <clox/vm/reg-vm.h>
+#include <clox/vm/vm.h>
 
 #include "ansi.h"
 
@@ -26,31 +36,207 @@
 #define FILE_PATH_MAX_LEN 1024
 #endif
 
-int script_run(const char* script_path, size_t script_path_len);
-void repl_start(void);
+enum cli_engine {
+    /**
+     * @brief Walks the AST with the tree-walking interpreter
+     */
+    CLI_ENGINE_AST,
+    /**
+     * @brief Compiles the AST to bytecode and runs it on the VM
+     */
+    CLI_ENGINE_VM,
+    /**
+     * @brief Compiles the tokens straight to bytecode, without building an AST, and runs it on the VM
+     */
+    CLI_ENGINE_VM_SINGLE_PASS,
+    /**
+     * @brief Compiles the AST to register code and runs it on the register VM
+     */
+    CLI_ENGINE_VM_REGISTER,
+};
+
+enum cli_profile_format {
+    CLI_PROFILE_FORMAT_NONE,
+    /**
+     * @brief Sorted tables of the opcodes and of the pairs of opcodes
+     */
+    CLI_PROFILE_FORMAT_TABLE,
+    CLI_PROFILE_FORMAT_JSON,
+};
+
+/**
+ * @brief How many pairs of opcodes the profile table shows
+ */
+#define CLI_PROFILE_TABLE_PAIRS 20
+
+struct cli_options {
+    /**
+     * @brief The script to run. NULL starts the REPL
+     */
+    const char* script_path;
+    /**
+     * @brief Dumps the runtime allocation counters to stderr at exit
+     */
+    bool mem_stats;
+    /**
+     * @brief Dumps the interpreter runtime counters to stderr at exit
+     */
+    bool interpreter_stats;
+    /**
+     * @brief Allocates temporary values in a region which is freed in bulk after each statement
+     */
+    bool region;
+    /**
+     * @brief Size of the interpreter output buffer. 0 is the default size
+     */
+    size_t output_buffer_size;
+    /**
+     * @brief What runs the scripts
+     */
+    enum cli_engine engine;
+    /**
+     * @brief Dumps the instructions executed by the VM to stderr at exit. Requires CLOX_VM_PROFILE
+     */
+    enum cli_profile_format profile_opcodes;
+    /**
+     * @brief One in how many instructions the profile times, 0 to only count them
+     */
+    uint32_t profile_sample_period;
+};
+
+int cli_options_parse(struct cli_options* opts, int argc, char* argv[]);
+void usage(FILE* file, const char* program);
+int script_run(const struct cli_options* opts, const char* script_path, size_t script_path_len);
+int program_run_ast(const struct cli_options* opts, struct clox_ast_program* prog);
+int program_run_vm(const struct cli_options* opts, struct clox_ast_program* prog);
+int program_run_vm_register(const struct cli_options* opts, struct clox_ast_program* prog);
+int tokens_run_vm(const struct cli_options* opts, const struct token* tokens);
+int chunk_run_vm(const struct cli_options* opts, struct clox_vm_chunk* chunk);
+void repl_start(const struct cli_options* opts);
+void repl_chunk_run(struct clox_vm* vm, struct clox_vm_chunk* chunk, int compile_rc);
+void repl_reg_chunk_run(struct clox_vm_reg_vm* vm, struct clox_vm_chunk* chunk, int compile_rc);
+void vm_profile_start(const struct cli_options* opts, struct clox_vm* vm, struct clox_vm_profile* profile);
+void vm_profile_fprint(const struct cli_options* opts, const struct clox_vm_profile* profile, FILE* file);
 
 int main(int argc, char* argv[]) {
-    if (argc >= 3) {
-        fprintf(stderr, "usage: %s [script]\n", argv[0]);
+    struct cli_options opts = {0};
+    if (cli_options_parse(&opts, argc, argv) != 0) {
+        usage(stderr, argv[0]);
         return EXIT_FAILURE;
     }
-    if (argc == 2) {
-        const char* script_path = argv[1];
-        size_t script_path_len = strnlen(script_path, FILE_PATH_MAX_LEN);
+
+    int exit_code = EXIT_SUCCESS;
+    if (opts.script_path != NULL) {
+        size_t script_path_len = strnlen(opts.script_path, FILE_PATH_MAX_LEN);
         if (script_path_len >= FILE_PATH_MAX_LEN) {
             fprintf(stderr, "error: script file path overflow. the path limit is %u.\n", FILE_PATH_MAX_LEN);
             return EXIT_FAILURE;
         }
-        if (script_run(script_path, script_path_len) != 0) {
-            return EXIT_FAILURE;
+        if (script_run(&opts, opts.script_path, script_path_len) != 0) {
+            exit_code = EXIT_FAILURE;
         }
-        return EXIT_SUCCESS;
+    } else {
+        repl_start(&opts);
+    }
+
+    if (opts.mem_stats) {
+        clox_mem_stats_fprint(stderr);
     }
-    repl_start();
-    return EXIT_SUCCESS;
+    return exit_code;
 }
 
-int script_run(const char* script_path, size_t script_path_len) {
+int cli_options_parse(struct cli_options* opts, int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+
+        if (strcmp(arg, "--mem-stats") == 0) {
+            opts->mem_stats = true;
+        } else if (strcmp(arg, "--interpreter-stats") == 0) {
+            opts->interpreter_stats = true;
+        } else if (strcmp(arg, "--region") == 0) {
+            opts->region = true;
+        } else if (strncmp(arg, "--output-buffer=", 16) == 0) {
+            char* end = NULL;
+            unsigned long long size = strtoull(arg + 16, &end, 10);
+            if (end == arg + 16 || *end != '\0' || size == 0) {
+                fprintf(stderr, "error: invalid output buffer size '%s'\n", arg + 16);
+                return 1;
+            }
+            opts->output_buffer_size = size;
+        } else if (strncmp(arg, "--engine=", 9) == 0) {
+            if (strcmp(arg + 9, "ast") == 0) {
+                opts->engine = CLI_ENGINE_AST;
+            } else if (strcmp(arg + 9, "vm") == 0) {
+                opts->engine = CLI_ENGINE_VM;
+            } else if (strcmp(arg + 9, "vm-single-pass") == 0) {
+                opts->engine = CLI_ENGINE_VM_SINGLE_PASS;
+            } else if (strcmp(arg + 9, "vm-register") == 0) {
+                opts->engine = CLI_ENGINE_VM_REGISTER;
+            } else {
+                fprintf(stderr, "error: unknown engine '%s'\n", arg + 9);
+                return 1;
+            }
+        } else if (strcmp(arg, "--profile-opcodes") == 0 || strcmp(arg, "--profile-opcodes=table") == 0) {
+            opts->profile_opcodes = CLI_PROFILE_FORMAT_TABLE;
+        } else if (strcmp(arg, "--profile-opcodes=json") == 0) {
+            opts->profile_opcodes = CLI_PROFILE_FORMAT_JSON;
+        } else if (strncmp(arg, "--profile-sample=", 17) == 0) {
+            char* end = NULL;
+            unsigned long period = strtoul(arg + 17, &end, 10);
+            if (end == arg + 17 || *end != '\0' || period == 0 || period > UINT32_MAX) {
+                fprintf(stderr, "error: invalid profile sample period '%s'\n", arg + 17);
+                return 1;
+            }
+            opts->profile_sample_period = (uint32_t) period;
+        } else if (strncmp(arg, "--", 2) == 0) {
+            fprintf(stderr, "error: unknown option '%s'\n", arg);
+            return 1;
+        } else if (opts->script_path == NULL) {
+            opts->script_path = arg;
+        } else {
+            fprintf(stderr, "error: only one script is supported\n");
+            return 1;
+        }
+    }
+
+#if !defined(CLOX_VM_PROFILE)
+    if (opts->profile_opcodes != CLI_PROFILE_FORMAT_NONE || opts->profile_sample_period != 0) {
+        fputs("error: the opcode profiler isn't built in. configure with -DCLOX_VM_PROFILE=ON\n", stderr);
+        return 1;
+    }
+#endif
+    if (opts->profile_sample_period != 0 && opts->profile_opcodes == CLI_PROFILE_FORMAT_NONE) {
+        opts->profile_opcodes = CLI_PROFILE_FORMAT_TABLE;
+    }
+    if (opts->profile_opcodes != CLI_PROFILE_FORMAT_NONE && opts->engine == CLI_ENGINE_VM_REGISTER) {
+        fputs("error: the opcode profiler only covers the stack vm engines (vm and vm-single-pass)\n", stderr);
+        return 1;
+    }
+    return 0;
+}
+
+void usage(FILE* file, const char* program) {
+    fprintf(file, "usage: %s [options] [script]\n", program);
+    fputs("options:\n", file);
+    fputs("  --mem-stats          prints runtime allocation counters to stderr at exit\n", file);
+    fputs("  --interpreter-stats  prints interpreter runtime counters (e.g. node specializations, constant globals) to stderr at exit\n", file);
+    fputs("  --region             allocates temporary values in a region freed after each statement\n", file);
+    fputs("  --output-buffer=N    buffers up to N bytes of printed output before writing it (default 65536)\n", file);
+    fputs("  --engine=ENGINE      what runs the script:\n", file);
+    fputs("                         ast             walks the AST (default)\n", file);
+    fputs("                         vm              compiles the AST to bytecode and runs it on the VM\n", file);
+    fputs("                         vm-single-pass  compiles the source to bytecode in one pass, without an AST\n", file);
+    fputs("                         vm-register     compiles the AST to register code and runs it on the register VM\n", file);
+    fputs("                       --region only applies to the ast engine. On the vm engines, --interpreter-stats\n", file);
+    fputs("                       prints the bytecode instruction counters\n", file);
+    fputs("  --profile-opcodes[=FORMAT]\n", file);
+    fputs("                       prints the instructions executed by the vm engines to stderr at exit, per opcode\n", file);
+    fputs("                       and per pair of opcodes, as a table (default) or json. Requires a build with\n", file);
+    fputs("                       CLOX_VM_PROFILE\n", file);
+    fputs("  --profile-sample=N   also times one in N instructions with --profile-opcodes\n", file);
+}
+
+int script_run(const struct cli_options* opts, const char* script_path, size_t script_path_len) {
     (void) script_path_len;
     
     struct str script_contents = {0};
@@ -62,6 +248,16 @@ int script_run(const char* script_path, size_t script_path_len) {
     struct scanner scanner = {0};
     scanner_scan_all(&scanner, strview_from_str(script_contents));
 
+    if (opts->engine == CLI_ENGINE_VM_SINGLE_PASS) {
+        int rc = tokens_run_vm(opts, scanner.tokens);
+        scanner_free(&scanner);
+        munmap(script_contents.ptr, script_contents.len);
+        if (rc != 0) {
+            fprintf(stderr, "error: %s:%d: runtime error\n", __FILE__, __LINE__);
+        }
+        return rc;
+    }
+
     struct parser parser;
     parser_init(&parser, scanner.tokens);
 
@@ -75,21 +271,25 @@ int script_run(const char* script_path, size_t script_path_len) {
         return 1;
     }
 
-    struct clox_interpreter interpreter;
-    clox_interpreter_init(&interpreter);
-
-    // NOTE This value is borrowed from the interpreter internal state.
-    // struct clox_value value = clox_interpreter_eval(&interpreter, expr);
-    // clox_value_fprintln(stdout, value);
-    if (clox_interpreter_exec_program(&interpreter, prog) != 0) {
+    int rc;
+    switch (opts->engine) {
+    case CLI_ENGINE_VM:
+        rc = program_run_vm(opts, prog);
+        break;
+    case CLI_ENGINE_VM_REGISTER:
+        rc = program_run_vm_register(opts, prog);
+        break;
+    default:
+        rc = program_run_ast(opts, prog);
+        break;
+    }
+    if (rc != 0) {
         fprintf(stderr, "error: %s:%d: runtime error\n", __FILE__, __LINE__);
-        clox_interpreter_free(&interpreter);
         clox_ast_program_free(prog);
         scanner_free(&scanner);
         return 1;
     }
 
-    clox_interpreter_free(&interpreter);
     clox_ast_program_free(prog);
     scanner_free(&scanner);
 
@@ -100,12 +300,146 @@ int script_run(const char* script_path, size_t script_path_len) {
     return 0;
 }
 
-void repl_start(void) {
+int program_run_ast(const struct cli_options* opts, struct clox_ast_program* prog) {
+    struct clox_interpreter interpreter;
+    clox_interpreter_init(&interpreter);
+    interpreter.use_region = opts->region;
+    if (opts->output_buffer_size > 0) {
+        clox_output_set_cap(&interpreter.output, opts->output_buffer_size);
+    }
+
+    // The whole script is known upfront, so its constant globals can be propagated.
+    // REPL lines can't: any later line could assign them.
+    clox_interpreter_optimize_program(&interpreter, prog);
+
+    // NOTE This value is borrowed from the interpreter internal state.
+    // struct clox_value value = clox_interpreter_eval(&interpreter, expr);
+    // clox_value_fprintln(stdout, value);
+    int rc = clox_interpreter_exec_program(&interpreter, prog);
+    if (opts->interpreter_stats) {
+        clox_interpreter_stats_fprint(&interpreter, stderr);
+    }
+
+    clox_interpreter_free(&interpreter);
+    return rc;
+}
+
+int program_run_vm(const struct cli_options* opts, struct clox_ast_program* prog) {
+    // Same as the ast engine, minus the concat flattening: the VM joins strings one `+` at a time anyway
+    struct clox_optimizer_report report;
+    clox_optimizer_propagate_constants(prog, &report);
+    clox_optimizer_report_free(&report);
+
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+    if (clox_vm_compile(prog, &chunk) != 0) {
+        fputs("error: failed to compile the script to bytecode\n", stderr);
+        clox_vm_chunk_free(&chunk);
+        return 1;
+    }
+
+    int rc = chunk_run_vm(opts, &chunk);
+    clox_vm_chunk_free(&chunk);
+    return rc;
+}
+
+int program_run_vm_register(const struct cli_options* opts, struct clox_ast_program* prog) {
+    // Same as the stack VM
+    struct clox_optimizer_report report;
+    clox_optimizer_propagate_constants(prog, &report);
+    clox_optimizer_report_free(&report);
+
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+    if (clox_vm_reg_compile(prog, &chunk) != 0) {
+        fputs("error: failed to compile the script to register code\n", stderr);
+        clox_vm_chunk_free(&chunk);
+        return 1;
+    }
+
+    struct clox_vm_reg_vm vm;
+    clox_vm_reg_vm_init(&vm);
+    if (opts->output_buffer_size > 0) {
+        clox_output_set_cap(&vm.output, opts->output_buffer_size);
+    }
+
+    enum clox_vm_interpret_result result = clox_vm_reg_vm_interpret(&vm, &chunk);
+
+    clox_vm_reg_vm_free(&vm);
+    if (opts->interpreter_stats) {
+        size_t instructions = 0;
+        for (size_t offset = 0; offset < chunk.codes_count; offset += clox_vm_reg_op_code_length(chunk.codes[offset])) {
+            instructions++;
+        }
+        fprintf(stderr, "vm-register: instructions=%zu\n", instructions);
+    }
+    clox_vm_chunk_free(&chunk);
+    return (result == CLOX_VM_INTERPRET_RESULT_OK) ? 0 : 1;
+}
+
+int tokens_run_vm(const struct cli_options* opts, const struct token* tokens) {
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+    if (clox_vm_compile_tokens(tokens, &chunk) != 0) {
+        fputs("error: failed to compile the script to bytecode\n", stderr);
+        clox_vm_chunk_free(&chunk);
+        return 1;
+    }
+
+    int rc = chunk_run_vm(opts, &chunk);
+    clox_vm_chunk_free(&chunk);
+    return rc;
+}
+
+int chunk_run_vm(const struct cli_options* opts, struct clox_vm_chunk* chunk) {
+    struct clox_vm_peephole_report peephole;
+    clox_vm_peephole_optimize(chunk, &peephole);
+
+    struct clox_vm vm;
+    clox_vm_init(&vm);
+    if (opts->output_buffer_size > 0) {
+        clox_output_set_cap(&vm.output, opts->output_buffer_size);
+    }
+
+    struct clox_vm_profile profile;
+    vm_profile_start(opts, &vm, &profile);
+
+    enum clox_vm_interpret_result result = clox_vm_interpret(&vm, chunk);
+
+    clox_vm_free(&vm);
+    if (opts->interpreter_stats) {
+        fprintf(stderr, "vm: instructions=%zu superinstructions=%zu (from %zu instructions)\n",
+            peephole.instructions_after, peephole.fused, peephole.instructions_before);
+    }
+    vm_profile_fprint(opts, &profile, stderr);
+    return (result == CLOX_VM_INTERPRET_RESULT_OK) ? 0 : 1;
+}
+
+void repl_start(const struct cli_options* opts) {
     struct scanner scanner = {0};
     struct parser parser;
 
     struct clox_interpreter interpreter;
     clox_interpreter_init(&interpreter);
+    interpreter.use_region = opts->region;
+    if (opts->output_buffer_size > 0) {
+        clox_output_set_cap(&interpreter.output, opts->output_buffer_size);
+    }
+
+    // The VM globals outlive the lines, each of them compiled to its own chunk
+    struct clox_vm vm;
+    clox_vm_init(&vm);
+    if (opts->output_buffer_size > 0) {
+        clox_output_set_cap(&vm.output, opts->output_buffer_size);
+    }
+    struct clox_vm_reg_vm reg_vm;
+    clox_vm_reg_vm_init(&reg_vm);
+    if (opts->output_buffer_size > 0) {
+        clox_output_set_cap(&reg_vm.output, opts->output_buffer_size);
+    }
+    // accumulated over all the lines
+    struct clox_vm_profile profile;
+    vm_profile_start(opts, &vm, &profile);
 
     char line[1024] = {0};
     const size_t line_cap = ARRAY_SIZE(line);
@@ -115,6 +449,8 @@ void repl_start(void) {
         memset(line, 0, line_cap);
 
         printf(CLOX_ANSI_HWHT "> " CLOX_ANSI_RESET);
+        // the interpreter output doesn't go through stdio, so the prompt must be written before it
+        fflush(stdout);
 
         fgets(line, line_cap, stdin);
         if (line[0] == '\0') {
@@ -126,6 +462,14 @@ void repl_start(void) {
         // Lexing. Tokens are stored inside the scanner
         scanner_scan_all_from_cstr(&scanner, line, line_len);
 
+        if (opts->engine == CLI_ENGINE_VM_SINGLE_PASS) {
+            struct clox_vm_chunk chunk;
+            clox_vm_chunk_init(&chunk);
+            repl_chunk_run(&vm, &chunk, clox_vm_compile_tokens(scanner.tokens, &chunk));
+            clox_vm_chunk_free(&chunk);
+            continue;
+        }
+
         parser_init(&parser, scanner.tokens);
 
         struct clox_ast_program* prog = parser_parse(&parser);
@@ -135,6 +479,23 @@ void repl_start(void) {
             continue;
         }
 
+        if (opts->engine == CLI_ENGINE_VM) {
+            struct clox_vm_chunk chunk;
+            clox_vm_chunk_init(&chunk);
+            repl_chunk_run(&vm, &chunk, clox_vm_compile(prog, &chunk));
+            clox_vm_chunk_free(&chunk);
+            clox_ast_program_free(prog);
+            continue;
+        }
+        if (opts->engine == CLI_ENGINE_VM_REGISTER) {
+            struct clox_vm_chunk chunk;
+            clox_vm_chunk_init(&chunk);
+            repl_reg_chunk_run(&reg_vm, &chunk, clox_vm_reg_compile(prog, &chunk));
+            clox_vm_chunk_free(&chunk);
+            clox_ast_program_free(prog);
+            continue;
+        }
+
         // NOTE This value is borrowed from the interpreter internal state.
         // struct clox_value value = clox_interpreter_eval(&interpreter, expr);
         // clox_value_fprintln(stdout, value);
@@ -144,10 +505,76 @@ void repl_start(void) {
             clox_ast_program_free(prog);
             continue;
         }
+        clox_interpreter_flush(&interpreter);
 
         clox_ast_program_free(prog);
     }
     
+    if (opts->interpreter_stats) {
+        clox_interpreter_stats_fprint(&interpreter, stderr);
+    }
     clox_interpreter_free(&interpreter);
+    clox_vm_free(&vm);
+    clox_vm_reg_vm_free(&reg_vm);
+    if (opts->engine != CLI_ENGINE_AST) {
+        vm_profile_fprint(opts, &profile, stderr);
+    }
     scanner_free(&scanner);
 }
+
+/**
+ * @brief Runs the chunk compiled from a REPL line, unless its compilation failed
+ */
+void repl_chunk_run(struct clox_vm* vm, struct clox_vm_chunk* chunk, int compile_rc) {
+    if (compile_rc != 0) {
+        fprintf(stderr, "error: compilation failed\n");
+        return;
+    }
+    struct clox_vm_peephole_report peephole;
+    clox_vm_peephole_optimize(chunk, &peephole);
+    if (clox_vm_interpret(vm, chunk) != CLOX_VM_INTERPRET_RESULT_OK) {
+        fprintf(stderr, "error: %s:%d: runtime error\n", __FILE__, __LINE__);
+    }
+    clox_output_flush(&vm->output);
+}
+
+/**
+ * @brief Runs the register code compiled from a REPL line, unless its compilation failed
+ */
+void repl_reg_chunk_run(struct clox_vm_reg_vm* vm, struct clox_vm_chunk* chunk, int compile_rc) {
+    if (compile_rc != 0) {
+        fprintf(stderr, "error: compilation failed\n");
+        return;
+    }
+    if (clox_vm_reg_vm_interpret(vm, chunk) != CLOX_VM_INTERPRET_RESULT_OK) {
+        fprintf(stderr, "error: %s:%d: runtime error\n", __FILE__, __LINE__);
+    }
+    clox_output_flush(&vm->output);
+}
+
+/**
+ * @brief Attaches the profile to the VM, if the opcodes are profiled
+ */
+void vm_profile_start(const struct cli_options* opts, struct clox_vm* vm, struct clox_vm_profile* profile) {
+    clox_vm_profile_init(profile, opts->profile_sample_period);
+#if defined(CLOX_VM_PROFILE)
+    if (opts->profile_opcodes != CLI_PROFILE_FORMAT_NONE) {
+        vm->profile = profile;
+    }
+#else
+    (void) vm;
+#endif
+}
+
+void vm_profile_fprint(const struct cli_options* opts, const struct clox_vm_profile* profile, FILE* file) {
+    switch (opts->profile_opcodes) {
+    case CLI_PROFILE_FORMAT_NONE:
+        break;
+    case CLI_PROFILE_FORMAT_TABLE:
+        clox_vm_profile_fprint_table(profile, file, CLI_PROFILE_TABLE_PAIRS);
+        break;
+    case CLI_PROFILE_FORMAT_JSON:
+        clox_vm_profile_fprint_json(profile, file);
+        break;
+    }
+}
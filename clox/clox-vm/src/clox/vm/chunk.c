@@ -1,17 +1,50 @@
 #include "chunk.h"
 #include "mem.h"
 
+#include <assert.h>
+#include <string.h>
+
+#include <clox/stb_ds.h>
+
+struct clox_vm_chunk_constant_slot {
+    size_t key;
+    size_t value;
+};
+
+/**
+ * @brief Appends an entry to the line table
+ */
+static void chunk_lines_push(struct clox_vm_chunk* chunk, uint8_t count, int8_t delta);
+
+/**
+ * @brief Hashes a number or string constant
+ * 
+ * @return bool false if the constant is of another kind, which isn't deduplicated
+ */
+static bool chunk_constant_hash(clox_vm_value value, size_t* hash);
+
+/**
+ * @brief Whether two constants with the same hash are really the same. Numbers must be stored the same way and
+ * have the same bits
+ */
+static bool chunk_constant_is_same(clox_vm_value left, clox_vm_value right);
+
 void clox_vm_chunk_init(struct clox_vm_chunk* chunk) {
     chunk->codes = NULL;
     chunk->codes_capacity = chunk->codes_count = 0;
     clox_vm_value_array_init(&chunk->constants);
+    chunk->constants_lookup = NULL;
     chunk->lines = NULL;
+    chunk->lines_capacity = chunk->lines_count = 0;
+    chunk->last_line = 0;
+    chunk->line_cursor = (struct clox_vm_chunk_line_cursor) {0};
 }
 
 void clox_vm_chunk_free(struct clox_vm_chunk* chunk) {
-    CLOX_VM_MEM_FREE_ARRAY(size_t, chunk->lines, chunk->codes_capacity);
+    CLOX_VM_MEM_FREE_ARRAY(uint8_t, chunk->lines, chunk->lines_capacity);
     CLOX_VM_MEM_FREE_ARRAY(uint8_t, chunk->codes, chunk->codes_capacity);
     clox_vm_value_array_free(&chunk->constants);
+    hmfree(chunk->constants_lookup);
     clox_vm_chunk_init(chunk);
 }
 
@@ -20,14 +53,140 @@ void clox_vm_chunk_write(struct clox_vm_chunk* chunk, uint8_t byte, size_t line)
         size_t old_capacity = chunk->codes_capacity;
         chunk->codes_capacity = CLOX_VM_MEM_GROW_CAPACITY(old_capacity);
         chunk->codes = CLOX_VM_MEM_GROW_ARRAY(uint8_t, chunk->codes, old_capacity, chunk->codes_capacity);
-        chunk->lines = CLOX_VM_MEM_GROW_ARRAY(size_t, chunk->lines, old_capacity, chunk->codes_capacity);
     }
     chunk->codes[chunk->codes_count] = byte;
-    chunk->lines[chunk->codes_count] = line;
     chunk->codes_count++;
+
+    // Same line as the previous code: the last entry just spans one more code, if it can
+    if (chunk->lines_count > 0 && line == chunk->last_line && chunk->lines[chunk->lines_count - 2] < UINT8_MAX) {
+        chunk->lines[chunk->lines_count - 2]++;
+        return;
+    }
+
+    // Jumps that don't fit a byte take empty entries
+    long delta = (long) line - (long) chunk->last_line;
+    for (; delta > INT8_MAX; delta -= INT8_MAX) {
+        chunk_lines_push(chunk, 0, INT8_MAX);
+    }
+    for (; delta < INT8_MIN; delta -= INT8_MIN) {
+        chunk_lines_push(chunk, 0, INT8_MIN);
+    }
+    chunk_lines_push(chunk, 1, (int8_t) delta);
+    chunk->last_line = line;
+}
+
+static void chunk_lines_push(struct clox_vm_chunk* chunk, uint8_t count, int8_t delta) {
+    if (chunk->lines_count + 2 > chunk->lines_capacity) {
+        size_t old_capacity = chunk->lines_capacity;
+        chunk->lines_capacity = CLOX_VM_MEM_GROW_CAPACITY(old_capacity);
+        chunk->lines = CLOX_VM_MEM_GROW_ARRAY(uint8_t, chunk->lines, old_capacity, chunk->lines_capacity);
+    }
+    chunk->lines[chunk->lines_count++] = count;
+    chunk->lines[chunk->lines_count++] = (uint8_t) delta;
+}
+
+size_t clox_vm_chunk_get_line(struct clox_vm_chunk* chunk, size_t offset) {
+    assert(offset < chunk->codes_count);
+
+    struct clox_vm_chunk_line_cursor* cursor = &chunk->line_cursor;
+    if (offset < cursor->offset) {
+        *cursor = (struct clox_vm_chunk_line_cursor) {0};
+    }
+
+    for (;;) {
+        assert(cursor->entry < chunk->lines_count);
+        const uint8_t count = chunk->lines[cursor->entry];
+        const size_t line = cursor->line + (int8_t) chunk->lines[cursor->entry + 1];
+        if (offset < cursor->offset + count) {
+            // the cursor stays at this entry, as the next lookups will probably hit it too
+            return line;
+        }
+        cursor->entry += 2;
+        cursor->offset += count;
+        cursor->line = line;
+    }
 }
 
 size_t clox_vm_chunk_add_constant(struct clox_vm_chunk* chunk, clox_vm_value value) {
+    size_t hash;
+    if (!chunk_constant_hash(value, &hash)) {
+        clox_vm_value_array_write(&chunk->constants, value);
+        return chunk->constants.count - 1;
+    }
+
+    struct clox_vm_chunk_constant_slot* slot = hmgetp_null(chunk->constants_lookup, hash);
+    if (slot != NULL && chunk_constant_is_same(chunk->constants.values[slot->value], value)) {
+        clox_value_free(&value);
+        return slot->value;
+    }
+
     clox_vm_value_array_write(&chunk->constants, value);
+    // on a collision the slot keeps pointing to the first constant, the new one just isn't shared
+    if (slot == NULL) {
+        hmput(chunk->constants_lookup, hash, chunk->constants.count - 1);
+    }
     return chunk->constants.count - 1;
 }
+
+static bool chunk_constant_hash(clox_vm_value value, size_t* hash) {
+    if (clox_value_is_number(value)) {
+        double number = clox_value_as_number(value);
+        *hash = stbds_hash_bytes(&number, sizeof(number), 0);
+        return true;
+    }
+    if (clox_value_is_string(value)) {
+        struct strview sv = clox_value_as_strview(&value);
+        // another seed, so that strings and numbers with the same bytes don't always collide
+        *hash = stbds_hash_bytes((void*) sv.ptr, sv.len, 1);
+        return true;
+    }
+    return false;
+}
+
+static bool chunk_constant_is_same(clox_vm_value left, clox_vm_value right) {
+    if (clox_value_is_number(left) && clox_value_is_number(right)) {
+        double left_number = clox_value_as_number(left);
+        double right_number = clox_value_as_number(right);
+        return clox_value_is_integer(left) == clox_value_is_integer(right)
+            && memcmp(&left_number, &right_number, sizeof(double)) == 0;
+    }
+    if (clox_value_is_string(left) && clox_value_is_string(right)) {
+        return strview_equals(clox_value_as_strview(&left), clox_value_as_strview(&right));
+    }
+    return false;
+}
+
+int clox_vm_chunk_write_constant_op(struct clox_vm_chunk* chunk, enum clox_vm_op_code op, size_t index, size_t line) {
+    if (index >= CLOX_VM_CHUNK_CONSTANTS_MAX) {
+        return 1;
+    }
+    if (index <= UINT8_MAX) {
+        clox_vm_chunk_write(chunk, op, line);
+        clox_vm_chunk_write(chunk, (uint8_t) index, line);
+        return 0;
+    }
+
+    enum clox_vm_op_code op_long;
+    switch (op) {
+    case CLOX_VM_OP_CODE_CONSTANT:
+        op_long = CLOX_VM_OP_CODE_CONSTANT_LONG;
+        break;
+    case CLOX_VM_OP_CODE_DEFINE_GLOBAL:
+        op_long = CLOX_VM_OP_CODE_DEFINE_GLOBAL_LONG;
+        break;
+    case CLOX_VM_OP_CODE_GET_GLOBAL:
+        op_long = CLOX_VM_OP_CODE_GET_GLOBAL_LONG;
+        break;
+    case CLOX_VM_OP_CODE_SET_GLOBAL:
+        op_long = CLOX_VM_OP_CODE_SET_GLOBAL_LONG;
+        break;
+    default:
+        assert(false && "the instruction doesn't take a constant");
+        return 1;
+    }
+    clox_vm_chunk_write(chunk, op_long, line);
+    clox_vm_chunk_write(chunk, (uint8_t) (index & 0xff), line);
+    clox_vm_chunk_write(chunk, (uint8_t) ((index >> 8) & 0xff), line);
+    clox_vm_chunk_write(chunk, (uint8_t) ((index >> 16) & 0xff), line);
+    return 0;
+}
@@ -4,11 +4,107 @@
 #include "common.h"
 #include "value.h"
 
+/**
+ * @brief Every opcode, as X(name, operand), where operand is what follows the opcode in the chunk codes:
+ * - NONE: nothing
+ * - CONSTANT: the index of a constant, in one byte
+ * - CONSTANT_LONG: the index of a constant, in 3 bytes (little endian)
+ * - SLOT: the stack slot of a local, in one byte
+ * - COUNT: a number of values, in one byte
+ *
+ * The enum, the disassembler and the VM dispatch tables are all generated from it, so adding an opcode here is
+ * enough for them to know about it.
+ */
+#define CLOX_VM_OP_CODES(X)                                                                                         \
+    X(RETURN, NONE)                                                                                                 \
+    /* Pushes a constant */                                                                                         \
+    X(CONSTANT, CONSTANT)                                                                                           \
+    X(CONSTANT_LONG, CONSTANT_LONG)                                                                                 \
+    X(NIL, NONE)                                                                                                    \
+    X(TRUE, NONE)                                                                                                   \
+    X(FALSE, NONE)                                                                                                  \
+    X(POP, NONE)                                                                                                    \
+    /* Pushes a local */                                                                                            \
+    X(GET_LOCAL, SLOT)                                                                                              \
+    /* Stores the top of the stack, which is left in place, into a local */                                         \
+    X(SET_LOCAL, SLOT)                                                                                              \
+    /* Pops a value into the global whose name is the constant */                                                   \
+    X(DEFINE_GLOBAL, CONSTANT)                                                                                      \
+    X(DEFINE_GLOBAL_LONG, CONSTANT_LONG)                                                                            \
+    /* Pushes the global whose name is the constant */                                                              \
+    X(GET_GLOBAL, CONSTANT)                                                                                         \
+    X(GET_GLOBAL_LONG, CONSTANT_LONG)                                                                               \
+    /* Stores the top of the stack, which is left in place, into the global whose name is the constant */           \
+    X(SET_GLOBAL, CONSTANT)                                                                                         \
+    X(SET_GLOBAL_LONG, CONSTANT_LONG)                                                                               \
+    X(EQUAL, NONE)                                                                                                  \
+    X(GREATER, NONE)                                                                                                \
+    X(GREATER_EQUAL, NONE)                                                                                          \
+    X(LESS, NONE)                                                                                                   \
+    X(LESS_EQUAL, NONE)                                                                                             \
+    X(ADD, NONE)                                                                                                    \
+    X(SUBTRACT, NONE)                                                                                               \
+    X(MULTIPLY, NONE)                                                                                               \
+    X(DIVIDE, NONE)                                                                                                 \
+    X(NOT, NONE)                                                                                                    \
+    X(NEGATE, NONE)                                                                                                 \
+    X(PRINT, NONE)                                                                                                  \
+    /* Superinstructions, written by the peephole pass (see peephole.h) in place of common sequences. */            \
+    /* <op>_CONSTANT: CONSTANT + <op>, applying the binary operator to the top of the stack and the constant */     \
+    X(ADD_CONSTANT, CONSTANT)                                                                                       \
+    X(SUBTRACT_CONSTANT, CONSTANT)                                                                                  \
+    X(MULTIPLY_CONSTANT, CONSTANT)                                                                                  \
+    X(DIVIDE_CONSTANT, CONSTANT)                                                                                    \
+    X(GREATER_CONSTANT, CONSTANT)                                                                                   \
+    X(GREATER_EQUAL_CONSTANT, CONSTANT)                                                                             \
+    X(LESS_CONSTANT, CONSTANT)                                                                                      \
+    X(LESS_EQUAL_CONSTANT, CONSTANT)                                                                                \
+    /* SET_GLOBAL + POP: an assignment statement, moving the value into the global */                               \
+    X(SET_GLOBAL_POP, CONSTANT)                                                                                     \
+    /* SET_LOCAL + POP */                                                                                           \
+    X(SET_LOCAL_POP, SLOT)                                                                                          \
+    /* COUNT times POP, e.g. the locals of a block going out of scope */                                            \
+    X(POP_N, COUNT)
+
 enum clox_vm_op_code {
-    CLOX_VM_OP_CODE_RETURN,
-    CLOX_VM_OP_CODE_CONSTANT,
+#define X(name, operand) CLOX_VM_OP_CODE_##name,
+    CLOX_VM_OP_CODES(X)
+#undef X
+    /**
+     * @brief How many opcodes there are. Not an opcode itself
+     */
+    CLOX_VM_OP_CODE_COUNT,
 };
 
+#define CLOX_VM_OP_OPERAND_LENGTH_NONE 0
+#define CLOX_VM_OP_OPERAND_LENGTH_CONSTANT 1
+#define CLOX_VM_OP_OPERAND_LENGTH_CONSTANT_LONG 3
+#define CLOX_VM_OP_OPERAND_LENGTH_SLOT 1
+#define CLOX_VM_OP_OPERAND_LENGTH_COUNT 1
+
+/**
+ * @return size_t how many codes an instruction takes, its opcode included
+ */
+static inline size_t clox_vm_op_code_length(enum clox_vm_op_code op) {
+    switch (op) {
+#define X(name, operand) case CLOX_VM_OP_CODE_##name: return 1 + CLOX_VM_OP_OPERAND_LENGTH_##operand;
+    CLOX_VM_OP_CODES(X)
+#undef X
+    default:
+        return 1;
+    }
+}
+
+/**
+ * @brief How many constants a chunk can hold: the _LONG instructions take 3-byte indexes
+ */
+#define CLOX_VM_CHUNK_CONSTANTS_MAX ((size_t) 1 << 24)
+
+/**
+ * @brief An entry of the hash map (stb_ds) indexing the constants of a chunk
+ */
+struct clox_vm_chunk_constant_slot;
+
 struct clox_vm_chunk {
     /**
      * @brief A dynamic array of multiple codes
@@ -27,14 +123,42 @@ struct clox_vm_chunk {
      */
     struct clox_vm_value_array constants;
     /**
-     * @brief Dynamic array of source code line numbers.
-     * 
-     * The index in this array is aligned with the index in the codes array.
-     * This is way we don't need another capacity/count variables.
+     * @brief Hash map (stb_ds) from the hash of number and string constants to their index in constants, so that
+     * repeated literals and variable names share a single entry
+     */
+    struct clox_vm_chunk_constant_slot* constants_lookup;
+    /**
+     * @brief Run-length encoded source code lines of the codes. Use clox_vm_chunk_get_line to get the line of a code.
      * 
-     * In order to get the op code source code line, use its index here.
+     * Consecutive codes usually come from the same line, so the table is a sequence of 2-byte entries: how many
+     * codes the entry spans (0 to 255) and the difference between its line and the previous entry's (a signed
+     * byte). Longer runs and bigger jumps take more entries.
+     */
+    uint8_t* lines;
+    size_t lines_capacity;
+    size_t lines_count;
+    /**
+     * @brief The line of the last code written
+     */
+    size_t last_line;
+    /**
+     * @brief Where clox_vm_chunk_get_line stopped decoding the lines last time, so that lookups in ascending order
+     * (e.g. disassembling) don't start over from the first entry every time
      */
-    size_t* lines;
+    struct clox_vm_chunk_line_cursor {
+        /**
+         * @brief Index in lines of the next entry to decode
+         */
+        size_t entry;
+        /**
+         * @brief Offset of the first code of that entry
+         */
+        size_t offset;
+        /**
+         * @brief Line of the entry before it
+         */
+        size_t line;
+    } line_cursor;
 };
 
 void clox_vm_chunk_init(struct clox_vm_chunk* chunk);
@@ -42,8 +166,36 @@ void clox_vm_chunk_free(struct clox_vm_chunk* chunk);
 void clox_vm_chunk_write(struct clox_vm_chunk* chunk, uint8_t byte, size_t line);
 
 /**
- * @return the index where the constant was appended 
+ * @brief Gets the source code line of a code.
+ * 
+ * It decodes the line table, so it's meant for error reporting and debugging, not for hot paths. Lookups are
+ * cheap when offsets go forward, as they resume from the previous one.
+ * 
+ * @param chunk 
+ * @param offset the index of the code. It must be less than codes_count
+ * @return size_t 
+ */
+size_t clox_vm_chunk_get_line(struct clox_vm_chunk* chunk, size_t offset);
+
+/**
+ * @brief Adds a constant to the chunk pool. The chunk takes ownership of it.
+ * 
+ * Numbers and strings equal to a constant already in the pool aren't appended again: value is freed and the index
+ * of the existing one is returned. Numbers are only shared when they are stored the same way and have the same
+ * bits, so e.g. `0` and `-0` stay apart.
+ * 
+ * @return the index of the constant. It may be CLOX_VM_CHUNK_CONSTANTS_MAX or more, which no instruction can refer to
  */
 size_t clox_vm_chunk_add_constant(struct clox_vm_chunk* chunk, clox_vm_value value);
 
+/**
+ * @brief Writes an instruction whose operand is the index of a constant: op followed by a byte if the index fits
+ * one, else the _LONG variant of op followed by 3 bytes.
+ * 
+ * @param op one of CLOX_VM_OP_CODE_CONSTANT, CLOX_VM_OP_CODE_DEFINE_GLOBAL, CLOX_VM_OP_CODE_GET_GLOBAL and
+ * CLOX_VM_OP_CODE_SET_GLOBAL
+ * @return int 0 on success. non-zero, writing nothing, if index is CLOX_VM_CHUNK_CONSTANTS_MAX or more
+ */
+int clox_vm_chunk_write_constant_op(struct clox_vm_chunk* chunk, enum clox_vm_op_code op, size_t index, size_t line);
+
 #endif
@@ -0,0 +1,106 @@
+#include "unit-helpers.h"
+
+#include <stdio.h>
+
+#define STB_DS_IMPLEMENTATION
+#include <clox/stb_ds.h>
+
+static void test_lines(void) {
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+
+    // long runs, big jumps in both directions and a line going back
+    size_t expected[2000];
+    size_t count = 0;
+    for (size_t i = 0; i < 600; i++) {
+        expected[count++] = 1;
+    }
+    expected[count++] = 2;
+    expected[count++] = 2;
+    expected[count++] = 1000;
+    expected[count++] = 3;
+    for (size_t line = 4; line < 1000; line++) {
+        expected[count++] = line;
+    }
+    expected[count++] = 70000;
+    expected[count++] = 1;
+
+    for (size_t i = 0; i < count; i++) {
+        clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_NIL, expected[i]);
+    }
+    assert(chunk.codes_count == count);
+
+    // in order, which resumes from the previous lookup
+    for (size_t i = 0; i < count; i++) {
+        assert(clox_vm_chunk_get_line(&chunk, i) == expected[i]);
+    }
+    // and backwards, which starts over
+    for (size_t i = count; i > 0; i--) {
+        assert(clox_vm_chunk_get_line(&chunk, i - 1) == expected[i - 1]);
+    }
+
+    // writing after a lookup keeps the table consistent
+    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_RETURN, 1);
+    assert(clox_vm_chunk_get_line(&chunk, count) == 1);
+    assert(clox_vm_chunk_get_line(&chunk, count - 2) == 70000);
+
+    clox_vm_chunk_free(&chunk);
+}
+
+static void test_lines_size(void) {
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+
+    // a typical statement: a handful of codes per line
+    for (size_t line = 1; line <= 1000; line++) {
+        for (size_t i = 0; i < 6; i++) {
+            clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_POP, line);
+        }
+    }
+    // one entry per line, instead of a size_t per code
+    assert(chunk.lines_count == 2 * 1000);
+    assert(chunk.lines_count * 10 < chunk.codes_count * sizeof(size_t));
+
+    clox_vm_chunk_free(&chunk);
+}
+
+static void test_constants(void) {
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+
+    assert(clox_vm_chunk_add_constant(&chunk, clox_value_number_compact(1)) == 0);
+    assert(clox_vm_chunk_add_constant(&chunk, clox_value_string_from_strview(strview_from_cstr("a", 1))) == 1);
+    assert(clox_vm_chunk_add_constant(&chunk, clox_value_number_compact(0)) == 2);
+    // same values, same entries
+    assert(clox_vm_chunk_add_constant(&chunk, clox_value_number_compact(1)) == 0);
+    assert(clox_vm_chunk_add_constant(&chunk, clox_value_string_from_strview(strview_from_cstr("a", 1))) == 1);
+    // they compare equal, but print differently
+    assert(clox_vm_chunk_add_constant(&chunk, clox_value_number_compact(-0.0)) == 3);
+    assert(clox_vm_chunk_add_constant(&chunk, clox_value_number_compact(-0.0)) == 3);
+    // only numbers and strings are shared
+    assert(clox_vm_chunk_add_constant(&chunk, clox_value_nil()) == 4);
+    assert(clox_vm_chunk_add_constant(&chunk, clox_value_nil()) == 5);
+    assert(chunk.constants.count == 6);
+
+    // indexes past a byte take the _LONG instruction
+    for (size_t i = 6; i < 300; i++) {
+        assert(clox_vm_chunk_add_constant(&chunk, clox_value_number_compact((double) i)) == i);
+    }
+    assert(clox_vm_chunk_write_constant_op(&chunk, CLOX_VM_OP_CODE_CONSTANT, 255, 1) == 0);
+    assert(clox_vm_chunk_write_constant_op(&chunk, CLOX_VM_OP_CODE_GET_GLOBAL, 0x10203, 1) == 0);
+    assert(clox_vm_chunk_write_constant_op(&chunk, CLOX_VM_OP_CODE_CONSTANT, CLOX_VM_CHUNK_CONSTANTS_MAX, 1) != 0);
+    assert(chunk.codes_count == 2 + 4);
+    assert(chunk.codes[0] == CLOX_VM_OP_CODE_CONSTANT && chunk.codes[1] == 255);
+    assert(chunk.codes[2] == CLOX_VM_OP_CODE_GET_GLOBAL_LONG);
+    assert(chunk.codes[3] == 0x03 && chunk.codes[4] == 0x02 && chunk.codes[5] == 0x01);
+
+    clox_vm_chunk_free(&chunk);
+}
+
+int main() {
+    test_lines();
+    test_lines_size();
+    test_constants();
+
+    puts("chunk.unit: ok");
+}
@@ -0,0 +1,465 @@
+#include "compiler-single-pass.h"
+
+#include "chunk.h"
+
+#include <clox/stb_ds.h>
+#include <clox/token.h>
+
+/**
+ * @brief Binding power of the operators, lowest first
+ */
+enum precedence {
+    PRECEDENCE_NONE,
+    PRECEDENCE_ASSIGNMENT,  // =
+    PRECEDENCE_EQUALITY,    // == !=
+    PRECEDENCE_COMPARISON,  // < > <= >=
+    PRECEDENCE_TERM,        // + -
+    PRECEDENCE_FACTOR,      // * /
+    PRECEDENCE_UNARY,       // ! -
+    PRECEDENCE_PRIMARY,
+};
+
+/**
+ * @brief A block local in scope. Same as struct parser_local
+ */
+struct single_pass_local {
+    struct strview name;
+    /**
+     * @brief Nesting depth of the block where it's declared. -1 while its own initializer is being compiled
+     */
+    int depth;
+};
+
+struct single_pass_compiler {
+    const struct token* tokens;
+    size_t current;
+    struct clox_vm_chunk* chunk;
+    /**
+     * @brief Dynamic array (stb_ds) of the locals in scope, innermost last. The index of a local is its VM stack slot
+     */
+    struct single_pass_local* locals;
+    /**
+     * @brief Current block nesting depth. 0 is the global scope
+     */
+    int scope_depth;
+};
+
+/**
+ * @brief Compiles an expression starting with the token just consumed
+ * 
+ * @param can_assign whether the expression may be the target of an assignment
+ */
+typedef int (*parse_fn)(struct single_pass_compiler* c, bool can_assign);
+
+struct parse_rule {
+    /**
+     * @brief Compiles the expressions starting with the token. NULL if no expression starts with it
+     */
+    parse_fn prefix;
+    /**
+     * @brief Compiles the operator, whose left operand was already compiled. NULL if the token isn't an operator
+     */
+    parse_fn infix;
+    enum precedence precedence;
+};
+
+static int expression(struct single_pass_compiler* c);
+static int parse_precedence(struct single_pass_compiler* c, enum precedence precedence);
+static int grouping(struct single_pass_compiler* c, bool can_assign);
+static int unary(struct single_pass_compiler* c, bool can_assign);
+static int binary(struct single_pass_compiler* c, bool can_assign);
+static int number(struct single_pass_compiler* c, bool can_assign);
+static int string(struct single_pass_compiler* c, bool can_assign);
+static int literal(struct single_pass_compiler* c, bool can_assign);
+static int variable(struct single_pass_compiler* c, bool can_assign);
+
+static int declaration(struct single_pass_compiler* c);
+static int var_declaration(struct single_pass_compiler* c);
+static int statement(struct single_pass_compiler* c);
+static int print_statement(struct single_pass_compiler* c);
+static int block(struct single_pass_compiler* c);
+static int expression_statement(struct single_pass_compiler* c);
+
+static const struct parse_rule rules[] = {
+    [TOKEN_KIND_LEFT_PAREN]    = { grouping, NULL,   PRECEDENCE_NONE },
+    [TOKEN_KIND_MINUS]         = { unary,    binary, PRECEDENCE_TERM },
+    [TOKEN_KIND_PLUS]          = { NULL,     binary, PRECEDENCE_TERM },
+    [TOKEN_KIND_SLASH]         = { NULL,     binary, PRECEDENCE_FACTOR },
+    [TOKEN_KIND_STAR]          = { NULL,     binary, PRECEDENCE_FACTOR },
+    [TOKEN_KIND_BANG]          = { unary,    NULL,   PRECEDENCE_NONE },
+    [TOKEN_KIND_BANG_EQUAL]    = { NULL,     binary, PRECEDENCE_EQUALITY },
+    [TOKEN_KIND_EQUAL_EQUAL]   = { NULL,     binary, PRECEDENCE_EQUALITY },
+    [TOKEN_KIND_GREATER]       = { NULL,     binary, PRECEDENCE_COMPARISON },
+    [TOKEN_KIND_GREATER_EQUAL] = { NULL,     binary, PRECEDENCE_COMPARISON },
+    [TOKEN_KIND_LESS]          = { NULL,     binary, PRECEDENCE_COMPARISON },
+    [TOKEN_KIND_LESS_EQUAL]    = { NULL,     binary, PRECEDENCE_COMPARISON },
+    [TOKEN_KIND_IDENTIFIER]    = { variable, NULL,   PRECEDENCE_NONE },
+    [TOKEN_KIND_STRING]        = { string,   NULL,   PRECEDENCE_NONE },
+    [TOKEN_KIND_NUMBER]        = { number,   NULL,   PRECEDENCE_NONE },
+    [TOKEN_KIND_FALSE]         = { literal,  NULL,   PRECEDENCE_NONE },
+    [TOKEN_KIND_NIL]           = { literal,  NULL,   PRECEDENCE_NONE },
+    [TOKEN_KIND_TRUE]          = { literal,  NULL,   PRECEDENCE_NONE },
+    // every other token is zeroed, i.e. it has no rules
+    [TOKEN_KIND_WHILE]         = { NULL,     NULL,   PRECEDENCE_NONE },
+};
+
+static const struct parse_rule* get_rule(enum token_kind kind) {
+    return &rules[kind];
+}
+
+static const struct token* peek(const struct single_pass_compiler* c) {
+    return &c->tokens[c->current];
+}
+
+static const struct token* previous(const struct single_pass_compiler* c) {
+    return &c->tokens[c->current - 1];
+}
+
+static bool check(const struct single_pass_compiler* c, enum token_kind kind) {
+    return peek(c)->kind == kind;
+}
+
+static void advance(struct single_pass_compiler* c) {
+    if (!check(c, TOKEN_KIND_EOF)) {
+        c->current++;
+    }
+}
+
+static bool match(struct single_pass_compiler* c, enum token_kind kind) {
+    if (!check(c, kind)) {
+        return false;
+    }
+    advance(c);
+    return true;
+}
+
+static int consume(struct single_pass_compiler* c, enum token_kind kind, const char* msg) {
+    if (match(c, kind)) {
+        return 0;
+    }
+    fprintf(stderr, "error: line %zu: %s: expected token %s, got %s\n",
+        peek(c)->line, msg, token_kind_to_cstr(kind), token_to_cstr(peek(c)));
+    return 1;
+}
+
+static void emit_byte_at(struct single_pass_compiler* c, uint8_t byte, size_t line) {
+    clox_vm_chunk_write(c->chunk, byte, line);
+}
+
+/**
+ * @brief Emits a byte attributed to the line of the last consumed token
+ */
+static void emit_byte(struct single_pass_compiler* c, uint8_t byte) {
+    emit_byte_at(c, byte, previous(c)->line);
+}
+
+/**
+ * @brief Adds a constant to the chunk, which takes it over, and emits an instruction referring to it
+ */
+static int emit_constant_op_at(struct single_pass_compiler* c, enum clox_vm_op_code op_code, clox_vm_value value,
+    size_t line) {
+    size_t index = clox_vm_chunk_add_constant(c->chunk, value);
+    if (clox_vm_chunk_write_constant_op(c->chunk, op_code, index, line) != 0) {
+        fprintf(stderr, "error: line %zu: too many constants in one chunk\n", line);
+        return 1;
+    }
+    return 0;
+}
+
+static int emit_constant(struct single_pass_compiler* c, clox_vm_value value) {
+    return emit_constant_op_at(c, CLOX_VM_OP_CODE_CONSTANT, value, previous(c)->line);
+}
+
+static int emit_named(struct single_pass_compiler* c, enum clox_vm_op_code op_code, struct strview name) {
+    return emit_constant_op_at(c, op_code, clox_value_string_from_strview(name), previous(c)->line);
+}
+
+/**
+ * @brief Resolves a variable name to the slot of the innermost local in scope with that name. Same as the parser's.
+ *
+ * @param slot set to the local slot, or -1 if no local has that name
+ * @return int non-zero if the name refers to a local being declared (i.e. it's read from its own initializer)
+ */
+static int resolve_local(const struct single_pass_compiler* c, const struct token* name, long* slot) {
+    for (long i = arrlen(c->locals) - 1; i >= 0; i--) {
+        if (strview_equals(c->locals[i].name, name->lexeme)) {
+            if (c->locals[i].depth == -1) {
+                fprintf(stderr, "error: line %zu: can't read local variable '%.*s' in its own initializer\n",
+                    name->line, (int) name->lexeme.len, name->lexeme.ptr);
+                return 1;
+            }
+            *slot = i;
+            return 0;
+        }
+    }
+    *slot = -1;
+    return 0;
+}
+
+static int expression(struct single_pass_compiler* c) {
+    return parse_precedence(c, PRECEDENCE_ASSIGNMENT);
+}
+
+/**
+ * @brief Compiles an expression made of the operators binding at least as tight as precedence
+ */
+static int parse_precedence(struct single_pass_compiler* c, enum precedence precedence) {
+    advance(c);
+    parse_fn prefix = get_rule(previous(c)->kind)->prefix;
+    if (prefix == NULL) {
+        fprintf(stderr, "error: line %zu: expecting a primary expression (a literal or an opening parentesis '('), got '%s'\n",
+            previous(c)->line, token_to_cstr(previous(c)));
+        return 1;
+    }
+
+    // `a + b = c` must not be compiled as `a + (b = c)`
+    const bool can_assign = precedence <= PRECEDENCE_ASSIGNMENT;
+    if (prefix(c, can_assign) != 0) {
+        return 1;
+    }
+
+    while (precedence <= get_rule(peek(c)->kind)->precedence) {
+        advance(c);
+        if (get_rule(previous(c)->kind)->infix(c, can_assign) != 0) {
+            return 1;
+        }
+    }
+
+    if (can_assign && check(c, TOKEN_KIND_EQUAL)) {
+        fprintf(stderr, "error: line: %zu: invalid l-value expression for assignment\n", peek(c)->line);
+        return 1;
+    }
+    return 0;
+}
+
+static int grouping(struct single_pass_compiler* c, bool can_assign) {
+    (void) can_assign;
+    if (expression(c) != 0) {
+        return 1;
+    }
+    return consume(c, TOKEN_KIND_RIGHT_PAREN, "expect ')' after expression");
+}
+
+static int unary(struct single_pass_compiler* c, bool can_assign) {
+    (void) can_assign;
+    const struct token operator = *previous(c);
+
+    if (parse_precedence(c, PRECEDENCE_UNARY) != 0) {
+        return 1;
+    }
+    emit_byte_at(c, (operator.kind == TOKEN_KIND_MINUS) ? CLOX_VM_OP_CODE_NEGATE : CLOX_VM_OP_CODE_NOT, operator.line);
+    return 0;
+}
+
+static int binary(struct single_pass_compiler* c, bool can_assign) {
+    (void) can_assign;
+    const struct token operator = *previous(c);
+
+    // binary operators are left associative, so the right operand only takes the tighter ones
+    if (parse_precedence(c, get_rule(operator.kind)->precedence + 1) != 0) {
+        return 1;
+    }
+
+    // The runtime errors point at the operator
+    switch (operator.kind) {
+    case TOKEN_KIND_PLUS:          emit_byte_at(c, CLOX_VM_OP_CODE_ADD, operator.line); break;
+    case TOKEN_KIND_MINUS:         emit_byte_at(c, CLOX_VM_OP_CODE_SUBTRACT, operator.line); break;
+    case TOKEN_KIND_STAR:          emit_byte_at(c, CLOX_VM_OP_CODE_MULTIPLY, operator.line); break;
+    case TOKEN_KIND_SLASH:         emit_byte_at(c, CLOX_VM_OP_CODE_DIVIDE, operator.line); break;
+    case TOKEN_KIND_GREATER:       emit_byte_at(c, CLOX_VM_OP_CODE_GREATER, operator.line); break;
+    case TOKEN_KIND_GREATER_EQUAL: emit_byte_at(c, CLOX_VM_OP_CODE_GREATER_EQUAL, operator.line); break;
+    case TOKEN_KIND_LESS:          emit_byte_at(c, CLOX_VM_OP_CODE_LESS, operator.line); break;
+    case TOKEN_KIND_LESS_EQUAL:    emit_byte_at(c, CLOX_VM_OP_CODE_LESS_EQUAL, operator.line); break;
+    case TOKEN_KIND_EQUAL_EQUAL:   emit_byte_at(c, CLOX_VM_OP_CODE_EQUAL, operator.line); break;
+    case TOKEN_KIND_BANG_EQUAL:
+        emit_byte_at(c, CLOX_VM_OP_CODE_EQUAL, operator.line);
+        emit_byte_at(c, CLOX_VM_OP_CODE_NOT, operator.line);
+        break;
+    default:
+        return 1;
+    }
+    return 0;
+}
+
+static int number(struct single_pass_compiler* c, bool can_assign) {
+    (void) can_assign;
+    return emit_constant(c, clox_value_number_compact(previous(c)->value.number.val));
+}
+
+static int string(struct single_pass_compiler* c, bool can_assign) {
+    (void) can_assign;
+    return emit_constant(c, clox_value_string_from_strview(previous(c)->value.string.val));
+}
+
+static int literal(struct single_pass_compiler* c, bool can_assign) {
+    (void) can_assign;
+    switch (previous(c)->kind) {
+    case TOKEN_KIND_FALSE: emit_byte(c, CLOX_VM_OP_CODE_FALSE); break;
+    case TOKEN_KIND_TRUE:  emit_byte(c, CLOX_VM_OP_CODE_TRUE); break;
+    case TOKEN_KIND_NIL:   emit_byte(c, CLOX_VM_OP_CODE_NIL); break;
+    default:
+        return 1;
+    }
+    return 0;
+}
+
+static int variable(struct single_pass_compiler* c, bool can_assign) {
+    const struct token name = *previous(c);
+
+    long slot;
+    if (resolve_local(c, &name, &slot) != 0) {
+        return 1;
+    }
+
+    uint8_t get_op = CLOX_VM_OP_CODE_GET_GLOBAL;
+    uint8_t set_op = CLOX_VM_OP_CODE_SET_GLOBAL;
+    if (slot != -1) {
+        get_op = CLOX_VM_OP_CODE_GET_LOCAL;
+        set_op = CLOX_VM_OP_CODE_SET_LOCAL;
+    }
+
+    uint8_t op = get_op;
+    if (can_assign && match(c, TOKEN_KIND_EQUAL)) {
+        // assignment is right associative
+        if (expression(c) != 0) {
+            return 1;
+        }
+        op = set_op;
+    }
+
+    if (slot != -1) {
+        // locals can't outnumber the slots, see var_declaration
+        emit_byte_at(c, op, name.line);
+        emit_byte_at(c, (uint8_t) slot, name.line);
+        return 0;
+    }
+
+    return emit_constant_op_at(c, op, clox_value_string_from_strview(name.lexeme), name.line);
+}
+
+static int declaration(struct single_pass_compiler* c) {
+    if (match(c, TOKEN_KIND_VAR)) {
+        return var_declaration(c);
+    }
+    return statement(c);
+}
+
+static int var_declaration(struct single_pass_compiler* c) {
+    if (consume(c, TOKEN_KIND_IDENTIFIER, "error: expecting variable name") != 0) {
+        return 1;
+    }
+    const struct token name = *previous(c);
+
+    long slot = -1;
+    if (c->scope_depth > 0) {
+        for (long i = arrlen(c->locals) - 1; i >= 0 && c->locals[i].depth >= c->scope_depth; i--) {
+            if (strview_equals(c->locals[i].name, name.lexeme)) {
+                fprintf(stderr, "error: line %zu: a variable named '%.*s' is already declared in this scope\n",
+                    name.line, (int) name.lexeme.len, name.lexeme.ptr);
+                return 1;
+            }
+        }
+        slot = arrlen(c->locals);
+        if (slot > UINT8_MAX) {
+            fprintf(stderr, "error: line %zu: too many local variables in scope\n", name.line);
+            return 1;
+        }
+        // Declared right away, so reading it from its own initializer can be told apart from reading a shadowed one
+        arrpush(c->locals, ((struct single_pass_local) { .name = name.lexeme, .depth = -1 }));
+    }
+
+    if (match(c, TOKEN_KIND_EQUAL)) {
+        if (expression(c) != 0) {
+            return 1;
+        }
+    } else {
+        emit_byte_at(c, CLOX_VM_OP_CODE_NIL, name.line);
+    }
+
+    if (consume(c, TOKEN_KIND_SEMICOLON, "error: expecting ';' after variable declaration") != 0) {
+        return 1;
+    }
+
+    if (slot != -1) {
+        // The initializer value is left on the stack, right where the local lives from now on
+        c->locals[slot].depth = c->scope_depth;
+        return 0;
+    }
+    return emit_named(c, CLOX_VM_OP_CODE_DEFINE_GLOBAL, name.lexeme);
+}
+
+static int statement(struct single_pass_compiler* c) {
+    if (match(c, TOKEN_KIND_PRINT)) {
+        return print_statement(c);
+    }
+    if (match(c, TOKEN_KIND_LEFT_BRACE)) {
+        return block(c);
+    }
+    return expression_statement(c);
+}
+
+static int print_statement(struct single_pass_compiler* c) {
+    if (expression(c) != 0
+        || consume(c, TOKEN_KIND_SEMICOLON, "error: expecting ';' after print expression operand") != 0)
+    {
+        return 1;
+    }
+    emit_byte(c, CLOX_VM_OP_CODE_PRINT);
+    return 0;
+}
+
+// block -> "{" declaration* "}"
+static int block(struct single_pass_compiler* c) {
+    const long first_slot = arrlen(c->locals);
+
+    c->scope_depth++;
+    while (!check(c, TOKEN_KIND_RIGHT_BRACE) && !check(c, TOKEN_KIND_EOF)) {
+        if (declaration(c) != 0) {
+            return 1;
+        }
+    }
+    c->scope_depth--;
+
+    if (consume(c, TOKEN_KIND_RIGHT_BRACE, "error: expecting '}' after block") != 0) {
+        return 1;
+    }
+
+    // Leaving the scope drops its locals
+    for (long i = first_slot; i < arrlen(c->locals); i++) {
+        emit_byte(c, CLOX_VM_OP_CODE_POP);
+    }
+    arrsetlen(c->locals, first_slot);
+    return 0;
+}
+
+static int expression_statement(struct single_pass_compiler* c) {
+    if (expression(c) != 0 || consume(c, TOKEN_KIND_SEMICOLON, "error: expecting ';' after expression") != 0) {
+        return 1;
+    }
+    // The expression value is discarded
+    emit_byte(c, CLOX_VM_OP_CODE_POP);
+    return 0;
+}
+
+int clox_vm_compile_tokens(const struct token* tokens, struct clox_vm_chunk* chunk) {
+    struct single_pass_compiler c = {
+        .tokens = tokens,
+        .current = 0,
+        .chunk = chunk,
+        .locals = NULL,
+        .scope_depth = 0,
+    };
+
+    int rc = 0;
+    while (!check(&c, TOKEN_KIND_EOF)) {
+        if (declaration(&c) != 0) {
+            fprintf(stderr, "error: line %zu: failed to compile statement\n", peek(&c)->line);
+            rc = 1;
+            break;
+        }
+    }
+    emit_byte_at(&c, CLOX_VM_OP_CODE_RETURN, peek(&c)->line);
+
+    arrfree(c.locals);
+    return rc;
+}
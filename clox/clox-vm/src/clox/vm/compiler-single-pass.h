@@ -0,0 +1,24 @@
+#ifndef CLOX_VM_COMPILER_SINGLE_PASS_H
+#define CLOX_VM_COMPILER_SINGLE_PASS_H
+
+#include "common.h"
+
+struct token;
+struct clox_vm_chunk;
+
+/**
+ * @brief Compiles the scanned tokens of a script straight into bytecode, appending it to the chunk followed by a
+ * return instruction.
+ * 
+ * Unlike clox_vm_compile, no AST is built: it's a single pass Pratt compiler which emits code while parsing. It
+ * accepts the very same language as the parser, resolving block locals to the same stack slots, so both front ends
+ * produce equivalent chunks. The optimizer can't run without an AST, so constants aren't propagated.
+ * 
+ * @param tokens the scanner tokens, terminated by an EOF token
+ * @param chunk 
+ * @return int 0 on success. non-zero on syntax errors or if the script exceeds the chunk limits, reported to stderr.
+ * The chunk contents are meaningless then
+ */
+int clox_vm_compile_tokens(const struct token* tokens, struct clox_vm_chunk* chunk);
+
+#endif
@@ -0,0 +1,359 @@
+#include "compiler.h"
+
+#include "chunk.h"
+
+#include <assert.h>
+
+#include <clox/stb_ds.h>
+#include <clox/ast/expr.h>
+#include <clox/ast/expr-visitor.h>
+#include <clox/ast/statement.h>
+#include <clox/ast/statement-visitor.h>
+#include <clox/ast/program.h>
+
+/**
+ * @brief An expression pending compilation. Same as the AST interpreter frames, see struct clox_interpreter_eval_frame
+ */
+struct compiler_frame {
+    struct clox_ast_expr* expr;
+    size_t next_child;
+};
+
+struct compiler {
+    struct clox_vm_chunk* chunk;
+    /**
+     * @brief Line of the code being compiled. Only some nodes have tokens, so the others inherit the line of the
+     * closest enclosing one
+     */
+    size_t line;
+    /**
+     * @brief How many block locals are in scope, i.e. the VM stack height between statements
+     */
+    uint32_t local_count;
+    /**
+     * @brief Dynamic array (stb_ds) of the expressions pending compilation
+     */
+    struct compiler_frame* frames;
+};
+
+static int compile_expr_binary(struct clox_ast_expr* expr, void* userctx);
+static int compile_expr_grouping(struct clox_ast_expr* expr, void* userctx);
+static int compile_expr_literal(struct clox_ast_expr* expr, void* userctx);
+static int compile_expr_unary(struct clox_ast_expr* expr, void* userctx);
+static int compile_expr_var(struct clox_ast_expr* expr, void* userctx);
+static int compile_expr_assign(struct clox_ast_expr* expr, void* userctx);
+static int compile_expr_concat(struct clox_ast_expr* expr, void* userctx);
+
+static int compile_statement_expr(struct clox_ast_statement* stmt, void* userctx);
+static int compile_statement_print(struct clox_ast_statement* stmt, void* userctx);
+static int compile_statement_var(struct clox_ast_statement* stmt, void* userctx);
+static int compile_statement_block(struct clox_ast_statement* stmt, void* userctx);
+
+static const struct clox_ast_expr_visitor compiler_expr_visitor = {
+    .visit_binary = compile_expr_binary,
+    .visit_grouping = compile_expr_grouping,
+    .visit_literal = compile_expr_literal,
+    .visit_unary = compile_expr_unary,
+    .visit_var = compile_expr_var,
+    .visit_assign = compile_expr_assign,
+    .visit_concat = compile_expr_concat,
+};
+
+static const struct clox_ast_statement_visitor compiler_statement_visitor = {
+    .visit_statement_expr = compile_statement_expr,
+    .visit_statement_print = compile_statement_print,
+    .visit_statement_var = compile_statement_var,
+    .visit_statement_block = compile_statement_block,
+};
+
+static void emit_byte(struct compiler* compiler, uint8_t byte) {
+    clox_vm_chunk_write(compiler->chunk, byte, compiler->line);
+}
+
+static void emit_bytes(struct compiler* compiler, uint8_t byte1, uint8_t byte2) {
+    emit_byte(compiler, byte1);
+    emit_byte(compiler, byte2);
+}
+
+/**
+ * @brief Adds a constant to the chunk, which takes it over, and emits an instruction referring to it
+ * 
+ * @return int 0 on success. non-zero if the chunk constants don't fit the instruction operand anymore
+ */
+static int emit_constant_op(struct compiler* compiler, enum clox_vm_op_code op_code, clox_vm_value value) {
+    size_t index = clox_vm_chunk_add_constant(compiler->chunk, value);
+    if (clox_vm_chunk_write_constant_op(compiler->chunk, op_code, index, compiler->line) != 0) {
+        fprintf(stderr, "error: line %zu: too many constants in one chunk\n", compiler->line);
+        return 1;
+    }
+    return 0;
+}
+
+static int emit_constant(struct compiler* compiler, clox_vm_value value) {
+    return emit_constant_op(compiler, CLOX_VM_OP_CODE_CONSTANT, value);
+}
+
+/**
+ * @brief Emits an instruction whose operand is the constant with a variable name
+ */
+static int emit_named(struct compiler* compiler, enum clox_vm_op_code op_code, const struct token* name) {
+    return emit_constant_op(compiler, op_code, clox_value_string_from_strview(name->lexeme));
+}
+
+static int emit_local(struct compiler* compiler, uint8_t op_code, int32_t slot) {
+    if (slot > UINT8_MAX) {
+        fprintf(stderr, "error: line %zu: too many local variables in scope\n", compiler->line);
+        return 1;
+    }
+    emit_bytes(compiler, op_code, (uint8_t) slot);
+    return 0;
+}
+
+/**
+ * @return size_t the line of the expression own token, or fallback if it has none
+ */
+static size_t expr_line(const struct clox_ast_expr* expr, size_t fallback) {
+    switch (expr->kind) {
+    case CLOX_AST_EXPR_KIND_BINARY:
+        return expr->value.binary.operator.line;
+    case CLOX_AST_EXPR_KIND_UNARY:
+        return expr->value.unary.operator.line;
+    case CLOX_AST_EXPR_KIND_VAR:
+        return expr->value.var.name.line;
+    case CLOX_AST_EXPR_KIND_ASSIGN:
+        return expr->value.assign.name.line;
+    case CLOX_AST_EXPR_KIND_CONCAT:
+        return expr->value.concat.operators[0].line;
+    default:
+        return fallback;
+    }
+}
+
+/**
+ * @brief Compiles an expression into the code leaving its value on the top of the VM stack.
+ * 
+ * Like the AST interpreter evaluation, it's a postorder traversal with an explicit stack, so long chains
+ * (e.g. `a + b + c + ...`) don't exhaust the C stack. The visitors emit the code of a node after its children's.
+ */
+static int compile_expr(struct compiler* compiler, struct clox_ast_expr* expr) {
+    const long frames_base = arrlen(compiler->frames);
+    const size_t line = compiler->line;
+
+    arrpush(compiler->frames, ((struct compiler_frame) { .expr = expr, .next_child = 0 }));
+    while (arrlen(compiler->frames) > frames_base) {
+        struct compiler_frame* frame = &arrlast(compiler->frames);
+        if (frame->next_child == 0) {
+            compiler->line = expr_line(frame->expr, compiler->line);
+        }
+
+        struct clox_ast_expr* child = clox_ast_expr_child(frame->expr, frame->next_child);
+        if (child != NULL) {
+            // A concat node is a chain of `+`, so every operand after the second one is joined to the result so far
+            // right after being evaluated
+            if (frame->expr->kind == CLOX_AST_EXPR_KIND_CONCAT && frame->next_child >= 2) {
+                compiler->line = frame->expr->value.concat.operators[frame->next_child - 2].line;
+                emit_byte(compiler, CLOX_VM_OP_CODE_ADD);
+            }
+            frame->next_child++;
+            arrpush(compiler->frames, ((struct compiler_frame) { .expr = child, .next_child = 0 }));
+            continue;
+        }
+
+        struct clox_ast_expr* ready = arrpop(compiler->frames).expr;
+        // the children may have moved the line forward
+        compiler->line = expr_line(ready, compiler->line);
+        int rc = clox_ast_expr_accept(ready, &compiler_expr_visitor, compiler);
+        if (rc != 0) {
+            arrsetlen(compiler->frames, frames_base);
+            return rc;
+        }
+    }
+
+    compiler->line = line;
+    return 0;
+}
+
+static int compile_expr_binary(struct clox_ast_expr* expr, void* userctx) {
+    struct compiler* compiler = userctx;
+
+    switch (expr->value.binary.operator.kind) {
+    case TOKEN_KIND_PLUS:          emit_byte(compiler, CLOX_VM_OP_CODE_ADD); break;
+    case TOKEN_KIND_MINUS:         emit_byte(compiler, CLOX_VM_OP_CODE_SUBTRACT); break;
+    case TOKEN_KIND_STAR:          emit_byte(compiler, CLOX_VM_OP_CODE_MULTIPLY); break;
+    case TOKEN_KIND_SLASH:         emit_byte(compiler, CLOX_VM_OP_CODE_DIVIDE); break;
+    case TOKEN_KIND_GREATER:       emit_byte(compiler, CLOX_VM_OP_CODE_GREATER); break;
+    case TOKEN_KIND_GREATER_EQUAL: emit_byte(compiler, CLOX_VM_OP_CODE_GREATER_EQUAL); break;
+    case TOKEN_KIND_LESS:          emit_byte(compiler, CLOX_VM_OP_CODE_LESS); break;
+    case TOKEN_KIND_LESS_EQUAL:    emit_byte(compiler, CLOX_VM_OP_CODE_LESS_EQUAL); break;
+    case TOKEN_KIND_EQUAL_EQUAL:   emit_byte(compiler, CLOX_VM_OP_CODE_EQUAL); break;
+    case TOKEN_KIND_BANG_EQUAL:    emit_bytes(compiler, CLOX_VM_OP_CODE_EQUAL, CLOX_VM_OP_CODE_NOT); break;
+    default:
+        fprintf(stderr, "error: line %zu: unknown binary operator '%.*s'\n", compiler->line,
+            (int) expr->value.binary.operator.lexeme.len, expr->value.binary.operator.lexeme.ptr);
+        return 1;
+    }
+    return 0;
+}
+
+static int compile_expr_grouping(struct clox_ast_expr* expr, void* userctx) {
+    (void) expr;
+    (void) userctx;
+    // the grouped expression value is already on the stack
+    return 0;
+}
+
+static int compile_expr_literal(struct clox_ast_expr* expr, void* userctx) {
+    struct compiler* compiler = userctx;
+    struct clox_ast_expr_literal* lit = &expr->value.literal;
+
+    switch (lit->kind) {
+    case CLOX_AST_EXPR_LITERAL_KIND_NUMBER:
+        return emit_constant(compiler, clox_value_number_compact(lit->value.number.val));
+    case CLOX_AST_EXPR_LITERAL_KIND_STRING:
+        // shared with the AST
+        return emit_constant(compiler, clox_value_string(rcstr_retain(lit->value.string.val)));
+    case CLOX_AST_EXPR_LITERAL_KIND_BOOL:
+        emit_byte(compiler, lit->value.boolean.val ? CLOX_VM_OP_CODE_TRUE : CLOX_VM_OP_CODE_FALSE);
+        return 0;
+    case CLOX_AST_EXPR_LITERAL_KIND_NIL:
+        emit_byte(compiler, CLOX_VM_OP_CODE_NIL);
+        return 0;
+    }
+    return 1;
+}
+
+static int compile_expr_unary(struct clox_ast_expr* expr, void* userctx) {
+    struct compiler* compiler = userctx;
+
+    switch (expr->value.unary.operator.kind) {
+    case TOKEN_KIND_MINUS: emit_byte(compiler, CLOX_VM_OP_CODE_NEGATE); break;
+    case TOKEN_KIND_BANG:  emit_byte(compiler, CLOX_VM_OP_CODE_NOT); break;
+    default:
+        fprintf(stderr, "error: line %zu: unknown unary operator '%.*s'\n", compiler->line,
+            (int) expr->value.unary.operator.lexeme.len, expr->value.unary.operator.lexeme.ptr);
+        return 1;
+    }
+    return 0;
+}
+
+static int compile_expr_var(struct clox_ast_expr* expr, void* userctx) {
+    struct compiler* compiler = userctx;
+    struct clox_ast_expr_var* var = &expr->value.var;
+
+    if (var->slot != CLOX_AST_SLOT_GLOBAL) {
+        return emit_local(compiler, CLOX_VM_OP_CODE_GET_LOCAL, var->slot);
+    }
+    return emit_named(compiler, CLOX_VM_OP_CODE_GET_GLOBAL, &var->name);
+}
+
+static int compile_expr_assign(struct clox_ast_expr* expr, void* userctx) {
+    struct compiler* compiler = userctx;
+    struct clox_ast_expr_assign* assign = &expr->value.assign;
+
+    if (assign->slot != CLOX_AST_SLOT_GLOBAL) {
+        return emit_local(compiler, CLOX_VM_OP_CODE_SET_LOCAL, assign->slot);
+    }
+    return emit_named(compiler, CLOX_VM_OP_CODE_SET_GLOBAL, &assign->name);
+}
+
+static int compile_expr_concat(struct clox_ast_expr* expr, void* userctx) {
+    struct compiler* compiler = userctx;
+    // the operands before the last one were already joined by compile_expr
+    compiler->line = arrlast(expr->value.concat.operators).line;
+    emit_byte(compiler, CLOX_VM_OP_CODE_ADD);
+    return 0;
+}
+
+static int compile_statement(struct compiler* compiler, struct clox_ast_statement* stmt) {
+    return clox_ast_statement_accept(stmt, &compiler_statement_visitor, compiler);
+}
+
+static int compile_statement_expr(struct clox_ast_statement* stmt, void* userctx) {
+    struct compiler* compiler = userctx;
+
+    // statements have no token of their own, the code discarding the value belongs to the expression line
+    compiler->line = expr_line(stmt->as.expr_statement.expr, compiler->line);
+    if (compile_expr(compiler, stmt->as.expr_statement.expr) != 0) {
+        return 1;
+    }
+    // The expression value is discarded
+    emit_byte(compiler, CLOX_VM_OP_CODE_POP);
+    return 0;
+}
+
+static int compile_statement_print(struct clox_ast_statement* stmt, void* userctx) {
+    struct compiler* compiler = userctx;
+
+    compiler->line = expr_line(stmt->as.print_statement.expr, compiler->line);
+    if (compile_expr(compiler, stmt->as.print_statement.expr) != 0) {
+        return 1;
+    }
+    emit_byte(compiler, CLOX_VM_OP_CODE_PRINT);
+    return 0;
+}
+
+static int compile_statement_var(struct clox_ast_statement* stmt, void* userctx) {
+    struct compiler* compiler = userctx;
+    struct clox_ast_statement_var* var_stmt = &stmt->as.var_statement;
+
+    compiler->line = var_stmt->name.line;
+    if (var_stmt->initializer != NULL) {
+        if (compile_expr(compiler, var_stmt->initializer) != 0) {
+            return 1;
+        }
+    } else {
+        emit_byte(compiler, CLOX_VM_OP_CODE_NIL);
+    }
+
+    if (var_stmt->slot != CLOX_AST_SLOT_GLOBAL) {
+        // The initializer value is left on the stack, right where the local lives from now on
+        assert((uint32_t) var_stmt->slot == compiler->local_count);
+        if (var_stmt->slot > UINT8_MAX) {
+            fprintf(stderr, "error: line %zu: too many local variables in scope\n", compiler->line);
+            return 1;
+        }
+        compiler->local_count++;
+        return 0;
+    }
+    return emit_named(compiler, CLOX_VM_OP_CODE_DEFINE_GLOBAL, &var_stmt->name);
+}
+
+static int compile_statement_block(struct clox_ast_statement* stmt, void* userctx) {
+    struct compiler* compiler = userctx;
+    struct clox_ast_statement_block* block_stmt = &stmt->as.block_statement;
+
+    assert(block_stmt->first_slot == compiler->local_count);
+    for (long i = 0; i < arrlen(block_stmt->statements); i++) {
+        if (compile_statement(compiler, block_stmt->statements[i]) != 0) {
+            return 1;
+        }
+    }
+
+    // Leaving the scope drops its locals
+    for (uint32_t i = 0; i < block_stmt->slot_count; i++) {
+        emit_byte(compiler, CLOX_VM_OP_CODE_POP);
+    }
+    compiler->local_count -= block_stmt->slot_count;
+    return 0;
+}
+
+int clox_vm_compile(struct clox_ast_program* prog, struct clox_vm_chunk* chunk) {
+    struct compiler compiler = {
+        .chunk = chunk,
+        .line = 1,
+        .local_count = 0,
+        .frames = NULL,
+    };
+
+    int rc = 0;
+    for (long i = 0; i < arrlen(prog->statements); i++) {
+        rc = compile_statement(&compiler, prog->statements[i]);
+        if (rc != 0) {
+            break;
+        }
+    }
+    emit_byte(&compiler, CLOX_VM_OP_CODE_RETURN);
+
+    arrfree(compiler.frames);
+    return rc;
+}
@@ -0,0 +1,22 @@
+#ifndef CLOX_VM_COMPILER_H
+#define CLOX_VM_COMPILER_H
+
+#include "common.h"
+
+struct clox_ast_program;
+struct clox_vm_chunk;
+
+/**
+ * @brief Compiles a parsed program into bytecode, appending it to the chunk followed by a return instruction.
+ * 
+ * Block locals live in the VM stack, at the slots the parser resolved them to. Globals are looked up by name.
+ * The chunk borrows nothing from the program, so the AST can be freed right after compiling it.
+ * 
+ * @param prog 
+ * @param chunk 
+ * @return int 0 on success. non-zero if the program exceeds the chunk limits (e.g. too many constants), which is
+ * reported to stderr
+ */
+int clox_vm_compile(struct clox_ast_program* prog, struct clox_vm_chunk* chunk);
+
+#endif
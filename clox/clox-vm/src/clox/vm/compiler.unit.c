@@ -0,0 +1,245 @@
+#include "unit-helpers.h"
+
+#include <stdio.h>
+
+#define STB_DS_IMPLEMENTATION
+#include <clox/stb_ds.h>
+
+#include "compiler.h"
+#include "compiler-single-pass.h"
+#include "vm.h"
+
+/**
+ * @brief Which front end the tests compile with
+ */
+static bool single_pass = false;
+
+/**
+ * @brief Compiles a script with the current front end
+ */
+static int compile(const char* src, struct clox_vm_chunk* chunk) {
+    if (!single_pass) {
+        return unit_compile(src, chunk, clox_vm_compile);
+    }
+
+    struct scanner scanner = {0};
+    scanner_scan_all_from_cstr(&scanner, src, strlen(src));
+    int rc = clox_vm_compile_tokens(scanner.tokens, chunk);
+    // the chunk doesn't depend on the source
+    scanner_free(&scanner);
+    return rc;
+}
+
+/**
+ * @brief Compiles and runs a script on a fresh VM, which is left for the caller to inspect and free
+ */
+static enum clox_vm_interpret_result run(struct clox_vm* vm, const char* src) {
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+    assert(compile(src, &chunk) == 0);
+
+    clox_vm_init(vm);
+    enum clox_vm_interpret_result result = clox_vm_interpret(vm, &chunk);
+    clox_vm_chunk_free(&chunk);
+    return result;
+}
+
+static bool global_is_string(struct clox_vm* vm, const char* name, const char* expected) {
+    struct clox_value val = unit_global(&vm->globals, name);
+    return clox_value_is_string(val)
+        && strview_equals(clox_value_as_strview(&val), strview_from_cstr(expected, strlen(expected)));
+}
+
+static void test_expressions(void) {
+    struct clox_vm vm;
+    assert(run(&vm,
+        "var a = -(1 + 2) * 4 / 2;\n"
+        "var b = !(a >= -6) == (a < -6);\n"
+        "var c = 1 != 2;\n"
+        "var d = 0 / 0;\n"
+        "var e = d <= d;\n"
+        "var s = \"con\" + \"cat\" + \"enation\";\n") == CLOX_VM_INTERPRET_RESULT_OK);
+    assert(clox_value_as_number(unit_global(&vm.globals, "a")) == -6);
+    assert(clox_value_as_bool(unit_global(&vm.globals, "b")));
+    assert(clox_value_as_bool(unit_global(&vm.globals, "c")));
+    // NaN is not ordered, so `<=` can't be compiled as `!(>)`
+    assert(!clox_value_as_bool(unit_global(&vm.globals, "e")));
+    assert(global_is_string(&vm, "s", "concatenation"));
+    assert(vm.stack_top == vm.stack);
+    clox_vm_free(&vm);
+}
+
+static void test_variables(void) {
+    struct clox_vm vm;
+    assert(run(&vm,
+        "var g = \"global\";\n"
+        "var n;\n"
+        "{\n"
+        "    var a = \"outer\";\n"
+        "    { var b = a + \"-inner\"; g = b; }\n"
+        "    var c = 1;\n"
+        "    c = c + 1;\n"
+        "    n = c = c * 10;\n"
+        "}\n"
+        "var x = 1;\n"
+        "var x = x + 1;\n") == CLOX_VM_INTERPRET_RESULT_OK);
+    assert(global_is_string(&vm, "g", "outer-inner"));
+    assert(clox_value_as_number(unit_global(&vm.globals, "n")) == 20);
+    assert(clox_value_as_number(unit_global(&vm.globals, "x")) == 2);
+    // the block locals were popped when leaving their scope
+    assert(vm.stack_top == vm.stack);
+    clox_vm_free(&vm);
+}
+
+static void test_runtime_errors(void) {
+    struct clox_vm vm;
+    assert(run(&vm, "{ var a = 1; print a + \"x\"; }") == CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR);
+    assert(vm.stack_top == vm.stack);
+    clox_vm_free(&vm);
+
+    assert(run(&vm, "print undefined;") == CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR);
+    clox_vm_free(&vm);
+
+    assert(run(&vm, "undefined = 1;") == CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR);
+    clox_vm_free(&vm);
+
+    assert(run(&vm, "var a = -\"x\";") == CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR);
+    clox_vm_free(&vm);
+}
+
+static void test_many_constants(void) {
+    // 400 globals each initialized with its own number, then read back: far more than a byte can index
+    char src[32 * 1024];
+    size_t len = 0;
+    for (int i = 0; i < 400; i++) {
+        len += (size_t) snprintf(src + len, sizeof(src) - len, "var v%d = %d;\n", i, i * 3);
+    }
+    len += (size_t) snprintf(src + len, sizeof(src) - len, "var sum = 0;\n");
+    for (int i = 0; i < 400; i++) {
+        len += (size_t) snprintf(src + len, sizeof(src) - len, "sum = sum + v%d + 1;\n", i);
+    }
+    assert(len < sizeof(src));
+
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+    assert(compile(src, &chunk) == 0);
+    // every name and number is stored once: 401 names, 400 numbers (0 included) and 1
+    assert(chunk.constants.count == 401 + 400 + 1);
+    clox_vm_chunk_free(&chunk);
+
+    struct clox_vm vm;
+    assert(run(&vm, src) == CLOX_VM_INTERPRET_RESULT_OK);
+    assert(clox_value_as_number(unit_global(&vm.globals, "v399")) == 399 * 3);
+    assert(clox_value_as_number(unit_global(&vm.globals, "sum")) == 3 * (399 * 400 / 2) + 400);
+    clox_vm_free(&vm);
+}
+
+static void test_stack_depth(void) {
+    // As many locals as the slot operands can address, plus temporaries nested deeper than that on top of them
+    char src[32 * 1024];
+    size_t len = (size_t) snprintf(src, sizeof(src), "var g = 1;\nvar sum;\nvar deep;\n{\n");
+    for (int i = 0; i < 256; i++) {
+        len += (size_t) snprintf(src + len, sizeof(src) - len, "var a%d = %d;\n", i, i);
+    }
+    len += (size_t) snprintf(src + len, sizeof(src) - len, "sum = a255 + a0;\ndeep = ");
+    for (int i = 0; i < 300; i++) {
+        len += (size_t) snprintf(src + len, sizeof(src) - len, "(g + ");
+    }
+    len += (size_t) snprintf(src + len, sizeof(src) - len, "a255");
+    for (int i = 0; i < 300; i++) {
+        len += (size_t) snprintf(src + len, sizeof(src) - len, ")");
+    }
+    len += (size_t) snprintf(src + len, sizeof(src) - len, ";\n}\n");
+    assert(len < sizeof(src));
+
+    struct clox_vm vm;
+    assert(run(&vm, src) == CLOX_VM_INTERPRET_RESULT_OK);
+    assert(clox_value_as_number(unit_global(&vm.globals, "sum")) == 255);
+    assert(clox_value_as_number(unit_global(&vm.globals, "deep")) == 300 + 255);
+    assert(vm.stack_top == vm.stack);
+    clox_vm_free(&vm);
+
+    // one local too many for the slot operands
+    len = (size_t) snprintf(src, sizeof(src), "{\n");
+    for (int i = 0; i < 257; i++) {
+        len += (size_t) snprintf(src + len, sizeof(src) - len, "var a%d = %d;\n", i, i);
+    }
+    len += (size_t) snprintf(src + len, sizeof(src) - len, "}\n");
+    assert(len < sizeof(src));
+
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+    assert(compile(src, &chunk) != 0);
+    clox_vm_chunk_free(&chunk);
+}
+
+static void test_front_ends_agree(void) {
+    const char src[] =
+        "var a = 1 + 2 * 3 - -4 / (5 + 6);\n"
+        "var b = a = \"x\" + \"y\";\n"
+        "{ var a = !b == nil; { var c = a != (b >= 1); a = c = 2; } print a <= 3 > false; }\n"
+        "b;\n";
+
+    struct clox_vm_chunk from_ast;
+    clox_vm_chunk_init(&from_ast);
+    single_pass = false;
+    assert(compile(src, &from_ast) == 0);
+
+    struct clox_vm_chunk from_tokens;
+    clox_vm_chunk_init(&from_tokens);
+    single_pass = true;
+    assert(compile(src, &from_tokens) == 0);
+
+    assert(from_ast.codes_count == from_tokens.codes_count);
+    assert(memcmp(from_ast.codes, from_tokens.codes, from_ast.codes_count) == 0);
+    assert(from_ast.constants.count == from_tokens.constants.count);
+    for (size_t i = 0; i < from_ast.constants.count; i++) {
+        assert(clox_value_is_equal(from_ast.constants.values[i], from_tokens.constants.values[i]));
+    }
+
+    clox_vm_chunk_free(&from_tokens);
+    clox_vm_chunk_free(&from_ast);
+}
+
+static void test_single_pass_syntax_errors(void) {
+    const char* invalid[] = {
+        "a + b = c;",
+        "(a) = 1;",
+        "-a = 1;",
+        "{ var a = a; }",
+        "{ var a; var a; }",
+        "print 1",
+        "print (1;",
+        "var = 1;",
+        "{ print 1;",
+        "print +1;",
+    };
+    single_pass = true;
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        struct clox_vm_chunk chunk;
+        clox_vm_chunk_init(&chunk);
+        assert(compile(invalid[i], &chunk) != 0);
+        clox_vm_chunk_free(&chunk);
+    }
+
+    // shadowing and redeclaring globals are fine
+    struct clox_vm vm;
+    assert(run(&vm, "var a = 1; var a = a + 1; { var b = a; { var a = b * 10; a = a + 1; } }") == CLOX_VM_INTERPRET_RESULT_OK);
+    assert(clox_value_as_number(unit_global(&vm.globals, "a")) == 2);
+    clox_vm_free(&vm);
+}
+
+int main() {
+    for (int i = 0; i < 2; i++) {
+        single_pass = (i == 1);
+        test_expressions();
+        test_variables();
+        test_runtime_errors();
+        test_many_constants();
+        test_stack_depth();
+    }
+    test_front_ends_agree();
+    test_single_pass_syntax_errors();
+
+    puts("compiler.unit: ok");
+}
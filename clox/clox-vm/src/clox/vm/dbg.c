@@ -12,6 +12,16 @@ static size_t simple_instruction(const char* name, size_t offset);
  */
 static size_t constant_instruction(const char* name, struct clox_vm_chunk* chunk, size_t offset);
 
+/**
+ * @return size_t the offset for the next instruction
+ */
+static size_t constant_long_instruction(const char* name, struct clox_vm_chunk* chunk, size_t offset);
+
+/**
+ * @return size_t the offset for the next instruction
+ */
+static size_t byte_instruction(const char* name, struct clox_vm_chunk* chunk, size_t offset);
+
 void clox_vm_dbg_chunk_disassemble(struct clox_vm_chunk* chunk, const char* name) {
     fprintf(stderr, "== %s ==\n", name);
 
@@ -23,20 +33,35 @@ void clox_vm_dbg_chunk_disassemble(struct clox_vm_chunk* chunk, const char* name
 size_t clox_vm_dbg_chunk_disassemble_instruction(struct clox_vm_chunk* chunk, size_t offset) {
     fprintf(stderr, "%04zu ", offset);
 
-    if (offset > 0 && chunk->lines[offset] == chunk->lines[offset - 1]) {
+    // the previous line first, so the lookups only move forward
+    size_t previous_line = (offset > 0) ? clox_vm_chunk_get_line(chunk, offset - 1) : 0;
+    size_t line = clox_vm_chunk_get_line(chunk, offset);
+    if (offset > 0 && line == previous_line) {
         printf("   | ");
     } else {
-        printf("%4zu ", chunk->lines[offset]);
+        printf("%4zu ", line);
     }
 
     uint8_t instruction = chunk->codes[offset];
     switch (instruction)
     {
-    case CLOX_VM_OP_CODE_RETURN:
-        return simple_instruction("OP_RETURN", offset);
+#define DISASSEMBLE_NONE(name) simple_instruction(name, offset)
+#define DISASSEMBLE_CONSTANT(name) constant_instruction(name, chunk, offset)
+#define DISASSEMBLE_CONSTANT_LONG(name) constant_long_instruction(name, chunk, offset)
+#define DISASSEMBLE_SLOT(name) byte_instruction(name, chunk, offset)
+#define DISASSEMBLE_COUNT(name) byte_instruction(name, chunk, offset)
+#define X(name, operand)                            \
+    case CLOX_VM_OP_CODE_##name:                    \
+        return DISASSEMBLE_##operand("OP_" #name);
 
-    case CLOX_VM_OP_CODE_CONSTANT:
-        return constant_instruction("OP_CONSTANT", chunk, offset);
+    CLOX_VM_OP_CODES(X)
+
+#undef X
+#undef DISASSEMBLE_COUNT
+#undef DISASSEMBLE_SLOT
+#undef DISASSEMBLE_CONSTANT_LONG
+#undef DISASSEMBLE_CONSTANT
+#undef DISASSEMBLE_NONE
 
     default:
         fprintf(stderr, "Unknown opcode %hhu\n", instruction);
@@ -55,11 +80,30 @@ static size_t constant_instruction(const char* name, struct clox_vm_chunk* chunk
     // the second (this constant variable) is the index in the constants pool array
     uint8_t constant = chunk->codes[offset + 1];
 
-    // printf("%-16s $%04u='", name, constant);
-    printf("%-16s %4u '", name, constant);
+    // printf("%-25s $%04u='", name, constant);
+    printf("%-25s %4u '", name, constant);
 
     clox_vm_value_print(chunk->constants.values[constant]);
 
     printf("'\n");
     return offset + 2;
 }
+
+static size_t constant_long_instruction(const char* name, struct clox_vm_chunk* chunk, size_t offset) {
+    // the index takes the 3 bytes after the opcode, least significant first
+    uint32_t constant = chunk->codes[offset + 1] | (chunk->codes[offset + 2] << 8) | (chunk->codes[offset + 3] << 16);
+
+    printf("%-25s %4u '", name, constant);
+
+    clox_vm_value_print(chunk->constants.values[constant]);
+
+    printf("'\n");
+    return offset + 4;
+}
+
+static size_t byte_instruction(const char* name, struct clox_vm_chunk* chunk, size_t offset) {
+    // The operand is a stack slot, which doesn't say anything about the variable name, or a count
+    uint8_t slot = chunk->codes[offset + 1];
+    printf("%-25s %4u\n", name, slot);
+    return offset + 2;
+}
@@ -1,6 +1,18 @@
 #include "common.h"
 #include "chunk.h"
 #include "dbg.h"
+#include "vm.h"
+
+#define STB_DS_IMPLEMENTATION
+#include <clox/stb_ds.h>
+
+/**
+ * @brief Appends an OP_CONSTANT instruction pushing the given value
+ */
+static void emit_constant(struct clox_vm_chunk* chunk, clox_vm_value value, size_t line) {
+    size_t constant = clox_vm_chunk_add_constant(chunk, value);
+    clox_vm_chunk_write_constant_op(chunk, CLOX_VM_OP_CODE_CONSTANT, constant, line);
+}
 
 int main(int argc, char** argv) {
     (void) argc;
@@ -9,16 +21,38 @@ int main(int argc, char** argv) {
     struct clox_vm_chunk chunk;
     clox_vm_chunk_init(&chunk);
 
-    // push 1.2
-    size_t constant = clox_vm_chunk_add_constant(&chunk, 1.2);
-    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_CONSTANT, 123);
-    clox_vm_chunk_write(&chunk, (uint8_t) constant, 123);
+    // print -((1.2 + 3.4) / 5.6);
+    emit_constant(&chunk, clox_value_number(1.2), 123);
+    emit_constant(&chunk, clox_value_number(3.4), 123);
+    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_ADD, 123);
+    emit_constant(&chunk, clox_value_number(5.6), 123);
+    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_DIVIDE, 123);
+    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_NEGATE, 123);
+    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_PRINT, 123);
+
+    // print !(1 < 2) == false;
+    emit_constant(&chunk, clox_value_number(1), 124);
+    emit_constant(&chunk, clox_value_number(2), 124);
+    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_LESS, 124);
+    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_NOT, 124);
+    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_FALSE, 124);
+    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_EQUAL, 124);
+    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_PRINT, 124);
+
+    // nil;
+    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_NIL, 125);
+    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_POP, 125);
 
     // ret
-    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_RETURN, 123);
+    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_RETURN, 126);
 
     clox_vm_dbg_chunk_disassemble(&chunk, "test chunk");
 
+    struct clox_vm vm;
+    clox_vm_init(&vm);
+    enum clox_vm_interpret_result result = clox_vm_interpret(&vm, &chunk);
+    clox_vm_free(&vm);
+
     clox_vm_chunk_free(&chunk);
-    return 0;
+    return result == CLOX_VM_INTERPRET_RESULT_OK ? 0 : 1;
 }
@@ -0,0 +1,107 @@
+#include "peephole.h"
+
+#include "chunk.h"
+
+/**
+ * @return enum clox_vm_op_code the superinstruction applying op to a constant operand, or CLOX_VM_OP_CODE_COUNT
+ * if there is none
+ */
+static enum clox_vm_op_code peephole_constant_operand(uint8_t op);
+
+/**
+ * @brief Appends an instruction to a chunk, all its codes attributed to line
+ */
+static void peephole_emit(struct clox_vm_chunk* chunk, const uint8_t* codes, size_t count, size_t line);
+
+void clox_vm_peephole_optimize(struct clox_vm_chunk* chunk, struct clox_vm_peephole_report* report) {
+    *report = (struct clox_vm_peephole_report) {0};
+
+    struct clox_vm_chunk optimized;
+    clox_vm_chunk_init(&optimized);
+
+    for (size_t offset = 0; offset < chunk->codes_count; ) {
+        const uint8_t* code = &chunk->codes[offset];
+        const size_t length = clox_vm_op_code_length(code[0]);
+        const size_t line = clox_vm_chunk_get_line(chunk, offset);
+        report->instructions_before++;
+        report->instructions_after++;
+
+        // the instruction after this one, if any, and whether it's on the same line
+        const size_t next = offset + length;
+        const bool next_same_line = next < chunk->codes_count && clox_vm_chunk_get_line(chunk, next) == line;
+
+        if (code[0] == CLOX_VM_OP_CODE_CONSTANT && next_same_line) {
+            enum clox_vm_op_code fused = peephole_constant_operand(chunk->codes[next]);
+            if (fused != CLOX_VM_OP_CODE_COUNT) {
+                const uint8_t superinstruction[] = {fused, code[1]};
+                peephole_emit(&optimized, superinstruction, sizeof(superinstruction), line);
+                report->instructions_before++;
+                report->fused++;
+                offset = next + 1;
+                continue;
+            }
+        }
+
+        if ((code[0] == CLOX_VM_OP_CODE_SET_GLOBAL || code[0] == CLOX_VM_OP_CODE_SET_LOCAL) && next_same_line
+            && chunk->codes[next] == CLOX_VM_OP_CODE_POP) {
+            const uint8_t fused = (code[0] == CLOX_VM_OP_CODE_SET_GLOBAL)
+                ? CLOX_VM_OP_CODE_SET_GLOBAL_POP
+                : CLOX_VM_OP_CODE_SET_LOCAL_POP;
+            const uint8_t superinstruction[] = {fused, code[1]};
+            peephole_emit(&optimized, superinstruction, sizeof(superinstruction), line);
+            report->instructions_before++;
+            report->fused++;
+            offset = next + 1;
+            continue;
+        }
+
+        if (code[0] == CLOX_VM_OP_CODE_POP) {
+            size_t count = 1;
+            while (offset + count < chunk->codes_count && count < UINT8_MAX
+                && chunk->codes[offset + count] == CLOX_VM_OP_CODE_POP
+                && clox_vm_chunk_get_line(chunk, offset + count) == line) {
+                count++;
+            }
+            if (count > 1) {
+                const uint8_t superinstruction[] = {CLOX_VM_OP_CODE_POP_N, (uint8_t) count};
+                peephole_emit(&optimized, superinstruction, sizeof(superinstruction), line);
+                report->instructions_before += count - 1;
+                report->fused++;
+                offset += count;
+                continue;
+            }
+        }
+
+        peephole_emit(&optimized, code, length, line);
+        offset = next;
+    }
+
+    // the constants are moved over as they are, indexes included
+    optimized.constants = chunk->constants;
+    optimized.constants_lookup = chunk->constants_lookup;
+    clox_vm_value_array_init(&chunk->constants);
+    chunk->constants_lookup = NULL;
+
+    clox_vm_chunk_free(chunk);
+    *chunk = optimized;
+}
+
+static enum clox_vm_op_code peephole_constant_operand(uint8_t op) {
+    switch (op) {
+    case CLOX_VM_OP_CODE_ADD:           return CLOX_VM_OP_CODE_ADD_CONSTANT;
+    case CLOX_VM_OP_CODE_SUBTRACT:      return CLOX_VM_OP_CODE_SUBTRACT_CONSTANT;
+    case CLOX_VM_OP_CODE_MULTIPLY:      return CLOX_VM_OP_CODE_MULTIPLY_CONSTANT;
+    case CLOX_VM_OP_CODE_DIVIDE:        return CLOX_VM_OP_CODE_DIVIDE_CONSTANT;
+    case CLOX_VM_OP_CODE_GREATER:       return CLOX_VM_OP_CODE_GREATER_CONSTANT;
+    case CLOX_VM_OP_CODE_GREATER_EQUAL: return CLOX_VM_OP_CODE_GREATER_EQUAL_CONSTANT;
+    case CLOX_VM_OP_CODE_LESS:          return CLOX_VM_OP_CODE_LESS_CONSTANT;
+    case CLOX_VM_OP_CODE_LESS_EQUAL:    return CLOX_VM_OP_CODE_LESS_EQUAL_CONSTANT;
+    default:                            return CLOX_VM_OP_CODE_COUNT;
+    }
+}
+
+static void peephole_emit(struct clox_vm_chunk* chunk, const uint8_t* codes, size_t count, size_t line) {
+    for (size_t i = 0; i < count; i++) {
+        clox_vm_chunk_write(chunk, codes[i], line);
+    }
+}
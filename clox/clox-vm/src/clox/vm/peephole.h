@@ -0,0 +1,43 @@
+#ifndef CLOX_VM_PEEPHOLE_H
+#define CLOX_VM_PEEPHOLE_H
+
+#include "common.h"
+
+struct clox_vm_chunk;
+
+/**
+ * @brief What the peephole pass did to a chunk
+ */
+struct clox_vm_peephole_report {
+    /**
+     * @brief Instructions in the chunk before the pass. There are no jumps, so that's also how many dispatches
+     * running it takes
+     */
+    size_t instructions_before;
+    /**
+     * @brief Instructions in the chunk after the pass
+     */
+    size_t instructions_after;
+    /**
+     * @brief Superinstructions written in place of sequences of instructions
+     */
+    size_t fused;
+};
+
+/**
+ * @brief Rewrites common sequences of instructions of a compiled chunk into superinstructions, so that running
+ * it takes fewer dispatches:
+ * - CONSTANT + a binary arithmetic or comparison operator: <op>_CONSTANT
+ * - SET_GLOBAL + POP and SET_LOCAL + POP: SET_GLOBAL_POP and SET_LOCAL_POP
+ * - consecutive POPs: POP_N
+ *
+ * Only instructions from the same line are fused, so runtime errors report the same lines as before. The codes
+ * and the line table are rebuilt, while the constants are kept as they are. Chunks don't have jumps yet, so
+ * there are no targets to fix up.
+ *
+ * @param chunk
+ * @param report where the outcome is written to
+ */
+void clox_vm_peephole_optimize(struct clox_vm_chunk* chunk, struct clox_vm_peephole_report* report);
+
+#endif
@@ -0,0 +1,138 @@
+#include "unit-helpers.h"
+
+#include <stdio.h>
+
+#define STB_DS_IMPLEMENTATION
+#include <clox/stb_ds.h>
+
+#include "compiler.h"
+#include "peephole.h"
+#include "vm.h"
+
+static void test_fusions(void) {
+    const char src[] =
+        "var x = 1;\n"
+        "x = x + 2;\n"
+        "var s = \"a\";\n"
+        "s = s + \"b\" + \"c\";\n"
+        "{\n"
+        "    var a = x * 3; var b = a / 2 - 1; var c = b >= 0.5;\n"
+        "    a = a - 1; x = a;\n"
+        "}\n"
+        "var lt = x < 10 == x <= 8;\n"
+        "var gt = x > 10 == x >= 8;\n";
+
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+    assert(unit_compile(src, &chunk, clox_vm_compile) == 0);
+    const size_t constants = chunk.constants.count;
+
+    struct clox_vm_peephole_report report;
+    clox_vm_peephole_optimize(&chunk, &report);
+    assert(report.instructions_after + report.fused <= report.instructions_before);
+    assert(report.fused == 17);
+    assert(chunk.constants.count == constants);
+
+    assert(unit_count_op(&chunk, CLOX_VM_OP_CODE_ADD_CONSTANT) == 3);
+    assert(unit_count_op(&chunk, CLOX_VM_OP_CODE_SUBTRACT_CONSTANT) == 2);
+    assert(unit_count_op(&chunk, CLOX_VM_OP_CODE_MULTIPLY_CONSTANT) == 1);
+    assert(unit_count_op(&chunk, CLOX_VM_OP_CODE_DIVIDE_CONSTANT) == 1);
+    assert(unit_count_op(&chunk, CLOX_VM_OP_CODE_GREATER_EQUAL_CONSTANT) == 2);
+    assert(unit_count_op(&chunk, CLOX_VM_OP_CODE_LESS_CONSTANT) == 1);
+    assert(unit_count_op(&chunk, CLOX_VM_OP_CODE_GREATER_CONSTANT) == 1);
+    assert(unit_count_op(&chunk, CLOX_VM_OP_CODE_SET_GLOBAL_POP) == 3);
+    assert(unit_count_op(&chunk, CLOX_VM_OP_CODE_SET_LOCAL_POP) == 1);
+    // the 3 locals of the block
+    assert(unit_count_op(&chunk, CLOX_VM_OP_CODE_POP_N) == 1);
+    assert(unit_count_op(&chunk, CLOX_VM_OP_CODE_LESS_EQUAL_CONSTANT) == 1);
+
+    struct clox_vm vm;
+    clox_vm_init(&vm);
+    assert(clox_vm_interpret(&vm, &chunk) == CLOX_VM_INTERPRET_RESULT_OK);
+    assert(vm.stack_top == vm.stack);
+    assert(clox_value_as_number(unit_global(&vm.globals, "x")) == 8);
+    struct clox_value s = unit_global(&vm.globals, "s");
+    assert(strview_equals(clox_value_as_strview(&s), strview_from_cstr("abc", 3)));
+    assert(clox_value_as_bool(unit_global(&vm.globals, "lt")));
+    assert(!clox_value_as_bool(unit_global(&vm.globals, "gt")));
+    clox_vm_free(&vm);
+
+    clox_vm_chunk_free(&chunk);
+}
+
+static void test_lines(void) {
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+    const size_t one = clox_vm_chunk_add_constant(&chunk, clox_value_number_compact(1));
+
+    // split across lines: kept apart
+    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_NIL, 1);
+    clox_vm_chunk_write_constant_op(&chunk, CLOX_VM_OP_CODE_CONSTANT, one, 1);
+    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_ADD, 2);
+    // same line: fused
+    clox_vm_chunk_write_constant_op(&chunk, CLOX_VM_OP_CODE_CONSTANT, one, 3);
+    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_ADD, 3);
+    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_POP, 4);
+    clox_vm_chunk_write(&chunk, CLOX_VM_OP_CODE_RETURN, 5);
+
+    struct clox_vm_peephole_report report;
+    clox_vm_peephole_optimize(&chunk, &report);
+    assert(report.instructions_before == 7 && report.instructions_after == 6 && report.fused == 1);
+
+    const uint8_t expected_codes[] = {
+        CLOX_VM_OP_CODE_NIL,
+        CLOX_VM_OP_CODE_CONSTANT, (uint8_t) one,
+        CLOX_VM_OP_CODE_ADD,
+        CLOX_VM_OP_CODE_ADD_CONSTANT, (uint8_t) one,
+        CLOX_VM_OP_CODE_POP,
+        CLOX_VM_OP_CODE_RETURN,
+    };
+    const size_t expected_lines[] = {1, 1, 1, 2, 3, 3, 4, 5};
+    assert(chunk.codes_count == sizeof(expected_codes));
+    assert(memcmp(chunk.codes, expected_codes, sizeof(expected_codes)) == 0);
+    for (size_t i = 0; i < chunk.codes_count; i++) {
+        assert(clox_vm_chunk_get_line(&chunk, i) == expected_lines[i]);
+    }
+
+    // nil + 1 fails at the line of the `+`
+    struct clox_vm vm;
+    clox_vm_init(&vm);
+    assert(clox_vm_interpret(&vm, &chunk) == CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR);
+    assert(vm.stack_top == vm.stack);
+    clox_vm_free(&vm);
+
+    clox_vm_chunk_free(&chunk);
+}
+
+static void test_runtime_errors(void) {
+    const char* scripts[] = {
+        "var n; print n < 1;",
+        "var n = \"x\"; n = n - 1;",
+        "var n = true; n = n + \"x\";",
+        "{ var a = 1; var b = nil; a = b * 2; }",
+        "undefined = 1;",
+    };
+    for (size_t i = 0; i < sizeof(scripts) / sizeof(scripts[0]); i++) {
+        struct clox_vm_chunk chunk;
+        clox_vm_chunk_init(&chunk);
+        assert(unit_compile(scripts[i], &chunk, clox_vm_compile) == 0);
+        struct clox_vm_peephole_report report;
+        clox_vm_peephole_optimize(&chunk, &report);
+        assert(report.fused > 0);
+
+        struct clox_vm vm;
+        clox_vm_init(&vm);
+        assert(clox_vm_interpret(&vm, &chunk) == CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR);
+        assert(vm.stack_top == vm.stack);
+        clox_vm_free(&vm);
+        clox_vm_chunk_free(&chunk);
+    }
+}
+
+int main() {
+    test_fusions();
+    test_lines();
+    test_runtime_errors();
+
+    puts("peephole.unit: ok");
+}
@@ -0,0 +1,225 @@
+#include "profile.h"
+
+#include <inttypes.h>
+#include <time.h>
+
+static const char* const profile_op_names[] = {
+#define X(name, operand) [CLOX_VM_OP_CODE_##name] = #name,
+    CLOX_VM_OP_CODES(X)
+#undef X
+};
+
+struct profile_op_count {
+    uint8_t op;
+    uint64_t count;
+};
+
+struct profile_pair_count {
+    uint8_t first;
+    uint8_t second;
+    uint64_t count;
+};
+
+static uint64_t profile_now_ns(void);
+
+/**
+ * @brief Sorts by count, the greatest first. Ties keep the opcodes order, so the output is stable
+ */
+static int profile_op_count_cmp(const void* a, const void* b);
+static int profile_pair_count_cmp(const void* a, const void* b);
+
+/**
+ * @return size_t how many opcodes were executed, written to ops sorted by count
+ */
+static size_t profile_sorted_ops(const struct clox_vm_profile* profile, struct profile_op_count* ops);
+
+/**
+ * @return size_t how many pairs of opcodes were executed, written to pairs sorted by count
+ */
+static size_t profile_sorted_pairs(const struct clox_vm_profile* profile, struct profile_pair_count* pairs);
+
+/**
+ * @return double the average time of an opcode, or a negative value if it wasn't timed
+ */
+static double profile_op_ns(const struct clox_vm_profile* profile, uint8_t op);
+
+void clox_vm_profile_init(struct clox_vm_profile* profile, uint32_t sample_period) {
+    *profile = (struct clox_vm_profile) {0};
+    profile->sample_period = sample_period;
+    profile->until_sample = sample_period;
+    profile->sampled = CLOX_VM_OP_CODE_COUNT;
+    profile->previous = CLOX_VM_OP_CODE_COUNT;
+
+    if (sample_period != 0) {
+        // the cheapest of a few back to back reads, as the samples take one read each
+        profile->clock_overhead_ns = UINT64_MAX;
+        for (int i = 0; i < 64; i++) {
+            uint64_t start = profile_now_ns();
+            uint64_t elapsed = profile_now_ns() - start;
+            if (elapsed < profile->clock_overhead_ns) {
+                profile->clock_overhead_ns = elapsed;
+            }
+        }
+    }
+}
+
+void clox_vm_profile_sample_end(struct clox_vm_profile* profile) {
+    uint64_t elapsed = profile_now_ns() - profile->sample_start_ns;
+    elapsed = (elapsed > profile->clock_overhead_ns) ? elapsed - profile->clock_overhead_ns : 0;
+    profile->samples[profile->sampled]++;
+    profile->sampled_ns[profile->sampled] += elapsed;
+    profile->sampled = CLOX_VM_OP_CODE_COUNT;
+}
+
+void clox_vm_profile_sample_start(struct clox_vm_profile* profile, uint8_t op) {
+    profile->until_sample = profile->sample_period;
+    profile->sampled = op;
+    // last, so the bookkeeping above isn't part of the sample
+    profile->sample_start_ns = profile_now_ns();
+}
+
+void clox_vm_profile_run_end(struct clox_vm_profile* profile) {
+    profile->sampled = CLOX_VM_OP_CODE_COUNT;
+    profile->previous = CLOX_VM_OP_CODE_COUNT;
+}
+
+uint64_t clox_vm_profile_instructions(const struct clox_vm_profile* profile) {
+    uint64_t instructions = 0;
+    for (size_t op = 0; op < CLOX_VM_OP_CODE_COUNT; op++) {
+        instructions += profile->counts[op];
+    }
+    return instructions;
+}
+
+void clox_vm_profile_fprint_table(const struct clox_vm_profile* profile, FILE* file, size_t max_pairs) {
+    const uint64_t instructions = clox_vm_profile_instructions(profile);
+    const double total = (instructions > 0) ? (double) instructions : 1;
+
+    fprintf(file, "opcode profile: %" PRIu64 " instructions", instructions);
+    if (profile->sample_period != 0) {
+        fprintf(file, ", 1 in %" PRIu32 " timed", profile->sample_period);
+    }
+    fputc('\n', file);
+
+    struct profile_op_count ops[CLOX_VM_OP_CODE_COUNT];
+    const size_t ops_count = profile_sorted_ops(profile, ops);
+    fprintf(file, "%-24s %14s %7s %7s", "opcode", "count", "%", "cumul%");
+    if (profile->sample_period != 0) {
+        fprintf(file, " %10s %9s", "samples", "ns/instr");
+    }
+    fputc('\n', file);
+    uint64_t cumulated = 0;
+    for (size_t i = 0; i < ops_count; i++) {
+        cumulated += ops[i].count;
+        fprintf(file, "%-24s %14" PRIu64 " %7.2f %7.2f", profile_op_names[ops[i].op], ops[i].count,
+            100.0 * ops[i].count / total, 100.0 * cumulated / total);
+        if (profile->sample_period != 0) {
+            double ns = profile_op_ns(profile, ops[i].op);
+            if (ns < 0) {
+                fprintf(file, " %10" PRIu64 " %9s", profile->samples[ops[i].op], "-");
+            } else {
+                fprintf(file, " %10" PRIu64 " %9.2f", profile->samples[ops[i].op], ns);
+            }
+        }
+        fputc('\n', file);
+    }
+
+    struct profile_pair_count* pairs = malloc(sizeof(*pairs) * CLOX_VM_OP_CODE_COUNT * CLOX_VM_OP_CODE_COUNT);
+    const size_t pairs_count = profile_sorted_pairs(profile, pairs);
+    fprintf(file, "\n%-49s %14s %7s\n", "pair", "count", "%");
+    for (size_t i = 0; i < pairs_count && i < max_pairs; i++) {
+        fprintf(file, "%-24s %-24s %14" PRIu64 " %7.2f\n", profile_op_names[pairs[i].first],
+            profile_op_names[pairs[i].second], pairs[i].count, 100.0 * pairs[i].count / total);
+    }
+    free(pairs);
+}
+
+void clox_vm_profile_fprint_json(const struct clox_vm_profile* profile, FILE* file) {
+    fprintf(file, "{\"instructions\":%" PRIu64 ",\"sample_period\":%" PRIu32 ",\"opcodes\":[",
+        clox_vm_profile_instructions(profile), profile->sample_period);
+
+    struct profile_op_count ops[CLOX_VM_OP_CODE_COUNT];
+    const size_t ops_count = profile_sorted_ops(profile, ops);
+    for (size_t i = 0; i < ops_count; i++) {
+        fprintf(file, "%s{\"opcode\":\"%s\",\"count\":%" PRIu64 ",\"samples\":%" PRIu64 ",\"ns\":",
+            (i > 0) ? "," : "", profile_op_names[ops[i].op], ops[i].count, profile->samples[ops[i].op]);
+        double ns = profile_op_ns(profile, ops[i].op);
+        if (ns < 0) {
+            fputs("null}", file);
+        } else {
+            fprintf(file, "%.2f}", ns);
+        }
+    }
+
+    fputs("],\"pairs\":[", file);
+    struct profile_pair_count* pairs = malloc(sizeof(*pairs) * CLOX_VM_OP_CODE_COUNT * CLOX_VM_OP_CODE_COUNT);
+    const size_t pairs_count = profile_sorted_pairs(profile, pairs);
+    for (size_t i = 0; i < pairs_count; i++) {
+        fprintf(file, "%s{\"first\":\"%s\",\"second\":\"%s\",\"count\":%" PRIu64 "}", (i > 0) ? "," : "",
+            profile_op_names[pairs[i].first], profile_op_names[pairs[i].second], pairs[i].count);
+    }
+    free(pairs);
+    fputs("]}\n", file);
+}
+
+static uint64_t profile_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static int profile_op_count_cmp(const void* a, const void* b) {
+    const struct profile_op_count* left = a;
+    const struct profile_op_count* right = b;
+    if (left->count != right->count) {
+        return (left->count > right->count) ? -1 : 1;
+    }
+    return (int) left->op - (int) right->op;
+}
+
+static int profile_pair_count_cmp(const void* a, const void* b) {
+    const struct profile_pair_count* left = a;
+    const struct profile_pair_count* right = b;
+    if (left->count != right->count) {
+        return (left->count > right->count) ? -1 : 1;
+    }
+    if (left->first != right->first) {
+        return (int) left->first - (int) right->first;
+    }
+    return (int) left->second - (int) right->second;
+}
+
+static size_t profile_sorted_ops(const struct clox_vm_profile* profile, struct profile_op_count* ops) {
+    size_t count = 0;
+    for (size_t op = 0; op < CLOX_VM_OP_CODE_COUNT; op++) {
+        if (profile->counts[op] > 0) {
+            ops[count++] = (struct profile_op_count) {.op = (uint8_t) op, .count = profile->counts[op]};
+        }
+    }
+    qsort(ops, count, sizeof(*ops), profile_op_count_cmp);
+    return count;
+}
+
+static size_t profile_sorted_pairs(const struct clox_vm_profile* profile, struct profile_pair_count* pairs) {
+    size_t count = 0;
+    for (size_t first = 0; first < CLOX_VM_OP_CODE_COUNT; first++) {
+        for (size_t second = 0; second < CLOX_VM_OP_CODE_COUNT; second++) {
+            if (profile->pairs[first][second] > 0) {
+                pairs[count++] = (struct profile_pair_count) {
+                    .first = (uint8_t) first,
+                    .second = (uint8_t) second,
+                    .count = profile->pairs[first][second],
+                };
+            }
+        }
+    }
+    qsort(pairs, count, sizeof(*pairs), profile_pair_count_cmp);
+    return count;
+}
+
+static double profile_op_ns(const struct clox_vm_profile* profile, uint8_t op) {
+    if (profile->samples[op] == 0) {
+        return -1;
+    }
+    return (double) profile->sampled_ns[op] / (double) profile->samples[op];
+}
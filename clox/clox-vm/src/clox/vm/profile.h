@@ -0,0 +1,116 @@
+#ifndef CLOX_VM_PROFILE_H
+#define CLOX_VM_PROFILE_H
+
+#include "common.h"
+#include "chunk.h"
+
+/**
+ * @brief Counters of the instructions executed by a VM, to find out which opcodes are worth optimizing and which
+ * sequences of them are worth fusing into superinstructions.
+ *
+ * The VM only feeds them when built with CLOX_VM_PROFILE (see the option in CMakeLists.txt). Otherwise the hook
+ * isn't compiled at all, so dispatching costs the same as without a profiler.
+ */
+struct clox_vm_profile {
+    /**
+     * @brief How many times each opcode was executed
+     */
+    uint64_t counts[CLOX_VM_OP_CODE_COUNT];
+    /**
+     * @brief How many times each opcode (second index) was executed right after another one (first index)
+     */
+    uint64_t pairs[CLOX_VM_OP_CODE_COUNT][CLOX_VM_OP_CODE_COUNT];
+    /**
+     * @brief How many executions of each opcode were timed
+     */
+    uint64_t samples[CLOX_VM_OP_CODE_COUNT];
+    /**
+     * @brief Nanoseconds the timed executions of each opcode took, dispatch included
+     */
+    uint64_t sampled_ns[CLOX_VM_OP_CODE_COUNT];
+    /**
+     * @brief One in how many instructions is timed. 0 doesn't time any: reading the clock costs more than most
+     * instructions, so timing them all would mostly measure the clock
+     */
+    uint32_t sample_period;
+    /**
+     * @brief Instructions left until the next timed one
+     */
+    uint32_t until_sample;
+    /**
+     * @brief Nanoseconds reading the clock takes, subtracted from every sample
+     */
+    uint64_t clock_overhead_ns;
+    /**
+     * @brief When the timed instruction started
+     */
+    uint64_t sample_start_ns;
+    /**
+     * @brief The opcode being timed, or CLOX_VM_OP_CODE_COUNT
+     */
+    uint8_t sampled;
+    /**
+     * @brief The last executed opcode, or CLOX_VM_OP_CODE_COUNT at the start of a chunk
+     */
+    uint8_t previous;
+};
+
+/**
+ * @param profile
+ * @param sample_period one in how many instructions is timed, 0 to only count them
+ */
+void clox_vm_profile_init(struct clox_vm_profile* profile, uint32_t sample_period);
+
+/**
+ * @brief Ends the sample of the instruction being timed
+ */
+void clox_vm_profile_sample_end(struct clox_vm_profile* profile);
+
+/**
+ * @brief Starts timing an instruction, until the next one starts
+ */
+void clox_vm_profile_sample_start(struct clox_vm_profile* profile, uint8_t op);
+
+/**
+ * @brief Accounts an instruction about to be executed. Called by the VM on every dispatch
+ */
+static inline void clox_vm_profile_instruction(struct clox_vm_profile* profile, uint8_t op) {
+    if (profile->sampled != CLOX_VM_OP_CODE_COUNT) {
+        clox_vm_profile_sample_end(profile);
+    }
+    profile->counts[op]++;
+    if (profile->previous != CLOX_VM_OP_CODE_COUNT) {
+        profile->pairs[profile->previous][op]++;
+    }
+    profile->previous = op;
+    if (profile->sample_period != 0 && --profile->until_sample == 0) {
+        clox_vm_profile_sample_start(profile, op);
+    }
+}
+
+/**
+ * @brief Called by the VM when a chunk stops running. The last instruction (a return or a runtime error) isn't
+ * timed, and the next chunk doesn't pair with this one
+ */
+void clox_vm_profile_run_end(struct clox_vm_profile* profile);
+
+/**
+ * @return uint64_t how many instructions were executed
+ */
+uint64_t clox_vm_profile_instructions(const struct clox_vm_profile* profile);
+
+/**
+ * @brief Prints the executed opcodes, the most executed first, then the most executed pairs of opcodes
+ *
+ * @param profile
+ * @param file
+ * @param max_pairs how many pairs are printed at most
+ */
+void clox_vm_profile_fprint_table(const struct clox_vm_profile* profile, FILE* file, size_t max_pairs);
+
+/**
+ * @brief Prints the same as clox_vm_profile_fprint_table as a JSON object, with every executed pair
+ */
+void clox_vm_profile_fprint_json(const struct clox_vm_profile* profile, FILE* file);
+
+#endif
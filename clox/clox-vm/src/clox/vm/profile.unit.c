@@ -0,0 +1,147 @@
+#include "unit-helpers.h"
+
+#include <stdio.h>
+
+#define STB_DS_IMPLEMENTATION
+#include <clox/stb_ds.h>
+
+#include "compiler.h"
+#include "profile.h"
+#include "vm.h"
+
+static void test_counts(void) {
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+    assert(unit_compile("var x = 1; x = x + 2; print x;", &chunk, clox_vm_compile) == 0);
+
+    struct clox_vm_profile profile;
+    clox_vm_profile_init(&profile, 0);
+    struct clox_vm vm;
+    clox_vm_init(&vm);
+    vm.profile = &profile;
+
+    // no jumps: every instruction runs once per run
+    for (int run = 1; run <= 2; run++) {
+        assert(clox_vm_interpret(&vm, &chunk) == CLOX_VM_INTERPRET_RESULT_OK);
+
+        uint64_t static_counts[CLOX_VM_OP_CODE_COUNT] = {0};
+        uint64_t static_pairs[CLOX_VM_OP_CODE_COUNT][CLOX_VM_OP_CODE_COUNT] = {{0}};
+        size_t instructions = 0;
+        for (size_t offset = 0, previous = CLOX_VM_OP_CODE_COUNT; offset < chunk.codes_count;
+                offset += clox_vm_op_code_length(chunk.codes[offset])) {
+            static_counts[chunk.codes[offset]]++;
+            if (previous != CLOX_VM_OP_CODE_COUNT) {
+                static_pairs[previous][chunk.codes[offset]]++;
+            }
+            previous = chunk.codes[offset];
+            instructions++;
+        }
+
+        assert(clox_vm_profile_instructions(&profile) == run * instructions);
+        for (size_t op = 0; op < CLOX_VM_OP_CODE_COUNT; op++) {
+            assert(profile.counts[op] == run * static_counts[op]);
+            assert(profile.samples[op] == 0);
+            // the return of a run doesn't pair with the first instruction of the next one
+            for (size_t next = 0; next < CLOX_VM_OP_CODE_COUNT; next++) {
+                assert(profile.pairs[op][next] == run * static_pairs[op][next]);
+            }
+        }
+    }
+    assert(profile.counts[CLOX_VM_OP_CODE_ADD] == 2);
+    assert(profile.pairs[CLOX_VM_OP_CODE_GET_GLOBAL][CLOX_VM_OP_CODE_CONSTANT] == 2);
+
+    clox_vm_free(&vm);
+    clox_vm_chunk_free(&chunk);
+}
+
+static void test_sampling(void) {
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+    assert(unit_compile("var x = 1; x = x * 2 + x; x = -x;", &chunk, clox_vm_compile) == 0);
+
+    struct clox_vm_profile profile;
+    clox_vm_profile_init(&profile, 2);
+    struct clox_vm vm;
+    clox_vm_init(&vm);
+    vm.profile = &profile;
+    for (int run = 0; run < 10; run++) {
+        assert(clox_vm_interpret(&vm, &chunk) == CLOX_VM_INTERPRET_RESULT_OK);
+    }
+
+    // every other instruction is timed, but the returns ending the runs aren't
+    uint64_t samples = 0;
+    for (size_t op = 0; op < CLOX_VM_OP_CODE_COUNT; op++) {
+        assert(profile.samples[op] <= profile.counts[op]);
+        samples += profile.samples[op];
+    }
+    assert(profile.samples[CLOX_VM_OP_CODE_RETURN] == 0);
+    const uint64_t instructions = clox_vm_profile_instructions(&profile);
+    assert(samples <= instructions / 2 && samples + 10 >= instructions / 2);
+    assert(profile.sampled == CLOX_VM_OP_CODE_COUNT);
+
+    clox_vm_free(&vm);
+    clox_vm_chunk_free(&chunk);
+}
+
+static void test_runtime_error(void) {
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+    assert(unit_compile("var x = nil; x = x - 1;", &chunk, clox_vm_compile) == 0);
+
+    struct clox_vm_profile profile;
+    clox_vm_profile_init(&profile, 1);
+    struct clox_vm vm;
+    clox_vm_init(&vm);
+    vm.profile = &profile;
+    assert(clox_vm_interpret(&vm, &chunk) == CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR);
+
+    // the failed instruction is counted, not timed
+    assert(profile.counts[CLOX_VM_OP_CODE_SUBTRACT] == 1);
+    assert(profile.samples[CLOX_VM_OP_CODE_SUBTRACT] == 0);
+    assert(profile.counts[CLOX_VM_OP_CODE_RETURN] == 0);
+    assert(profile.previous == CLOX_VM_OP_CODE_COUNT);
+
+    clox_vm_free(&vm);
+    clox_vm_chunk_free(&chunk);
+}
+
+static void test_reports(void) {
+    struct clox_vm_profile profile;
+    clox_vm_profile_init(&profile, 0);
+    profile.counts[CLOX_VM_OP_CODE_CONSTANT] = 3;
+    profile.counts[CLOX_VM_OP_CODE_ADD] = 1;
+    profile.pairs[CLOX_VM_OP_CODE_CONSTANT][CLOX_VM_OP_CODE_ADD] = 1;
+    profile.pairs[CLOX_VM_OP_CODE_CONSTANT][CLOX_VM_OP_CODE_CONSTANT] = 2;
+
+    char buffer[1024] = {0};
+    FILE* file = fmemopen(buffer, sizeof(buffer) - 1, "w");
+    clox_vm_profile_fprint_json(&profile, file);
+    fclose(file);
+    assert(strcmp(buffer,
+        "{\"instructions\":4,\"sample_period\":0,\"opcodes\":["
+        "{\"opcode\":\"CONSTANT\",\"count\":3,\"samples\":0,\"ns\":null},"
+        "{\"opcode\":\"ADD\",\"count\":1,\"samples\":0,\"ns\":null}],\"pairs\":["
+        "{\"first\":\"CONSTANT\",\"second\":\"CONSTANT\",\"count\":2},"
+        "{\"first\":\"CONSTANT\",\"second\":\"ADD\",\"count\":1}]}\n") == 0);
+
+    memset(buffer, 0, sizeof(buffer));
+    file = fmemopen(buffer, sizeof(buffer) - 1, "w");
+    clox_vm_profile_fprint_table(&profile, file, 1);
+    fclose(file);
+    assert(strncmp(buffer, "opcode profile: 4 instructions\n", 31) == 0);
+    // sorted, and only the first pair
+    char* constant = strstr(buffer, "\nCONSTANT ");
+    char* add = strstr(buffer, "\nADD ");
+    assert(constant != NULL && add != NULL && constant < add);
+    assert(strstr(buffer, "CONSTANT                 CONSTANT ") != NULL);
+    assert(strstr(buffer, "CONSTANT                 ADD ") == NULL);
+}
+
+int main() {
+    test_counts();
+    test_sampling();
+    test_runtime_error();
+    test_reports();
+
+    puts("profile.unit: ok");
+}
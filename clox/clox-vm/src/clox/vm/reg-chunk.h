@@ -0,0 +1,101 @@
+#ifndef CLOX_VM_REG_CHUNK_H
+#define CLOX_VM_REG_CHUNK_H
+
+#include "common.h"
+
+/**
+ * @brief Every opcode of the register VM (see reg-vm.h), as X(name, a, b, c), where a, b and c are the operands
+ * following the opcode in the chunk codes:
+ * - NONE: nothing
+ * - REG: a register, in one byte
+ * - CONSTANT: the index of a constant, in one byte
+ * - CONSTANT_LONG: the index of a constant, in 3 bytes (little endian)
+ *
+ * Instructions are three-address: the result goes straight to a register instead of the top of a stack, and the
+ * operands are read from wherever they are, so locals aren't copied around to be used. The register VM code is
+ * stored in a struct clox_vm_chunk, sharing its line table and deduplicated constants with the stack VM code.
+ */
+#define CLOX_VM_REG_OP_CODES(X)                                                                                     \
+    X(RETURN, NONE, NONE, NONE)                                                                                     \
+    /* R[a] = constant b */                                                                                         \
+    X(LOAD_CONSTANT, REG, CONSTANT, NONE)                                                                           \
+    X(LOAD_CONSTANT_LONG, REG, CONSTANT_LONG, NONE)                                                                 \
+    X(LOAD_NIL, REG, NONE, NONE)                                                                                    \
+    X(LOAD_TRUE, REG, NONE, NONE)                                                                                   \
+    X(LOAD_FALSE, REG, NONE, NONE)                                                                                  \
+    /* R[a] = R[b] */                                                                                               \
+    X(MOVE, REG, REG, NONE)                                                                                         \
+    /* Defines the global whose name is constant b as R[a] */                                                       \
+    X(DEFINE_GLOBAL, REG, CONSTANT, NONE)                                                                           \
+    X(DEFINE_GLOBAL_LONG, REG, CONSTANT_LONG, NONE)                                                                 \
+    /* R[a] = the global whose name is constant b */                                                                \
+    X(GET_GLOBAL, REG, CONSTANT, NONE)                                                                              \
+    X(GET_GLOBAL_LONG, REG, CONSTANT_LONG, NONE)                                                                    \
+    /* The global whose name is constant b = R[a] */                                                                \
+    X(SET_GLOBAL, REG, CONSTANT, NONE)                                                                              \
+    X(SET_GLOBAL_LONG, REG, CONSTANT_LONG, NONE)                                                                    \
+    /* R[a] = R[b] <op> R[c] */                                                                                     \
+    X(EQUAL, REG, REG, REG)                                                                                         \
+    X(NOT_EQUAL, REG, REG, REG)                                                                                     \
+    X(GREATER, REG, REG, REG)                                                                                       \
+    X(GREATER_EQUAL, REG, REG, REG)                                                                                 \
+    X(LESS, REG, REG, REG)                                                                                          \
+    X(LESS_EQUAL, REG, REG, REG)                                                                                    \
+    X(ADD, REG, REG, REG)                                                                                           \
+    X(SUBTRACT, REG, REG, REG)                                                                                      \
+    X(MULTIPLY, REG, REG, REG)                                                                                      \
+    X(DIVIDE, REG, REG, REG)                                                                                        \
+    /* R[a] = R[b] <op> constant c */                                                                               \
+    X(ADD_CONSTANT, REG, REG, CONSTANT)                                                                             \
+    X(SUBTRACT_CONSTANT, REG, REG, CONSTANT)                                                                        \
+    X(MULTIPLY_CONSTANT, REG, REG, CONSTANT)                                                                        \
+    X(DIVIDE_CONSTANT, REG, REG, CONSTANT)                                                                          \
+    X(GREATER_CONSTANT, REG, REG, CONSTANT)                                                                         \
+    X(GREATER_EQUAL_CONSTANT, REG, REG, CONSTANT)                                                                   \
+    X(LESS_CONSTANT, REG, REG, CONSTANT)                                                                            \
+    X(LESS_EQUAL_CONSTANT, REG, REG, CONSTANT)                                                                      \
+    /* R[a] = <op> R[b] */                                                                                          \
+    X(NOT, REG, REG, NONE)                                                                                          \
+    X(NEGATE, REG, REG, NONE)                                                                                       \
+    X(PRINT, REG, NONE, NONE)
+
+enum clox_vm_reg_op_code {
+#define X(name, a, b, c) CLOX_VM_REG_OP_CODE_##name,
+    CLOX_VM_REG_OP_CODES(X)
+#undef X
+    /**
+     * @brief How many opcodes there are. Not an opcode itself
+     */
+    CLOX_VM_REG_OP_CODE_COUNT,
+};
+
+#define CLOX_VM_REG_OP_OPERAND_LENGTH_NONE 0
+#define CLOX_VM_REG_OP_OPERAND_LENGTH_REG 1
+#define CLOX_VM_REG_OP_OPERAND_LENGTH_CONSTANT 1
+#define CLOX_VM_REG_OP_OPERAND_LENGTH_CONSTANT_LONG 3
+
+/**
+ * @brief How many codes an instruction takes, its opcode included, as a constant expression
+ */
+#define CLOX_VM_REG_OP_LENGTH(a, b, c)                                                                              \
+    (1 + CLOX_VM_REG_OP_OPERAND_LENGTH_##a + CLOX_VM_REG_OP_OPERAND_LENGTH_##b + CLOX_VM_REG_OP_OPERAND_LENGTH_##c)
+
+/**
+ * @return size_t how many codes an instruction takes, its opcode included
+ */
+static inline size_t clox_vm_reg_op_code_length(enum clox_vm_reg_op_code op) {
+    switch (op) {
+#define X(name, a, b, c) case CLOX_VM_REG_OP_CODE_##name: return CLOX_VM_REG_OP_LENGTH(a, b, c);
+    CLOX_VM_REG_OP_CODES(X)
+#undef X
+    default:
+        return 1;
+    }
+}
+
+/**
+ * @brief How many registers a frame has: register operands take one byte
+ */
+#define CLOX_VM_REG_REGISTERS_MAX 256
+
+#endif
@@ -0,0 +1,633 @@
+#include "reg-compiler.h"
+
+#include "chunk.h"
+#include "reg-chunk.h"
+
+#include <assert.h>
+
+#include <clox/stb_ds.h>
+#include <clox/ast/expr.h>
+#include <clox/ast/expr-visitor.h>
+#include <clox/ast/statement.h>
+#include <clox/ast/statement-visitor.h>
+#include <clox/ast/program.h>
+
+enum reg_operand_kind {
+    /**
+     * @brief The register of a local, which is read in place
+     */
+    REG_OPERAND_KIND_LOCAL,
+    /**
+     * @brief A temporary register, released along with the expression using it
+     */
+    REG_OPERAND_KIND_TEMP,
+    /**
+     * @brief A constant not loaded into any register yet, so that instructions taking a constant operand can use it
+     * as it is
+     */
+    REG_OPERAND_KIND_CONSTANT,
+};
+
+/**
+ * @brief Where the value of a compiled expression is
+ */
+struct reg_operand {
+    enum reg_operand_kind kind;
+    /**
+     * @brief The register, or the index of the constant
+     */
+    size_t index;
+};
+
+/**
+ * @brief An expression pending compilation. Same as the stack VM compiler frames, plus the first register the
+ * expression may use for its temporaries
+ */
+struct reg_compiler_frame {
+    struct clox_ast_expr* expr;
+    size_t next_child;
+    uint32_t base;
+};
+
+struct reg_compiler {
+    struct clox_vm_chunk* chunk;
+    /**
+     * @brief Line of the code being compiled. Only some nodes have tokens, so the others inherit the line of the
+     * closest enclosing one
+     */
+    size_t line;
+    /**
+     * @brief How many block locals are in scope. They take the registers below it
+     */
+    uint32_t local_count;
+    /**
+     * @brief The first free register. Temporaries are allocated and released like a stack, above the locals
+     */
+    uint32_t next_register;
+    /**
+     * @brief The first register the temporaries of the expression being visited may use
+     */
+    uint32_t visited_base;
+    /**
+     * @brief Offset of the last instruction written if its result goes to its first operand, or SIZE_MAX. An
+     * assignment can make it write straight to the variable instead of a temporary
+     */
+    size_t last_result_offset;
+    /**
+     * @brief Dynamic array (stb_ds) of the expressions pending compilation
+     */
+    struct reg_compiler_frame* frames;
+    /**
+     * @brief Dynamic array (stb_ds) of where the values of the compiled expressions are, the last compiled on top
+     */
+    struct reg_operand* operands;
+};
+
+static int reg_compile_expr_binary(struct clox_ast_expr* expr, void* userctx);
+static int reg_compile_expr_grouping(struct clox_ast_expr* expr, void* userctx);
+static int reg_compile_expr_literal(struct clox_ast_expr* expr, void* userctx);
+static int reg_compile_expr_unary(struct clox_ast_expr* expr, void* userctx);
+static int reg_compile_expr_var(struct clox_ast_expr* expr, void* userctx);
+static int reg_compile_expr_assign(struct clox_ast_expr* expr, void* userctx);
+static int reg_compile_expr_concat(struct clox_ast_expr* expr, void* userctx);
+
+static int reg_compile_statement_expr(struct clox_ast_statement* stmt, void* userctx);
+static int reg_compile_statement_print(struct clox_ast_statement* stmt, void* userctx);
+static int reg_compile_statement_var(struct clox_ast_statement* stmt, void* userctx);
+static int reg_compile_statement_block(struct clox_ast_statement* stmt, void* userctx);
+
+static const struct clox_ast_expr_visitor reg_compiler_expr_visitor = {
+    .visit_binary = reg_compile_expr_binary,
+    .visit_grouping = reg_compile_expr_grouping,
+    .visit_literal = reg_compile_expr_literal,
+    .visit_unary = reg_compile_expr_unary,
+    .visit_var = reg_compile_expr_var,
+    .visit_assign = reg_compile_expr_assign,
+    .visit_concat = reg_compile_expr_concat,
+};
+
+static const struct clox_ast_statement_visitor reg_compiler_statement_visitor = {
+    .visit_statement_expr = reg_compile_statement_expr,
+    .visit_statement_print = reg_compile_statement_print,
+    .visit_statement_var = reg_compile_statement_var,
+    .visit_statement_block = reg_compile_statement_block,
+};
+
+static void emit_byte(struct reg_compiler* compiler, uint8_t byte) {
+    clox_vm_chunk_write(compiler->chunk, byte, compiler->line);
+}
+
+/**
+ * @brief Emits an instruction. Its operands are bytes: the ones it doesn't have are ignored
+ */
+static void emit_op(struct reg_compiler* compiler, enum clox_vm_reg_op_code op, uint8_t a, uint8_t b, uint8_t c) {
+    const size_t length = clox_vm_reg_op_code_length(op);
+    const uint8_t operands[] = {a, b, c};
+    compiler->last_result_offset = SIZE_MAX;
+    emit_byte(compiler, op);
+    for (size_t i = 0; i + 1 < length; i++) {
+        emit_byte(compiler, operands[i]);
+    }
+}
+
+/**
+ * @brief Emits an instruction whose result goes to register a
+ */
+static void emit_result_op(struct reg_compiler* compiler, enum clox_vm_reg_op_code op, uint8_t a, uint8_t b,
+    uint8_t c) {
+    const size_t offset = compiler->chunk->codes_count;
+    emit_op(compiler, op, a, b, c);
+    compiler->last_result_offset = offset;
+}
+
+/**
+ * @brief Emits an instruction taking a register and a constant: op if the index fits a byte, else op_long
+ *
+ * @return int 0 on success. non-zero if the chunk constants don't fit the instruction operand anymore
+ */
+static int emit_constant_op(struct reg_compiler* compiler, enum clox_vm_reg_op_code op,
+    enum clox_vm_reg_op_code op_long, uint8_t reg, size_t index) {
+    if (index >= CLOX_VM_CHUNK_CONSTANTS_MAX) {
+        fprintf(stderr, "error: line %zu: too many constants in one chunk\n", compiler->line);
+        return 1;
+    }
+    if (index <= UINT8_MAX) {
+        emit_op(compiler, op, reg, (uint8_t) index, 0);
+        return 0;
+    }
+    compiler->last_result_offset = SIZE_MAX;
+    emit_byte(compiler, op_long);
+    emit_byte(compiler, reg);
+    emit_byte(compiler, (uint8_t) (index & 0xff));
+    emit_byte(compiler, (uint8_t) ((index >> 8) & 0xff));
+    emit_byte(compiler, (uint8_t) ((index >> 16) & 0xff));
+    return 0;
+}
+
+/**
+ * @brief Emits an instruction whose operands are a register and the constant with a variable name
+ */
+static int emit_named(struct reg_compiler* compiler, enum clox_vm_reg_op_code op, enum clox_vm_reg_op_code op_long,
+    uint8_t reg, const struct token* name) {
+    size_t index = clox_vm_chunk_add_constant(compiler->chunk, clox_value_string_from_strview(name->lexeme));
+    return emit_constant_op(compiler, op, op_long, reg, index);
+}
+
+/**
+ * @brief Allocates a temporary register above the ones in use
+ */
+static int reg_alloc(struct reg_compiler* compiler, uint8_t* reg) {
+    if (compiler->next_register >= CLOX_VM_REG_REGISTERS_MAX) {
+        fprintf(stderr, "error: line %zu: expression too complex, it needs more than %d registers\n", compiler->line,
+            CLOX_VM_REG_REGISTERS_MAX);
+        return 1;
+    }
+    *reg = (uint8_t) compiler->next_register++;
+    return 0;
+}
+
+/**
+ * @brief Makes sure an operand is in a register, loading a constant into a new temporary
+ */
+static int reg_operand_load(struct reg_compiler* compiler, struct reg_operand* operand) {
+    if (operand->kind != REG_OPERAND_KIND_CONSTANT) {
+        return 0;
+    }
+    uint8_t reg;
+    if (reg_alloc(compiler, &reg) != 0) {
+        return 1;
+    }
+    const size_t offset = compiler->chunk->codes_count;
+    if (emit_constant_op(compiler, CLOX_VM_REG_OP_CODE_LOAD_CONSTANT, CLOX_VM_REG_OP_CODE_LOAD_CONSTANT_LONG, reg,
+            operand->index) != 0) {
+        return 1;
+    }
+    compiler->last_result_offset = offset;
+    *operand = (struct reg_operand) { .kind = REG_OPERAND_KIND_TEMP, .index = reg };
+    return 0;
+}
+
+/**
+ * @brief Starts the result of an expression: releases the temporaries of its children and allocates the register
+ * its result goes to, which may be one of them. The instructions read their operands before writing their
+ * result, so that's fine
+ */
+static int reg_result(struct reg_compiler* compiler, uint32_t base, uint8_t* reg) {
+    compiler->next_register = base;
+    if (reg_alloc(compiler, reg) != 0) {
+        return 1;
+    }
+    arrpush(compiler->operands, ((struct reg_operand) { .kind = REG_OPERAND_KIND_TEMP, .index = *reg }));
+    return 0;
+}
+
+/**
+ * @brief Emits a binary operator applied to the two operands on top of the operand stack, replacing them with its
+ * result
+ */
+static int reg_compile_binary(struct reg_compiler* compiler, uint32_t base, enum clox_vm_reg_op_code op,
+    enum clox_vm_reg_op_code op_constant) {
+    struct reg_operand right = arrpop(compiler->operands);
+    struct reg_operand left = arrpop(compiler->operands);
+    if (reg_operand_load(compiler, &left) != 0) {
+        return 1;
+    }
+    // constants fitting a byte don't need to be loaded first
+    const bool right_constant = op_constant != CLOX_VM_REG_OP_CODE_COUNT
+        && right.kind == REG_OPERAND_KIND_CONSTANT && right.index <= UINT8_MAX;
+    if (!right_constant && reg_operand_load(compiler, &right) != 0) {
+        return 1;
+    }
+
+    uint8_t reg;
+    if (reg_result(compiler, base, &reg) != 0) {
+        return 1;
+    }
+    emit_result_op(compiler, right_constant ? op_constant : op, reg, (uint8_t) left.index, (uint8_t) right.index);
+    return 0;
+}
+
+/**
+ * @return size_t the line of the expression own token, or fallback if it has none
+ */
+static size_t expr_line(const struct clox_ast_expr* expr, size_t fallback) {
+    switch (expr->kind) {
+    case CLOX_AST_EXPR_KIND_BINARY:
+        return expr->value.binary.operator.line;
+    case CLOX_AST_EXPR_KIND_UNARY:
+        return expr->value.unary.operator.line;
+    case CLOX_AST_EXPR_KIND_VAR:
+        return expr->value.var.name.line;
+    case CLOX_AST_EXPR_KIND_ASSIGN:
+        return expr->value.assign.name.line;
+    case CLOX_AST_EXPR_KIND_CONCAT:
+        return expr->value.concat.operators[0].line;
+    default:
+        return fallback;
+    }
+}
+
+/**
+ * @brief Compiles an expression, pushing where its value is to the operand stack.
+ *
+ * Like the stack VM compiler, it's a postorder traversal with an explicit stack, so long chains don't exhaust the
+ * C stack. Locals are used in place, so one read before an operand able to assign it (i.e. not a leaf, the same
+ * rule as the AST interpreter borrowing values) is copied to a temporary first.
+ */
+static int reg_compile_expr(struct reg_compiler* compiler, struct clox_ast_expr* expr) {
+    const long frames_base = arrlen(compiler->frames);
+    const size_t line = compiler->line;
+
+    arrpush(compiler->frames, ((struct reg_compiler_frame) {
+        .expr = expr,
+        .next_child = 0,
+        .base = compiler->next_register,
+    }));
+    while (arrlen(compiler->frames) > frames_base) {
+        struct reg_compiler_frame* frame = &arrlast(compiler->frames);
+        if (frame->next_child == 0) {
+            compiler->line = expr_line(frame->expr, compiler->line);
+        }
+
+        struct clox_ast_expr* child = clox_ast_expr_child(frame->expr, frame->next_child);
+        if (child != NULL) {
+            int rc = 0;
+            // A concat node is a chain of `+`, so every operand after the second one is joined to the result so far
+            // right after being evaluated
+            if (frame->expr->kind == CLOX_AST_EXPR_KIND_CONCAT && frame->next_child >= 2) {
+                compiler->line = frame->expr->value.concat.operators[frame->next_child - 2].line;
+                rc = reg_compile_binary(compiler, frame->base, CLOX_VM_REG_OP_CODE_ADD,
+                    CLOX_VM_REG_OP_CODE_ADD_CONSTANT);
+            }
+            struct reg_operand* previous = (frame->next_child > 0) ? &arrlast(compiler->operands) : NULL;
+            if (rc == 0 && previous != NULL && previous->kind == REG_OPERAND_KIND_LOCAL
+                && !clox_ast_expr_is_leaf(child)) {
+                uint8_t reg;
+                rc = reg_alloc(compiler, &reg);
+                if (rc == 0) {
+                    emit_result_op(compiler, CLOX_VM_REG_OP_CODE_MOVE, reg, (uint8_t) previous->index, 0);
+                    *previous = (struct reg_operand) { .kind = REG_OPERAND_KIND_TEMP, .index = reg };
+                }
+            }
+            if (rc != 0) {
+                arrsetlen(compiler->frames, frames_base);
+                return rc;
+            }
+            frame->next_child++;
+            arrpush(compiler->frames, ((struct reg_compiler_frame) {
+                .expr = child,
+                .next_child = 0,
+                .base = compiler->next_register,
+            }));
+            continue;
+        }
+
+        struct reg_compiler_frame ready = arrpop(compiler->frames);
+        // the children may have moved the line forward
+        compiler->line = expr_line(ready.expr, compiler->line);
+        compiler->visited_base = ready.base;
+        int rc = clox_ast_expr_accept(ready.expr, &reg_compiler_expr_visitor, compiler);
+        if (rc != 0) {
+            arrsetlen(compiler->frames, frames_base);
+            return rc;
+        }
+    }
+
+    compiler->line = line;
+    return 0;
+}
+
+static int reg_compile_expr_binary(struct clox_ast_expr* expr, void* userctx) {
+    struct reg_compiler* compiler = userctx;
+    const uint32_t base = compiler->visited_base;
+
+    switch (expr->value.binary.operator.kind) {
+    case TOKEN_KIND_PLUS:
+        return reg_compile_binary(compiler, base, CLOX_VM_REG_OP_CODE_ADD, CLOX_VM_REG_OP_CODE_ADD_CONSTANT);
+    case TOKEN_KIND_MINUS:
+        return reg_compile_binary(compiler, base, CLOX_VM_REG_OP_CODE_SUBTRACT,
+            CLOX_VM_REG_OP_CODE_SUBTRACT_CONSTANT);
+    case TOKEN_KIND_STAR:
+        return reg_compile_binary(compiler, base, CLOX_VM_REG_OP_CODE_MULTIPLY,
+            CLOX_VM_REG_OP_CODE_MULTIPLY_CONSTANT);
+    case TOKEN_KIND_SLASH:
+        return reg_compile_binary(compiler, base, CLOX_VM_REG_OP_CODE_DIVIDE, CLOX_VM_REG_OP_CODE_DIVIDE_CONSTANT);
+    case TOKEN_KIND_GREATER:
+        return reg_compile_binary(compiler, base, CLOX_VM_REG_OP_CODE_GREATER,
+            CLOX_VM_REG_OP_CODE_GREATER_CONSTANT);
+    case TOKEN_KIND_GREATER_EQUAL:
+        return reg_compile_binary(compiler, base, CLOX_VM_REG_OP_CODE_GREATER_EQUAL,
+            CLOX_VM_REG_OP_CODE_GREATER_EQUAL_CONSTANT);
+    case TOKEN_KIND_LESS:
+        return reg_compile_binary(compiler, base, CLOX_VM_REG_OP_CODE_LESS, CLOX_VM_REG_OP_CODE_LESS_CONSTANT);
+    case TOKEN_KIND_LESS_EQUAL:
+        return reg_compile_binary(compiler, base, CLOX_VM_REG_OP_CODE_LESS_EQUAL,
+            CLOX_VM_REG_OP_CODE_LESS_EQUAL_CONSTANT);
+    case TOKEN_KIND_EQUAL_EQUAL:
+        return reg_compile_binary(compiler, base, CLOX_VM_REG_OP_CODE_EQUAL, CLOX_VM_REG_OP_CODE_COUNT);
+    case TOKEN_KIND_BANG_EQUAL:
+        return reg_compile_binary(compiler, base, CLOX_VM_REG_OP_CODE_NOT_EQUAL, CLOX_VM_REG_OP_CODE_COUNT);
+    default:
+        fprintf(stderr, "error: line %zu: unknown binary operator '%.*s'\n", compiler->line,
+            (int) expr->value.binary.operator.lexeme.len, expr->value.binary.operator.lexeme.ptr);
+        return 1;
+    }
+}
+
+static int reg_compile_expr_grouping(struct clox_ast_expr* expr, void* userctx) {
+    (void) expr;
+    (void) userctx;
+    // the grouped expression operand is the grouping's
+    return 0;
+}
+
+static int reg_compile_expr_literal(struct clox_ast_expr* expr, void* userctx) {
+    struct reg_compiler* compiler = userctx;
+    struct clox_ast_expr_literal* lit = &expr->value.literal;
+
+    enum clox_vm_reg_op_code op;
+    switch (lit->kind) {
+    case CLOX_AST_EXPR_LITERAL_KIND_NUMBER:
+        arrpush(compiler->operands, ((struct reg_operand) {
+            .kind = REG_OPERAND_KIND_CONSTANT,
+            .index = clox_vm_chunk_add_constant(compiler->chunk, clox_value_number_compact(lit->value.number.val)),
+        }));
+        return 0;
+    case CLOX_AST_EXPR_LITERAL_KIND_STRING:
+        // shared with the AST
+        arrpush(compiler->operands, ((struct reg_operand) {
+            .kind = REG_OPERAND_KIND_CONSTANT,
+            .index = clox_vm_chunk_add_constant(compiler->chunk, clox_value_string(rcstr_retain(lit->value.string.val))),
+        }));
+        return 0;
+    case CLOX_AST_EXPR_LITERAL_KIND_BOOL:
+        op = lit->value.boolean.val ? CLOX_VM_REG_OP_CODE_LOAD_TRUE : CLOX_VM_REG_OP_CODE_LOAD_FALSE;
+        break;
+    case CLOX_AST_EXPR_LITERAL_KIND_NIL:
+        op = CLOX_VM_REG_OP_CODE_LOAD_NIL;
+        break;
+    default:
+        return 1;
+    }
+
+    uint8_t reg;
+    if (reg_result(compiler, compiler->visited_base, &reg) != 0) {
+        return 1;
+    }
+    emit_result_op(compiler, op, reg, 0, 0);
+    return 0;
+}
+
+static int reg_compile_expr_unary(struct clox_ast_expr* expr, void* userctx) {
+    struct reg_compiler* compiler = userctx;
+
+    enum clox_vm_reg_op_code op;
+    switch (expr->value.unary.operator.kind) {
+    case TOKEN_KIND_MINUS: op = CLOX_VM_REG_OP_CODE_NEGATE; break;
+    case TOKEN_KIND_BANG:  op = CLOX_VM_REG_OP_CODE_NOT; break;
+    default:
+        fprintf(stderr, "error: line %zu: unknown unary operator '%.*s'\n", compiler->line,
+            (int) expr->value.unary.operator.lexeme.len, expr->value.unary.operator.lexeme.ptr);
+        return 1;
+    }
+
+    struct reg_operand operand = arrpop(compiler->operands);
+    if (reg_operand_load(compiler, &operand) != 0) {
+        return 1;
+    }
+    uint8_t reg;
+    if (reg_result(compiler, compiler->visited_base, &reg) != 0) {
+        return 1;
+    }
+    emit_result_op(compiler, op, reg, (uint8_t) operand.index, 0);
+    return 0;
+}
+
+static int reg_compile_expr_var(struct clox_ast_expr* expr, void* userctx) {
+    struct reg_compiler* compiler = userctx;
+    struct clox_ast_expr_var* var = &expr->value.var;
+
+    if (var->slot != CLOX_AST_SLOT_GLOBAL) {
+        // read in place
+        arrpush(compiler->operands, ((struct reg_operand) { .kind = REG_OPERAND_KIND_LOCAL, .index = var->slot }));
+        return 0;
+    }
+
+    uint8_t reg;
+    if (reg_result(compiler, compiler->visited_base, &reg) != 0) {
+        return 1;
+    }
+    const size_t offset = compiler->chunk->codes_count;
+    if (emit_named(compiler, CLOX_VM_REG_OP_CODE_GET_GLOBAL, CLOX_VM_REG_OP_CODE_GET_GLOBAL_LONG, reg,
+            &var->name) != 0) {
+        return 1;
+    }
+    compiler->last_result_offset = offset;
+    return 0;
+}
+
+static int reg_compile_expr_assign(struct clox_ast_expr* expr, void* userctx) {
+    struct reg_compiler* compiler = userctx;
+    struct clox_ast_expr_assign* assign = &expr->value.assign;
+    const uint32_t base = compiler->visited_base;
+
+    struct reg_operand value = arrpop(compiler->operands);
+    if (assign->slot == CLOX_AST_SLOT_GLOBAL) {
+        if (reg_operand_load(compiler, &value) != 0) {
+            return 1;
+        }
+        if (emit_named(compiler, CLOX_VM_REG_OP_CODE_SET_GLOBAL, CLOX_VM_REG_OP_CODE_SET_GLOBAL_LONG,
+                (uint8_t) value.index, &assign->name) != 0) {
+            return 1;
+        }
+        // the assignment evaluates to the assigned value, which is still in its register
+        arrpush(compiler->operands, value);
+        return 0;
+    }
+
+    const uint8_t slot = (uint8_t) assign->slot;
+    if (value.kind == REG_OPERAND_KIND_CONSTANT) {
+        if (emit_constant_op(compiler, CLOX_VM_REG_OP_CODE_LOAD_CONSTANT, CLOX_VM_REG_OP_CODE_LOAD_CONSTANT_LONG,
+                slot, value.index) != 0) {
+            return 1;
+        }
+    } else if (value.kind == REG_OPERAND_KIND_TEMP && compiler->last_result_offset != SIZE_MAX
+        && compiler->chunk->codes[compiler->last_result_offset + 1] == value.index) {
+        // the value was just computed into the temporary: it's computed into the local instead
+        compiler->chunk->codes[compiler->last_result_offset + 1] = slot;
+    } else if (value.index != slot) {
+        emit_result_op(compiler, CLOX_VM_REG_OP_CODE_MOVE, slot, (uint8_t) value.index, 0);
+    }
+    compiler->next_register = base;
+    arrpush(compiler->operands, ((struct reg_operand) { .kind = REG_OPERAND_KIND_LOCAL, .index = slot }));
+    return 0;
+}
+
+static int reg_compile_expr_concat(struct clox_ast_expr* expr, void* userctx) {
+    struct reg_compiler* compiler = userctx;
+    // the operands before the last one were already joined by reg_compile_expr
+    compiler->line = arrlast(expr->value.concat.operators).line;
+    return reg_compile_binary(compiler, compiler->visited_base, CLOX_VM_REG_OP_CODE_ADD,
+        CLOX_VM_REG_OP_CODE_ADD_CONSTANT);
+}
+
+/**
+ * @brief Compiles an expression whose value must end up in a register, which is written to reg
+ */
+static int reg_compile_expr_to_register(struct reg_compiler* compiler, struct clox_ast_expr* expr, uint8_t* reg) {
+    if (reg_compile_expr(compiler, expr) != 0) {
+        return 1;
+    }
+    struct reg_operand operand = arrpop(compiler->operands);
+    if (reg_operand_load(compiler, &operand) != 0) {
+        return 1;
+    }
+    *reg = (uint8_t) operand.index;
+    return 0;
+}
+
+static int reg_compile_statement(struct reg_compiler* compiler, struct clox_ast_statement* stmt) {
+    int rc = clox_ast_statement_accept(stmt, &reg_compiler_statement_visitor, compiler);
+    // the temporaries don't outlive the statement
+    compiler->next_register = compiler->local_count;
+    if (compiler->operands != NULL) {
+        stbds_header(compiler->operands)->length = 0;
+    }
+    return rc;
+}
+
+static int reg_compile_statement_expr(struct clox_ast_statement* stmt, void* userctx) {
+    struct reg_compiler* compiler = userctx;
+
+    compiler->line = expr_line(stmt->as.expr_statement.expr, compiler->line);
+    // The expression value is just left where it is
+    return reg_compile_expr(compiler, stmt->as.expr_statement.expr);
+}
+
+static int reg_compile_statement_print(struct clox_ast_statement* stmt, void* userctx) {
+    struct reg_compiler* compiler = userctx;
+
+    compiler->line = expr_line(stmt->as.print_statement.expr, compiler->line);
+    uint8_t reg;
+    if (reg_compile_expr_to_register(compiler, stmt->as.print_statement.expr, &reg) != 0) {
+        return 1;
+    }
+    emit_op(compiler, CLOX_VM_REG_OP_CODE_PRINT, reg, 0, 0);
+    return 0;
+}
+
+static int reg_compile_statement_var(struct clox_ast_statement* stmt, void* userctx) {
+    struct reg_compiler* compiler = userctx;
+    struct clox_ast_statement_var* var_stmt = &stmt->as.var_statement;
+
+    compiler->line = var_stmt->name.line;
+    if (var_stmt->slot != CLOX_AST_SLOT_GLOBAL && var_stmt->slot >= CLOX_VM_REG_REGISTERS_MAX) {
+        fprintf(stderr, "error: line %zu: too many local variables in scope\n", compiler->line);
+        return 1;
+    }
+
+    uint8_t reg;
+    if (var_stmt->initializer != NULL) {
+        if (reg_compile_expr_to_register(compiler, var_stmt->initializer, &reg) != 0) {
+            return 1;
+        }
+    } else if (reg_alloc(compiler, &reg) == 0) {
+        emit_result_op(compiler, CLOX_VM_REG_OP_CODE_LOAD_NIL, reg, 0, 0);
+    } else {
+        return 1;
+    }
+
+    if (var_stmt->slot != CLOX_AST_SLOT_GLOBAL) {
+        // The local takes the first free register, where the initializer value usually is already
+        assert((uint32_t) var_stmt->slot == compiler->local_count);
+        if (reg != var_stmt->slot) {
+            emit_result_op(compiler, CLOX_VM_REG_OP_CODE_MOVE, (uint8_t) var_stmt->slot, reg, 0);
+        }
+        compiler->local_count++;
+        return 0;
+    }
+    return emit_named(compiler, CLOX_VM_REG_OP_CODE_DEFINE_GLOBAL, CLOX_VM_REG_OP_CODE_DEFINE_GLOBAL_LONG, reg,
+        &var_stmt->name);
+}
+
+static int reg_compile_statement_block(struct clox_ast_statement* stmt, void* userctx) {
+    struct reg_compiler* compiler = userctx;
+    struct clox_ast_statement_block* block_stmt = &stmt->as.block_statement;
+
+    assert(block_stmt->first_slot == compiler->local_count);
+    for (long i = 0; i < arrlen(block_stmt->statements); i++) {
+        if (reg_compile_statement(compiler, block_stmt->statements[i]) != 0) {
+            return 1;
+        }
+    }
+
+    // Leaving the scope frees its registers, the values in them are released when they are overwritten
+    compiler->local_count -= block_stmt->slot_count;
+    return 0;
+}
+
+int clox_vm_reg_compile(struct clox_ast_program* prog, struct clox_vm_chunk* chunk) {
+    struct reg_compiler compiler = {
+        .chunk = chunk,
+        .line = 1,
+        .local_count = 0,
+        .next_register = 0,
+        .visited_base = 0,
+        .last_result_offset = SIZE_MAX,
+        .frames = NULL,
+        .operands = NULL,
+    };
+
+    int rc = 0;
+    for (long i = 0; i < arrlen(prog->statements); i++) {
+        rc = reg_compile_statement(&compiler, prog->statements[i]);
+        if (rc != 0) {
+            break;
+        }
+    }
+    emit_op(&compiler, CLOX_VM_REG_OP_CODE_RETURN, 0, 0, 0);
+
+    arrfree(compiler.operands);
+    arrfree(compiler.frames);
+    return rc;
+}
@@ -0,0 +1,25 @@
+#ifndef CLOX_VM_REG_COMPILER_H
+#define CLOX_VM_REG_COMPILER_H
+
+#include "common.h"
+
+struct clox_ast_program;
+struct clox_vm_chunk;
+
+/**
+ * @brief Compiles a parsed program into register VM code (see reg-chunk.h), appending it to the chunk followed by
+ * a return instruction.
+ *
+ * Block locals live in the registers numbered after the slots the parser resolved them to, and the temporaries of
+ * an expression in the registers right above the locals in scope. Reading a local takes no instruction: its
+ * register is the operand. Globals are looked up by name. The chunk borrows nothing from the program, so the AST
+ * can be freed right after compiling it.
+ *
+ * @param prog
+ * @param chunk
+ * @return int 0 on success. non-zero if the program exceeds the chunk limits (e.g. an expression needing more than
+ * CLOX_VM_REG_REGISTERS_MAX registers), which is reported to stderr
+ */
+int clox_vm_reg_compile(struct clox_ast_program* prog, struct clox_vm_chunk* chunk);
+
+#endif
@@ -0,0 +1,405 @@
+#include "reg-vm.h"
+
+#include "chunk.h"
+
+#include <unistd.h>
+
+static enum clox_vm_interpret_result reg_vm_run(struct clox_vm_reg_vm* vm);
+
+/**
+ * @return the source line of the instruction being executed
+ */
+static size_t reg_vm_current_line(const struct clox_vm_reg_vm* vm);
+
+/**
+ * @brief Reports an undefined variable, with the same message as the stack VM
+ */
+static void reg_vm_report_undefined_variable(struct clox_vm_reg_vm* vm, clox_vm_value* name);
+
+/**
+ * @brief Reports a binary operator requiring numbers applied to something else, with the same message as the stack
+ * VM
+ */
+static void reg_vm_report_number_operands(struct clox_vm_reg_vm* vm, const char* operator, clox_vm_value left,
+    clox_vm_value right);
+
+/**
+ * @brief Reports `+` applied to something else than two numbers or two strings, with the same message as the stack
+ * VM
+ */
+static void reg_vm_report_add_operands(struct clox_vm_reg_vm* vm, clox_vm_value left, clox_vm_value right);
+
+void clox_vm_reg_vm_init(struct clox_vm_reg_vm* vm) {
+    vm->chunk = NULL;
+    vm->ip = NULL;
+    for (size_t i = 0; i < CLOX_VM_REG_REGISTERS_MAX; i++) {
+        vm->registers[i] = clox_value_nil();
+    }
+    clox_env_init(&vm->globals);
+    clox_output_init(&vm->output, STDOUT_FILENO, CLOX_OUTPUT_DEFAULT_CAP);
+}
+
+void clox_vm_reg_vm_free(struct clox_vm_reg_vm* vm) {
+    for (size_t i = 0; i < CLOX_VM_REG_REGISTERS_MAX; i++) {
+        clox_value_free(&vm->registers[i]);
+    }
+    clox_env_free(&vm->globals);
+    clox_output_free(&vm->output);
+    vm->chunk = NULL;
+    vm->ip = NULL;
+}
+
+enum clox_vm_interpret_result clox_vm_reg_vm_interpret(struct clox_vm_reg_vm* vm, struct clox_vm_chunk* chunk) {
+    vm->chunk = chunk;
+    vm->ip = chunk->codes;
+
+    return reg_vm_run(vm);
+}
+
+static size_t reg_vm_current_line(const struct clox_vm_reg_vm* vm) {
+    return clox_vm_chunk_get_line(vm->chunk, (size_t) (vm->ip - vm->chunk->codes));
+}
+
+static void reg_vm_report_undefined_variable(struct clox_vm_reg_vm* vm, clox_vm_value* name) {
+    clox_output_flush(&vm->output);
+    struct strview sv = clox_value_as_strview(name);
+    fprintf(stderr, "error: line %zu: undefined variable '%.*s'\n", reg_vm_current_line(vm), (int) sv.len, sv.ptr);
+}
+
+static void reg_vm_report_number_operands(struct clox_vm_reg_vm* vm, const char* operator, clox_vm_value left,
+    clox_vm_value right) {
+    clox_output_flush(&vm->output);
+    fprintf(stderr, "error: line %zu: binary operator '%s' requires both operands to be numbers. got left as %s and right as %s\n",
+        reg_vm_current_line(vm), operator, clox_value_kind_to_cstr(clox_value_get_kind(left)),
+        clox_value_kind_to_cstr(clox_value_get_kind(right)));
+}
+
+static void reg_vm_report_add_operands(struct clox_vm_reg_vm* vm, clox_vm_value left, clox_vm_value right) {
+    clox_output_flush(&vm->output);
+    fprintf(stderr, "error: line %zu: binary operator '+' is only valid if both operands are numbers or strings. left operand is %s and right operand is %s\n",
+        reg_vm_current_line(vm), clox_value_kind_to_cstr(clox_value_get_kind(left)),
+        clox_value_kind_to_cstr(clox_value_get_kind(right)));
+}
+
+/**
+ * @brief Writes a value to a register, releasing the one it held. Only strings hold anything
+ */
+static inline void reg_vm_set(clox_vm_value* reg, clox_vm_value value) {
+    if (clox_value_is_string(*reg)) {
+        clox_value_free(reg);
+    }
+    *reg = value;
+}
+
+static void reg_vm_define_global(struct clox_vm_reg_vm* vm, clox_vm_value value, clox_vm_value* name) {
+    clox_env_define(&vm->globals, clox_value_as_strview(name), clox_value_dup(value));
+}
+
+static enum clox_vm_interpret_result reg_vm_get_global(struct clox_vm_reg_vm* vm, clox_vm_value* reg,
+    clox_vm_value* name) {
+    struct clox_env_kv* entry = clox_env_lookup(&vm->globals, clox_value_as_strview(name));
+    if (entry == NULL) {
+        reg_vm_report_undefined_variable(vm, name);
+        return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+    }
+    reg_vm_set(reg, clox_value_dup(entry->value));
+    return CLOX_VM_INTERPRET_RESULT_OK;
+}
+
+static enum clox_vm_interpret_result reg_vm_set_global(struct clox_vm_reg_vm* vm, clox_vm_value value,
+    clox_vm_value* name) {
+    struct clox_env_kv* entry = clox_env_lookup(&vm->globals, clox_value_as_strview(name));
+    if (entry == NULL) {
+        reg_vm_report_undefined_variable(vm, name);
+        return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+    }
+    clox_env_kv_set(entry, clox_value_dup(value));
+    return CLOX_VM_INTERPRET_RESULT_OK;
+}
+
+/* How many codes each instruction takes, so that the handlers know where the next one is */
+enum {
+#define X(name, a, b, c) REG_VM_LENGTH_##name = CLOX_VM_REG_OP_LENGTH(a, b, c),
+    CLOX_VM_REG_OP_CODES(X)
+#undef X
+};
+
+/* The operands of the instruction being executed: ip stays at its opcode until it's done */
+#define R(n) (vm->registers[vm->ip[n]])
+#define K(n) (vm->chunk->constants.values[vm->ip[n]])
+#define K_LONG(n) (vm->chunk->constants.values[vm->ip[n] | (vm->ip[(n) + 1] << 8) | (vm->ip[(n) + 2] << 16)])
+/* R[a] = op(R[b], right), for the binary operators requiring numbers. Numbers don't own anything, so they don't
+ * need to be duplicated */
+#define BINARY_NUMBER_OP(operator, op, right)                                                                       \
+    do {                                                                                                            \
+        clox_vm_value left_ = R(2);                                                                                 \
+        clox_vm_value right_ = (right);                                                                             \
+        if (!clox_value_is_number(left_) || !clox_value_is_number(right_)) {                                        \
+            reg_vm_report_number_operands(vm, operator, left_, right_);                                             \
+            return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;                                                          \
+        }                                                                                                           \
+        reg_vm_set(&R(1), op(left_, right_));                                                                       \
+    } while (0)
+/* R[a] = R[b] + right, numbers or strings */
+#define ADD_OP(right)                                                                                               \
+    do {                                                                                                            \
+        clox_vm_value* left_ = &R(2);                                                                               \
+        clox_vm_value* right_ = &(right);                                                                           \
+        if (clox_value_is_number(*left_) && clox_value_is_number(*right_)) {                                        \
+            reg_vm_set(&R(1), clox_value_number_add(*left_, *right_));                                              \
+        } else if (clox_value_is_string(*left_) && clox_value_is_string(*right_)) {                                 \
+            reg_vm_set(&R(1), clox_value_string_concat(NULL, left_, right_));                                       \
+        } else {                                                                                                    \
+            reg_vm_report_add_operands(vm, *left_, *right_);                                                        \
+            return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;                                                          \
+        }                                                                                                           \
+    } while (0)
+#define NUMBER_GREATER(left, right) clox_value_bool(clox_value_number_less(right, left))
+#define NUMBER_GREATER_EQUAL(left, right) clox_value_bool(clox_value_number_less_equal(right, left))
+#define NUMBER_LESS(left, right) clox_value_bool(clox_value_number_less(left, right))
+#define NUMBER_LESS_EQUAL(left, right) clox_value_bool(clox_value_number_less_equal(left, right))
+
+/* Same dispatch as the stack VM (see vm.c), without a tail call variant: computed goto is used in its place.
+ * VM_NEXT(name) moves past the instruction of the handler and runs the next one */
+#if defined(CLOX_VM_DISPATCH_COMPUTED_GOTO) || defined(CLOX_VM_DISPATCH_TAIL_CALL)
+
+#define VM_OP(name) op_##name:
+#define VM_NEXT(name) vm->ip += REG_VM_LENGTH_##name; goto *op_labels[*vm->ip]
+
+// label addresses and `goto *` are extensions
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+static enum clox_vm_interpret_result reg_vm_run(struct clox_vm_reg_vm* vm) {
+    static void* const op_labels[] = {
+#define X(name, a, b, c) [CLOX_VM_REG_OP_CODE_##name] = &&op_##name,
+        CLOX_VM_REG_OP_CODES(X)
+#undef X
+    };
+
+    goto *op_labels[*vm->ip];
+
+#else
+
+#define VM_OP(name) case CLOX_VM_REG_OP_CODE_##name:
+#define VM_NEXT(name) vm->ip += REG_VM_LENGTH_##name; continue
+
+static enum clox_vm_interpret_result reg_vm_run(struct clox_vm_reg_vm* vm) {
+    for (;;) {
+        uint8_t instruction = *vm->ip;
+        switch (instruction) {
+
+#endif
+
+VM_OP(RETURN) {
+    return CLOX_VM_INTERPRET_RESULT_OK;
+}
+
+VM_OP(LOAD_CONSTANT) {
+    reg_vm_set(&R(1), clox_value_dup(K(2)));
+    VM_NEXT(LOAD_CONSTANT);
+}
+
+VM_OP(LOAD_CONSTANT_LONG) {
+    reg_vm_set(&R(1), clox_value_dup(K_LONG(2)));
+    VM_NEXT(LOAD_CONSTANT_LONG);
+}
+
+VM_OP(LOAD_NIL) {
+    reg_vm_set(&R(1), clox_value_nil());
+    VM_NEXT(LOAD_NIL);
+}
+
+VM_OP(LOAD_TRUE) {
+    reg_vm_set(&R(1), clox_value_bool(true));
+    VM_NEXT(LOAD_TRUE);
+}
+
+VM_OP(LOAD_FALSE) {
+    reg_vm_set(&R(1), clox_value_bool(false));
+    VM_NEXT(LOAD_FALSE);
+}
+
+VM_OP(MOVE) {
+    reg_vm_set(&R(1), clox_value_dup(R(2)));
+    VM_NEXT(MOVE);
+}
+
+VM_OP(DEFINE_GLOBAL) {
+    reg_vm_define_global(vm, R(1), &K(2));
+    VM_NEXT(DEFINE_GLOBAL);
+}
+
+VM_OP(DEFINE_GLOBAL_LONG) {
+    reg_vm_define_global(vm, R(1), &K_LONG(2));
+    VM_NEXT(DEFINE_GLOBAL_LONG);
+}
+
+VM_OP(GET_GLOBAL) {
+    if (reg_vm_get_global(vm, &R(1), &K(2)) != CLOX_VM_INTERPRET_RESULT_OK) {
+        return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+    }
+    VM_NEXT(GET_GLOBAL);
+}
+
+VM_OP(GET_GLOBAL_LONG) {
+    if (reg_vm_get_global(vm, &R(1), &K_LONG(2)) != CLOX_VM_INTERPRET_RESULT_OK) {
+        return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+    }
+    VM_NEXT(GET_GLOBAL_LONG);
+}
+
+VM_OP(SET_GLOBAL) {
+    if (reg_vm_set_global(vm, R(1), &K(2)) != CLOX_VM_INTERPRET_RESULT_OK) {
+        return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+    }
+    VM_NEXT(SET_GLOBAL);
+}
+
+VM_OP(SET_GLOBAL_LONG) {
+    if (reg_vm_set_global(vm, R(1), &K_LONG(2)) != CLOX_VM_INTERPRET_RESULT_OK) {
+        return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+    }
+    VM_NEXT(SET_GLOBAL_LONG);
+}
+
+VM_OP(EQUAL) {
+    reg_vm_set(&R(1), clox_value_bool(clox_value_is_equal(R(2), R(3))));
+    VM_NEXT(EQUAL);
+}
+
+VM_OP(NOT_EQUAL) {
+    reg_vm_set(&R(1), clox_value_bool(!clox_value_is_equal(R(2), R(3))));
+    VM_NEXT(NOT_EQUAL);
+}
+
+VM_OP(GREATER) {
+    BINARY_NUMBER_OP(">", NUMBER_GREATER, R(3));
+    VM_NEXT(GREATER);
+}
+
+VM_OP(GREATER_EQUAL) {
+    BINARY_NUMBER_OP(">=", NUMBER_GREATER_EQUAL, R(3));
+    VM_NEXT(GREATER_EQUAL);
+}
+
+VM_OP(LESS) {
+    BINARY_NUMBER_OP("<", NUMBER_LESS, R(3));
+    VM_NEXT(LESS);
+}
+
+VM_OP(LESS_EQUAL) {
+    BINARY_NUMBER_OP("<=", NUMBER_LESS_EQUAL, R(3));
+    VM_NEXT(LESS_EQUAL);
+}
+
+VM_OP(ADD) {
+    ADD_OP(R(3));
+    VM_NEXT(ADD);
+}
+
+VM_OP(SUBTRACT) {
+    BINARY_NUMBER_OP("-", clox_value_number_sub, R(3));
+    VM_NEXT(SUBTRACT);
+}
+
+VM_OP(MULTIPLY) {
+    BINARY_NUMBER_OP("*", clox_value_number_mul, R(3));
+    VM_NEXT(MULTIPLY);
+}
+
+VM_OP(DIVIDE) {
+    BINARY_NUMBER_OP("/", clox_value_number_div, R(3));
+    VM_NEXT(DIVIDE);
+}
+
+VM_OP(ADD_CONSTANT) {
+    ADD_OP(K(3));
+    VM_NEXT(ADD_CONSTANT);
+}
+
+VM_OP(SUBTRACT_CONSTANT) {
+    BINARY_NUMBER_OP("-", clox_value_number_sub, K(3));
+    VM_NEXT(SUBTRACT_CONSTANT);
+}
+
+VM_OP(MULTIPLY_CONSTANT) {
+    BINARY_NUMBER_OP("*", clox_value_number_mul, K(3));
+    VM_NEXT(MULTIPLY_CONSTANT);
+}
+
+VM_OP(DIVIDE_CONSTANT) {
+    BINARY_NUMBER_OP("/", clox_value_number_div, K(3));
+    VM_NEXT(DIVIDE_CONSTANT);
+}
+
+VM_OP(GREATER_CONSTANT) {
+    BINARY_NUMBER_OP(">", NUMBER_GREATER, K(3));
+    VM_NEXT(GREATER_CONSTANT);
+}
+
+VM_OP(GREATER_EQUAL_CONSTANT) {
+    BINARY_NUMBER_OP(">=", NUMBER_GREATER_EQUAL, K(3));
+    VM_NEXT(GREATER_EQUAL_CONSTANT);
+}
+
+VM_OP(LESS_CONSTANT) {
+    BINARY_NUMBER_OP("<", NUMBER_LESS, K(3));
+    VM_NEXT(LESS_CONSTANT);
+}
+
+VM_OP(LESS_EQUAL_CONSTANT) {
+    BINARY_NUMBER_OP("<=", NUMBER_LESS_EQUAL, K(3));
+    VM_NEXT(LESS_EQUAL_CONSTANT);
+}
+
+VM_OP(NOT) {
+    reg_vm_set(&R(1), clox_value_bool(!clox_value_is_truthy(R(2))));
+    VM_NEXT(NOT);
+}
+
+VM_OP(NEGATE) {
+    if (!clox_value_is_number(R(2))) {
+        clox_output_flush(&vm->output);
+        fprintf(stderr, "error: line %zu: minus unary operator (a.k.a. '-') can only be applied to numbers. got %s\n",
+            reg_vm_current_line(vm), clox_value_kind_to_cstr(clox_value_get_kind(R(2))));
+        return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+    }
+    reg_vm_set(&R(1), clox_value_number_negate(R(2)));
+    VM_NEXT(NEGATE);
+}
+
+VM_OP(PRINT) {
+    clox_value_println(&vm->output, R(1));
+    VM_NEXT(PRINT);
+}
+
+#if defined(CLOX_VM_DISPATCH_COMPUTED_GOTO) || defined(CLOX_VM_DISPATCH_TAIL_CALL)
+
+}
+
+#pragma GCC diagnostic pop
+
+#else
+
+        default:
+            clox_output_flush(&vm->output);
+            fprintf(stderr, "error: line %zu: unknown opcode %hhu\n", reg_vm_current_line(vm), instruction);
+            return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+        }
+    }
+}
+
+#endif
+
+#undef VM_NEXT
+#undef VM_OP
+#undef NUMBER_LESS_EQUAL
+#undef NUMBER_LESS
+#undef NUMBER_GREATER_EQUAL
+#undef NUMBER_GREATER
+#undef ADD_OP
+#undef BINARY_NUMBER_OP
+#undef K_LONG
+#undef K
+#undef R
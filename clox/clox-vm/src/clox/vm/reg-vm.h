@@ -0,0 +1,60 @@
+#ifndef CLOX_VM_REG_VM_H
+#define CLOX_VM_REG_VM_H
+
+#include "common.h"
+#include "value.h"
+#include "reg-chunk.h"
+#include "vm.h"
+
+#include <clox/output.h>
+#include <clox/env.h>
+
+struct clox_vm_chunk;
+
+/**
+ * @brief A VM running register code (see reg-chunk.h and reg-compiler.h), the alternative to the stack VM. It
+ * behaves the same way, runtime errors included.
+ */
+struct clox_vm_reg_vm {
+    /**
+     * @brief The chunk being executed
+     */
+    struct clox_vm_chunk* chunk;
+    /**
+     * @brief Instruction pointer: the instruction being executed in the chunk codes
+     */
+    uint8_t* ip;
+    /**
+     * @brief The register file of the running frame: the locals, then the temporaries. There are no functions yet,
+     * so the chunk is the only frame. The values in it are owned by the VM, and released when overwritten
+     */
+    clox_vm_value registers[CLOX_VM_REG_REGISTERS_MAX];
+    /**
+     * @brief The global variables. They outlive the chunks, so a REPL can run one chunk per line
+     */
+    struct clox_env globals;
+    /**
+     * @brief Where the print statements write to (stdout)
+     */
+    struct clox_output output;
+};
+
+void clox_vm_reg_vm_init(struct clox_vm_reg_vm* vm);
+
+/**
+ * @brief Frees the values left in the registers and the globals, and flushes the pending output
+ */
+void clox_vm_reg_vm_free(struct clox_vm_reg_vm* vm);
+
+/**
+ * @brief Executes the chunk until its return instruction.
+ *
+ * Runtime errors are reported to stderr, the same way the stack VM does.
+ *
+ * @param vm
+ * @param chunk register code
+ * @return enum clox_vm_interpret_result
+ */
+enum clox_vm_interpret_result clox_vm_reg_vm_interpret(struct clox_vm_reg_vm* vm, struct clox_vm_chunk* chunk);
+
+#endif
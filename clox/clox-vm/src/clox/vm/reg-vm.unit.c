@@ -0,0 +1,236 @@
+#include "unit-helpers.h"
+
+#include <stdio.h>
+
+// POSIX
+#include <unistd.h>
+
+#define STB_DS_IMPLEMENTATION
+#include <clox/stb_ds.h>
+
+#include "compiler.h"
+#include "reg-compiler.h"
+#include "reg-vm.h"
+#include "vm.h"
+
+static void test_codes(void) {
+    const char src[] = "{ var a = 1; var b = a + 2; a = b * a; print a; }";
+
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+    assert(unit_compile(src, &chunk, clox_vm_reg_compile) == 0);
+
+    // the locals are the operands, and the product is computed straight into a
+    const uint8_t expected_codes[] = {
+        CLOX_VM_REG_OP_CODE_LOAD_CONSTANT, 0, 0,
+        CLOX_VM_REG_OP_CODE_ADD_CONSTANT, 1, 0, 1,
+        CLOX_VM_REG_OP_CODE_MULTIPLY, 0, 1, 0,
+        CLOX_VM_REG_OP_CODE_PRINT, 0,
+        CLOX_VM_REG_OP_CODE_RETURN,
+    };
+    assert(chunk.codes_count == sizeof(expected_codes));
+    assert(memcmp(chunk.codes, expected_codes, sizeof(expected_codes)) == 0);
+    assert(chunk.constants.count == 2);
+
+    clox_vm_chunk_free(&chunk);
+}
+
+static void test_parity(void) {
+    // reads of locals followed by assignments to them, chained assignments, globals and concatenations
+    const char src[] =
+        "var x = 1;\n"
+        "var a = x + (x = 2);\n"
+        "var b = (x = 3) + (x = 4);\n"
+        "var c; var d;\n"
+        "c = d = x * 2;\n"
+        "var s = \"a\";\n"
+        "s = s + \"b\" + s + \"c\";\n"
+        "var e; var f; var g; var h;\n"
+        "{\n"
+        "    var l = 1;\n"
+        "    var m = l + (l = 10) + l;\n"
+        "    l = l * m - -l;\n"
+        "    var n = !(l > m) == (m <= 21);\n"
+        "    e = l; f = m; g = n;\n"
+        "    { var l2 = l; l2 = l2 + 1; h = l2 / 4; }\n"
+        "}\n";
+    const char* names[] = {"x", "a", "b", "c", "d", "s", "e", "f", "g", "h"};
+
+    struct clox_vm_chunk stack_chunk;
+    clox_vm_chunk_init(&stack_chunk);
+    assert(unit_compile(src, &stack_chunk, clox_vm_compile) == 0);
+    struct clox_vm stack_vm;
+    clox_vm_init(&stack_vm);
+    assert(clox_vm_interpret(&stack_vm, &stack_chunk) == CLOX_VM_INTERPRET_RESULT_OK);
+
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+    assert(unit_compile(src, &chunk, clox_vm_reg_compile) == 0);
+    struct clox_vm_reg_vm vm;
+    clox_vm_reg_vm_init(&vm);
+    assert(clox_vm_reg_vm_interpret(&vm, &chunk) == CLOX_VM_INTERPRET_RESULT_OK);
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        assert(clox_value_is_equal(unit_global(&vm.globals, names[i]), unit_global(&stack_vm.globals, names[i])));
+    }
+    assert(clox_value_as_number(unit_global(&vm.globals, "a")) == 3);
+    assert(clox_value_as_number(unit_global(&vm.globals, "b")) == 7);
+    assert(clox_value_as_number(unit_global(&vm.globals, "c")) == 8);
+    struct clox_value s = unit_global(&vm.globals, "s");
+    assert(strview_equals(clox_value_as_strview(&s), strview_from_cstr("abac", 4)));
+    assert(clox_value_as_number(unit_global(&vm.globals, "e")) == 220);
+    assert(clox_value_as_number(unit_global(&vm.globals, "f")) == 21);
+    assert(!clox_value_as_bool(unit_global(&vm.globals, "g")));
+    assert(clox_value_as_number(unit_global(&vm.globals, "h")) == 221.0 / 4);
+
+    // fewer instructions than the stack VM needs
+    size_t stack_instructions = 0;
+    for (size_t offset = 0; offset < stack_chunk.codes_count;
+        offset += clox_vm_op_code_length(stack_chunk.codes[offset])) {
+        stack_instructions++;
+    }
+    size_t instructions = 0;
+    for (size_t offset = 0; offset < chunk.codes_count; offset += clox_vm_reg_op_code_length(chunk.codes[offset])) {
+        instructions++;
+    }
+    assert(instructions < stack_instructions);
+
+    clox_vm_reg_vm_free(&vm);
+    clox_vm_chunk_free(&chunk);
+    clox_vm_free(&stack_vm);
+    clox_vm_chunk_free(&stack_chunk);
+}
+
+static void test_runtime_errors(void) {
+    const char* scripts[] = {
+        "var n; print n < 1;",
+        "var n = \"x\"; n = n - 1;",
+        "var n = true; n = n + \"x\";",
+        "{ var a = 1; var b = nil; a = b * 2; }",
+        "{ var a = \"x\"; print -a; }",
+        "undefined = 1;",
+        "print undefined;",
+    };
+    for (size_t i = 0; i < sizeof(scripts) / sizeof(scripts[0]); i++) {
+        struct clox_vm_chunk chunk;
+        clox_vm_chunk_init(&chunk);
+        assert(unit_compile(scripts[i], &chunk, clox_vm_reg_compile) == 0);
+
+        struct clox_vm_reg_vm vm;
+        clox_vm_reg_vm_init(&vm);
+        assert(clox_vm_reg_vm_interpret(&vm, &chunk) == CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR);
+        clox_vm_reg_vm_free(&vm);
+        clox_vm_chunk_free(&chunk);
+    }
+}
+
+/**
+ * @brief Runs the chunk with both VMs printing into the same pipe as stderr, as with 2>&1, and checks that what was
+ * printed before the runtime error shows up before its message
+ */
+static void test_output_order(void) {
+    const char src[] = "print 1; print -\"x\";";
+    const char expected[] = "1\nerror: line 1: minus unary operator";
+
+    for (int reg = 0; reg <= 1; reg++) {
+        struct clox_vm_chunk chunk;
+        clox_vm_chunk_init(&chunk);
+        assert(unit_compile(src, &chunk, reg ? clox_vm_reg_compile : clox_vm_compile) == 0);
+
+        // small enough to fit in the pipe
+        int fds[2];
+        assert(pipe(fds) == 0);
+        const int saved_stderr = dup(STDERR_FILENO);
+        assert(saved_stderr >= 0 && dup2(fds[1], STDERR_FILENO) >= 0);
+
+        if (reg) {
+            struct clox_vm_reg_vm vm;
+            clox_vm_reg_vm_init(&vm);
+            clox_output_free(&vm.output);
+            clox_output_init(&vm.output, fds[1], CLOX_OUTPUT_DEFAULT_CAP);
+            assert(clox_vm_reg_vm_interpret(&vm, &chunk) == CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR);
+            clox_vm_reg_vm_free(&vm);
+        } else {
+            struct clox_vm vm;
+            clox_vm_init(&vm);
+            clox_output_free(&vm.output);
+            clox_output_init(&vm.output, fds[1], CLOX_OUTPUT_DEFAULT_CAP);
+            assert(clox_vm_interpret(&vm, &chunk) == CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR);
+            clox_vm_free(&vm);
+        }
+
+        assert(dup2(saved_stderr, STDERR_FILENO) >= 0);
+        close(saved_stderr);
+        close(fds[1]);
+
+        char contents[1024];
+        size_t len = 0;
+        ssize_t n;
+        while ((n = read(fds[0], contents + len, sizeof(contents) - 1 - len)) > 0) {
+            len += (size_t) n;
+        }
+        contents[len] = '\0';
+        close(fds[0]);
+        assert(strncmp(contents, expected, strlen(expected)) == 0);
+
+        clox_vm_chunk_free(&chunk);
+    }
+}
+
+static void test_limits(void) {
+    // Each level keeps its left operand in a register until its right one is done
+    char* deep = NULL;
+    const char prefix[] = "var x = 1; print ";
+    memcpy(arraddnptr(deep, sizeof(prefix) - 1), prefix, sizeof(prefix) - 1);
+    for (int i = 0; i < CLOX_VM_REG_REGISTERS_MAX + 10; i++) {
+        memcpy(arraddnptr(deep, 6), "x + (x", 6);
+    }
+    for (int i = 0; i < CLOX_VM_REG_REGISTERS_MAX + 10; i++) {
+        arrput(deep, ')');
+    }
+    arrput(deep, ';');
+    arrput(deep, '\0');
+
+    struct clox_vm_chunk chunk;
+    clox_vm_chunk_init(&chunk);
+    assert(unit_compile(deep, &chunk, clox_vm_reg_compile) != 0);
+    clox_vm_chunk_free(&chunk);
+    arrfree(deep);
+
+    // Past 256 constants, the globals are named by the long instructions. g0 and g1 came early enough for the short ones
+    char* many = NULL;
+    char buf[64];
+    for (int i = 0; i < 300; i++) {
+        int len = snprintf(buf, sizeof(buf), "var g%d = %d;\n", i, i);
+        memcpy(arraddnptr(many, len), buf, len);
+    }
+    const char suffix[] = "var sum = g0 + g299; g1 = sum;";
+    memcpy(arraddnptr(many, sizeof(suffix)), suffix, sizeof(suffix));
+
+    clox_vm_chunk_init(&chunk);
+    assert(unit_compile(many, &chunk, clox_vm_reg_compile) == 0);
+    assert(chunk.constants.count > UINT8_MAX + 1);
+    assert(unit_count_reg_op(&chunk, CLOX_VM_REG_OP_CODE_DEFINE_GLOBAL_LONG) > 0);
+    assert(unit_count_reg_op(&chunk, CLOX_VM_REG_OP_CODE_LOAD_CONSTANT_LONG) > 0);
+    assert(unit_count_reg_op(&chunk, CLOX_VM_REG_OP_CODE_GET_GLOBAL_LONG) == 2);
+    assert(unit_count_reg_op(&chunk, CLOX_VM_REG_OP_CODE_SET_GLOBAL) == 1);
+
+    struct clox_vm_reg_vm vm;
+    clox_vm_reg_vm_init(&vm);
+    assert(clox_vm_reg_vm_interpret(&vm, &chunk) == CLOX_VM_INTERPRET_RESULT_OK);
+    assert(clox_value_as_number(unit_global(&vm.globals, "sum")) == 299);
+    assert(clox_value_as_number(unit_global(&vm.globals, "g1")) == 299);
+    clox_vm_reg_vm_free(&vm);
+    clox_vm_chunk_free(&chunk);
+    arrfree(many);
+}
+
+int main() {
+    test_codes();
+    test_parity();
+    test_runtime_errors();
+    test_output_order();
+    test_limits();
+
+    puts("reg-vm.unit: ok");
+}
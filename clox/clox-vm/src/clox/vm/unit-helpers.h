@@ -0,0 +1,72 @@
+#ifndef CLOX_VM_UNIT_HELPERS_H
+#define CLOX_VM_UNIT_HELPERS_H
+
+/* Shared by the VM unit tests, which include it first. Their checks call the code under test, so they must not be
+ * compiled out when NDEBUG is defined (e.g. release builds) */
+#undef NDEBUG
+#include <assert.h>
+#include <string.h>
+
+#include <clox/scanner.h>
+#include <clox/parser.h>
+#include <clox/env.h>
+#include <clox/ast/program.h>
+
+#include "chunk.h"
+#include "reg-chunk.h"
+
+/**
+ * @brief Parses a script and compiles its AST into the chunk with the given compiler
+ *
+ * @param src
+ * @param chunk
+ * @param compile clox_vm_compile or clox_vm_reg_compile
+ * @return int what the compiler returned
+ */
+static inline int unit_compile(const char* src, struct clox_vm_chunk* chunk,
+    int (*compile)(struct clox_ast_program* prog, struct clox_vm_chunk* chunk)) {
+    struct scanner scanner = {0};
+    scanner_scan_all_from_cstr(&scanner, src, strlen(src));
+    struct parser parser;
+    parser_init(&parser, scanner.tokens);
+    struct clox_ast_program* prog = parser_parse(&parser);
+    assert(prog != NULL);
+    int rc = compile(prog, chunk);
+    // the chunk doesn't depend on the AST nor on the source
+    clox_ast_program_free(prog);
+    scanner_free(&scanner);
+    return rc;
+}
+
+/**
+ * @return struct clox_value the value of a global which must be defined. It's borrowed from the globals
+ */
+static inline struct clox_value unit_global(struct clox_env* globals, const char* name) {
+    struct clox_value val;
+    assert(clox_env_get(globals, strview_from_cstr(name, strlen(name)), &val) == 0);
+    return val;
+}
+
+/**
+ * @return size_t how many instructions of the stack VM chunk have the given opcode
+ */
+static inline size_t unit_count_op(const struct clox_vm_chunk* chunk, enum clox_vm_op_code op) {
+    size_t count = 0;
+    for (size_t offset = 0; offset < chunk->codes_count; offset += clox_vm_op_code_length(chunk->codes[offset])) {
+        count += (chunk->codes[offset] == op);
+    }
+    return count;
+}
+
+/**
+ * @return size_t how many instructions of the register VM chunk have the given opcode
+ */
+static inline size_t unit_count_reg_op(const struct clox_vm_chunk* chunk, enum clox_vm_reg_op_code op) {
+    size_t count = 0;
+    for (size_t offset = 0; offset < chunk->codes_count; offset += clox_vm_reg_op_code_length(chunk->codes[offset])) {
+        count += (chunk->codes[offset] == op);
+    }
+    return count;
+}
+
+#endif
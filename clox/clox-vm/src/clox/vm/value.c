@@ -17,10 +17,13 @@ void clox_vm_value_array_write(struct clox_vm_value_array* va, clox_vm_value val
 }
 
 void clox_vm_value_array_free(struct clox_vm_value_array* va) {
+    for (size_t i = 0; i < va->count; i++) {
+        clox_value_free(&va->values[i]);
+    }
     CLOX_VM_MEM_FREE_ARRAY(clox_vm_value, va->values, va->capacity);
     clox_vm_value_array_init(va);
 }
 
 void clox_vm_value_print(clox_vm_value value) {
-    printf("%g", value);
+    clox_value_fdump(stdout, value);
 }
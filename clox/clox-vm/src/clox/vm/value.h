@@ -3,7 +3,12 @@
 
 #include "common.h"
 
-typedef double clox_vm_value;
+#include <clox/value.h>
+
+/**
+ * @brief The VM shares the values of the AST interpreter, so both engines behave the same way
+ */
+typedef struct clox_value clox_vm_value;
 
 struct clox_vm_value_array {
     clox_vm_value* values;
@@ -13,6 +18,9 @@ struct clox_vm_value_array {
 
 void clox_vm_value_array_init(struct clox_vm_value_array* va);
 void clox_vm_value_array_write(struct clox_vm_value_array* va, clox_vm_value value);
+/**
+ * @brief Frees the array along with the values it owns
+ */
 void clox_vm_value_array_free(struct clox_vm_value_array* va);
 void clox_vm_value_print(clox_vm_value value);
 
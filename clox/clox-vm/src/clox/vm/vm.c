@@ -0,0 +1,540 @@
+#include "vm.h"
+
+#include "chunk.h"
+#include "mem.h"
+#if defined(CLOX_VM_PROFILE)
+#include "profile.h"
+#endif
+
+#include <unistd.h>
+
+static void vm_stack_reset(struct clox_vm* vm);
+
+/**
+ * @brief Makes room for more values on the stack. Pointers into the old stack are invalidated
+ */
+static void vm_stack_grow(struct clox_vm* vm);
+static enum clox_vm_interpret_result vm_run(struct clox_vm* vm);
+
+/**
+ * @return the source line of the instruction being executed
+ */
+static size_t vm_current_line(const struct clox_vm* vm);
+
+static void vm_report_undefined_variable(struct clox_vm* vm, clox_vm_value* name);
+
+/**
+ * @brief Reports a binary operator requiring numbers applied to something else
+ */
+static void vm_report_number_operands(struct clox_vm* vm, const char* operator, clox_vm_value left,
+    clox_vm_value right);
+
+/**
+ * @brief Reports `+` applied to something else than two numbers or two strings
+ */
+static void vm_report_add_operands(struct clox_vm* vm, clox_vm_value left, clox_vm_value right);
+
+void clox_vm_init(struct clox_vm* vm) {
+    vm->chunk = NULL;
+    vm->ip = NULL;
+    vm->stack_capacity = CLOX_VM_STACK_INITIAL_CAPACITY;
+    vm->stack = CLOX_VM_MEM_GROW_ARRAY(clox_vm_value, NULL, 0, vm->stack_capacity);
+    vm->stack_top = vm->stack;
+    clox_env_init(&vm->globals);
+    clox_output_init(&vm->output, STDOUT_FILENO, CLOX_OUTPUT_DEFAULT_CAP);
+#if defined(CLOX_VM_PROFILE)
+    vm->profile = NULL;
+#endif
+}
+
+void clox_vm_free(struct clox_vm* vm) {
+    vm_stack_reset(vm);
+    CLOX_VM_MEM_FREE_ARRAY(clox_vm_value, vm->stack, vm->stack_capacity);
+    vm->stack = NULL;
+    vm->stack_top = NULL;
+    vm->stack_capacity = 0;
+    clox_env_free(&vm->globals);
+    clox_output_free(&vm->output);
+    vm->chunk = NULL;
+    vm->ip = NULL;
+}
+
+enum clox_vm_interpret_result clox_vm_interpret(struct clox_vm* vm, struct clox_vm_chunk* chunk) {
+    vm->chunk = chunk;
+    vm->ip = chunk->codes;
+
+    enum clox_vm_interpret_result result = vm_run(vm);
+#if defined(CLOX_VM_PROFILE)
+    if (vm->profile != NULL) {
+        clox_vm_profile_run_end(vm->profile);
+    }
+#endif
+    if (result != CLOX_VM_INTERPRET_RESULT_OK) {
+        vm_stack_reset(vm);
+    }
+    return result;
+}
+
+static void vm_stack_reset(struct clox_vm* vm) {
+    while (vm->stack_top > vm->stack) {
+        clox_value_free(--vm->stack_top);
+    }
+}
+
+static void vm_stack_grow(struct clox_vm* vm) {
+    const size_t count = (size_t) (vm->stack_top - vm->stack);
+    const size_t old_capacity = vm->stack_capacity;
+    vm->stack_capacity = CLOX_VM_MEM_GROW_CAPACITY(old_capacity);
+    vm->stack = CLOX_VM_MEM_GROW_ARRAY(clox_vm_value, vm->stack, old_capacity, vm->stack_capacity);
+    vm->stack_top = vm->stack + count;
+}
+
+static size_t vm_current_line(const struct clox_vm* vm) {
+    // ip already moved past the opcode
+    return clox_vm_chunk_get_line(vm->chunk, (size_t) (vm->ip - vm->chunk->codes - 1));
+}
+
+static void vm_report_undefined_variable(struct clox_vm* vm, clox_vm_value* name) {
+    clox_output_flush(&vm->output);
+    struct strview sv = clox_value_as_strview(name);
+    fprintf(stderr, "error: line %zu: undefined variable '%.*s'\n", vm_current_line(vm), (int) sv.len, sv.ptr);
+}
+
+static void vm_report_number_operands(struct clox_vm* vm, const char* operator, clox_vm_value left,
+    clox_vm_value right) {
+    clox_output_flush(&vm->output);
+    fprintf(stderr, "error: line %zu: binary operator '%s' requires both operands to be numbers. got left as %s and right as %s\n",
+        vm_current_line(vm), operator, clox_value_kind_to_cstr(clox_value_get_kind(left)),
+        clox_value_kind_to_cstr(clox_value_get_kind(right)));
+}
+
+static void vm_report_add_operands(struct clox_vm* vm, clox_vm_value left, clox_vm_value right) {
+    clox_output_flush(&vm->output);
+    fprintf(stderr, "error: line %zu: binary operator '+' is only valid if both operands are numbers or strings. left operand is %s and right operand is %s\n",
+        vm_current_line(vm), clox_value_kind_to_cstr(clox_value_get_kind(left)),
+        clox_value_kind_to_cstr(clox_value_get_kind(right)));
+}
+
+#define READ_BYTE() (*vm->ip++)
+/* Reads the opcode of the next instruction, where the profiler hooks in. Without CLOX_VM_PROFILE it's a plain
+ * read, so the dispatch is the same as if there were no profiler */
+#if defined(CLOX_VM_PROFILE)
+#define READ_OPCODE() \
+    ((vm->profile != NULL) ? clox_vm_profile_instruction(vm->profile, *vm->ip) : (void) 0, READ_BYTE())
+#else
+#define READ_OPCODE() READ_BYTE()
+#endif
+#define READ_CONSTANT() (vm->chunk->constants.values[READ_BYTE()])
+#define READ_INDEX_LONG() (vm->ip += 3, (size_t) (vm->ip[-3] | (vm->ip[-2] << 8) | (vm->ip[-1] << 16)))
+#define READ_CONSTANT_LONG() (vm->chunk->constants.values[READ_INDEX_LONG()])
+#define PEEK(distance) (vm->stack_top[-1 - (distance)])
+/* The value is evaluated after growing the stack, so it may read the stack */
+#define PUSH(value)                                                                         \
+    do {                                                                                    \
+        if (vm->stack_top == vm->stack + vm->stack_capacity) {                              \
+            vm_stack_grow(vm);                                                              \
+        }                                                                                   \
+        *vm->stack_top++ = (value);                                                         \
+    } while (0)
+/* Pops the two operands of a binary operator requiring numbers, and pushes op(left, right).
+ * Numbers don't own anything, so the operands don't need to be freed */
+#define BINARY_NUMBER_OP(operator, op)                                                                              \
+    do {                                                                                                            \
+        if (!clox_value_is_number(PEEK(0)) || !clox_value_is_number(PEEK(1))) {                                     \
+            vm_report_number_operands(vm, operator, PEEK(1), PEEK(0));                                              \
+            return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;                                                          \
+        }                                                                                                           \
+        clox_vm_value right = *--vm->stack_top;                                                                     \
+        vm->stack_top[-1] = op(vm->stack_top[-1], right);                                                           \
+    } while (0)
+/* Same as BINARY_NUMBER_OP, with the constant operand of the instruction as the right operand */
+#define BINARY_NUMBER_CONSTANT_OP(operator, op)                                                                     \
+    do {                                                                                                            \
+        clox_vm_value right = READ_CONSTANT();                                                                      \
+        if (!clox_value_is_number(PEEK(0)) || !clox_value_is_number(right)) {                                       \
+            vm_report_number_operands(vm, operator, PEEK(0), right);                                                \
+            return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;                                                          \
+        }                                                                                                           \
+        vm->stack_top[-1] = op(vm->stack_top[-1], right);                                                           \
+    } while (0)
+#define NUMBER_GREATER(left, right) clox_value_bool(clox_value_number_less(right, left))
+#define NUMBER_GREATER_EQUAL(left, right) clox_value_bool(clox_value_number_less_equal(right, left))
+#define NUMBER_LESS(left, right) clox_value_bool(clox_value_number_less(left, right))
+#define NUMBER_LESS_EQUAL(left, right) clox_value_bool(clox_value_number_less_equal(left, right))
+
+static void vm_define_global(struct clox_vm* vm, clox_vm_value* name) {
+    // the env takes the value over
+    clox_env_define(&vm->globals, clox_value_as_strview(name), *--vm->stack_top);
+}
+
+static enum clox_vm_interpret_result vm_get_global(struct clox_vm* vm, clox_vm_value* name) {
+    struct clox_env_kv* entry = clox_env_lookup(&vm->globals, clox_value_as_strview(name));
+    if (entry == NULL) {
+        vm_report_undefined_variable(vm, name);
+        return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+    }
+    PUSH(clox_value_dup(entry->value));
+    return CLOX_VM_INTERPRET_RESULT_OK;
+}
+
+static enum clox_vm_interpret_result vm_set_global(struct clox_vm* vm, clox_vm_value* name) {
+    struct clox_env_kv* entry = clox_env_lookup(&vm->globals, clox_value_as_strview(name));
+    if (entry == NULL) {
+        vm_report_undefined_variable(vm, name);
+        return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+    }
+    // the assignment evaluates to the assigned value, so it stays on the stack
+    clox_env_kv_set(entry, clox_value_dup(PEEK(0)));
+    return CLOX_VM_INTERPRET_RESULT_OK;
+}
+
+/* How the execution goes from an instruction to the next one (see CLOX_VM_DISPATCH in CMakeLists.txt).
+ * VM_OP(name) starts the handler of an opcode and VM_NEXT() ends it, running the next instruction:
+ * - switch: handlers are the cases of a switch in a loop, so every instruction goes through the same indirect
+ *   branch at the top of the loop, which is hard to predict
+ * - computed goto: handlers are labels, each one jumping straight to the next handler through a table of label
+ *   addresses (a GCC/Clang extension). Every handler has its own indirect branch, predicted on its own
+ * - tail call: handlers are functions, each one tail-calling the next handler. musttail guarantees the call is
+ *   compiled to a jump, even without optimizations, so the C stack doesn't grow. The VM state lives in the
+ *   struct rather than in locals shared by the handlers
+ * The handlers bodies are the same in every mode: runtime errors just return from them. */
+#if defined(CLOX_VM_DISPATCH_TAIL_CALL)
+
+#if !defined(__has_attribute)
+#error "tail call dispatch requires __attribute__((musttail))"
+#elif !__has_attribute(musttail)
+#error "tail call dispatch requires __attribute__((musttail))"
+#endif
+
+typedef enum clox_vm_interpret_result (*vm_op_handler)(struct clox_vm* vm);
+
+#define X(name, operand) static enum clox_vm_interpret_result vm_op_##name(struct clox_vm* vm);
+CLOX_VM_OP_CODES(X)
+#undef X
+
+static const vm_op_handler vm_op_handlers[] = {
+#define X(name, operand) [CLOX_VM_OP_CODE_##name] = vm_op_##name,
+    CLOX_VM_OP_CODES(X)
+#undef X
+};
+
+#define VM_OP(name) static enum clox_vm_interpret_result vm_op_##name(struct clox_vm* vm)
+#define VM_NEXT() __attribute__((musttail)) return vm_op_handlers[READ_OPCODE()](vm)
+
+static enum clox_vm_interpret_result vm_run(struct clox_vm* vm) {
+    return vm_op_handlers[READ_OPCODE()](vm);
+}
+
+#elif defined(CLOX_VM_DISPATCH_COMPUTED_GOTO)
+
+#define VM_OP(name) op_##name:
+#define VM_NEXT() goto *op_labels[READ_OPCODE()]
+
+// label addresses and `goto *` are extensions
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+static enum clox_vm_interpret_result vm_run(struct clox_vm* vm) {
+    static void* const op_labels[] = {
+#define X(name, operand) [CLOX_VM_OP_CODE_##name] = &&op_##name,
+        CLOX_VM_OP_CODES(X)
+#undef X
+    };
+
+    VM_NEXT();
+
+#else
+
+#define VM_OP(name) case CLOX_VM_OP_CODE_##name:
+#define VM_NEXT() continue
+
+static enum clox_vm_interpret_result vm_run(struct clox_vm* vm) {
+    for (;;) {
+        uint8_t instruction = READ_OPCODE();
+        switch (instruction) {
+
+#endif
+
+VM_OP(RETURN) {
+    (void) vm;
+    return CLOX_VM_INTERPRET_RESULT_OK;
+}
+
+VM_OP(CONSTANT) {
+    clox_vm_value constant = READ_CONSTANT();
+    PUSH(clox_value_dup(constant));
+    VM_NEXT();
+}
+
+VM_OP(CONSTANT_LONG) {
+    clox_vm_value constant = READ_CONSTANT_LONG();
+    PUSH(clox_value_dup(constant));
+    VM_NEXT();
+}
+
+VM_OP(NIL) {
+    PUSH(clox_value_nil());
+    VM_NEXT();
+}
+
+VM_OP(TRUE) {
+    PUSH(clox_value_bool(true));
+    VM_NEXT();
+}
+
+VM_OP(FALSE) {
+    PUSH(clox_value_bool(false));
+    VM_NEXT();
+}
+
+VM_OP(POP) {
+    clox_value_free(--vm->stack_top);
+    VM_NEXT();
+}
+
+VM_OP(GET_LOCAL) {
+    uint8_t slot = READ_BYTE();
+    PUSH(clox_value_dup(vm->stack[slot]));
+    VM_NEXT();
+}
+
+VM_OP(SET_LOCAL) {
+    uint8_t slot = READ_BYTE();
+    clox_value_free(&vm->stack[slot]);
+    vm->stack[slot] = clox_value_dup(PEEK(0));
+    VM_NEXT();
+}
+
+VM_OP(DEFINE_GLOBAL) {
+    vm_define_global(vm, &READ_CONSTANT());
+    VM_NEXT();
+}
+
+VM_OP(DEFINE_GLOBAL_LONG) {
+    vm_define_global(vm, &READ_CONSTANT_LONG());
+    VM_NEXT();
+}
+
+VM_OP(GET_GLOBAL) {
+    if (vm_get_global(vm, &READ_CONSTANT()) != CLOX_VM_INTERPRET_RESULT_OK) {
+        return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+    }
+    VM_NEXT();
+}
+
+VM_OP(GET_GLOBAL_LONG) {
+    if (vm_get_global(vm, &READ_CONSTANT_LONG()) != CLOX_VM_INTERPRET_RESULT_OK) {
+        return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+    }
+    VM_NEXT();
+}
+
+VM_OP(SET_GLOBAL) {
+    if (vm_set_global(vm, &READ_CONSTANT()) != CLOX_VM_INTERPRET_RESULT_OK) {
+        return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+    }
+    VM_NEXT();
+}
+
+VM_OP(SET_GLOBAL_LONG) {
+    if (vm_set_global(vm, &READ_CONSTANT_LONG()) != CLOX_VM_INTERPRET_RESULT_OK) {
+        return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+    }
+    VM_NEXT();
+}
+
+// the operands are freed where they are on the stack: handlers taking the address of their locals can't always
+// be tail called
+VM_OP(EQUAL) {
+    bool equal = clox_value_is_equal(PEEK(1), PEEK(0));
+    clox_value_free(--vm->stack_top);
+    clox_value_free(&vm->stack_top[-1]);
+    vm->stack_top[-1] = clox_value_bool(equal);
+    VM_NEXT();
+}
+
+VM_OP(GREATER) {
+    BINARY_NUMBER_OP(">", NUMBER_GREATER);
+    VM_NEXT();
+}
+
+VM_OP(GREATER_EQUAL) {
+    BINARY_NUMBER_OP(">=", NUMBER_GREATER_EQUAL);
+    VM_NEXT();
+}
+
+VM_OP(LESS) {
+    BINARY_NUMBER_OP("<", NUMBER_LESS);
+    VM_NEXT();
+}
+
+VM_OP(LESS_EQUAL) {
+    BINARY_NUMBER_OP("<=", NUMBER_LESS_EQUAL);
+    VM_NEXT();
+}
+
+VM_OP(ADD) {
+    if (clox_value_is_string(PEEK(0)) && clox_value_is_string(PEEK(1))) {
+        clox_vm_value concat = clox_value_string_concat(NULL, &PEEK(1), &PEEK(0));
+        clox_value_free(--vm->stack_top);
+        clox_value_free(&vm->stack_top[-1]);
+        vm->stack_top[-1] = concat;
+    } else if (clox_value_is_number(PEEK(0)) && clox_value_is_number(PEEK(1))) {
+        clox_vm_value right = *--vm->stack_top;
+        vm->stack_top[-1] = clox_value_number_add(vm->stack_top[-1], right);
+    } else {
+        vm_report_add_operands(vm, PEEK(1), PEEK(0));
+        return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+    }
+    VM_NEXT();
+}
+
+VM_OP(SUBTRACT) {
+    BINARY_NUMBER_OP("-", clox_value_number_sub);
+    VM_NEXT();
+}
+
+VM_OP(MULTIPLY) {
+    BINARY_NUMBER_OP("*", clox_value_number_mul);
+    VM_NEXT();
+}
+
+VM_OP(DIVIDE) {
+    BINARY_NUMBER_OP("/", clox_value_number_div);
+    VM_NEXT();
+}
+
+VM_OP(NOT) {
+    bool falsey = !clox_value_is_truthy(PEEK(0));
+    clox_value_free(&vm->stack_top[-1]);
+    vm->stack_top[-1] = clox_value_bool(falsey);
+    VM_NEXT();
+}
+
+VM_OP(NEGATE) {
+    if (!clox_value_is_number(PEEK(0))) {
+        clox_output_flush(&vm->output);
+        fprintf(stderr, "error: line %zu: minus unary operator (a.k.a. '-') can only be applied to numbers. got %s\n",
+            vm_current_line(vm), clox_value_kind_to_cstr(clox_value_get_kind(PEEK(0))));
+        return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+    }
+    vm->stack_top[-1] = clox_value_number_negate(vm->stack_top[-1]);
+    VM_NEXT();
+}
+
+VM_OP(PRINT) {
+    clox_value_println(&vm->output, PEEK(0));
+    clox_value_free(--vm->stack_top);
+    VM_NEXT();
+}
+
+VM_OP(ADD_CONSTANT) {
+    clox_vm_value* right = &READ_CONSTANT();
+    if (clox_value_is_number(PEEK(0)) && clox_value_is_number(*right)) {
+        vm->stack_top[-1] = clox_value_number_add(vm->stack_top[-1], *right);
+    } else if (clox_value_is_string(PEEK(0)) && clox_value_is_string(*right)) {
+        // the constant stays in the chunk
+        clox_vm_value concat = clox_value_string_concat(NULL, &PEEK(0), right);
+        clox_value_free(&vm->stack_top[-1]);
+        vm->stack_top[-1] = concat;
+    } else {
+        vm_report_add_operands(vm, PEEK(0), *right);
+        return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+    }
+    VM_NEXT();
+}
+
+VM_OP(SUBTRACT_CONSTANT) {
+    BINARY_NUMBER_CONSTANT_OP("-", clox_value_number_sub);
+    VM_NEXT();
+}
+
+VM_OP(MULTIPLY_CONSTANT) {
+    BINARY_NUMBER_CONSTANT_OP("*", clox_value_number_mul);
+    VM_NEXT();
+}
+
+VM_OP(DIVIDE_CONSTANT) {
+    BINARY_NUMBER_CONSTANT_OP("/", clox_value_number_div);
+    VM_NEXT();
+}
+
+VM_OP(GREATER_CONSTANT) {
+    BINARY_NUMBER_CONSTANT_OP(">", NUMBER_GREATER);
+    VM_NEXT();
+}
+
+VM_OP(GREATER_EQUAL_CONSTANT) {
+    BINARY_NUMBER_CONSTANT_OP(">=", NUMBER_GREATER_EQUAL);
+    VM_NEXT();
+}
+
+VM_OP(LESS_CONSTANT) {
+    BINARY_NUMBER_CONSTANT_OP("<", NUMBER_LESS);
+    VM_NEXT();
+}
+
+VM_OP(LESS_EQUAL_CONSTANT) {
+    BINARY_NUMBER_CONSTANT_OP("<=", NUMBER_LESS_EQUAL);
+    VM_NEXT();
+}
+
+VM_OP(SET_GLOBAL_POP) {
+    clox_vm_value* name = &READ_CONSTANT();
+    struct clox_env_kv* entry = clox_env_lookup(&vm->globals, clox_value_as_strview(name));
+    if (entry == NULL) {
+        vm_report_undefined_variable(vm, name);
+        return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+    }
+    // the value is moved from the stack to the global, no need to duplicate it
+    clox_env_kv_set(entry, *--vm->stack_top);
+    VM_NEXT();
+}
+
+VM_OP(SET_LOCAL_POP) {
+    uint8_t slot = READ_BYTE();
+    clox_value_free(&vm->stack[slot]);
+    vm->stack[slot] = *--vm->stack_top;
+    VM_NEXT();
+}
+
+VM_OP(POP_N) {
+    for (uint8_t count = READ_BYTE(); count > 0; count--) {
+        clox_value_free(--vm->stack_top);
+    }
+    VM_NEXT();
+}
+
+#if defined(CLOX_VM_DISPATCH_COMPUTED_GOTO)
+
+}
+
+#pragma GCC diagnostic pop
+
+#elif !defined(CLOX_VM_DISPATCH_TAIL_CALL)
+
+        default:
+            clox_output_flush(&vm->output);
+            fprintf(stderr, "error: line %zu: unknown opcode %hhu\n", vm_current_line(vm), instruction);
+            return CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR;
+        }
+    }
+}
+
+#endif
+
+#undef VM_NEXT
+#undef VM_OP
+#undef NUMBER_LESS_EQUAL
+#undef NUMBER_LESS
+#undef NUMBER_GREATER_EQUAL
+#undef NUMBER_GREATER
+#undef BINARY_NUMBER_CONSTANT_OP
+#undef BINARY_NUMBER_OP
+#undef PUSH
+#undef PEEK
+#undef READ_CONSTANT_LONG
+#undef READ_INDEX_LONG
+#undef READ_CONSTANT
+#undef READ_OPCODE
+#undef READ_BYTE
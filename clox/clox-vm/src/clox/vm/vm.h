@@ -0,0 +1,80 @@
+#ifndef CLOX_VM_VM_H
+#define CLOX_VM_VM_H
+
+#include "common.h"
+#include "value.h"
+
+#include <clox/output.h>
+#include <clox/env.h>
+
+/**
+ * @brief How many values the VM stack holds before it first grows. Enough for the 256 locals a chunk can address,
+ * the temporaries of deeply nested expressions may take more
+ */
+#define CLOX_VM_STACK_INITIAL_CAPACITY 256
+
+struct clox_vm_chunk;
+struct clox_vm_profile;
+
+enum clox_vm_interpret_result {
+    CLOX_VM_INTERPRET_RESULT_OK,
+    CLOX_VM_INTERPRET_RESULT_RUNTIME_ERROR,
+};
+
+struct clox_vm {
+    /**
+     * @brief The chunk being executed
+     */
+    struct clox_vm_chunk* chunk;
+    /**
+     * @brief Instruction pointer: the next instruction to be executed in the chunk codes
+     */
+    uint8_t* ip;
+    /**
+     * @brief Locals, operands and temporaries. It grows when full, so it can't overflow. The values in it are owned
+     * by the VM
+     */
+    clox_vm_value* stack;
+    /**
+     * @brief One past the topmost value in the stack
+     */
+    clox_vm_value* stack_top;
+    /**
+     * @brief How many values the stack can hold before growing again
+     */
+    size_t stack_capacity;
+    /**
+     * @brief The global variables. They outlive the chunks, so a REPL can run one chunk per line
+     */
+    struct clox_env globals;
+    /**
+     * @brief Where the print statements write to (stdout)
+     */
+    struct clox_output output;
+#if defined(CLOX_VM_PROFILE)
+    /**
+     * @brief Where the executed instructions are accounted, if not NULL. Not owned by the VM
+     */
+    struct clox_vm_profile* profile;
+#endif
+};
+
+void clox_vm_init(struct clox_vm* vm);
+
+/**
+ * @brief Frees the values left in the stack and the globals, and flushes the pending output
+ */
+void clox_vm_free(struct clox_vm* vm);
+
+/**
+ * @brief Executes the chunk until its return instruction.
+ * 
+ * Runtime errors are reported to stderr, the same way the AST interpreter does, and leave the stack empty.
+ * 
+ * @param vm 
+ * @param chunk 
+ * @return enum clox_vm_interpret_result 
+ */
+enum clox_vm_interpret_result clox_vm_interpret(struct clox_vm* vm, struct clox_vm_chunk* chunk);
+
+#endif
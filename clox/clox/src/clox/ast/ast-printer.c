@@ -4,8 +4,10 @@
 #include <assert.h>
 
 #include <clox/strview.h>
+#include <clox/dtoa.h>
 #include "expr.h"
 #include "expr-visitor.h"
+#include <clox/stb_ds.h>
 
 struct ast_printer {
     FILE* file;
@@ -17,6 +19,7 @@ static int print_literal(struct clox_ast_expr* expr, void* userctx);
 static int print_unary(struct clox_ast_expr* expr, void* userctx);
 static int print_var(struct clox_ast_expr* expr, void* userctx);
 static int print_assign(struct clox_ast_expr* expr, void* userctx);
+static int print_concat(struct clox_ast_expr* expr, void* userctx);
 
 static const struct clox_ast_expr_visitor ast_printer_expr_visitor = {
     .visit_binary = print_binary,
@@ -25,6 +28,7 @@ static const struct clox_ast_expr_visitor ast_printer_expr_visitor = {
     .visit_unary = print_unary,
     .visit_var = print_var,
     .visit_assign = print_assign,
+    .visit_concat = print_concat,
 };
 
 void ast_printer_println(struct clox_ast_expr* expr) {
@@ -81,11 +85,11 @@ static int print_literal(struct clox_ast_expr* expr, void* userctx) {
     
     switch (expr_lit->kind) {
     case CLOX_AST_EXPR_LITERAL_KIND_NUMBER:
-        fprintf(ast_printer->file, "%lf", expr_lit->value.number.val);
+        clox_dtoa_fprint(ast_printer->file, expr_lit->value.number.val);
         break;
 
     case CLOX_AST_EXPR_LITERAL_KIND_STRING:
-        fprintf(ast_printer->file, "%s", expr_lit->value.string.val.ptr);
+        fprintf(ast_printer->file, "%s", rcstr_chars(expr_lit->value.string.val));
         break;
 
     case CLOX_AST_EXPR_LITERAL_KIND_BOOL:
@@ -143,3 +147,19 @@ static int print_assign(struct clox_ast_expr* expr, void* userctx) {
 
     return 0;
 }
+
+static int print_concat(struct clox_ast_expr* expr, void* userctx) {
+    struct ast_printer* ast_printer = userctx;
+    struct clox_ast_expr_concat* expr_concat = &expr->value.concat;
+
+    fprintf(ast_printer->file, "(+");
+    for (long i = 0; i < arrlen(expr_concat->operands); i++) {
+        fputc(' ', ast_printer->file);
+        if (clox_ast_expr_accept(expr_concat->operands[i], &ast_printer_expr_visitor, userctx) != 0) {
+            return 1;
+        }
+    }
+    fputc(')', ast_printer->file);
+
+    return 0;
+}
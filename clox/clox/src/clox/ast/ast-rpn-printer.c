@@ -3,8 +3,10 @@
 #include <stdbool.h>
 #include <assert.h>
 
+#include <clox/dtoa.h>
 #include "expr.h"
 #include "expr-visitor.h"
+#include <clox/stb_ds.h>
 
 struct ast_rpn_printer {
     FILE* file;
@@ -16,6 +18,7 @@ static int rpn_print_literal(struct clox_ast_expr* expr, void* userctx);
 static int rpn_print_unary(struct clox_ast_expr* expr, void* userctx);
 static int rpn_print_var(struct clox_ast_expr* expr, void* userctx);
 static int rpn_print_assign(struct clox_ast_expr* expr, void* userctx);
+static int rpn_print_concat(struct clox_ast_expr* expr, void* userctx);
 
 static const struct clox_ast_expr_visitor ast_rpn_printer_expr_visitor = {
     .visit_binary = rpn_print_binary,
@@ -24,6 +27,7 @@ static const struct clox_ast_expr_visitor ast_rpn_printer_expr_visitor = {
     .visit_unary = rpn_print_unary,
     .visit_var = rpn_print_var,
     .visit_assign = rpn_print_assign,
+    .visit_concat = rpn_print_concat,
 };
 
 void ast_rpn_printer_println(struct clox_ast_expr* expr) {
@@ -73,11 +77,11 @@ static int rpn_print_literal(struct clox_ast_expr* expr, void* userctx) {
     
     switch (expr_lit->kind) {
     case CLOX_AST_EXPR_LITERAL_KIND_NUMBER:
-        fprintf(ast_rpn_printer->file, "%lf", expr_lit->value.number.val);
+        clox_dtoa_fprint(ast_rpn_printer->file, expr_lit->value.number.val);
         break;
 
     case CLOX_AST_EXPR_LITERAL_KIND_STRING:
-        fprintf(ast_rpn_printer->file, "%s", expr_lit->value.string.val.ptr);
+        fprintf(ast_rpn_printer->file, "%s", rcstr_chars(expr_lit->value.string.val));
         break;
 
     case CLOX_AST_EXPR_LITERAL_KIND_BOOL:
@@ -131,3 +135,22 @@ static int rpn_print_assign(struct clox_ast_expr* expr, void* userctx) {
 
     return 0;
 }
+
+static int rpn_print_concat(struct clox_ast_expr* expr, void* userctx) {
+    struct ast_rpn_printer* ast_rpn_printer = userctx;
+    struct clox_ast_expr_concat* expr_concat = &expr->value.concat;
+
+    // printed like the nested binary nodes it stands for: "a b + c +"
+    if (clox_ast_expr_accept(expr_concat->operands[0], &ast_rpn_printer_expr_visitor, userctx) != 0) {
+        return 1;
+    }
+    for (long i = 1; i < arrlen(expr_concat->operands); i++) {
+        fprintf(ast_rpn_printer->file, " ");
+        if (clox_ast_expr_accept(expr_concat->operands[i], &ast_rpn_printer_expr_visitor, userctx) != 0) {
+            return 1;
+        }
+        fprintf(ast_rpn_printer->file, " +");
+    }
+
+    return 0;
+}
@@ -4,6 +4,7 @@
 
 #include "expr.h"
 #include "expr-visitor.h"
+#include <clox/stb_ds.h>
 
 static int visit_binary(struct clox_ast_expr* expr, void* userctx);
 static int visit_grouping(struct clox_ast_expr* expr, void* userctx);
@@ -11,6 +12,7 @@ static int visit_literal(struct clox_ast_expr* expr, void* userctx);
 static int visit_unary(struct clox_ast_expr* expr, void* userctx);
 static int visit_var(struct clox_ast_expr* expr, void* userctx);
 static int visit_assign(struct clox_ast_expr* expr, void* userctx);
+static int visit_concat(struct clox_ast_expr* expr, void* userctx);
 
 const struct clox_ast_expr_visitor* clox_ast_expr_visitor_free(void) {
     static const struct clox_ast_expr_visitor vtable = {
@@ -20,25 +22,27 @@ const struct clox_ast_expr_visitor* clox_ast_expr_visitor_free(void) {
         .visit_unary = visit_unary,
         .visit_var = visit_var,
         .visit_assign = visit_assign,
+        .visit_concat = visit_concat,
     };
     return &vtable;
 }
 
-// Memory free must be a Postorder traversal
+// NOTE userctx is the stb_ds array of the nodes pending to be freed (see clox_ast_expr_free).
+// Children are pushed there instead of being freed recursively, so deep trees don't overflow the native stack.
 static int visit_binary(struct clox_ast_expr* expr, void* userctx) {
-    (void) userctx;
+    struct clox_ast_expr*** pending = userctx;
     
-    clox_ast_expr_free(expr->value.binary.left);
-    clox_ast_expr_free(expr->value.binary.right);
+    arrpush(*pending, expr->value.binary.left);
+    arrpush(*pending, expr->value.binary.right);
     free(expr);
 
     return 0;
 }
 
 static int visit_grouping(struct clox_ast_expr* expr, void* userctx) {
-    (void) userctx;
+    struct clox_ast_expr*** pending = userctx;
     
-    clox_ast_expr_free(expr->value.grouping.expr);
+    arrpush(*pending, expr->value.grouping.expr);
     free(expr);
 
     return 0;
@@ -48,7 +52,7 @@ static int visit_literal(struct clox_ast_expr* expr, void* userctx) {
     (void) userctx;
     
     if (expr->value.literal.kind == CLOX_AST_EXPR_LITERAL_KIND_STRING) {
-        str_free(&expr->value.literal.value.string.val);
+        rcstr_release(expr->value.literal.value.string.val);
     }
     free(expr);
 
@@ -56,9 +60,9 @@ static int visit_literal(struct clox_ast_expr* expr, void* userctx) {
 }
 
 static int visit_unary(struct clox_ast_expr* expr, void* userctx) {
-    (void) userctx;
+    struct clox_ast_expr*** pending = userctx;
     
-    clox_ast_expr_free(expr->value.unary.right);
+    arrpush(*pending, expr->value.unary.right);
     free(expr);
 
     return 0;
@@ -73,9 +77,22 @@ static int visit_var(struct clox_ast_expr* expr, void* userctx) {
 }
 
 static int visit_assign(struct clox_ast_expr* expr, void* userctx) {
-    (void) userctx;
+    struct clox_ast_expr*** pending = userctx;
     
-    clox_ast_expr_free(expr->value.assign.value);
+    arrpush(*pending, expr->value.assign.value);
+    free(expr);
+
+    return 0;
+}
+
+static int visit_concat(struct clox_ast_expr* expr, void* userctx) {
+    struct clox_ast_expr*** pending = userctx;
+    
+    for (long i = 0; i < arrlen(expr->value.concat.operands); i++) {
+        arrpush(*pending, expr->value.concat.operands[i]);
+    }
+    arrfree(expr->value.concat.operands);
+    arrfree(expr->value.concat.operators);
     free(expr);
 
     return 0;
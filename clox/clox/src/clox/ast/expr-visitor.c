@@ -43,6 +43,12 @@ int clox_ast_expr_accept(struct clox_ast_expr* expr, const struct clox_ast_expr_
             return visitor->visit_assign(expr, userctx);
         }
         return 0;
+
+    case CLOX_AST_EXPR_KIND_CONCAT:
+        if (visitor->visit_concat) {
+            return visitor->visit_concat(expr, userctx);
+        }
+        return 0;
     }
 
     assert(false && "unsupported clox_ast_expr_kind");
@@ -10,6 +10,7 @@ struct clox_ast_expr_visitor {
     int (*visit_unary)(struct clox_ast_expr* expr, void* userctx);
     int (*visit_var)(struct clox_ast_expr* expr, void* userctx);
     int (*visit_assign)(struct clox_ast_expr* expr, void* userctx);
+    int (*visit_concat)(struct clox_ast_expr* expr, void* userctx);
 };
 
 int clox_ast_expr_accept(struct clox_ast_expr* expr, const struct clox_ast_expr_visitor* visitor, void* userctx);
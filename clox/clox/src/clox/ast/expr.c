@@ -8,6 +8,7 @@
 #include <clox/commons.h>
 #include "expr-visitor.h"
 #include "expr-visitor-free.h"
+#include <clox/stb_ds.h>
 
 struct clox_ast_expr* clox_ast_expr_binary_new(struct clox_ast_expr* left, struct token operator, struct clox_ast_expr* right) {
     struct clox_ast_expr* expr = malloc(sizeof(struct clox_ast_expr));
@@ -42,6 +43,7 @@ struct clox_ast_expr* clox_ast_expr_var_new(struct token name) {
         .kind = CLOX_AST_EXPR_KIND_VAR,
         .value.var = (struct clox_ast_expr_var) {
             .name = name,
+            .slot = CLOX_AST_SLOT_GLOBAL,
         },
     };
     return expr;
@@ -56,11 +58,19 @@ struct clox_ast_expr* clox_ast_expr_assign_new(struct token name, struct clox_as
         .value.assign = (struct clox_ast_expr_assign) {
             .name = name,
             .value = value,
+            .slot = CLOX_AST_SLOT_GLOBAL,
         },
     };
     return expr;
 }
 
+struct clox_ast_expr* clox_ast_expr_concat_new(struct clox_ast_expr** operands, struct token* operators) {
+    struct clox_ast_expr* expr = malloc(sizeof(struct clox_ast_expr));
+    CLOX_ERR_PANIC_OOM_IF_NULL(expr);
+
+    *expr = clox_ast_expr_concat_create(operands, operators);
+    return expr;
+}
 
 struct clox_ast_expr* clox_ast_expr_literal_bool_new(bool val) {
     struct clox_ast_expr* expr = malloc(sizeof(struct clox_ast_expr));
@@ -94,24 +104,12 @@ struct clox_ast_expr* clox_ast_expr_literal_string_new(struct strview sv) {
     struct clox_ast_expr* expr = malloc(sizeof(struct clox_ast_expr));
     CLOX_ERR_PANIC_OOM_IF_NULL(expr);
 
-    size_t cstr_len = sv.len;
-    size_t cstr_cap = sv.len + 1;
-
-    char* cstr = calloc(cstr_cap, sizeof(char));
-    CLOX_ERR_PANIC_OOM_IF_NULL(cstr);
-
-    memcpy(cstr, sv.ptr, sv.len);
-    
     *expr = (struct clox_ast_expr) {
         .kind = CLOX_AST_EXPR_KIND_LITERAL,
         .value.literal = (struct clox_ast_expr_literal) {
             .kind = CLOX_AST_EXPR_LITERAL_KIND_STRING,
             .value.string = (struct clox_ast_expr_literal_string) {
-                .val = (struct str) {
-                    .cap = cstr_cap,
-                    .len = cstr_len,
-                    .ptr = cstr,
-                },
+                .val = rcstr_from_strview(sv),
             },
         },
     };
@@ -168,9 +166,67 @@ struct clox_ast_expr clox_ast_expr_grouping_create(struct clox_ast_expr* expr) {
     };
 }
 
+struct clox_ast_expr* clox_ast_expr_child(struct clox_ast_expr* expr, size_t index) {
+    switch (expr->kind) {
+    case CLOX_AST_EXPR_KIND_BINARY:
+        if (index == 0) {
+            return expr->value.binary.left;
+        }
+        return (index == 1) ? expr->value.binary.right : NULL;
+
+    case CLOX_AST_EXPR_KIND_GROUPING:
+        return (index == 0) ? expr->value.grouping.expr : NULL;
+
+    case CLOX_AST_EXPR_KIND_UNARY:
+        return (index == 0) ? expr->value.unary.right : NULL;
+
+    case CLOX_AST_EXPR_KIND_ASSIGN:
+        return (index == 0) ? expr->value.assign.value : NULL;
+
+    case CLOX_AST_EXPR_KIND_CONCAT:
+        return (index < (size_t) arrlen(expr->value.concat.operands)) ? expr->value.concat.operands[index] : NULL;
+
+    case CLOX_AST_EXPR_KIND_LITERAL:
+    case CLOX_AST_EXPR_KIND_VAR:
+        return NULL;
+    }
+    return NULL;
+}
+
+bool clox_ast_expr_is_leaf(const struct clox_ast_expr* expr) {
+    return expr->kind == CLOX_AST_EXPR_KIND_LITERAL || expr->kind == CLOX_AST_EXPR_KIND_VAR;
+}
+
+struct clox_ast_expr clox_ast_expr_concat_create(struct clox_ast_expr** operands, struct token* operators) {
+    assert(arrlen(operands) >= 2 && arrlen(operators) == arrlen(operands) - 1);
+
+    uint32_t last_non_leaf = 0;
+    for (long i = arrlen(operands) - 1; i > 0; i--) {
+        if (!clox_ast_expr_is_leaf(operands[i])) {
+            last_non_leaf = (uint32_t) i;
+            break;
+        }
+    }
+
+    return (struct clox_ast_expr) {
+        .kind = CLOX_AST_EXPR_KIND_CONCAT,
+        .value.concat = (struct clox_ast_expr_concat) {
+            .operands = operands,
+            .operators = operators,
+            .last_non_leaf = last_non_leaf,
+        },
+    };
+}
+
 // This is implemented basically as a post-order visitor.
 // Maybe we eventually end up with multiple post-order implementations.
 // Could we abstract those implementations as one and offer an extension point useful enough? (func ptr?)
 void clox_ast_expr_free(struct clox_ast_expr* expr) {
-    clox_ast_expr_accept(expr, clox_ast_expr_visitor_free(), NULL);
+    // Freeing a node pushes its children here, so the whole tree is freed without recursion
+    struct clox_ast_expr** pending = NULL;
+    arrpush(pending, expr);
+    while (arrlen(pending) > 0) {
+        clox_ast_expr_accept(arrpop(pending), clox_ast_expr_visitor_free(), &pending);
+    }
+    arrfree(pending);
 }
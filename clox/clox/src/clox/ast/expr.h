@@ -2,9 +2,12 @@
 #define CLOX_EXPR_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <clox/token.h>
-#include <clox/str.h>
+#include <clox/rcstr.h>
 #include <clox/strview.h>
+#include <clox/env.h>
 
 enum clox_ast_expr_literal_kind {
     CLOX_AST_EXPR_LITERAL_KIND_NUMBER,
@@ -18,7 +21,10 @@ struct clox_ast_expr_literal_number {
 };
 
 struct clox_ast_expr_literal_string {
-    struct str val;
+    /**
+     * @brief The literal string. Evaluation shares it instead of copying it
+     */
+    struct rcstr* val;
 };
 
 struct clox_ast_expr_literal_bool {
@@ -32,12 +38,41 @@ enum clox_ast_expr_kind {
     CLOX_AST_EXPR_KIND_UNARY,
     CLOX_AST_EXPR_KIND_VAR,
     CLOX_AST_EXPR_KIND_ASSIGN,
+    CLOX_AST_EXPR_KIND_CONCAT,
+};
+
+/**
+ * @brief The operand types a binary node has been specialized for at runtime (a.k.a. quickening).
+ * 
+ * Nodes start as generic and are rewritten by the interpreter into a specialized variant after they evaluate
+ * operands of the same types. A specialized node skips the generic dispatch and just guards its assumption,
+ * falling back to generic when it breaks.
+ */
+enum clox_ast_expr_binary_spec {
+    CLOX_AST_EXPR_BINARY_SPEC_GENERIC = 0,
+    CLOX_AST_EXPR_BINARY_SPEC_NUMBER_ADD,
+    CLOX_AST_EXPR_BINARY_SPEC_NUMBER_SUB,
+    CLOX_AST_EXPR_BINARY_SPEC_NUMBER_MUL,
+    CLOX_AST_EXPR_BINARY_SPEC_NUMBER_DIV,
+    CLOX_AST_EXPR_BINARY_SPEC_NUMBER_GREATER,
+    CLOX_AST_EXPR_BINARY_SPEC_NUMBER_GREATER_EQUAL,
+    CLOX_AST_EXPR_BINARY_SPEC_NUMBER_LESS,
+    CLOX_AST_EXPR_BINARY_SPEC_NUMBER_LESS_EQUAL,
+    CLOX_AST_EXPR_BINARY_SPEC_STRING_CONCAT,
 };
 
 struct clox_ast_expr_binary {
     struct clox_ast_expr* left;
     struct token operator;
     struct clox_ast_expr* right;
+    /**
+     * @brief Current specialization (see enum clox_ast_expr_binary_spec). Owned by the interpreter
+     */
+    uint8_t spec;
+    /**
+     * @brief How many times the specialization assumption broke. Past a limit the node stays generic for good
+     */
+    uint8_t despecializations;
 };
 
 struct clox_ast_expr_grouping {
@@ -58,13 +93,58 @@ struct clox_ast_expr_unary {
     struct clox_ast_expr* right;
 };
 
+/**
+ * @brief Slot of the variables which aren't block locals. Those are globals and live in the env
+ */
+#define CLOX_AST_SLOT_GLOBAL (-1)
+
 struct clox_ast_expr_var {
     struct token name;
+    /**
+     * @brief The interpreter locals stack slot the name was resolved to by the parser, or CLOX_AST_SLOT_GLOBAL
+     */
+    int32_t slot;
+    /**
+     * @brief Inline cache of the env entry the name resolves to. Owned by the interpreter
+     */
+    struct clox_env_cache cache;
 };
 
 struct clox_ast_expr_assign {
     struct token name;
     struct clox_ast_expr* value;
+    /**
+     * @brief The interpreter locals stack slot the name was resolved to by the parser, or CLOX_AST_SLOT_GLOBAL
+     */
+    int32_t slot;
+    /**
+     * @brief Inline cache of the env entry the name resolves to. Owned by the interpreter
+     */
+    struct clox_env_cache cache;
+};
+
+/**
+ * @brief A left-leaning chain of `+` (i.e. `a + b + c + ...`) with a string literal operand, so it can only
+ * evaluate to a string. The parser never makes these: the optimizer flattens nested binary nodes into them,
+ * so the result is allocated once instead of once per `+`.
+ * 
+ * It behaves like the nested binary nodes it replaces: operands are evaluated in order and each one is type
+ * checked right after being evaluated, reporting the very same errors.
+ */
+struct clox_ast_expr_concat {
+    /**
+     * @brief Dynamic array (stb_ds) of the operands, in evaluation order
+     */
+    struct clox_ast_expr** operands;
+    /**
+     * @brief Dynamic array (stb_ds) of the `+` operators. operators[i - 1] joins operands[i] to the ones before it
+     */
+    struct token* operators;
+    /**
+     * @brief Index of the last operand able to assign variables while being evaluated, or 0 if there's none.
+     * The operands evaluated before it must not be borrowed from the environment
+     */
+    uint32_t last_non_leaf;
 };
 
 struct clox_ast_expr {
@@ -76,6 +156,7 @@ struct clox_ast_expr {
         struct clox_ast_expr_unary unary;
         struct clox_ast_expr_var var;
         struct clox_ast_expr_assign assign;
+        struct clox_ast_expr_concat concat;
     } value;
 };
 
@@ -83,6 +164,7 @@ struct clox_ast_expr* clox_ast_expr_binary_new(struct clox_ast_expr* left, struc
 struct clox_ast_expr* clox_ast_expr_unary_new(struct token operator, struct clox_ast_expr* right);
 struct clox_ast_expr* clox_ast_expr_var_new(struct token name);
 struct clox_ast_expr* clox_ast_expr_assign_new(struct token name, struct clox_ast_expr* value);
+struct clox_ast_expr* clox_ast_expr_concat_new(struct clox_ast_expr** operands, struct token* operators);
 struct clox_ast_expr* clox_ast_expr_literal_bool_new(bool val);
 struct clox_ast_expr* clox_ast_expr_literal_nil_new(void);
 struct clox_ast_expr* clox_ast_expr_literal_string_new(struct strview sv);
@@ -90,6 +172,19 @@ struct clox_ast_expr* clox_ast_expr_literal_number_new(double val);
 struct clox_ast_expr* clox_ast_expr_grouping_new(struct clox_ast_expr* expr);
 struct clox_ast_expr  clox_ast_expr_literal_number_create(double val);
 struct clox_ast_expr  clox_ast_expr_grouping_create(struct clox_ast_expr* expr);
+struct clox_ast_expr  clox_ast_expr_concat_create(struct clox_ast_expr** operands, struct token* operators);
+
+/**
+ * @brief Gets the child expressions in evaluation order. Handy for walking trees without recursion.
+ * 
+ * @return struct clox_ast_expr* the child at index or NULL if there are no more children
+ */
+struct clox_ast_expr* clox_ast_expr_child(struct clox_ast_expr* expr, size_t index);
+
+/**
+ * @brief Leaf expressions are the ones that can't mutate the environment while being evaluated
+ */
+bool clox_ast_expr_is_leaf(const struct clox_ast_expr* expr);
 
 void clox_ast_expr_free(struct clox_ast_expr* expr);
 
@@ -21,6 +21,12 @@ int clox_ast_statement_accept(struct clox_ast_statement* stmt, const struct clox
             return visitor->visit_statement_var(stmt, userctx);
         }
         return 0;
+
+    case CLOX_AST_STATEMENT_KIND_BLOCK:
+        if (visitor->visit_statement_block) {
+            return visitor->visit_statement_block(stmt, userctx);
+        }
+        return 0;
     }
     
     return 1;
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 
 #include <clox/commons.h>
+#include <clox/stb_ds.h>
 #include "expr.h"
 
 struct clox_ast_statement* clox_ast_statement_new_expr(struct clox_ast_expr* expr) {
@@ -42,6 +43,23 @@ struct clox_ast_statement* clox_ast_statement_new_var(struct token name, struct
         .as.var_statement = (struct clox_ast_statement_var) {
             .name = name,
             .initializer = initializer,
+            .slot = CLOX_AST_SLOT_GLOBAL,
+        },
+    };
+
+    return stmt;
+}
+
+struct clox_ast_statement* clox_ast_statement_new_block(struct clox_ast_statement** statements, uint32_t first_slot, uint32_t slot_count) {
+    struct clox_ast_statement* stmt = malloc(sizeof(struct clox_ast_statement));
+    CLOX_ERR_PANIC_OOM_IF_NULL(stmt);
+
+    *stmt = (struct clox_ast_statement) {
+        .kind = CLOX_AST_STATEMENT_KIND_BLOCK,
+        .as.block_statement = (struct clox_ast_statement_block) {
+            .statements = statements,
+            .first_slot = first_slot,
+            .slot_count = slot_count,
         },
     };
 
@@ -56,9 +74,15 @@ void clox_ast_statement_free(struct clox_ast_statement* stmt) {
 
     case CLOX_AST_STATEMENT_KIND_PRINT:
         clox_ast_statement_print_free(&stmt->as.print_statement);
+        break;
 
     case CLOX_AST_STATEMENT_KIND_VAR:
         clox_ast_statement_var_free(&stmt->as.var_statement);
+        break;
+
+    case CLOX_AST_STATEMENT_KIND_BLOCK:
+        clox_ast_statement_block_free(&stmt->as.block_statement);
+        break;
     }
 
     free(stmt);
@@ -79,3 +103,10 @@ void clox_ast_statement_var_free(struct clox_ast_statement_var* var_stmt) {
         clox_ast_expr_free(var_stmt->initializer);
     }
 }
+
+void clox_ast_statement_block_free(struct clox_ast_statement_block* block_stmt) {
+    for (long i = 0; i < arrlen(block_stmt->statements); i++) {
+        clox_ast_statement_free(block_stmt->statements[i]);
+    }
+    arrfree(block_stmt->statements);
+}
@@ -1,6 +1,8 @@
 #ifndef CLOX_AST_STATEMENT_H
 #define CLOX_AST_STATEMENT_H
 
+#include <stdint.h>
+
 #include <clox/token.h>
 
 struct clox_ast_expr;
@@ -18,6 +20,10 @@ enum clox_ast_statement_kind {
      * @brief Variable Declaration Statement
      */
     CLOX_AST_STATEMENT_KIND_VAR,
+    /**
+     * @brief Block Statement
+     */
+    CLOX_AST_STATEMENT_KIND_BLOCK,
 };
 
 struct clox_ast_statement_expr {
@@ -31,6 +37,29 @@ struct clox_ast_statement_print {
 struct clox_ast_statement_var {
     struct token name;
     struct clox_ast_expr* initializer;
+    /**
+     * @brief The interpreter locals stack slot of the variable, or CLOX_AST_SLOT_GLOBAL if it's a global
+     */
+    int32_t slot;
+};
+
+/**
+ * @brief A block scope. Its locals are resolved by the parser to slots of the interpreter locals stack: the
+ * slots of a block come right after the ones of its enclosing blocks, so sibling blocks reuse the same slots.
+ */
+struct clox_ast_statement_block {
+    /**
+     * @brief Dynamic array (stb_ds) of statements
+     */
+    struct clox_ast_statement** statements;
+    /**
+     * @brief The slot of the first local declared in the block
+     */
+    uint32_t first_slot;
+    /**
+     * @brief How many locals are declared in the block, not counting the ones of nested blocks
+     */
+    uint32_t slot_count;
 };
 
 struct clox_ast_statement {
@@ -39,16 +68,19 @@ struct clox_ast_statement {
         struct clox_ast_statement_expr expr_statement;
         struct clox_ast_statement_print print_statement;
         struct clox_ast_statement_var var_statement;
+        struct clox_ast_statement_block block_statement;
     } as;
 };
 
 struct clox_ast_statement* clox_ast_statement_new_expr(struct clox_ast_expr* expr);
 struct clox_ast_statement* clox_ast_statement_new_print(struct clox_ast_expr* expr);
 struct clox_ast_statement* clox_ast_statement_new_var(struct token name, struct clox_ast_expr* initializer);
+struct clox_ast_statement* clox_ast_statement_new_block(struct clox_ast_statement** statements, uint32_t first_slot, uint32_t slot_count);
 
 void clox_ast_statement_free(struct clox_ast_statement* stmt);
 void clox_ast_statement_expr_free(struct clox_ast_statement_expr* expr_stmt);
 void clox_ast_statement_print_free(struct clox_ast_statement_print* print_stmt);
 void clox_ast_statement_var_free(struct clox_ast_statement_var* var_stmt);
+void clox_ast_statement_block_free(struct clox_ast_statement_block* block_stmt);
 
 #endif
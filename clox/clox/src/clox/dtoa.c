@@ -0,0 +1,407 @@
+#include "dtoa.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DOUBLE_EXPONENT_MASK    UINT64_C(0x7ff0000000000000)
+#define DOUBLE_SIGNIFICAND_MASK UINT64_C(0x000fffffffffffff)
+#define DOUBLE_HIDDEN_BIT       UINT64_C(0x0010000000000000)
+#define DOUBLE_SIGNIFICAND_BITS 52
+#define DOUBLE_EXPONENT_BIAS    (0x3ff + DOUBLE_SIGNIFICAND_BITS)
+
+/**
+ * @brief A "do it yourself" floating point number: f * 2^e, without any rounding nor special values
+ */
+struct diyfp {
+    uint64_t f;
+    int e;
+};
+
+// Normalized 10^k for k = -348, -340, ..., 340, rounded to 64 bits. Generated with exact rational arithmetic.
+static const uint64_t cached_powers_f[] = {
+    UINT64_C(0xfa8fd5a0081c0288), UINT64_C(0xbaaee17fa23ebf76), UINT64_C(0x8b16fb203055ac76), UINT64_C(0xcf42894a5dce35ea),
+    UINT64_C(0x9a6bb0aa55653b2d), UINT64_C(0xe61acf033d1a45df), UINT64_C(0xab70fe17c79ac6ca), UINT64_C(0xff77b1fcbebcdc4f),
+    UINT64_C(0xbe5691ef416bd60c), UINT64_C(0x8dd01fad907ffc3c), UINT64_C(0xd3515c2831559a83), UINT64_C(0x9d71ac8fada6c9b5),
+    UINT64_C(0xea9c227723ee8bcb), UINT64_C(0xaecc49914078536d), UINT64_C(0x823c12795db6ce57), UINT64_C(0xc21094364dfb5637),
+    UINT64_C(0x9096ea6f3848984f), UINT64_C(0xd77485cb25823ac7), UINT64_C(0xa086cfcd97bf97f4), UINT64_C(0xef340a98172aace5),
+    UINT64_C(0xb23867fb2a35b28e), UINT64_C(0x84c8d4dfd2c63f3b), UINT64_C(0xc5dd44271ad3cdba), UINT64_C(0x936b9fcebb25c996),
+    UINT64_C(0xdbac6c247d62a584), UINT64_C(0xa3ab66580d5fdaf6), UINT64_C(0xf3e2f893dec3f126), UINT64_C(0xb5b5ada8aaff80b8),
+    UINT64_C(0x87625f056c7c4a8b), UINT64_C(0xc9bcff6034c13053), UINT64_C(0x964e858c91ba2655), UINT64_C(0xdff9772470297ebd),
+    UINT64_C(0xa6dfbd9fb8e5b88f), UINT64_C(0xf8a95fcf88747d94), UINT64_C(0xb94470938fa89bcf), UINT64_C(0x8a08f0f8bf0f156b),
+    UINT64_C(0xcdb02555653131b6), UINT64_C(0x993fe2c6d07b7fac), UINT64_C(0xe45c10c42a2b3b06), UINT64_C(0xaa242499697392d3),
+    UINT64_C(0xfd87b5f28300ca0e), UINT64_C(0xbce5086492111aeb), UINT64_C(0x8cbccc096f5088cc), UINT64_C(0xd1b71758e219652c),
+    UINT64_C(0x9c40000000000000), UINT64_C(0xe8d4a51000000000), UINT64_C(0xad78ebc5ac620000), UINT64_C(0x813f3978f8940984),
+    UINT64_C(0xc097ce7bc90715b3), UINT64_C(0x8f7e32ce7bea5c70), UINT64_C(0xd5d238a4abe98068), UINT64_C(0x9f4f2726179a2245),
+    UINT64_C(0xed63a231d4c4fb27), UINT64_C(0xb0de65388cc8ada8), UINT64_C(0x83c7088e1aab65db), UINT64_C(0xc45d1df942711d9a),
+    UINT64_C(0x924d692ca61be758), UINT64_C(0xda01ee641a708dea), UINT64_C(0xa26da3999aef774a), UINT64_C(0xf209787bb47d6b85),
+    UINT64_C(0xb454e4a179dd1877), UINT64_C(0x865b86925b9bc5c2), UINT64_C(0xc83553c5c8965d3d), UINT64_C(0x952ab45cfa97a0b3),
+    UINT64_C(0xde469fbd99a05fe3), UINT64_C(0xa59bc234db398c25), UINT64_C(0xf6c69a72a3989f5c), UINT64_C(0xb7dcbf5354e9bece),
+    UINT64_C(0x88fcf317f22241e2), UINT64_C(0xcc20ce9bd35c78a5), UINT64_C(0x98165af37b2153df), UINT64_C(0xe2a0b5dc971f303a),
+    UINT64_C(0xa8d9d1535ce3b396), UINT64_C(0xfb9b7cd9a4a7443c), UINT64_C(0xbb764c4ca7a44410), UINT64_C(0x8bab8eefb6409c1a),
+    UINT64_C(0xd01fef10a657842c), UINT64_C(0x9b10a4e5e9913129), UINT64_C(0xe7109bfba19c0c9d), UINT64_C(0xac2820d9623bf429),
+    UINT64_C(0x80444b5e7aa7cf85), UINT64_C(0xbf21e44003acdd2d), UINT64_C(0x8e679c2f5e44ff8f), UINT64_C(0xd433179d9c8cb841),
+    UINT64_C(0x9e19db92b4e31ba9), UINT64_C(0xeb96bf6ebadf77d9), UINT64_C(0xaf87023b9bf0ee6b)
+};
+
+static const int16_t cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066
+};
+
+static const uint64_t powers_of_ten[] = {
+    UINT64_C(1), UINT64_C(10), UINT64_C(100), UINT64_C(1000), UINT64_C(10000), UINT64_C(100000),
+    UINT64_C(1000000), UINT64_C(10000000), UINT64_C(100000000), UINT64_C(1000000000), UINT64_C(10000000000),
+    UINT64_C(100000000000), UINT64_C(1000000000000), UINT64_C(10000000000000), UINT64_C(100000000000000),
+    UINT64_C(1000000000000000), UINT64_C(10000000000000000), UINT64_C(100000000000000000),
+    UINT64_C(1000000000000000000), UINT64_C(10000000000000000000),
+};
+
+static struct diyfp diyfp_from_double(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(double));
+
+    int biased_e = (int) ((bits & DOUBLE_EXPONENT_MASK) >> DOUBLE_SIGNIFICAND_BITS);
+    uint64_t significand = bits & DOUBLE_SIGNIFICAND_MASK;
+    if (biased_e != 0) {
+        return (struct diyfp) { significand + DOUBLE_HIDDEN_BIT, biased_e - DOUBLE_EXPONENT_BIAS };
+    }
+    // subnormal
+    return (struct diyfp) { significand, 1 - DOUBLE_EXPONENT_BIAS };
+}
+
+static int count_leading_zeros(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_clzll(x);
+#else
+    int n = 0;
+    while ((x & (UINT64_C(1) << 63)) == 0) {
+        x <<= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+static struct diyfp diyfp_normalize(struct diyfp x) {
+    int shift = count_leading_zeros(x.f);
+    return (struct diyfp) { x.f << shift, x.e - shift };
+}
+
+/**
+ * @brief The product rounded to the upper 64 bits
+ */
+static struct diyfp diyfp_mul(struct diyfp x, struct diyfp y) {
+    const uint64_t mask32 = UINT64_C(0xffffffff);
+    uint64_t a = x.f >> 32, b = x.f & mask32;
+    uint64_t c = y.f >> 32, d = y.f & mask32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+
+    uint64_t tmp = (bd >> 32) + (ad & mask32) + (bc & mask32);
+    tmp += UINT64_C(1) << 31;
+    return (struct diyfp) { ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64 };
+}
+
+/**
+ * @brief Computes the boundaries m- and m+ of value: the halfway points to its neighbour doubles.
+ * Any number strictly between them reads back as value. Both share the exponent of the normalized m+.
+ */
+static void boundaries(struct diyfp v, struct diyfp* minus, struct diyfp* plus) {
+    *plus = diyfp_normalize((struct diyfp) { (v.f << 1) + 1, v.e - 1 });
+
+    // the lower boundary is closer when the significand is a power of two (the exponent below is smaller), except
+    // for the smallest normal double, whose neighbour below is a subnormal with the same spacing
+    if (v.f == DOUBLE_HIDDEN_BIT && v.e > 1 - DOUBLE_EXPONENT_BIAS) {
+        *minus = (struct diyfp) { (v.f << 2) - 1, v.e - 2 };
+    } else {
+        *minus = (struct diyfp) { (v.f << 1) - 1, v.e - 1 };
+    }
+    minus->f <<= minus->e - plus->e;
+    minus->e = plus->e;
+}
+
+/**
+ * @brief Picks a cached power of ten c_k = 10^-k such that multiplying a number with exponent e by it lands in
+ * an exponent range where the integral part fits in 32 bits.
+ */
+static struct diyfp cached_power(int e, int* k) {
+    // ceil((-61 - e) * log10(2))
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int ik = (int) dk;
+    if (dk - ik > 0.0) {
+        ik++;
+    }
+
+    unsigned index = (unsigned) ((ik >> 3) + 1);
+    *k = -(-348 + (int) (index << 3));
+    return (struct diyfp) { cached_powers_f[index], cached_powers_e[index] };
+}
+
+static int count_decimal_digits(uint32_t n) {
+    int digits = 1;
+    while (digits < 10 && n >= powers_of_ten[digits]) {
+        digits++;
+    }
+    return digits;
+}
+
+/**
+ * @brief Moves the last digit closer to w while the digits stay within the unsafe interval, then tells whether
+ * they are guaranteed to be the shortest and closest ones. Every distance is scaled like rest, and it's only known
+ * up to unit because of the rounding of the products.
+ *
+ * @param wp_w the distance from w to the upper end of the unsafe interval
+ * @return bool false if the imprecision of w leaves more than one candidate, or the digits might not round-trip
+ */
+static bool round_weed(char* digits, int len, uint64_t wp_w, uint64_t delta, uint64_t rest, uint64_t ten_kappa,
+                       uint64_t unit) {
+    const uint64_t small_distance = wp_w - unit;
+    const uint64_t big_distance = wp_w + unit;
+
+    // w may be as low as w - unit: get as close as possible to the highest w could be
+    while (rest < small_distance && delta - rest >= ten_kappa
+           && (rest + ten_kappa < small_distance || small_distance - rest >= rest + ten_kappa - small_distance)) {
+        digits[len - 1]--;
+        rest += ten_kappa;
+    }
+
+    // if the next candidate would be closer to the lowest w could be, it's impossible to tell which one is closer
+    if (rest < big_distance && delta - rest >= ten_kappa
+        && (rest + ten_kappa < big_distance || big_distance - rest > rest + ten_kappa - big_distance)) {
+        return false;
+    }
+
+    // the digits must be inside the safe interval, which is the unsafe one narrowed by unit on both ends
+    return 2 * unit <= rest && rest <= delta - 4 * unit;
+}
+
+/**
+ * @brief Generates the shortest digits of the scaled upper boundary mp which still are above mp - delta, where
+ * the boundaries have already been widened by one unit to the unsafe interval.
+ *
+ * @return bool false if the digits can't be proven to be the shortest and closest ones. Their number is still a
+ * lower bound, since the unsafe interval contains the real one
+ */
+static bool digit_gen(struct diyfp w, struct diyfp mp, uint64_t delta, char* digits, int* len, int* k) {
+    const struct diyfp one = { UINT64_C(1) << -mp.e, mp.e };
+    const uint64_t wp_w = mp.f - w.f;
+    uint64_t unit = 1;
+
+    uint32_t p1 = (uint32_t) (mp.f >> -one.e);
+    uint64_t p2 = mp.f & (one.f - 1);
+    int kappa = count_decimal_digits(p1);
+    *len = 0;
+
+    // integral part
+    while (kappa > 0) {
+        uint32_t d = p1 / (uint32_t) powers_of_ten[kappa - 1];
+        p1 %= (uint32_t) powers_of_ten[kappa - 1];
+        if (d != 0 || *len != 0) {
+            digits[(*len)++] = (char) ('0' + d);
+        }
+        kappa--;
+
+        uint64_t rest = ((uint64_t) p1 << -one.e) + p2;
+        if (rest < delta) {
+            *k += kappa;
+            return round_weed(digits, *len, wp_w, delta, rest, powers_of_ten[kappa] << -one.e, unit);
+        }
+    }
+
+    // fractional part
+    while (true) {
+        p2 *= 10;
+        delta *= 10;
+        unit *= 10;
+        char d = (char) (p2 >> -one.e);
+        if (d != 0 || *len != 0) {
+            digits[(*len)++] = (char) ('0' + d);
+        }
+        p2 &= one.f - 1;
+        kappa--;
+
+        if (p2 < delta) {
+            *k += kappa;
+            return round_weed(digits, *len, wp_w * unit, delta, p2, one.f, unit);
+        }
+    }
+}
+
+/**
+ * @brief Writes the digits of a positive, finite value. The value is digits * 10^k, with at most 17 digits.
+ *
+ * @return bool false when Grisu3 can't prove the digits are the shortest and closest ones, which happens for about
+ * 0.5% of the doubles. len is then how many digits the shortest ones have at least
+ */
+static bool grisu3(double value, char* digits, int* len, int* k) {
+    struct diyfp v = diyfp_from_double(value);
+    struct diyfp minus, plus;
+    boundaries(v, &minus, &plus);
+
+    struct diyfp c_k = cached_power(plus.e, k);
+    struct diyfp w = diyfp_mul(diyfp_normalize(v), c_k);
+    struct diyfp wp = diyfp_mul(plus, c_k);
+    struct diyfp wm = diyfp_mul(minus, c_k);
+    // the products may be off by one ulp, so the boundaries are widened to the unsafe interval, which surely
+    // contains the real one. round_weed then checks that the digits also are in the narrowed, safe interval
+    wm.f--;
+    wp.f++;
+    return digit_gen(w, wp, wp.f - wm.f, digits, len, k);
+}
+
+/**
+ * @brief The exact, slow path for the doubles Grisu3 gives up on: the C library rounds value to more and more
+ * digits, starting from min_len, until they read back as value.
+ *
+ * @return int the number of digits, at most 17. The value is digits * 10^k
+ */
+static int shortest_exact(double value, int min_len, char* digits, int* k) {
+    char tmp[CLOX_DTOA_BUF_SIZE];
+    for (int precision = min_len; ; precision++) {
+        snprintf(tmp, sizeof(tmp), "%.*e", precision - 1, value);
+        // 17 digits always read back as value. strtod uses the decimal point of the same locale as snprintf
+        if (precision >= 17 || strtod(tmp, NULL) == value) {
+            break;
+        }
+    }
+
+    // d[.ddd]e±xx, whatever the decimal point is
+    int len = 0;
+    const char* p = tmp;
+    for (; *p != 'e'; p++) {
+        if (*p >= '0' && *p <= '9') {
+            digits[len++] = *p;
+        }
+    }
+    *k = atoi(p + 1) - (len - 1);
+    while (len > 1 && digits[len - 1] == '0') {
+        len--;
+        (*k)++;
+    }
+    return len;
+}
+
+static size_t write_integer(uint64_t n, char* buf) {
+    char digits[20];
+    int len = 0;
+    do {
+        digits[len++] = (char) ('0' + n % 10);
+        n /= 10;
+    } while (n != 0);
+
+    for (int i = 0; i < len; i++) {
+        buf[i] = digits[len - 1 - i];
+    }
+    return (size_t) len;
+}
+
+static size_t write_exponent(int exp, char* buf) {
+    size_t len = 0;
+    buf[len++] = 'e';
+    if (exp < 0) {
+        buf[len++] = '-';
+        exp = -exp;
+    } else {
+        buf[len++] = '+';
+    }
+
+    if (exp >= 100) {
+        buf[len++] = (char) ('0' + exp / 100);
+        exp %= 100;
+        buf[len++] = (char) ('0' + exp / 10);
+    } else if (exp >= 10) {
+        buf[len++] = (char) ('0' + exp / 10);
+    }
+    buf[len++] = (char) ('0' + exp % 10);
+    return len;
+}
+
+/**
+ * @brief Lays out digits * 10^k in buf, as described in clox_dtoa.
+ */
+static size_t format(const char* digits, int len, int k, char* buf) {
+    // 10^(exp10 - 1) <= value < 10^exp10
+    const int exp10 = len + k;
+
+    if (k >= 0 && exp10 <= 21) {
+        // integral: 1234e7 -> 12340000000
+        memcpy(buf, digits, (size_t) len);
+        memset(buf + len, '0', (size_t) k);
+        return (size_t) exp10;
+    }
+    if (exp10 > 0 && exp10 <= 21) {
+        // 1234e-2 -> 12.34
+        memcpy(buf, digits, (size_t) exp10);
+        buf[exp10] = '.';
+        memcpy(buf + exp10 + 1, digits + exp10, (size_t) (len - exp10));
+        return (size_t) len + 1;
+    }
+    if (exp10 > -6 && exp10 <= 0) {
+        // 1234e-6 -> 0.001234
+        const int zeros = -exp10;
+        buf[0] = '0';
+        buf[1] = '.';
+        memset(buf + 2, '0', (size_t) zeros);
+        memcpy(buf + 2 + zeros, digits, (size_t) len);
+        return (size_t) (2 + zeros + len);
+    }
+
+    // 1e30, 1234e30 -> 1.234e+33
+    size_t n = 0;
+    buf[n++] = digits[0];
+    if (len > 1) {
+        buf[n++] = '.';
+        memcpy(buf + n, digits + 1, (size_t) (len - 1));
+        n += (size_t) (len - 1);
+    }
+    return n + write_exponent(exp10 - 1, buf + n);
+}
+
+size_t clox_dtoa(double value, char* buf) {
+    if (value != value) {
+        memcpy(buf, "nan", 3);
+        return 3;
+    }
+
+    size_t len = 0;
+    if (signbit(value)) {
+        buf[len++] = '-';
+        value = -value;
+    }
+
+    if (value == 0.0) {
+        buf[len++] = '0';
+        return len;
+    }
+    if (value > DBL_MAX) {
+        memcpy(buf + len, "inf", 3);
+        return len + 3;
+    }
+
+    // integers are exactly representable up to 2^53, and their shortest form is just their digits
+    if (value <= 9007199254740992.0 && value == (double) (uint64_t) value) {
+        return len + write_integer((uint64_t) value, buf + len);
+    }
+
+    char digits[18];
+    int k = 0;
+    int digits_len;
+    if (!grisu3(value, digits, &digits_len, &k)) {
+        digits_len = shortest_exact(value, digits_len > 1 ? digits_len : 1, digits, &k);
+    }
+    return len + format(digits, digits_len, k, buf + len);
+}
+
+void clox_dtoa_fprint(FILE* file, double value) {
+    char buf[CLOX_DTOA_BUF_SIZE];
+    fwrite(buf, 1, clox_dtoa(value, buf), file);
+}
@@ -0,0 +1,36 @@
+#ifndef CLOX_DTOA_H
+#define CLOX_DTOA_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @brief Big enough for any number written by clox_dtoa (e.g. "-0.0000012345678901234567" or
+ * "-1.2345678901234567e-308")
+ */
+#define CLOX_DTOA_BUF_SIZE 32
+
+/**
+ * @brief Writes the shortest decimal representation of value that reads back as the very same double.
+ * 
+ * The digits are generated with Grisu3 (Florian Loitsch, "Printing Floating-Point Numbers Quickly and Accurately
+ * with Integers"), which only needs 64 bits integer arithmetic and detects the rare doubles (about 0.5%) whose
+ * digits it can't prove to be the shortest. Those take an exact, slower path through the C library instead.
+ * 
+ * Numbers are laid out like JavaScript does: integral values don't get a fractional part ("2", not "2.000000"),
+ * values from 1e-7 up to 1e21 use the fixed notation ("0.001", "123.5") and everything else the exponential one
+ * ("1e+21", "1.5e-7"). Special values are written as "nan", "inf" and "-inf". The output doesn't depend on the
+ * locale.
+ * 
+ * @param value
+ * @param buf where the number is written to, at least CLOX_DTOA_BUF_SIZE bytes long. It's not '\0' terminated
+ * @return size_t the number of bytes written
+ */
+size_t clox_dtoa(double value, char* buf);
+
+/**
+ * @brief Writes value to file, formatted by clox_dtoa.
+ */
+void clox_dtoa_fprint(FILE* file, double value);
+
+#endif
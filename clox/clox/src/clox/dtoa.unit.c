@@ -0,0 +1,134 @@
+// The checks call the code under test, so they must not be compiled out when NDEBUG is defined (e.g. release builds)
+#undef NDEBUG
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <assert.h>
+
+#include "dtoa.h"
+
+static void assert_formats(double value, const char* expected) {
+    char buf[CLOX_DTOA_BUF_SIZE + 1];
+    size_t len = clox_dtoa(value, buf);
+    buf[len] = '\0';
+    if (strcmp(buf, expected) != 0) {
+        fprintf(stderr, "dtoa.unit: %.17g formatted as '%s', expected '%s'\n", value, buf, expected);
+        abort();
+    }
+}
+
+static void assert_round_trips(double value) {
+    char buf[CLOX_DTOA_BUF_SIZE + 1];
+    size_t len = clox_dtoa(value, buf);
+    assert(len <= CLOX_DTOA_BUF_SIZE);
+    buf[len] = '\0';
+
+    double parsed = strtod(buf, NULL);
+    if (memcmp(&parsed, &value, sizeof(double)) != 0) {
+        fprintf(stderr, "dtoa.unit: %.17g formatted as '%s', which reads back as %.17g\n", value, buf, parsed);
+        abort();
+    }
+}
+
+/**
+ * @brief Checks that no correctly rounded decimal with fewer significant digits than the formatted one reads back
+ * as value
+ */
+static void assert_shortest(double value) {
+    char buf[CLOX_DTOA_BUF_SIZE + 1];
+    size_t len = clox_dtoa(value, buf);
+    buf[len] = '\0';
+
+    // significant digits, from the first non-zero one to the last one
+    int first = -1, last = -1;
+    for (size_t i = 0; i < len && buf[i] != 'e'; i++) {
+        if (buf[i] >= '1' && buf[i] <= '9') {
+            last = (int) i;
+            if (first < 0) {
+                first = (int) i;
+            }
+        }
+    }
+    if (first < 0) {
+        // zero
+        return;
+    }
+    int digits = 0;
+    for (int i = first; i <= last; i++) {
+        digits += (buf[i] >= '0' && buf[i] <= '9');
+    }
+
+    char shorter[CLOX_DTOA_BUF_SIZE];
+    for (int precision = 1; precision < digits; precision++) {
+        snprintf(shorter, sizeof(shorter), "%.*e", precision - 1, value);
+        if (strtod(shorter, NULL) == value) {
+            fprintf(stderr, "dtoa.unit: %.17g formatted as '%s', but '%s' is shorter\n", value, buf, shorter);
+            abort();
+        }
+    }
+}
+
+// xorshift64*, so the test is reproducible
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * UINT64_C(2685821657736338717);
+}
+
+int main() {
+    assert_formats(0.0, "0");
+    assert_formats(-0.0, "-0");
+    assert_formats(2.0, "2");
+    assert_formats(-17.0, "-17");
+    assert_formats(0.1, "0.1");
+    assert_formats(0.3, "0.3");
+    assert_formats(0.1 + 0.2, "0.30000000000000004");
+    assert_formats(1.5, "1.5");
+    assert_formats(123.456, "123.456");
+    assert_formats(1e-6, "0.000001");
+    assert_formats(1.5e-7, "1.5e-7");
+    assert_formats(9007199254740992.0, "9007199254740992");
+    assert_formats(1e20, "100000000000000000000");
+    assert_formats(1e21, "1e+21");
+    // plain Grisu2 isn't sure these are the closest digits, and writes 9.999999999999999e+22 and friends
+    assert_formats(1e23, "1e+23");
+    assert_formats(100000000000000000000000.0, "1e+23");
+    assert_formats(5e-310, "5e-310");
+    assert_formats(1.7976931348623155e308, "1.7976931348623155e+308");
+    assert_formats(2.2250738585072009e-308, "2.225073858507201e-308");
+    assert_formats(1.2345e100, "1.2345e+100");
+    assert_formats(DBL_MAX, "1.7976931348623157e+308");
+    assert_formats(DBL_MIN, "2.2250738585072014e-308");
+    assert_formats(5e-324, "5e-324");
+    assert_formats(INFINITY, "inf");
+    assert_formats(-INFINITY, "-inf");
+    assert_formats(NAN, "nan");
+
+    for (int i = -330; i <= 310; i++) {
+        assert_round_trips(pow(10, i));
+        assert_shortest(pow(10, i));
+    }
+    for (int i = 0; i < 100000; i++) {
+        assert_round_trips(i);
+        assert_round_trips(i / 100.0);
+    }
+
+    uint64_t state = UINT64_C(88172645463325252);
+    for (int i = 0; i < 1000000; i++) {
+        uint64_t bits = next_random(&state);
+        double value;
+        memcpy(&value, &bits, sizeof(double));
+        if (isfinite(value)) {
+            assert_round_trips(value);
+            if (i % 10 == 0) {
+                assert_shortest(value);
+            }
+        }
+    }
+
+    puts("dtoa.unit: ok");
+}
@@ -8,9 +8,19 @@ static clox_env_key hash_strview(const struct clox_env* env, struct strview sv)
     return stbds_hash_bytes(sv.ptr, sv.len, env->seed);
 }
 
+/**
+ * @brief Source of env versions. Being global, an env never reuses a version that some other env has used before
+ */
+static uint64_t versions = 0;
+
+static void env_bump_version(struct clox_env* env) {
+    env->version = ++versions;
+}
+
 void clox_env_init(struct clox_env* env) {
     env->table = NULL;
     env->seed = time(NULL);
+    env_bump_version(env);
 
     // Sets the default value for the hashmap, the value which
     // will be returned by hmget/shget if the key is not present.
@@ -24,14 +34,35 @@ void clox_env_free(struct clox_env* env) {
     hmfree(env->table);
     env->table = NULL;
     env->seed = 0;
+    env_bump_version(env);
+}
+
+struct clox_env_kv* clox_env_lookup(struct clox_env* env, struct strview var_name) {
+    return hmgetp_null(env->table, hash_strview(env, var_name));
+}
+
+void clox_env_kv_set(struct clox_env_kv* entry, struct clox_value var_value) {
+    clox_value_free(&entry->value);
+    entry->value = clox_value_promote(var_value);
 }
 
 void clox_env_define(struct clox_env* env, struct strview var_name, struct clox_value var_value) {
-    hmput(env->table, hash_strview(env, var_name), var_value);
+    clox_env_key key = hash_strview(env, var_name);
+
+    // Redefinitions replaces the old value, which is owned by the env
+    struct clox_env_kv* entry = hmgetp_null(env->table, key);
+    if (entry != NULL) {
+        clox_env_kv_set(entry, var_value);
+        return;
+    }
+
+    // New entries may grow the table, moving the existing ones around
+    hmput(env->table, key, clox_value_promote(var_value));
+    env_bump_version(env);
 }
 
 int clox_env_get(struct clox_env* env, struct strview var_name, struct clox_value* out_var_value) {
-    struct clox_env_kv* entry = hmgetp_null(env->table, hash_strview(env, var_name));
+    struct clox_env_kv* entry = clox_env_lookup(env, var_name);
     if (entry == NULL) {
         *out_var_value = clox_value_nil();
         return 1;
@@ -42,11 +73,11 @@ int clox_env_get(struct clox_env* env, struct strview var_name, struct clox_valu
 }
 
 int clox_env_assign(struct clox_env* env, struct strview var_name, struct clox_value var_value) {
-    struct clox_env_kv* entry = hmgetp_null(env->table, hash_strview(env, var_name));
+    struct clox_env_kv* entry = clox_env_lookup(env, var_name);
     if (entry == NULL) {
         return 1;
     }
 
-    clox_env_define(env, var_name, var_value);
+    clox_env_kv_set(entry, var_value);
     return 0;
 }
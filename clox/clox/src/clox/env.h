@@ -3,6 +3,7 @@
 #define CLOX_ENV_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "strview.h"
 #include "value.h"
@@ -24,12 +25,72 @@ struct clox_env {
      * @brief Random number
      */
     size_t seed;
+
+    /**
+     * @brief Stamp of the current table layout. It changes whenever entries may move or go away (e.g. the table grows),
+     * which invalidates every clox_env_cache filled before. Stamps are unique across all envs.
+     */
+    uint64_t version;
+};
+
+/**
+ * @brief A lookup cache for a single variable name, meant to be embedded in the AST nodes that refer to that variable.
+ * 
+ * A zeroed cache is empty.
+ */
+struct clox_env_cache {
+    struct clox_env_kv* entry;
+    uint64_t version;
 };
 
 void clox_env_init(struct clox_env* env);
 void clox_env_free(struct clox_env* env);
+
+/**
+ * @brief Looks up the entry of a variable.
+ * 
+ * @return struct clox_env_kv* the entry or NULL if the variable is undefined. It's valid until the env version changes
+ */
+struct clox_env_kv* clox_env_lookup(struct clox_env* env, struct strview var_name);
+
+/**
+ * @brief Gets the cached entry, if the cache was filled by this env and its layout hasn't changed since.
+ * 
+ * @return struct clox_env_kv* the cached entry or NULL if the cache is stale
+ */
+static inline struct clox_env_kv* clox_env_cache_get(const struct clox_env* env, const struct clox_env_cache* cache) {
+    return (cache->version == env->version) ? cache->entry : NULL;
+}
+
+static inline void clox_env_cache_fill(const struct clox_env* env, struct clox_env_cache* cache, struct clox_env_kv* entry) {
+    cache->entry = entry;
+    cache->version = env->version;
+}
+
+/**
+ * @brief Replaces the value of an entry. The env takes ownership of var_value.
+ * 
+ * Like every other way to store values in the env, values living in a region are promoted to the heap first.
+ */
+void clox_env_kv_set(struct clox_env_kv* entry, struct clox_value var_value);
+
+/**
+ * @brief Defines (or redefines) a variable. The env takes ownership of var_value.
+ */
 void clox_env_define(struct clox_env* env, struct strview var_name, struct clox_value var_value);
+
+/**
+ * @brief Gets a variable value. The out value is borrowed from the env, so it's valid only until the env is mutated.
+ * 
+ * @return int 0 on success. non-zero if the variable is undefined
+ */
 int clox_env_get(struct clox_env* env, struct strview var_name, struct clox_value* out_var_value);
+
+/**
+ * @brief Assigns a new value to an already defined variable. The env takes ownership of var_value on success.
+ * 
+ * @return int 0 on success. non-zero if the variable is undefined
+ */
 int clox_env_assign(struct clox_env* env, struct strview var_name, struct clox_value var_value);
 
 #endif
@@ -0,0 +1,51 @@
+// The checks call the code under test, so they must not be compiled out when NDEBUG is defined (e.g. release builds)
+#undef NDEBUG
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define STB_DS_IMPLEMENTATION
+#include <clox/stb_ds.h>
+
+#include "env.h"
+
+int main() {
+    struct clox_env env;
+    clox_env_init(&env);
+    clox_env_define(&env, strview_from_cstr("a", 1), clox_value_number(1));
+
+    // an empty cache never hits
+    struct clox_env_cache cache = {0};
+    assert(clox_env_cache_get(&env, &cache) == NULL);
+
+    struct clox_env_kv* entry = clox_env_lookup(&env, strview_from_cstr("a", 1));
+    assert(entry != NULL);
+    clox_env_cache_fill(&env, &cache, entry);
+    assert(clox_env_cache_get(&env, &cache) == entry);
+
+    // assignments and redefinitions don't move entries around
+    clox_env_assign(&env, strview_from_cstr("a", 1), clox_value_number(2));
+    clox_env_define(&env, strview_from_cstr("a", 1), clox_value_number(3));
+    assert(clox_env_cache_get(&env, &cache) == entry);
+    assert(clox_value_as_number(clox_env_cache_get(&env, &cache)->value) == 3);
+
+    // new variables may grow the table, so they invalidate the cache
+    char name[16];
+    for (int i = 0; i < 1000; i++) {
+        int len = snprintf(name, sizeof(name), "v%d", i);
+        clox_env_define(&env, strview_from_cstr(name, len), clox_value_number(i));
+        assert(clox_env_cache_get(&env, &cache) == NULL);
+    }
+    entry = clox_env_lookup(&env, strview_from_cstr("a", 1));
+    clox_env_cache_fill(&env, &cache, entry);
+    assert(clox_value_as_number(clox_env_cache_get(&env, &cache)->value) == 3);
+
+    // caches can't be reused across envs, even after the env memory is reused
+    clox_env_free(&env);
+    assert(clox_env_cache_get(&env, &cache) == NULL);
+    clox_env_init(&env);
+    assert(clox_env_cache_get(&env, &cache) == NULL);
+    clox_env_free(&env);
+
+    puts("env.unit: ok");
+}
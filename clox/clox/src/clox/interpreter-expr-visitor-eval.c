@@ -1,11 +1,13 @@
 #include "interpreter-expr-visitor-eval.h"
 
 #include <assert.h>
+#include <stdbool.h>
 
 #include "ast/expr.h"
 #include "ast/expr-visitor.h"
 #include "value.h"
 #include "interpreter.h"
+#include "stb_ds.h"
 
 static int eval_visit_expr_binary(struct clox_ast_expr* expr, void* userctx);
 static int eval_visit_expr_grouping(struct clox_ast_expr* expr, void* userctx);
@@ -13,6 +15,16 @@ static int eval_visit_expr_literal(struct clox_ast_expr* expr, void* userctx);
 static int eval_visit_expr_unary(struct clox_ast_expr* expr, void* userctx);
 static int eval_visit_expr_var(struct clox_ast_expr* expr, void* userctx);
 static int eval_visit_expr_assign(struct clox_ast_expr* expr, void* userctx);
+static int eval_visit_expr_concat(struct clox_ast_expr* expr, void* userctx);
+
+static int eval_binary_generic(struct clox_interpreter* interpreter, struct clox_ast_expr_binary* expr_bin,
+                               struct clox_value* left, struct clox_value* right);
+static bool eval_binary_specialized(struct clox_interpreter* interpreter, struct clox_ast_expr_binary* expr_bin,
+                                    struct clox_value* left, struct clox_value* right);
+static void binary_try_specialize(struct clox_interpreter* interpreter, struct clox_ast_expr_binary* expr_bin,
+                                  const struct clox_value* left, const struct clox_value* right);
+static void binary_despecialize(struct clox_interpreter* interpreter, struct clox_ast_expr_binary* expr_bin);
+static struct clox_env_kv* env_lookup_cached(struct clox_interpreter* interpreter, struct strview var_name, struct clox_env_cache* cache);
 
 const struct clox_ast_expr_visitor* clox_interpreter_expr_visitor_eval(void) {
     static const struct clox_ast_expr_visitor vtable = {
@@ -22,6 +34,7 @@ const struct clox_ast_expr_visitor* clox_interpreter_expr_visitor_eval(void) {
         .visit_unary = eval_visit_expr_unary,
         .visit_var = eval_visit_expr_var,
         .visit_assign = eval_visit_expr_assign,
+        .visit_concat = eval_visit_expr_concat,
     };
     return &vtable;
 }
@@ -29,164 +42,228 @@ const struct clox_ast_expr_visitor* clox_interpreter_expr_visitor_eval(void) {
 static int eval_visit_expr_binary(struct clox_ast_expr* expr, void* userctx) {
     struct clox_interpreter* interpreter = userctx;
     struct clox_ast_expr_binary* expr_bin = &expr->value.binary;
-    int rc = 0;
     
-    // NOTE this is a borrowed value
-    struct clox_interpreter_eval_result left_result = clox_interpreter_eval(interpreter, expr_bin->left);
-    if (left_result.outcome != CLOX_INTERPRETER_EVAL_RESULT_OK) {
-        fprintf(stderr, "error: line %zu: failed to evaluate left-hand-size of binary operator '", expr_bin->operator.line);
-        strview_fprint(expr_bin->operator.lexeme, stderr);
-        fputs("'\n", stderr);
-        return left_result.as.err_code;
-    }
-    struct clox_value left = left_result.as.value;
-    if (left.kind == CLOX_VALUE_KIND_STRING) {
-        left.as.string = str_dup(left.as.string);
-    }
+    // The operands were evaluated by the interpreter in order, so they are popped in reverse
+    struct clox_interpreter_eval_result right_result = clox_interpreter_pop_operand(interpreter);
+    struct clox_interpreter_eval_result left_result = clox_interpreter_pop_operand(interpreter);
 
-    // NOTE this is a borrowed value
-    struct clox_interpreter_eval_result right_result = clox_interpreter_eval(interpreter, expr_bin->right);
-    if (right_result.outcome != CLOX_INTERPRETER_EVAL_RESULT_OK) {
-        fprintf(stderr, "error: line %zu: failed to evaluate right-hand-size of binary operator '", expr_bin->operator.line);
-        strview_fprint(expr_bin->operator.lexeme, stderr);
-        fputs("'\n", stderr);
-        rc = right_result.as.err_code;
-        goto err_free_left;
-    }
-    struct clox_value right = right_result.as.value;
-    if (right.kind == CLOX_VALUE_KIND_STRING) {
-        right.as.string = str_dup(right.as.string);
+    int rc = 0;
+    struct clox_value* left = &left_result.as.value;
+    struct clox_value* right = &right_result.as.value;
+
+    if (expr_bin->spec == CLOX_AST_EXPR_BINARY_SPEC_GENERIC || !eval_binary_specialized(interpreter, expr_bin, left, right)) {
+        if (expr_bin->spec != CLOX_AST_EXPR_BINARY_SPEC_GENERIC) {
+            binary_despecialize(interpreter, expr_bin);
+        }
+        rc = eval_binary_generic(interpreter, expr_bin, left, right);
+        if (rc == 0) {
+            binary_try_specialize(interpreter, expr_bin, left, right);
+        }
     }
-    
-    switch(expr_bin->operator.kind) {
-    case TOKEN_KIND_PLUS:
-        if (left.kind == CLOX_VALUE_KIND_NUMBER && right.kind == CLOX_VALUE_KIND_NUMBER) {
-            struct clox_value val = clox_value_number(left.as.number + right.as.number);
-            clox_interpreter_set_value(interpreter, val);
-        } else if (left.kind == CLOX_VALUE_KIND_STRING && right.kind == CLOX_VALUE_KIND_STRING) {
-            // this allocates a new string (we own this str)
-            struct str concatenation = str_concat(left.as.string, right.as.string);
 
-            // its str is a borrow from the above concatenation
-            struct clox_value val = clox_value_string_str_borrow(concatenation);
+    clox_interpreter_eval_result_release(&right_result);
+    clox_interpreter_eval_result_release(&left_result);
+    return rc;
+}
 
-            clox_interpreter_set_value(interpreter, val);
+static int eval_binary_generic(struct clox_interpreter* interpreter, struct clox_ast_expr_binary* expr_bin,
+                               struct clox_value* left, struct clox_value* right)
+{
+    switch(expr_bin->operator.kind) {
+    case TOKEN_KIND_PLUS:
+        if (clox_value_is_number(*left) && clox_value_is_number(*right)) {
+            clox_interpreter_set_value(interpreter, clox_value_number_add(*left, *right));
+        } else if (clox_value_is_string(*left) && clox_value_is_string(*right)) {
+            // the new string is moved into the interpreter
+            clox_interpreter_set_value(interpreter, clox_value_string_concat(clox_interpreter_temp_region(interpreter), left, right));
         } else {
+            clox_interpreter_flush(interpreter);
             fprintf(stderr, "error: line %zu: binary operator '+' is only valid if both operands are numbers or strings. left operand is %s and right operand is %s\n",
-                expr_bin->operator.line, clox_value_kind_to_cstr(left.kind), clox_value_kind_to_cstr(right.kind));
-            rc = 1;
-            goto err_free_right_and_left;
+                expr_bin->operator.line, clox_value_kind_to_cstr(clox_value_get_kind(*left)), clox_value_kind_to_cstr(clox_value_get_kind(*right)));
+            return 1;
         }
         break;
 
     case TOKEN_KIND_MINUS:
-        if (left.kind != CLOX_VALUE_KIND_NUMBER || right.kind != CLOX_VALUE_KIND_NUMBER) {
+        if (!clox_value_is_number(*left) || !clox_value_is_number(*right)) {
+            clox_interpreter_flush(interpreter);
             fprintf(stderr, "error: line %zu: binary operator '' requires both operands to be numbers. got left as %s and right as %s\n",
-                expr_bin->operator.line, clox_value_kind_to_cstr(left.kind), clox_value_kind_to_cstr(right.kind));
-            rc = 1;
-            goto err_free_right_and_left;
+                expr_bin->operator.line, clox_value_kind_to_cstr(clox_value_get_kind(*left)), clox_value_kind_to_cstr(clox_value_get_kind(*right)));
+            return 1;
         }
-        clox_interpreter_set_value(interpreter, clox_value_number(left.as.number - right.as.number));
+        clox_interpreter_set_value(interpreter, clox_value_number_sub(*left, *right));
         break;
 
     case TOKEN_KIND_STAR:
-        if (left.kind != CLOX_VALUE_KIND_NUMBER || right.kind != CLOX_VALUE_KIND_NUMBER) {
+        if (!clox_value_is_number(*left) || !clox_value_is_number(*right)) {
+            clox_interpreter_flush(interpreter);
             fprintf(stderr, "error: line %zu: binary operator '' requires both operands to be numbers. got left as %s and right as %s\n",
-                expr_bin->operator.line, clox_value_kind_to_cstr(left.kind), clox_value_kind_to_cstr(right.kind));
-            rc = 1;
-            goto err_free_right_and_left;
+                expr_bin->operator.line, clox_value_kind_to_cstr(clox_value_get_kind(*left)), clox_value_kind_to_cstr(clox_value_get_kind(*right)));
+            return 1;
         }
-        clox_interpreter_set_value(interpreter, clox_value_number(left.as.number * right.as.number));
+        clox_interpreter_set_value(interpreter, clox_value_number_mul(*left, *right));
         break;
 
     case TOKEN_KIND_SLASH:
-        if (left.kind != CLOX_VALUE_KIND_NUMBER || right.kind != CLOX_VALUE_KIND_NUMBER) {
+        if (!clox_value_is_number(*left) || !clox_value_is_number(*right)) {
+            clox_interpreter_flush(interpreter);
             fprintf(stderr, "error: line %zu: binary operator '' requires both operands to be numbers. got left as %s and right as %s\n",
-                expr_bin->operator.line, clox_value_kind_to_cstr(left.kind), clox_value_kind_to_cstr(right.kind));
-            rc = 1;
-            goto err_free_right_and_left;
+                expr_bin->operator.line, clox_value_kind_to_cstr(clox_value_get_kind(*left)), clox_value_kind_to_cstr(clox_value_get_kind(*right)));
+            return 1;
         }
-        clox_interpreter_set_value(interpreter, clox_value_number(left.as.number / right.as.number));
+        clox_interpreter_set_value(interpreter, clox_value_number_div(*left, *right));
         break;
 
     case TOKEN_KIND_GREATER:
-        if (left.kind != CLOX_VALUE_KIND_NUMBER || right.kind != CLOX_VALUE_KIND_NUMBER) {
+        if (!clox_value_is_number(*left) || !clox_value_is_number(*right)) {
+            clox_interpreter_flush(interpreter);
             fprintf(stderr, "error: line %zu: binary operator '' requires both operands to be numbers. got left as %s and right as %s\n",
-                expr_bin->operator.line, clox_value_kind_to_cstr(left.kind), clox_value_kind_to_cstr(right.kind));
-            rc = 1;
-            goto err_free_right_and_left;
+                expr_bin->operator.line, clox_value_kind_to_cstr(clox_value_get_kind(*left)), clox_value_kind_to_cstr(clox_value_get_kind(*right)));
+            return 1;
         }
-        clox_interpreter_set_value(interpreter, clox_value_bool(left.as.number > right.as.number));
+        clox_interpreter_set_value(interpreter, clox_value_bool(clox_value_number_less(*right, *left)));
         break;
 
     case TOKEN_KIND_GREATER_EQUAL:
-        if (left.kind != CLOX_VALUE_KIND_NUMBER || right.kind != CLOX_VALUE_KIND_NUMBER) {
+        if (!clox_value_is_number(*left) || !clox_value_is_number(*right)) {
+            clox_interpreter_flush(interpreter);
             fprintf(stderr, "error: line %zu: binary operator '' requires both operands to be numbers. got left as %s and right as %s\n",
-                expr_bin->operator.line, clox_value_kind_to_cstr(left.kind), clox_value_kind_to_cstr(right.kind));
-            rc = 1;
-            goto err_free_right_and_left;
+                expr_bin->operator.line, clox_value_kind_to_cstr(clox_value_get_kind(*left)), clox_value_kind_to_cstr(clox_value_get_kind(*right)));
+            return 1;
         }
-        clox_interpreter_set_value(interpreter, clox_value_bool(left.as.number >= right.as.number));
+        clox_interpreter_set_value(interpreter, clox_value_bool(clox_value_number_less_equal(*right, *left)));
         break;
 
     case TOKEN_KIND_LESS:
-        if (left.kind != CLOX_VALUE_KIND_NUMBER || right.kind != CLOX_VALUE_KIND_NUMBER) {
+        if (!clox_value_is_number(*left) || !clox_value_is_number(*right)) {
+            clox_interpreter_flush(interpreter);
             fprintf(stderr, "error: line %zu: binary operator '' requires both operands to be numbers. got left as %s and right as %s\n",
-                expr_bin->operator.line, clox_value_kind_to_cstr(left.kind), clox_value_kind_to_cstr(right.kind));
-            rc = 1;
-            goto err_free_right_and_left;
+                expr_bin->operator.line, clox_value_kind_to_cstr(clox_value_get_kind(*left)), clox_value_kind_to_cstr(clox_value_get_kind(*right)));
+            return 1;
         }
-        clox_interpreter_set_value(interpreter, clox_value_bool(left.as.number < right.as.number));
+        clox_interpreter_set_value(interpreter, clox_value_bool(clox_value_number_less(*left, *right)));
         break;
 
     case TOKEN_KIND_LESS_EQUAL:
-        if (left.kind != CLOX_VALUE_KIND_NUMBER || right.kind != CLOX_VALUE_KIND_NUMBER) {
+        if (!clox_value_is_number(*left) || !clox_value_is_number(*right)) {
+            clox_interpreter_flush(interpreter);
             fprintf(stderr, "error: line %zu: binary operator '' requires both operands to be numbers. got left as %s and right as %s\n",
-                expr_bin->operator.line, clox_value_kind_to_cstr(left.kind), clox_value_kind_to_cstr(right.kind));
-            rc = 1;
-            goto err_free_right_and_left;
+                expr_bin->operator.line, clox_value_kind_to_cstr(clox_value_get_kind(*left)), clox_value_kind_to_cstr(clox_value_get_kind(*right)));
+            return 1;
         }
-        clox_interpreter_set_value(interpreter, clox_value_bool(left.as.number <= right.as.number));
+        clox_interpreter_set_value(interpreter, clox_value_bool(clox_value_number_less_equal(*left, *right)));
         break;
 
     case TOKEN_KIND_BANG_EQUAL:
-        clox_interpreter_set_value(interpreter, clox_value_bool(!clox_value_is_equal(left, right)));
+        clox_interpreter_set_value(interpreter, clox_value_bool(!clox_value_is_equal(*left, *right)));
         break;
 
     case TOKEN_KIND_EQUAL_EQUAL:
-        clox_interpreter_set_value(interpreter, clox_value_bool(clox_value_is_equal(left, right)));
+        clox_interpreter_set_value(interpreter, clox_value_bool(clox_value_is_equal(*left, *right)));
         break;
 
     default:
+        clox_interpreter_flush(interpreter);
         fprintf(stderr, "error: line %zu: unknown binary operator: ", expr_bin->operator.line);
         token_fprint(stderr, &expr_bin->operator);
         fputs("\n", stderr);
-        rc = 1;
-        goto err_free_right_and_left;
+        return 1;
     }
 
-    clox_value_free(&right);
-    clox_value_free(&left);
     return 0;
+}
 
-err_free_right_and_left:
-    clox_value_free(&right);
-err_free_left:
-    clox_value_free(&left);
-    interpreter->value = clox_value_nil();
-    return rc;
+static bool eval_binary_specialized(struct clox_interpreter* interpreter, struct clox_ast_expr_binary* expr_bin,
+                                    struct clox_value* left, struct clox_value* right)
+{
+    if (expr_bin->spec == CLOX_AST_EXPR_BINARY_SPEC_STRING_CONCAT) {
+        if (!clox_value_is_string(*left) || !clox_value_is_string(*right)) {
+            return false;
+        }
+        clox_interpreter_set_value(interpreter, clox_value_string_concat(clox_interpreter_temp_region(interpreter), left, right));
+        return true;
+    }
+
+    // Every other specialization works on numbers
+    if (!clox_value_is_number(*left) || !clox_value_is_number(*right)) {
+        return false;
+    }
+    // Integers and doubles are both numbers, so the integer fast paths are taken inside the operations themselves
+    struct clox_value a = *left;
+    struct clox_value b = *right;
+
+    switch (expr_bin->spec) {
+    case CLOX_AST_EXPR_BINARY_SPEC_NUMBER_ADD:           clox_interpreter_set_value(interpreter, clox_value_number_add(a, b));                   break;
+    case CLOX_AST_EXPR_BINARY_SPEC_NUMBER_SUB:           clox_interpreter_set_value(interpreter, clox_value_number_sub(a, b));                   break;
+    case CLOX_AST_EXPR_BINARY_SPEC_NUMBER_MUL:           clox_interpreter_set_value(interpreter, clox_value_number_mul(a, b));                   break;
+    case CLOX_AST_EXPR_BINARY_SPEC_NUMBER_DIV:           clox_interpreter_set_value(interpreter, clox_value_number_div(a, b));                   break;
+    case CLOX_AST_EXPR_BINARY_SPEC_NUMBER_GREATER:       clox_interpreter_set_value(interpreter, clox_value_bool(clox_value_number_less(b, a)));       break;
+    case CLOX_AST_EXPR_BINARY_SPEC_NUMBER_GREATER_EQUAL: clox_interpreter_set_value(interpreter, clox_value_bool(clox_value_number_less_equal(b, a))); break;
+    case CLOX_AST_EXPR_BINARY_SPEC_NUMBER_LESS:          clox_interpreter_set_value(interpreter, clox_value_bool(clox_value_number_less(a, b)));       break;
+    case CLOX_AST_EXPR_BINARY_SPEC_NUMBER_LESS_EQUAL:    clox_interpreter_set_value(interpreter, clox_value_bool(clox_value_number_less_equal(a, b))); break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Picks the specialization matching an operator applied to the given operands.
+ */
+static enum clox_ast_expr_binary_spec binary_spec_for(enum token_kind operator, struct clox_value left, struct clox_value right) {
+    if (clox_value_is_string(left) && clox_value_is_string(right)) {
+        return (operator == TOKEN_KIND_PLUS) ? CLOX_AST_EXPR_BINARY_SPEC_STRING_CONCAT : CLOX_AST_EXPR_BINARY_SPEC_GENERIC;
+    }
+    if (!clox_value_is_number(left) || !clox_value_is_number(right)) {
+        return CLOX_AST_EXPR_BINARY_SPEC_GENERIC;
+    }
+
+    switch (operator) {
+    case TOKEN_KIND_PLUS:          return CLOX_AST_EXPR_BINARY_SPEC_NUMBER_ADD;
+    case TOKEN_KIND_MINUS:         return CLOX_AST_EXPR_BINARY_SPEC_NUMBER_SUB;
+    case TOKEN_KIND_STAR:          return CLOX_AST_EXPR_BINARY_SPEC_NUMBER_MUL;
+    case TOKEN_KIND_SLASH:         return CLOX_AST_EXPR_BINARY_SPEC_NUMBER_DIV;
+    case TOKEN_KIND_GREATER:       return CLOX_AST_EXPR_BINARY_SPEC_NUMBER_GREATER;
+    case TOKEN_KIND_GREATER_EQUAL: return CLOX_AST_EXPR_BINARY_SPEC_NUMBER_GREATER_EQUAL;
+    case TOKEN_KIND_LESS:          return CLOX_AST_EXPR_BINARY_SPEC_NUMBER_LESS;
+    case TOKEN_KIND_LESS_EQUAL:    return CLOX_AST_EXPR_BINARY_SPEC_NUMBER_LESS_EQUAL;
+    default:
+        // equality works on any kind, so there is nothing to gain from specializing it
+        return CLOX_AST_EXPR_BINARY_SPEC_GENERIC;
+    }
+}
+
+static void binary_try_specialize(struct clox_interpreter* interpreter, struct clox_ast_expr_binary* expr_bin,
+                                  const struct clox_value* left, const struct clox_value* right)
+{
+    if (expr_bin->despecializations >= CLOX_INTERPRETER_DESPECIALIZATION_LIMIT) {
+        return;
+    }
+    enum clox_ast_expr_binary_spec spec = binary_spec_for(expr_bin->operator.kind, *left, *right);
+    if (spec != CLOX_AST_EXPR_BINARY_SPEC_GENERIC) {
+        expr_bin->spec = spec;
+        interpreter->stats.specialized++;
+    }
+}
+
+static void binary_despecialize(struct clox_interpreter* interpreter, struct clox_ast_expr_binary* expr_bin) {
+    expr_bin->spec = CLOX_AST_EXPR_BINARY_SPEC_GENERIC;
+    expr_bin->despecializations++;
+    interpreter->stats.despecialized++;
 }
 
 static int eval_visit_expr_grouping(struct clox_ast_expr* expr, void* userctx) {
+    (void) expr;
     struct clox_interpreter* interpreter = userctx;
 
-    // struct clox_value val = clox_interpreter_eval(interpreter, expr->value.grouping.expr);
-    struct clox_interpreter_eval_result res = clox_interpreter_eval(interpreter, expr->value.grouping.expr);
-    if (res.outcome != CLOX_INTERPRETER_EVAL_RESULT_OK) {
-        return res.as.err_code;
+    struct clox_interpreter_eval_result res = clox_interpreter_pop_operand(interpreter);
+
+    // Groupings are transparent, so the value ownership is kept as is
+    if (res.borrowed) {
+        clox_interpreter_set_value_borrowed(interpreter, res.as.value);
+    } else {
+        clox_interpreter_set_value(interpreter, res.as.value);
     }
-    
-    clox_interpreter_set_value(interpreter, res.as.value);
 
     return 0;
 }
@@ -197,12 +274,13 @@ static int eval_visit_expr_literal(struct clox_ast_expr* expr, void* userctx) {
 
     switch (expr_lit->kind) {
     case CLOX_AST_EXPR_LITERAL_KIND_NUMBER:
-        clox_interpreter_set_value(interpreter, clox_value_number(expr_lit->value.number.val));
+        // integral literals (the vast majority) start out as integers
+        clox_interpreter_set_value(interpreter, clox_value_number_compact(expr_lit->value.number.val));
         break;
 
     case CLOX_AST_EXPR_LITERAL_KIND_STRING:
-        //NOTE this allocates a new string
-        clox_interpreter_set_value(interpreter, clox_value_string_str_dup(expr_lit->value.string.val));
+        // The AST outlives the evaluation, so it's safe to borrow the literal string. It's shared only if stored.
+        clox_interpreter_set_value_borrowed(interpreter, clox_value_string(expr_lit->value.string.val));
         break;
 
     case CLOX_AST_EXPR_LITERAL_KIND_BOOL:
@@ -221,15 +299,7 @@ static int eval_visit_expr_unary(struct clox_ast_expr* expr, void* userctx) {
     struct clox_interpreter* interpreter = userctx;
     struct clox_ast_expr_unary* expr_un = &expr->value.unary;
 
-    // NOTE this value is borrowed. If we need further recursive evaluation with the interpreter we need to dup this.
-    // struct clox_value right = clox_interpreter_eval(interpreter, expr_un->right);
-    struct clox_interpreter_eval_result right_result = clox_interpreter_eval(interpreter, expr_un->right);
-    if (right_result.outcome != CLOX_INTERPRETER_EVAL_RESULT_OK) {
-        fprintf(stderr, "error: line %zu: failed to evaluate right-hand-size of unary operator '", expr_un->operator.line);
-        strview_fprint(expr_un->operator.lexeme, stderr);
-        fputs("'\n", stderr);
-        return right_result.as.err_code;
-    }
+    struct clox_interpreter_eval_result right_result = clox_interpreter_pop_operand(interpreter);
     struct clox_value right = right_result.as.value;
 
     switch (expr_un->operator.kind) {
@@ -238,21 +308,26 @@ static int eval_visit_expr_unary(struct clox_ast_expr* expr, void* userctx) {
         break;
 
     case TOKEN_KIND_MINUS:
-        if (right.kind != CLOX_VALUE_KIND_NUMBER) {
+        if (!clox_value_is_number(right)) {
+            clox_interpreter_flush(interpreter);
             fprintf(stderr,"error: line %zu: minus unary operator (a.k.a. '-') can only be applied to numbers. got %s\n",
-                expr_un->operator.line, clox_value_kind_to_cstr(right.kind));
+                expr_un->operator.line, clox_value_kind_to_cstr(clox_value_get_kind(right)));
+            clox_interpreter_eval_result_release(&right_result);
             return 1;
         }
-        clox_interpreter_set_value(interpreter, clox_value_number(-right.as.number));
+        clox_interpreter_set_value(interpreter, clox_value_number_negate(right));
         break;
 
     default:
+        clox_interpreter_flush(interpreter);
         fprintf(stderr, "error: line %zu: unknown unary operator: ", expr_un->operator.line);
         token_fprint(stderr, &expr_un->operator);
         fputs("\n", stderr);
+        clox_interpreter_eval_result_release(&right_result);
         return 1;
     }
 
+    clox_interpreter_eval_result_release(&right_result);
     return 0;
 }
 
@@ -260,17 +335,25 @@ static int eval_visit_expr_var(struct clox_ast_expr* expr, void* userctx) {
     struct clox_interpreter* interpreter = userctx;
     struct clox_ast_expr_var* expr_var = &expr->value.var;
 
+    if (expr_var->slot != CLOX_AST_SLOT_GLOBAL) {
+        // NOTE the value is still owned by the locals stack
+        clox_interpreter_set_value_borrowed(interpreter, interpreter->locals[expr_var->slot]);
+        return 0;
+    }
+
     struct strview var_name = expr_var->name.lexeme;
-    struct clox_value var_value;
 
-    if (clox_env_get(&interpreter->env, var_name, &var_value) != 0) {
+    struct clox_env_kv* entry = env_lookup_cached(interpreter, var_name, &expr_var->cache);
+    if (entry == NULL) {
+        clox_interpreter_flush(interpreter);
         fputs("error: runtime error: undefined variable '", stderr);
         strview_fprint(var_name, stderr);
         fputs("'\n", stderr);
         return 1;
     }
 
-    clox_interpreter_set_value(interpreter, clox_value_dup(var_value));
+    // NOTE the value is still owned by the environment. It's duplicated only if it ends up being stored
+    clox_interpreter_set_value_borrowed(interpreter, entry->value);
 
     return 0;
 }
@@ -283,27 +366,104 @@ static int eval_visit_expr_assign(struct clox_ast_expr* expr, void* userctx) {
     // This should be ok: newPoint(x + 2, 0).y = 3;
     // and this should not: a + b = c;
 
-    // Evaluate the assignment value
-    struct clox_interpreter_eval_result value_res = clox_interpreter_eval(interpreter, expr_assign->value);
-    if (value_res.outcome != CLOX_INTERPRETER_EVAL_RESULT_OK) {
-        fprintf(stderr, "error: line %zu: failed to evaluate assignment expression\n", expr_assign->name.line);
-        return value_res.as.err_code;
+    // The assignment value was already evaluated by the interpreter
+    struct clox_interpreter_eval_result value_res = clox_interpreter_pop_operand(interpreter);
+    struct clox_value var_value = clox_interpreter_eval_result_take(&value_res);
+
+    if (expr_assign->slot != CLOX_AST_SLOT_GLOBAL) {
+        struct clox_value* local = &interpreter->locals[expr_assign->slot];
+        clox_value_free(local);
+        *local = clox_value_promote(var_value);
+        clox_interpreter_set_value_borrowed(interpreter, *local);
+        return 0;
     }
-    struct clox_value var_value = clox_value_dup(value_res.as.value);
 
     // Get assignment target variable name from the environment
     struct strview var_name = expr_assign->name.lexeme;
 
-    if (clox_env_assign(&interpreter->env, var_name, var_value) != 0) {
+    // NOTE the lookup must come after evaluating the value, which may define variables and invalidate entries
+    struct clox_env_kv* entry = env_lookup_cached(interpreter, var_name, &expr_assign->cache);
+    if (entry == NULL) {
+        clox_interpreter_flush(interpreter);
         fputs("error: runtime error: undefined variable '", stderr);
         strview_fprint(var_name, stderr);
         fputs("'\n", stderr);
         clox_value_free(&var_value);
         return 1;
     }
+    clox_env_kv_set(entry, var_value);
 
-    //TODO parei aqui. implementar parser e testar se esse método está gerenciando memoria corretamente
-    clox_interpreter_set_value(interpreter, var_value);
+    // The assignment evaluates to the assigned value, which is now owned by the environment (and maybe promoted)
+    clox_interpreter_set_value_borrowed(interpreter, entry->value);
 
     return 0;
 }
+
+/**
+ * @brief The operands joined so far all have the type of the first one, since any other combination fails. So the
+ * operand can only be joined if both it and the first operand are strings, or both are numbers.
+ */
+int clox_interpreter_eval_concat_check(struct clox_interpreter* interpreter, const struct clox_ast_expr_concat* concat, size_t index) {
+    assert(index > 0 && (size_t) arrlen(interpreter->operands) > index);
+
+    struct clox_value first = interpreter->operands[arrlen(interpreter->operands) - 1 - index].as.value;
+    struct clox_value operand = arrlast(interpreter->operands).as.value;
+
+    if ((clox_value_is_string(first) && clox_value_is_string(operand))
+        || (clox_value_is_number(first) && clox_value_is_number(operand)))
+    {
+        return 0;
+    }
+    clox_interpreter_flush(interpreter);
+    fprintf(stderr, "error: line %zu: binary operator '+' is only valid if both operands are numbers or strings. left operand is %s and right operand is %s\n",
+        concat->operators[index - 1].line, clox_value_kind_to_cstr(clox_value_get_kind(first)), clox_value_kind_to_cstr(clox_value_get_kind(operand)));
+    return 1;
+}
+
+static int eval_visit_expr_concat(struct clox_ast_expr* expr, void* userctx) {
+    struct clox_interpreter* interpreter = userctx;
+    struct clox_ast_expr_concat* expr_concat = &expr->value.concat;
+    const long count = arrlen(expr_concat->operands);
+
+    // the other operands were already checked by the interpreter, before evaluating the ones after them
+    if (clox_interpreter_eval_concat_check(interpreter, expr_concat, count - 1) != 0) {
+        return 1;
+    }
+
+    // The optimizer only flattens chains with a string literal in them, and every operand has the type of the first
+    // one: they are all strings
+    struct clox_interpreter_eval_result* operands = &interpreter->operands[arrlen(interpreter->operands) - count];
+    assert(clox_value_is_string(operands[0].as.value));
+    if (interpreter->concat_parts != NULL) {
+        stbds_header(interpreter->concat_parts)->length = 0;
+    }
+    for (long i = 0; i < count; i++) {
+        arrput(interpreter->concat_parts, clox_value_as_strview(&operands[i].as.value));
+    }
+    clox_interpreter_set_value(interpreter, clox_value_string_concat_n(clox_interpreter_temp_region(interpreter),
+        interpreter->concat_parts, count));
+
+    for (long i = 0; i < count; i++) {
+        struct clox_interpreter_eval_result operand = clox_interpreter_pop_operand(interpreter);
+        clox_interpreter_eval_result_release(&operand);
+    }
+    return 0;
+}
+
+/**
+ * @brief Looks up a variable through the inline cache of its AST node, refilling the cache on misses.
+ */
+static struct clox_env_kv* env_lookup_cached(struct clox_interpreter* interpreter, struct strview var_name, struct clox_env_cache* cache) {
+    struct clox_env_kv* entry = clox_env_cache_get(&interpreter->env, cache);
+    if (entry != NULL) {
+        interpreter->stats.cache_hits++;
+        return entry;
+    }
+
+    interpreter->stats.cache_misses++;
+    entry = clox_env_lookup(&interpreter->env, var_name);
+    if (entry != NULL) {
+        clox_env_cache_fill(&interpreter->env, cache, entry);
+    }
+    return entry;
+}
@@ -1,8 +1,28 @@
 #ifndef CLOX_INTERPRETER_EXPR_VISITOR_EVAL_H
 #define CLOX_INTERPRETER_EXPR_VISITOR_EVAL_H
 
+#include <stddef.h>
+
 struct clox_ast_expr_visitor;
+struct clox_ast_expr_concat;
+struct clox_interpreter;
 
+/**
+ * @brief Evaluates a single expression node. It doesn't recurse: the values of its subexpressions must be already on
+ * the interpreter operands stack (see clox_interpreter_eval).
+ */
 const struct clox_ast_expr_visitor* clox_interpreter_expr_visitor_eval(void);
 
+/**
+ * @brief Type checks the operand of a concat node which was just evaluated, reporting the same error the binary
+ * node joining it would.
+ * 
+ * @param interpreter 
+ * @param concat 
+ * @param index the operand index, greater than 0. The operand is on the top of the operands stack, right above the
+ * ones before it
+ * @return int 0 if the operand can be joined to the ones before it
+ */
+int clox_interpreter_eval_concat_check(struct clox_interpreter* interpreter, const struct clox_ast_expr_concat* concat, size_t index);
+
 #endif
@@ -0,0 +1,59 @@
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+// POSIX
+#include <unistd.h>
+
+#define STB_DS_IMPLEMENTATION
+#include <clox/stb_ds.h>
+
+#include "scanner.h"
+#include "parser.h"
+#include "ast/program.h"
+#include "interpreter.h"
+
+int main() {
+    const char src[] = "print 1; print -\"x\";";
+    struct scanner scanner = {0};
+    scanner_scan_all_from_cstr(&scanner, src, strlen(src));
+    struct parser parser;
+    parser_init(&parser, scanner.tokens);
+    struct clox_ast_program* prog = parser_parse(&parser);
+    assert(prog != NULL);
+
+    // Both the output and the error messages go to the same pipe, as with 2>&1. They're small enough to fit in it
+    int fds[2];
+    assert(pipe(fds) == 0);
+    const int saved_stderr = dup(STDERR_FILENO);
+    assert(saved_stderr >= 0 && dup2(fds[1], STDERR_FILENO) >= 0);
+
+    struct clox_interpreter interpreter;
+    clox_interpreter_init(&interpreter);
+    clox_output_free(&interpreter.output);
+    clox_output_init(&interpreter.output, fds[1], CLOX_OUTPUT_DEFAULT_CAP);
+    assert(clox_interpreter_exec_program(&interpreter, prog) != 0);
+    clox_interpreter_free(&interpreter);
+
+    assert(dup2(saved_stderr, STDERR_FILENO) >= 0);
+    close(saved_stderr);
+    close(fds[1]);
+
+    // what was printed before the error shows up before its message
+    char contents[1024];
+    size_t len = 0;
+    ssize_t n;
+    while ((n = read(fds[0], contents + len, sizeof(contents) - 1 - len)) > 0) {
+        len += (size_t) n;
+    }
+    contents[len] = '\0';
+    close(fds[0]);
+    const char expected[] = "1\nerror: line 1: minus unary operator";
+    assert(strncmp(contents, expected, strlen(expected)) == 0);
+
+    clox_ast_program_free(prog);
+    scanner_free(&scanner);
+
+    puts("interpreter-output.unit: ok");
+}
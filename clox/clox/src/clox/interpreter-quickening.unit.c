@@ -0,0 +1,83 @@
+// The checks call the code under test, so they must not be compiled out when NDEBUG is defined (e.g. release builds)
+#undef NDEBUG
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define STB_DS_IMPLEMENTATION
+#include <clox/stb_ds.h>
+
+#include "scanner.h"
+#include "parser.h"
+#include "ast/expr.h"
+#include "interpreter.h"
+
+static struct clox_value eval_owned(struct clox_interpreter* interpreter, struct clox_ast_expr* expr) {
+    struct clox_interpreter_eval_result res = clox_interpreter_eval(interpreter, expr);
+    assert(res.outcome == CLOX_INTERPRETER_EVAL_RESULT_OK);
+    return clox_interpreter_eval_result_take(&res);
+}
+
+int main() {
+    const char src[] = "a + b";
+    struct scanner scanner = {0};
+    scanner_scan_all_from_cstr(&scanner, src, strlen(src));
+
+    struct parser parser;
+    parser_init(&parser, scanner.tokens);
+    struct clox_ast_expr* expr = parser_parse_expr(&parser);
+    assert(expr != NULL && expr->kind == CLOX_AST_EXPR_KIND_BINARY);
+    assert(expr->value.binary.spec == CLOX_AST_EXPR_BINARY_SPEC_GENERIC);
+
+    struct clox_interpreter interpreter;
+    clox_interpreter_init(&interpreter);
+    clox_env_define(&interpreter.env, strview_from_cstr("a", 1), clox_value_number(1));
+    clox_env_define(&interpreter.env, strview_from_cstr("b", 1), clox_value_number(2));
+
+    // the first evaluation goes through the generic path and specializes the node
+    struct clox_value val = eval_owned(&interpreter, expr);
+    assert(clox_value_as_number(val) == 3);
+    assert(expr->value.binary.spec == CLOX_AST_EXPR_BINARY_SPEC_NUMBER_ADD);
+    assert(interpreter.stats.specialized == 1);
+
+    // the guard holds, so the node stays specialized
+    val = eval_owned(&interpreter, expr);
+    assert(clox_value_as_number(val) == 3);
+    assert(interpreter.stats.despecialized == 0);
+
+    // breaking the assumption falls back to generic, which gets the same result a generic node would
+    clox_env_assign(&interpreter.env, strview_from_cstr("a", 1), clox_value_string_from_strview(strview_from_cstr("x", 1)));
+    clox_env_assign(&interpreter.env, strview_from_cstr("b", 1), clox_value_string_from_strview(strview_from_cstr("y", 1)));
+    val = eval_owned(&interpreter, expr);
+    struct strview sv = clox_value_as_strview(&val);
+    assert(sv.len == 2 && memcmp(sv.ptr, "xy", 2) == 0);
+    clox_value_free(&val);
+    assert(interpreter.stats.despecialized == 1);
+    assert(expr->value.binary.spec == CLOX_AST_EXPR_BINARY_SPEC_STRING_CONCAT);
+    assert(interpreter.stats.specialized == 2);
+
+    // errors are still reported by the generic path
+    clox_env_assign(&interpreter.env, strview_from_cstr("b", 1), clox_value_nil());
+    struct clox_interpreter_eval_result res = clox_interpreter_eval(&interpreter, expr);
+    assert(res.outcome == CLOX_INTERPRETER_EVAL_RESULT_ERR);
+    assert(expr->value.binary.spec == CLOX_AST_EXPR_BINARY_SPEC_GENERIC);
+
+    // a node whose assumptions keep breaking eventually stays generic
+    for (int i = 0; i < 2 * CLOX_INTERPRETER_DESPECIALIZATION_LIMIT; i++) {
+        clox_env_assign(&interpreter.env, strview_from_cstr("b", 1), clox_value_number(i));
+        clox_env_assign(&interpreter.env, strview_from_cstr("a", 1), clox_value_number(i));
+        val = eval_owned(&interpreter, expr);
+        clox_env_assign(&interpreter.env, strview_from_cstr("a", 1), clox_value_string_from_strview(strview_from_cstr("x", 1)));
+        clox_env_assign(&interpreter.env, strview_from_cstr("b", 1), clox_value_string_from_strview(strview_from_cstr("y", 1)));
+        val = eval_owned(&interpreter, expr);
+        clox_value_free(&val);
+    }
+    assert(expr->value.binary.spec == CLOX_AST_EXPR_BINARY_SPEC_GENERIC);
+    assert(expr->value.binary.despecializations == CLOX_INTERPRETER_DESPECIALIZATION_LIMIT);
+
+    clox_interpreter_free(&interpreter);
+    clox_ast_expr_free(expr);
+    scanner_free(&scanner);
+
+    puts("interpreter-quickening.unit: ok");
+}
@@ -0,0 +1,82 @@
+// The checks call the code under test, so they must not be compiled out when NDEBUG is defined (e.g. release builds)
+#undef NDEBUG
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define STB_DS_IMPLEMENTATION
+#include <clox/stb_ds.h>
+
+#include "scanner.h"
+#include "parser.h"
+#include "ast/expr.h"
+#include "ast/statement.h"
+#include "ast/program.h"
+#include "interpreter.h"
+
+int main() {
+    const char src[] =
+        "var g = 1;\n"
+        "{\n"
+        "    var a = g;\n"
+        "    { var b = a; var c = b; a = c + 1; }\n"
+        "    { var d = a; g = d * 2; }\n"
+        "}\n";
+    struct scanner scanner = {0};
+    scanner_scan_all_from_cstr(&scanner, src, strlen(src));
+
+    struct parser parser;
+    parser_init(&parser, scanner.tokens);
+    struct clox_ast_program* prog = parser_parse(&parser);
+    assert(prog != NULL && arrlen(prog->statements) == 2);
+
+    // globals aren't resolved to slots
+    struct clox_ast_statement* global = prog->statements[0];
+    assert(global->kind == CLOX_AST_STATEMENT_KIND_VAR && global->as.var_statement.slot == CLOX_AST_SLOT_GLOBAL);
+
+    struct clox_ast_statement* outer = prog->statements[1];
+    assert(outer->kind == CLOX_AST_STATEMENT_KIND_BLOCK);
+    assert(outer->as.block_statement.first_slot == 0 && outer->as.block_statement.slot_count == 1);
+
+    struct clox_ast_statement** outer_stmts = outer->as.block_statement.statements;
+    assert(outer_stmts[0]->as.var_statement.slot == 0);
+    assert(outer_stmts[0]->as.var_statement.initializer->value.var.slot == CLOX_AST_SLOT_GLOBAL);
+
+    // sibling blocks reuse the slots after their enclosing block ones
+    struct clox_ast_statement_block* first = &outer_stmts[1]->as.block_statement;
+    struct clox_ast_statement_block* second = &outer_stmts[2]->as.block_statement;
+    assert(first->first_slot == 1 && first->slot_count == 2);
+    assert(second->first_slot == 1 && second->slot_count == 1);
+    assert(first->statements[1]->as.var_statement.initializer->value.var.slot == 1);
+
+    struct clox_ast_expr* assign = first->statements[2]->as.expr_statement.expr;
+    assert(assign->kind == CLOX_AST_EXPR_KIND_ASSIGN && assign->value.assign.slot == 0);
+    assert(assign->value.assign.value->value.binary.left->value.var.slot == 2);
+
+    struct clox_interpreter interpreter;
+    clox_interpreter_init(&interpreter);
+    assert(clox_interpreter_exec_program(&interpreter, prog) == 0);
+
+    struct clox_value g;
+    assert(clox_env_get(&interpreter.env, strview_from_cstr("g", 1), &g) == 0);
+    assert(clox_value_as_number(g) == 4);
+
+    // the locals stack is as deep as the deepest block, and it's left clean
+    assert(arrlen(interpreter.locals) == 3);
+    for (long i = 0; i < arrlen(interpreter.locals); i++) {
+        assert(clox_value_is_nil(interpreter.locals[i]));
+    }
+
+    // once grown, scopes don't allocate anymore
+    struct clox_value* locals = interpreter.locals;
+    for (int i = 0; i < 1000; i++) {
+        assert(clox_interpreter_exec_statement(&interpreter, outer) == 0);
+    }
+    assert(interpreter.locals == locals && arrlen(interpreter.locals) == 3);
+
+    clox_interpreter_free(&interpreter);
+    clox_ast_program_free(prog);
+    scanner_free(&scanner);
+
+    puts("interpreter-scopes.unit: ok");
+}
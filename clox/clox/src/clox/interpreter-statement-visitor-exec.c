@@ -4,16 +4,20 @@
 #include "ast/statement-visitor.h"
 #include "interpreter.h"
 #include "env.h"
+#include "stb_ds.h"
+#include "ast/expr.h"
 
 static int exec_statement_expr(struct clox_ast_statement* stmt, void* userctx);
 static int exec_statement_print(struct clox_ast_statement* stmt, void* userctx);
 static int exec_statement_var(struct clox_ast_statement* stmt, void* userctx);
+static int exec_statement_block(struct clox_ast_statement* stmt, void* userctx);
 
 const struct clox_ast_statement_visitor* clox_interpreter_statement_visitor_exec(void) {
     static const struct clox_ast_statement_visitor vtable = {
         .visit_statement_expr = exec_statement_expr,
         .visit_statement_print = exec_statement_print,
         .visit_statement_var = exec_statement_var,
+        .visit_statement_block = exec_statement_block,
     };
     return &vtable;
 }
@@ -27,6 +31,9 @@ static int exec_statement_expr(struct clox_ast_statement* stmt, void* userctx) {
         fputs("error: failed to execute expression statement\n", stderr);
         return res.as.err_code;
     }
+
+    // The expression value is discarded
+    clox_interpreter_eval_result_release(&res);
     
     return 0;
 }
@@ -35,7 +42,6 @@ static int exec_statement_print(struct clox_ast_statement* stmt, void* userctx)
     struct clox_interpreter* interpreter = userctx;
     struct clox_ast_statement_print* print_stmt = &stmt->as.print_statement;
 
-    // NOTE val is a borrow which is owned by the interpreter
     struct clox_interpreter_eval_result res = clox_interpreter_eval(interpreter, print_stmt->expr);
     if (res.outcome != CLOX_INTERPRETER_EVAL_RESULT_OK) {
         fputs("error: failed to execute print statement\n", stderr);
@@ -43,7 +49,8 @@ static int exec_statement_print(struct clox_ast_statement* stmt, void* userctx)
     }
 
     // Executing the print action
-    clox_value_fprintln(stdout, res.as.value);
+    clox_value_println(&interpreter->output, res.as.value);
+    clox_interpreter_eval_result_release(&res);
 
     return 0;
 }
@@ -61,7 +68,15 @@ static int exec_statement_var(struct clox_ast_statement* stmt, void* userctx) {
             fputs("' because its initializer expression evaluation failed.\n", stderr);
             return init_result.as.err_code;
         }
-        var_value = clox_value_dup(init_result.as.value);
+        // This is where the value is stored, so this is where a borrowed value gets copied
+        var_value = clox_interpreter_eval_result_take(&init_result);
+    }
+
+    if (var_stmt->slot != CLOX_AST_SLOT_GLOBAL) {
+        struct clox_value* local = &interpreter->locals[var_stmt->slot];
+        clox_value_free(local);
+        *local = clox_value_promote(var_value);
+        return 0;
     }
 
     struct strview var_name = var_stmt->name.lexeme;
@@ -70,3 +85,29 @@ static int exec_statement_var(struct clox_ast_statement* stmt, void* userctx) {
 
     return 0;
 }
+
+static int exec_statement_block(struct clox_ast_statement* stmt, void* userctx) {
+    struct clox_interpreter* interpreter = userctx;
+    struct clox_ast_statement_block* block_stmt = &stmt->as.block_statement;
+
+    // The enclosing blocks locals are below first_slot, so the stack only needs to grow if this is the deepest so far
+    const long slots_end = (long) block_stmt->first_slot + block_stmt->slot_count;
+    while (arrlen(interpreter->locals) < slots_end) {
+        arrpush(interpreter->locals, clox_value_nil());
+    }
+
+    int rc = 0;
+    for (long i = 0; i < arrlen(block_stmt->statements); i++) {
+        rc = clox_interpreter_exec_statement(interpreter, block_stmt->statements[i]);
+        if (rc != 0) {
+            break;
+        }
+    }
+
+    // Leaving the scope. The slots are left as nil for the next block using them
+    for (long slot = block_stmt->first_slot; slot < slots_end; slot++) {
+        clox_value_free(&interpreter->locals[slot]);
+    }
+
+    return rc;
+}
@@ -1,5 +1,11 @@
 #include "interpreter.h"
 
+#include <assert.h>
+#include <stdint.h>
+
+// POSIX
+#include <unistd.h>
+
 #include "stb_ds.h"
 #include "ast/expr.h"
 #include "ast/expr-visitor.h"
@@ -9,34 +15,137 @@
 #include "interpreter-expr-visitor-eval.h"
 #include "interpreter-statement-visitor-exec.h"
 
+static void eval_own_top_operand(struct clox_interpreter* interpreter);
+static void eval_protect_borrowed_left(struct clox_interpreter* interpreter, struct clox_ast_expr* expr);
+static void eval_report_binary_failure(const struct token* operator, bool right);
+static void eval_unwind_concat(const struct clox_ast_expr_concat* concat, size_t from, size_t failed_operand);
+static void eval_unwind(struct clox_interpreter* interpreter, long frames_base, long operands_base);
+static struct clox_interpreter_eval_result interpreter_take_value(struct clox_interpreter* interpreter);
+
 void clox_interpreter_init(struct clox_interpreter* interpreter) {
     interpreter->value = clox_value_nil();
+    interpreter->value_borrowed = false;
     clox_env_init(&interpreter->env);
+    interpreter->locals = NULL;
+    interpreter->frames = NULL;
+    interpreter->operands = NULL;
+    interpreter->concat_parts = NULL;
+    interpreter->use_region = false;
+    clox_region_init(&interpreter->region);
+    clox_output_init(&interpreter->output, STDOUT_FILENO, CLOX_OUTPUT_DEFAULT_CAP);
+    interpreter->stats = (struct clox_interpreter_stats) {0};
+    interpreter->optimizations = (struct clox_optimizer_report) {0};
 }
 
 void clox_interpreter_free(struct clox_interpreter* interpreter) {
+    for (long i = 0; i < arrlen(interpreter->operands); i++) {
+        clox_interpreter_eval_result_release(&interpreter->operands[i]);
+    }
+    arrfree(interpreter->operands);
+    arrfree(interpreter->frames);
+    arrfree(interpreter->concat_parts);
+    for (long i = 0; i < arrlen(interpreter->locals); i++) {
+        clox_value_free(&interpreter->locals[i]);
+    }
+    arrfree(interpreter->locals);
     clox_env_free(&interpreter->env);
     // this will free the value if it's a str
     clox_interpreter_set_value(interpreter, clox_value_nil());
+    clox_region_free(&interpreter->region);
+    clox_output_free(&interpreter->output);
+    clox_optimizer_report_free(&interpreter->optimizations);
+}
+
+void clox_interpreter_flush(struct clox_interpreter* interpreter) {
+    clox_output_flush(&interpreter->output);
+}
+
+void clox_interpreter_stats_fprint(const struct clox_interpreter* interpreter, FILE* file) {
+    fprintf(file, "interpreter: specialized=%zu despecialized=%zu cache_hits=%zu cache_misses=%zu\n",
+        interpreter->stats.specialized, interpreter->stats.despecialized,
+        interpreter->stats.cache_hits, interpreter->stats.cache_misses);
+
+    const struct clox_optimizer_report* optimizations = &interpreter->optimizations;
+    fprintf(file, "interpreter: constant_globals=%zu propagated=%zu folded=%zu concats=%zu",
+        (size_t) arrlen(optimizations->constant_globals), optimizations->propagated, optimizations->folded,
+        optimizations->concats);
+    for (long i = 0; i < arrlen(optimizations->constant_globals); i++) {
+        struct strview name = optimizations->constant_globals[i];
+        fprintf(file, "%s%.*s", (i == 0) ? " (" : ", ", (int) name.len, name.ptr);
+    }
+    fputs(arrlen(optimizations->constant_globals) > 0 ? ")\n" : "\n", file);
 }
 
 struct clox_interpreter_eval_result clox_interpreter_eval(struct clox_interpreter* interpreter, struct clox_ast_expr* expr) {
-    int rc = clox_ast_expr_accept(expr, clox_interpreter_expr_visitor_eval(), interpreter);
-    if (rc != 0) {
-        return clox_interpreter_eval_result_err(rc);
+    const struct clox_ast_expr_visitor* visitor = clox_interpreter_expr_visitor_eval();
+    const long frames_base = arrlen(interpreter->frames);
+    const long operands_base = arrlen(interpreter->operands);
+
+    arrpush(interpreter->frames, ((struct clox_interpreter_eval_frame) { .expr = expr, .next_child = 0 }));
+
+    // Postorder traversal. A frame stays in the stack until all of its children are evaluated, then its visitor
+    // pops their values from the operands stack and sets the frame value in the interpreter.
+    while (arrlen(interpreter->frames) > frames_base) {
+        struct clox_interpreter_eval_frame* frame = &arrlast(interpreter->frames);
+
+        struct clox_ast_expr* child = clox_ast_expr_child(frame->expr, frame->next_child);
+        if (child != NULL) {
+            if (frame->expr->kind == CLOX_AST_EXPR_KIND_BINARY && frame->next_child == 1) {
+                eval_protect_borrowed_left(interpreter, frame->expr);
+            } else if (frame->expr->kind == CLOX_AST_EXPR_KIND_CONCAT && frame->next_child > 0) {
+                struct clox_ast_expr_concat* concat = &frame->expr->value.concat;
+                const size_t evaluated = frame->next_child - 1;
+                // Operands are type checked as soon as they are evaluated, so errors are reported before the next
+                // operands are evaluated, just like the nested binary nodes would do
+                if (evaluated > 0 && clox_interpreter_eval_concat_check(interpreter, concat, evaluated) != 0) {
+                    (void) arrpop(interpreter->frames);
+                    eval_unwind_concat(concat, evaluated + 1, SIZE_MAX);
+                    eval_unwind(interpreter, frames_base, operands_base);
+                    return clox_interpreter_eval_result_err(1);
+                }
+                // same as binary nodes: the next operands could free the borrowed ones under our feet
+                if (frame->next_child <= concat->last_non_leaf) {
+                    eval_own_top_operand(interpreter);
+                }
+            }
+            frame->next_child++;
+            arrpush(interpreter->frames, ((struct clox_interpreter_eval_frame) { .expr = child, .next_child = 0 }));
+            continue;
+        }
+
+        struct clox_ast_expr* ready = arrpop(interpreter->frames).expr;
+        int rc = clox_ast_expr_accept(ready, visitor, interpreter);
+        if (rc != 0) {
+            eval_unwind(interpreter, frames_base, operands_base);
+            return clox_interpreter_eval_result_err(rc);
+        }
+        arrpush(interpreter->operands, interpreter_take_value(interpreter));
     }
-    
-    return clox_interpreter_eval_result_ok(interpreter->value);
+
+    assert(arrlen(interpreter->operands) == operands_base + 1);
+    return arrpop(interpreter->operands);
 }
 
 int clox_interpreter_exec_statement(struct clox_interpreter* interpreter, struct clox_ast_statement* stmt) {
     return clox_ast_statement_accept(stmt, clox_interpreter_statement_visitor_exec(), interpreter);
 }
 
+void clox_interpreter_optimize_program(struct clox_interpreter* interpreter, struct clox_ast_program* prog) {
+    clox_optimizer_report_free(&interpreter->optimizations);
+    clox_optimizer_propagate_constants(prog, &interpreter->optimizations);
+    // after propagation, which may turn more operands into string literals
+    clox_optimizer_flatten_concats(prog, &interpreter->optimizations);
+}
+
 int clox_interpreter_exec_program(struct clox_interpreter* interpreter, struct clox_ast_program* prog) {
     for (long i = 0; i < arrlen(prog->statements); i++) {
         int rc = clox_interpreter_exec_statement(interpreter, prog->statements[i]);
+
+        // Temporaries don't outlive their statement
+        clox_region_reset(&interpreter->region);
+
         if (rc != 0) {
+            clox_interpreter_flush(interpreter);
             //TODO add line number to the statement and print it here
             fprintf(stderr, "error: %s:%d: runtime error\n", __FILE__, __LINE__);
             return rc;
@@ -46,8 +155,128 @@ int clox_interpreter_exec_program(struct clox_interpreter* interpreter, struct c
 }
 
 void clox_interpreter_set_value(struct clox_interpreter* interpreter, struct clox_value val) {
-    if (interpreter->value.kind == CLOX_VALUE_KIND_STRING) {
-        str_free(&interpreter->value.as.string);
+    if (!interpreter->value_borrowed) {
+        clox_value_free(&interpreter->value);
     }
     interpreter->value = val;
+    interpreter->value_borrowed = false;
+}
+
+void clox_interpreter_set_value_borrowed(struct clox_interpreter* interpreter, struct clox_value val) {
+    clox_interpreter_set_value(interpreter, val);
+    interpreter->value_borrowed = true;
+}
+
+struct clox_interpreter_eval_result clox_interpreter_pop_operand(struct clox_interpreter* interpreter) {
+    assert(arrlen(interpreter->operands) > 0);
+    return arrpop(interpreter->operands);
+}
+
+void clox_interpreter_eval_result_release(struct clox_interpreter_eval_result* res) {
+    if (res->outcome == CLOX_INTERPRETER_EVAL_RESULT_OK && !res->borrowed) {
+        clox_value_free(&res->as.value);
+    }
+}
+
+struct clox_value clox_interpreter_eval_result_take(struct clox_interpreter_eval_result* res) {
+    assert(res->outcome == CLOX_INTERPRETER_EVAL_RESULT_OK);
+
+    struct clox_value val = res->borrowed ? clox_value_dup(res->as.value) : res->as.value;
+    res->as.value = clox_value_nil();
+    res->borrowed = false;
+
+    return val;
+}
+
+/**
+ * @brief Takes ownership of the operand on the top of the operands stack, if it's borrowed
+ */
+static void eval_own_top_operand(struct clox_interpreter* interpreter) {
+    struct clox_interpreter_eval_result* top = &arrlast(interpreter->operands);
+    if (top->borrowed) {
+        *top = clox_interpreter_eval_result_ok(clox_interpreter_eval_result_take(top));
+    }
+}
+
+/**
+ * @brief Called between the evaluation of the operands of a binary expression, when its left operand is on the top
+ * of the operands stack.
+ */
+static void eval_protect_borrowed_left(struct clox_interpreter* interpreter, struct clox_ast_expr* expr) {
+    // A borrowed left operand may point into the environment. If the right operand is able to assign variables
+    // (e.g. `a + (a = "x")`) then it could free the borrowed value under our feet, so it must be taken first.
+    if (!clox_ast_expr_is_leaf(expr->value.binary.right)) {
+        eval_own_top_operand(interpreter);
+    }
+}
+
+/**
+ * @brief Reports an evaluation failure on every pending expression, innermost first, and drops their operands.
+ */
+static void eval_unwind(struct clox_interpreter* interpreter, long frames_base, long operands_base) {
+    while (arrlen(interpreter->frames) > frames_base) {
+        struct clox_interpreter_eval_frame frame = arrpop(interpreter->frames);
+        // the failed child is the last one pushed
+        size_t failed_child = frame.next_child - 1;
+
+        switch (frame.expr->kind) {
+        case CLOX_AST_EXPR_KIND_BINARY:
+            eval_report_binary_failure(&frame.expr->value.binary.operator, failed_child != 0);
+            break;
+
+        case CLOX_AST_EXPR_KIND_CONCAT:
+            eval_unwind_concat(&frame.expr->value.concat, (failed_child > 0) ? failed_child : 1, failed_child);
+            break;
+
+        case CLOX_AST_EXPR_KIND_UNARY: {
+            const struct token* operator = &frame.expr->value.unary.operator;
+            fprintf(stderr, "error: line %zu: failed to evaluate right-hand-size of unary operator '", operator->line);
+            strview_fprint(operator->lexeme, stderr);
+            fputs("'\n", stderr);
+            break;
+        }
+
+        case CLOX_AST_EXPR_KIND_ASSIGN:
+            fprintf(stderr, "error: line %zu: failed to evaluate assignment expression\n", frame.expr->value.assign.name.line);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    while (arrlen(interpreter->operands) > operands_base) {
+        struct clox_interpreter_eval_result operand = arrpop(interpreter->operands);
+        clox_interpreter_eval_result_release(&operand);
+    }
+    clox_interpreter_set_value(interpreter, clox_value_nil());
+}
+
+static void eval_report_binary_failure(const struct token* operator, bool right) {
+    fprintf(stderr, "error: line %zu: failed to evaluate %s-hand-size of binary operator '",
+        operator->line, right ? "right" : "left");
+    strview_fprint(operator->lexeme, stderr);
+    fputs("'\n", stderr);
+}
+
+/**
+ * @brief Reports a failure inside a concat node the way the nested binary nodes it replaced would: every one of them
+ * from the innermost node involved (the one joining the operand at index from) outwards.
+ */
+static void eval_unwind_concat(const struct clox_ast_expr_concat* concat, size_t from, size_t failed_operand) {
+    for (size_t i = from; i < (size_t) arrlen(concat->operands); i++) {
+        eval_report_binary_failure(&concat->operators[i - 1], i == failed_operand);
+    }
+}
+
+/**
+ * @brief Moves the value out of the interpreter
+ */
+static struct clox_interpreter_eval_result interpreter_take_value(struct clox_interpreter* interpreter) {
+    struct clox_interpreter_eval_result res = interpreter->value_borrowed
+        ? clox_interpreter_eval_result_ok_borrowed(interpreter->value)
+        : clox_interpreter_eval_result_ok(interpreter->value);
+    interpreter->value = clox_value_nil();
+    interpreter->value_borrowed = false;
+    return res;
 }
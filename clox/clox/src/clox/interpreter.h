@@ -1,8 +1,14 @@
 #ifndef CLOX_INTERPRETER_H
 #define CLOX_INTERPRETER_H
 
+#include <stdbool.h>
+#include <stdio.h>
+
 #include "value.h"
 #include "env.h"
+#include "region.h"
+#include "output.h"
+#include "optimizer.h"
 
 struct clox_ast_expr;
 struct clox_ast_statement;
@@ -17,37 +23,150 @@ struct clox_interpreter_eval_result {
         struct clox_value value;
         int err_code;
     } as;
+    /**
+     * @brief Whether the resulting value is borrowed or owned by the caller.
+     *
+     * Owned values must be consumed: either moved into some storage or released with clox_interpreter_eval_result_release.
+     * Borrowed values (e.g. a variable read straight from the environment) are valid only until the environment
+     * is mutated, so they must be duplicated (see clox_interpreter_eval_result_take) if they need to be stored.
+     */
+    bool borrowed;
 };
 
 #define clox_interpreter_eval_result_ok(val) \
     (struct clox_interpreter_eval_result) { \
         .outcome = CLOX_INTERPRETER_EVAL_RESULT_OK, \
-        .as.value = (val) \
+        .as.value = (val), \
+        .borrowed = false, \
+    }
+
+#define clox_interpreter_eval_result_ok_borrowed(val) \
+    (struct clox_interpreter_eval_result) { \
+        .outcome = CLOX_INTERPRETER_EVAL_RESULT_OK, \
+        .as.value = (val), \
+        .borrowed = true, \
     }
 
 #define clox_interpreter_eval_result_err(code) \
     (struct clox_interpreter_eval_result) { \
         .outcome = CLOX_INTERPRETER_EVAL_RESULT_ERR, \
-        .as.err_code = (code) \
+        .as.err_code = (code), \
+        .borrowed = false, \
     }
 
+/**
+ * @brief An expression pending evaluation in the interpreter explicit stack
+ */
+struct clox_interpreter_eval_frame {
+    struct clox_ast_expr* expr;
+    /**
+     * @brief Index of the next child expression to be evaluated. All children are evaluated before the expr itself
+     */
+    size_t next_child;
+};
+
+/**
+ * @brief How many times a specialized node may fall back to generic before it stays generic for good
+ */
+#define CLOX_INTERPRETER_DESPECIALIZATION_LIMIT 4
+
+/**
+ * @brief Runtime counters of the interpreter
+ */
+struct clox_interpreter_stats {
+    /**
+     * @brief How many times a generic node was rewritten into a type-specialized variant
+     */
+    size_t specialized;
+    /**
+     * @brief How many times a specialized node had its type assumption broken and fell back to generic
+     */
+    size_t despecialized;
+    /**
+     * @brief Variable lookups served by the inline cache of their AST node
+     */
+    size_t cache_hits;
+    /**
+     * @brief Variable lookups that had to go through the env hash table
+     */
+    size_t cache_misses;
+};
+
 /**
  * @brief The AST Interpreter.
  * 
- * It traverses recursively (through visitor implementations) the AST of Clox programs parsed with
- * clox_parser, executing all statements in order, evaluating expressions and saving its values in the environment state as needed.
+ * It traverses (through visitor implementations) the AST of Clox programs parsed with clox_parser, executing all
+ * statements in order, evaluating expressions and saving its values in the environment state as needed.
+ * 
+ * Expressions are evaluated without recursion: subexpressions are walked in postorder with an explicit stack of
+ * pending expressions, and their values are kept in an explicit operands stack until their parent is evaluated.
+ * So deep expressions don't cost native stack.
  */
 struct clox_interpreter {
     /**
-     * @brief evaluation resulting value
+     * @brief evaluation resulting value. It is moved out of the interpreter by clox_interpreter_eval
      */
     struct clox_value value;
-    
+
+    /**
+     * @brief Whether value is borrowed from somewhere else (usually the environment) instead of owned by the interpreter
+     */
+    bool value_borrowed;
+
     /**
      * @brief Environment state where global variables are stored
      * 
      */
     struct clox_env env;
+
+    /**
+     * @brief Stack (stb_ds array) of the block local variables, indexed by the slots the parser resolved them to.
+     * 
+     * Blocks just use the slots right after the ones of their enclosing blocks, so entering and leaving a scope
+     * doesn't allocate: the stack only grows the first time blocks get that deep.
+     */
+    struct clox_value* locals;
+
+    /**
+     * @brief Explicit stack (stb_ds array) of the expressions pending evaluation
+     */
+    struct clox_interpreter_eval_frame* frames;
+
+    /**
+     * @brief Explicit stack (stb_ds array) of evaluated subexpressions waiting for their parent to be evaluated
+     */
+    struct clox_interpreter_eval_result* operands;
+
+    /**
+     * @brief Scratch buffer (stb_ds array) for the strings joined by a concat node
+     */
+    struct strview* concat_parts;
+
+    /**
+     * @brief Whether temporary strings are allocated in the region instead of the heap. Off by default
+     */
+    bool use_region;
+
+    /**
+     * @brief Region for the temporary strings made while executing a statement. It's reset after each statement,
+     * so temporaries are freed in bulk. Values stored in the env are promoted out of it
+     */
+    struct clox_region region;
+
+    /**
+     * @brief Where print statements write to. Buffered stdout by default
+     */
+    struct clox_output output;
+
+    /**
+     * @brief Runtime counters
+     */
+    struct clox_interpreter_stats stats;
+
+    /**
+     * @brief What the optimizer did to the program before running it (see clox_interpreter_optimize_program)
+     */
+    struct clox_optimizer_report optimizations;
 };
 
 /**
@@ -58,18 +177,36 @@ struct clox_interpreter {
 void clox_interpreter_init(struct clox_interpreter* interpreter);
 
 /**
- * @brief Cleans up the Interpreter after use.
+ * @brief Cleans up the Interpreter after use. Pending output is flushed.
  * 
  * @param interpreter 
  */
 void clox_interpreter_free(struct clox_interpreter* interpreter);
 
 /**
- * @brief Evaluates the given AST expression. The value is a borrow which is owned by the interpreter.
+ * @brief Writes out everything printed so far. It's also done on errors and when the interpreter is freed.
+ * 
+ * @param interpreter 
+ */
+void clox_interpreter_flush(struct clox_interpreter* interpreter);
+
+/**
+ * @brief Prints the interpreter runtime counters.
+ * 
+ * @param interpreter 
+ * @param file 
+ */
+void clox_interpreter_stats_fprint(const struct clox_interpreter* interpreter, FILE* file);
+
+/**
+ * @brief Evaluates the given AST expression, without recursion.
+ * 
+ * The resulting value is moved out of the interpreter into the result, so the caller is responsible for it.
+ * Check the result borrowed flag to know if it must be released or if it must be duplicated before being stored.
  * 
  * @param interpreter 
  * @param expr The root expression where evaluation starts
- * @return struct clox_value 
+ * @return struct clox_interpreter_eval_result 
  */
 struct clox_interpreter_eval_result clox_interpreter_eval(struct clox_interpreter* interpreter, struct clox_ast_expr* expr);
 
@@ -91,13 +228,68 @@ int clox_interpreter_exec_statement(struct clox_interpreter* interpreter, struct
 int clox_interpreter_exec_program(struct clox_interpreter* interpreter, struct clox_ast_program* prog);
 
 /**
- * @brief Sets a new value in the interpreter state.
+ * @brief Optimizes the given AST program in place before it's executed, propagating its constant globals
+ * (see clox_optimizer_propagate_constants) and flattening its concatenation chains (see
+ * clox_optimizer_flatten_concats). The outcome is kept in the interpreter to be reported with its stats.
  * 
- * If the previous value is a string, then free's it (because the old value own's the str buffer which were heap allocated).
+ * Only whole scripts can be optimized. Programs executed piecemeal (e.g. REPL lines) must not be.
+ * 
+ * @param interpreter 
+ * @param prog 
+ */
+void clox_interpreter_optimize_program(struct clox_interpreter* interpreter, struct clox_ast_program* prog);
+
+/**
+ * @brief Moves a new value into the interpreter state. The interpreter now owns it.
+ * 
+ * If the previous value is owned, then free's it.
  * 
  * @param interpreter 
  * @param val The new value to be set
  */
 void clox_interpreter_set_value(struct clox_interpreter* interpreter, struct clox_value val);
 
+/**
+ * @brief Sets a new borrowed value in the interpreter state. The interpreter will never free it.
+ * 
+ * @param interpreter 
+ * @param val The new value to be set. It must outlive its evaluation
+ */
+void clox_interpreter_set_value_borrowed(struct clox_interpreter* interpreter, struct clox_value val);
+
+/**
+ * @brief Gets where temporary values must be allocated.
+ * 
+ * @return struct clox_region* the region or NULL if temporaries go to the heap
+ */
+static inline struct clox_region* clox_interpreter_temp_region(struct clox_interpreter* interpreter) {
+    return interpreter->use_region ? &interpreter->region : NULL;
+}
+
+/**
+ * @brief Pops the value of an evaluated subexpression. Visitors use it to get their operands, which are popped in
+ * reverse order (e.g. the right operand comes before the left one).
+ * 
+ * @param interpreter 
+ * @return struct clox_interpreter_eval_result the operand. The caller is now responsible for it
+ */
+struct clox_interpreter_eval_result clox_interpreter_pop_operand(struct clox_interpreter* interpreter);
+
+/**
+ * @brief Releases the result value if it's owned. Borrowed values are left untouched.
+ * 
+ * @param res 
+ */
+void clox_interpreter_eval_result_release(struct clox_interpreter_eval_result* res);
+
+/**
+ * @brief Takes ownership of the result value. Owned values are moved and borrowed values are duplicated.
+ * 
+ * This is the only point where copies are made, so call it only when the value is actually going to be stored.
+ * 
+ * @param res 
+ * @return struct clox_value an owned value
+ */
+struct clox_value clox_interpreter_eval_result_take(struct clox_interpreter_eval_result* res);
+
 #endif
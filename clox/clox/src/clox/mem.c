@@ -0,0 +1,52 @@
+#include "mem.h"
+
+#include <stdlib.h>
+
+#include "commons.h"
+
+static struct clox_mem_stats stats = {0};
+
+static void stats_account_alloc(size_t size) {
+    stats.allocs++;
+    stats.bytes += size;
+    stats.live_bytes += size;
+    if (stats.live_bytes > stats.peak_bytes) {
+        stats.peak_bytes = stats.live_bytes;
+    }
+}
+
+void* clox_mem_alloc(size_t size) {
+    void* ptr = malloc(size);
+    CLOX_ERR_PANIC_OOM_IF_NULL(ptr);
+
+    stats_account_alloc(size);
+
+    return ptr;
+}
+
+void* clox_mem_calloc(size_t count, size_t size) {
+    void* ptr = calloc(count, size);
+    CLOX_ERR_PANIC_OOM_IF_NULL(ptr);
+
+    stats_account_alloc(count * size);
+
+    return ptr;
+}
+
+void clox_mem_free(void* ptr, size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+    stats.frees++;
+    stats.live_bytes -= size;
+    free(ptr);
+}
+
+const struct clox_mem_stats* clox_mem_stats(void) {
+    return &stats;
+}
+
+void clox_mem_stats_fprint(FILE* file) {
+    fprintf(file, "mem: allocs=%zu frees=%zu bytes=%zu peak_bytes=%zu\n",
+        stats.allocs, stats.frees, stats.bytes, stats.peak_bytes);
+}
@@ -0,0 +1,57 @@
+#ifndef CLOX_MEM_H
+#define CLOX_MEM_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @brief Allocation counters for the memory the runtime allocates on behalf of values (strings, mostly).
+ *
+ * AST nodes and scanner tokens are not accounted here. Those are allocated once per parse, so they don't
+ * tell anything about how expensive evaluation is.
+ */
+struct clox_mem_stats {
+    /**
+     * @brief How many allocations were made
+     */
+    size_t allocs;
+    /**
+     * @brief How many allocations were released
+     */
+    size_t frees;
+    /**
+     * @brief Total bytes requested through all allocations
+     */
+    size_t bytes;
+    /**
+     * @brief Bytes currently allocated
+     */
+    size_t live_bytes;
+    /**
+     * @brief The highest live_bytes seen
+     */
+    size_t peak_bytes;
+};
+
+/**
+ * @brief Allocates size bytes of uninitialized memory. Panics on out of memory.
+ */
+void* clox_mem_alloc(size_t size);
+
+/**
+ * @brief Allocates zeroed memory for count elements of size bytes each. Panics on out of memory.
+ */
+void* clox_mem_calloc(size_t count, size_t size);
+
+/**
+ * @brief Releases memory allocated with clox_mem_alloc or clox_mem_calloc. NULL is a noop.
+ * 
+ * @param ptr 
+ * @param size the same size used on allocation. Used only for accounting
+ */
+void clox_mem_free(void* ptr, size_t size);
+
+const struct clox_mem_stats* clox_mem_stats(void);
+void clox_mem_stats_fprint(FILE* file);
+
+#endif
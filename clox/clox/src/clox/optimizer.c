@@ -0,0 +1,564 @@
+#include "optimizer.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "ast/expr.h"
+#include "ast/statement.h"
+#include "ast/program.h"
+#include "value.h"
+#include "rcstr.h"
+#include "stb_ds.h"
+
+/**
+ * @brief What the optimizer knows about a global variable
+ */
+struct optimizer_global {
+    /**
+     * @brief Hash of the name
+     */
+    uint64_t key;
+    struct strview name;
+    /**
+     * @brief How many var statements declare the global
+     */
+    uint32_t declarations;
+    /**
+     * @brief Whether some assignment targets the global
+     */
+    bool assigned;
+    /**
+     * @brief Whether another name has the same hash. Those globals are never constant
+     */
+    bool ambiguous;
+    /**
+     * @brief Whether the global was found to be constant. It's only set once its declaration has been optimized,
+     * so reads placed before it (which are runtime errors) are left alone
+     */
+    bool constant;
+    /**
+     * @brief The constant value. Strings are borrowed from the initializer literal
+     */
+    struct clox_ast_expr_literal value;
+};
+
+struct optimizer_frame {
+    struct clox_ast_expr* expr;
+    size_t next_child;
+};
+
+struct optimizer {
+    /**
+     * @brief stb_ds hash table of the globals declared or assigned in the program
+     */
+    struct optimizer_global* globals;
+    /**
+     * @brief Explicit stack (stb_ds array) of the expressions being walked, so deep trees don't cost native stack
+     */
+    struct optimizer_frame* frames;
+    struct clox_optimizer_report* report;
+};
+
+static struct optimizer_global* optimizer_global_upsert(struct optimizer* opt, struct strview name);
+static struct optimizer_global* optimizer_global_find(struct optimizer* opt, struct strview name);
+static void optimizer_scan_statement(struct optimizer* opt, struct clox_ast_statement* stmt);
+static void optimizer_scan_expr(struct optimizer* opt, struct clox_ast_expr* expr);
+static void optimizer_fold_statement(struct optimizer* opt, struct clox_ast_statement* stmt);
+static void optimizer_fold_expr(struct optimizer* opt, struct clox_ast_expr* expr);
+static void optimizer_fold_node(struct optimizer* opt, struct clox_ast_expr* expr);
+static void optimizer_flatten_statement(struct optimizer* opt, struct clox_ast_statement* stmt);
+static void optimizer_flatten_expr(struct optimizer* opt, struct clox_ast_expr* expr);
+static void optimizer_flatten_chain(struct optimizer* opt, struct clox_ast_expr* expr);
+static bool expr_is_plus(const struct clox_ast_expr* expr);
+static bool expr_is_string_literal(const struct clox_ast_expr* expr);
+static bool fold_unary(const struct clox_ast_expr_unary* expr_un, struct clox_ast_expr_literal* out);
+static bool fold_binary(const struct clox_ast_expr_binary* expr_bin, struct clox_ast_expr_literal* out);
+static struct clox_value literal_value(const struct clox_ast_expr_literal* lit);
+static struct clox_ast_expr_literal literal_from_value(struct clox_value val);
+static struct clox_ast_expr_literal literal_dup(const struct clox_ast_expr_literal* lit);
+static void expr_replace_with_literal(struct clox_ast_expr* expr, struct clox_ast_expr_literal lit);
+
+void clox_optimizer_propagate_constants(struct clox_ast_program* prog, struct clox_optimizer_report* report) {
+    *report = (struct clox_optimizer_report) {0};
+    struct optimizer opt = {
+        .globals = NULL,
+        .frames = NULL,
+        .report = report,
+    };
+
+    // First pass: the declarations and assignments of every global. An assignment anywhere (even after the reads)
+    // rules the global out, so the whole program must be seen before rewriting anything.
+    for (long i = 0; i < arrlen(prog->statements); i++) {
+        optimizer_scan_statement(&opt, prog->statements[i]);
+    }
+
+    // Second pass: in program order, so globals become constant right after their declaration
+    for (long i = 0; i < arrlen(prog->statements); i++) {
+        optimizer_fold_statement(&opt, prog->statements[i]);
+    }
+
+    arrfree(opt.frames);
+    hmfree(opt.globals);
+}
+
+void clox_optimizer_flatten_concats(struct clox_ast_program* prog, struct clox_optimizer_report* report) {
+    struct optimizer opt = {
+        .globals = NULL,
+        .frames = NULL,
+        .report = report,
+    };
+
+    for (long i = 0; i < arrlen(prog->statements); i++) {
+        optimizer_flatten_statement(&opt, prog->statements[i]);
+    }
+
+    arrfree(opt.frames);
+}
+
+void clox_optimizer_report_free(struct clox_optimizer_report* report) {
+    arrfree(report->constant_globals);
+    *report = (struct clox_optimizer_report) {0};
+}
+
+static struct optimizer_global* optimizer_global_upsert(struct optimizer* opt, struct strview name) {
+    uint64_t key = stbds_hash_bytes((void*) name.ptr, name.len, 0);
+    struct optimizer_global* global = hmgetp_null(opt->globals, key);
+    if (global == NULL) {
+        hmputs(opt->globals, ((struct optimizer_global) { .key = key, .name = name }));
+        global = hmgetp_null(opt->globals, key);
+    } else if (!strview_equals(global->name, name)) {
+        global->ambiguous = true;
+    }
+    return global;
+}
+
+static struct optimizer_global* optimizer_global_find(struct optimizer* opt, struct strview name) {
+    struct optimizer_global* global = hmgetp_null(opt->globals, stbds_hash_bytes((void*) name.ptr, name.len, 0));
+    if (global == NULL || global->ambiguous || !strview_equals(global->name, name)) {
+        return NULL;
+    }
+    return global;
+}
+
+static void optimizer_scan_statement(struct optimizer* opt, struct clox_ast_statement* stmt) {
+    switch (stmt->kind) {
+    case CLOX_AST_STATEMENT_KIND_EXPR:
+        optimizer_scan_expr(opt, stmt->as.expr_statement.expr);
+        break;
+
+    case CLOX_AST_STATEMENT_KIND_PRINT:
+        optimizer_scan_expr(opt, stmt->as.print_statement.expr);
+        break;
+
+    case CLOX_AST_STATEMENT_KIND_VAR:
+        if (stmt->as.var_statement.initializer != NULL) {
+            optimizer_scan_expr(opt, stmt->as.var_statement.initializer);
+        }
+        if (stmt->as.var_statement.slot == CLOX_AST_SLOT_GLOBAL) {
+            optimizer_global_upsert(opt, stmt->as.var_statement.name.lexeme)->declarations++;
+        }
+        break;
+
+    case CLOX_AST_STATEMENT_KIND_BLOCK:
+        for (long i = 0; i < arrlen(stmt->as.block_statement.statements); i++) {
+            optimizer_scan_statement(opt, stmt->as.block_statement.statements[i]);
+        }
+        break;
+    }
+}
+
+static void optimizer_scan_expr(struct optimizer* opt, struct clox_ast_expr* expr) {
+    // the frames stack is reused as a plain stack of pending expressions, order doesn't matter here
+    arrpush(opt->frames, ((struct optimizer_frame) { .expr = expr, .next_child = 0 }));
+    while (arrlen(opt->frames) > 0) {
+        struct clox_ast_expr* pending = arrpop(opt->frames).expr;
+        if (pending->kind == CLOX_AST_EXPR_KIND_ASSIGN && pending->value.assign.slot == CLOX_AST_SLOT_GLOBAL) {
+            optimizer_global_upsert(opt, pending->value.assign.name.lexeme)->assigned = true;
+        }
+
+        struct clox_ast_expr* child;
+        for (size_t i = 0; (child = clox_ast_expr_child(pending, i)) != NULL; i++) {
+            arrpush(opt->frames, ((struct optimizer_frame) { .expr = child, .next_child = 0 }));
+        }
+    }
+}
+
+static void optimizer_fold_statement(struct optimizer* opt, struct clox_ast_statement* stmt) {
+    switch (stmt->kind) {
+    case CLOX_AST_STATEMENT_KIND_EXPR:
+        optimizer_fold_expr(opt, stmt->as.expr_statement.expr);
+        break;
+
+    case CLOX_AST_STATEMENT_KIND_PRINT:
+        optimizer_fold_expr(opt, stmt->as.print_statement.expr);
+        break;
+
+    case CLOX_AST_STATEMENT_KIND_VAR: {
+        struct clox_ast_statement_var* var_stmt = &stmt->as.var_statement;
+        if (var_stmt->initializer != NULL) {
+            optimizer_fold_expr(opt, var_stmt->initializer);
+        }
+        if (var_stmt->slot != CLOX_AST_SLOT_GLOBAL) {
+            break;
+        }
+
+        struct optimizer_global* global = optimizer_global_find(opt, var_stmt->name.lexeme);
+        if (global == NULL || global->declarations != 1 || global->assigned) {
+            break;
+        }
+        if (var_stmt->initializer == NULL) {
+            global->value = (struct clox_ast_expr_literal) { .kind = CLOX_AST_EXPR_LITERAL_KIND_NIL };
+        } else if (var_stmt->initializer->kind == CLOX_AST_EXPR_KIND_LITERAL) {
+            global->value = var_stmt->initializer->value.literal;
+        } else {
+            break;
+        }
+        global->constant = true;
+        arrput(opt->report->constant_globals, var_stmt->name.lexeme);
+        break;
+    }
+
+    case CLOX_AST_STATEMENT_KIND_BLOCK:
+        for (long i = 0; i < arrlen(stmt->as.block_statement.statements); i++) {
+            optimizer_fold_statement(opt, stmt->as.block_statement.statements[i]);
+        }
+        break;
+    }
+}
+
+static void optimizer_fold_expr(struct optimizer* opt, struct clox_ast_expr* expr) {
+    // Postorder, like the interpreter evaluation: children are folded first, so their parent may see literals
+    arrpush(opt->frames, ((struct optimizer_frame) { .expr = expr, .next_child = 0 }));
+    while (arrlen(opt->frames) > 0) {
+        struct optimizer_frame* frame = &arrlast(opt->frames);
+        struct clox_ast_expr* child = clox_ast_expr_child(frame->expr, frame->next_child);
+        if (child != NULL) {
+            frame->next_child++;
+            arrpush(opt->frames, ((struct optimizer_frame) { .expr = child, .next_child = 0 }));
+            continue;
+        }
+        optimizer_fold_node(opt, arrpop(opt->frames).expr);
+    }
+}
+
+static void optimizer_fold_node(struct optimizer* opt, struct clox_ast_expr* expr) {
+    struct clox_ast_expr_literal lit;
+
+    switch (expr->kind) {
+    case CLOX_AST_EXPR_KIND_VAR: {
+        if (expr->value.var.slot != CLOX_AST_SLOT_GLOBAL) {
+            break;
+        }
+        struct optimizer_global* global = optimizer_global_find(opt, expr->value.var.name.lexeme);
+        if (global != NULL && global->constant) {
+            expr_replace_with_literal(expr, literal_dup(&global->value));
+            opt->report->propagated++;
+        }
+        break;
+    }
+
+    case CLOX_AST_EXPR_KIND_GROUPING:
+        if (expr->value.grouping.expr->kind == CLOX_AST_EXPR_KIND_LITERAL) {
+            expr_replace_with_literal(expr, literal_dup(&expr->value.grouping.expr->value.literal));
+            opt->report->folded++;
+        }
+        break;
+
+    case CLOX_AST_EXPR_KIND_UNARY:
+        if (expr->value.unary.right->kind == CLOX_AST_EXPR_KIND_LITERAL && fold_unary(&expr->value.unary, &lit)) {
+            expr_replace_with_literal(expr, lit);
+            opt->report->folded++;
+        }
+        break;
+
+    case CLOX_AST_EXPR_KIND_BINARY:
+        if (expr->value.binary.left->kind == CLOX_AST_EXPR_KIND_LITERAL
+            && expr->value.binary.right->kind == CLOX_AST_EXPR_KIND_LITERAL
+            && fold_binary(&expr->value.binary, &lit))
+        {
+            expr_replace_with_literal(expr, lit);
+            opt->report->folded++;
+        }
+        break;
+
+    case CLOX_AST_EXPR_KIND_LITERAL:
+    case CLOX_AST_EXPR_KIND_ASSIGN:
+    case CLOX_AST_EXPR_KIND_CONCAT:
+        break;
+    }
+}
+
+static void optimizer_flatten_statement(struct optimizer* opt, struct clox_ast_statement* stmt) {
+    switch (stmt->kind) {
+    case CLOX_AST_STATEMENT_KIND_EXPR:
+        optimizer_flatten_expr(opt, stmt->as.expr_statement.expr);
+        break;
+
+    case CLOX_AST_STATEMENT_KIND_PRINT:
+        optimizer_flatten_expr(opt, stmt->as.print_statement.expr);
+        break;
+
+    case CLOX_AST_STATEMENT_KIND_VAR:
+        if (stmt->as.var_statement.initializer != NULL) {
+            optimizer_flatten_expr(opt, stmt->as.var_statement.initializer);
+        }
+        break;
+
+    case CLOX_AST_STATEMENT_KIND_BLOCK:
+        for (long i = 0; i < arrlen(stmt->as.block_statement.statements); i++) {
+            optimizer_flatten_statement(opt, stmt->as.block_statement.statements[i]);
+        }
+        break;
+    }
+}
+
+static void optimizer_flatten_expr(struct optimizer* opt, struct clox_ast_expr* expr) {
+    // Preorder, so chains are found from their outermost `+`
+    arrpush(opt->frames, ((struct optimizer_frame) { .expr = expr, .next_child = 0 }));
+    while (arrlen(opt->frames) > 0) {
+        struct clox_ast_expr* pending = arrpop(opt->frames).expr;
+        if (expr_is_plus(pending)) {
+            optimizer_flatten_chain(opt, pending);
+            continue;
+        }
+
+        struct clox_ast_expr* child;
+        for (size_t i = 0; (child = clox_ast_expr_child(pending, i)) != NULL; i++) {
+            arrpush(opt->frames, ((struct optimizer_frame) { .expr = child, .next_child = 0 }));
+        }
+    }
+}
+
+/**
+ * @brief Flattens the chain of `+` starting at expr, if it's worth it, and queues the chain operands to be walked.
+ * 
+ * The chain links are never walked on their own: a long chain which isn't flattened (e.g. of numbers) would be
+ * walked over and over otherwise.
+ */
+static void optimizer_flatten_chain(struct optimizer* opt, struct clox_ast_expr* expr) {
+    size_t count = 1;
+    bool has_string_literal = false;
+    struct clox_ast_expr* link = expr;
+    for (; expr_is_plus(link); link = link->value.binary.left) {
+        count++;
+        has_string_literal = has_string_literal || expr_is_string_literal(link->value.binary.right);
+        arrpush(opt->frames, ((struct optimizer_frame) { .expr = link->value.binary.right, .next_child = 0 }));
+    }
+    has_string_literal = has_string_literal || expr_is_string_literal(link);
+    arrpush(opt->frames, ((struct optimizer_frame) { .expr = link, .next_child = 0 }));
+
+    // two operands are joined with a single allocation anyway
+    if (count < 3 || !has_string_literal) {
+        return;
+    }
+
+    struct clox_ast_expr** operands = NULL;
+    struct token* operators = NULL;
+    arrsetlen(operands, count);
+    arrsetlen(operators, count - 1);
+
+    size_t i = count - 1;
+    link = expr;
+    while (expr_is_plus(link)) {
+        struct clox_ast_expr* left = link->value.binary.left;
+        operands[i] = link->value.binary.right;
+        operators[i - 1] = link->value.binary.operator;
+        // the links are dropped, their operands are moved into the concat node. The outermost one is reused for it
+        if (link != expr) {
+            free(link);
+        }
+        link = left;
+        i--;
+    }
+    assert(i == 0);
+    operands[0] = link;
+
+    *expr = clox_ast_expr_concat_create(operands, operators);
+    opt->report->concats++;
+}
+
+static bool expr_is_plus(const struct clox_ast_expr* expr) {
+    return expr->kind == CLOX_AST_EXPR_KIND_BINARY && expr->value.binary.operator.kind == TOKEN_KIND_PLUS;
+}
+
+static bool expr_is_string_literal(const struct clox_ast_expr* expr) {
+    return expr->kind == CLOX_AST_EXPR_KIND_LITERAL && expr->value.literal.kind == CLOX_AST_EXPR_LITERAL_KIND_STRING;
+}
+
+/**
+ * @brief Evaluates an unary operation on a literal the way the interpreter would.
+ *
+ * @return bool false if it would fail at runtime, so it must be left to the interpreter
+ */
+static bool fold_unary(const struct clox_ast_expr_unary* expr_un, struct clox_ast_expr_literal* out) {
+    struct clox_value right = literal_value(&expr_un->right->value.literal);
+
+    switch (expr_un->operator.kind) {
+    case TOKEN_KIND_BANG:
+        *out = literal_from_value(clox_value_bool(!clox_value_is_truthy(right)));
+        return true;
+
+    case TOKEN_KIND_MINUS:
+        if (!clox_value_is_number(right)) {
+            return false;
+        }
+        *out = literal_from_value(clox_value_number_negate(right));
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Evaluates a binary operation on literals the way the interpreter would.
+ *
+ * @return bool false if it would fail at runtime, so it must be left to the interpreter
+ */
+static bool fold_binary(const struct clox_ast_expr_binary* expr_bin, struct clox_ast_expr_literal* out) {
+    const struct clox_ast_expr_literal* left_lit = &expr_bin->left->value.literal;
+    const struct clox_ast_expr_literal* right_lit = &expr_bin->right->value.literal;
+    struct clox_value left = literal_value(left_lit);
+    struct clox_value right = literal_value(right_lit);
+    const bool numbers = clox_value_is_number(left) && clox_value_is_number(right);
+
+    switch (expr_bin->operator.kind) {
+    case TOKEN_KIND_PLUS:
+        if (numbers) {
+            *out = literal_from_value(clox_value_number_add(left, right));
+            return true;
+        }
+        if (left_lit->kind == CLOX_AST_EXPR_LITERAL_KIND_STRING && right_lit->kind == CLOX_AST_EXPR_LITERAL_KIND_STRING) {
+            // long results become ropes, so folding long chains of literals doesn't copy them over and over
+            *out = (struct clox_ast_expr_literal) {
+                .kind = CLOX_AST_EXPR_LITERAL_KIND_STRING,
+                .value.string.val = rcstr_concat(left_lit->value.string.val, right_lit->value.string.val),
+            };
+            return true;
+        }
+        return false;
+
+    case TOKEN_KIND_MINUS:
+        if (!numbers) {
+            return false;
+        }
+        *out = literal_from_value(clox_value_number_sub(left, right));
+        return true;
+
+    case TOKEN_KIND_STAR:
+        if (!numbers) {
+            return false;
+        }
+        *out = literal_from_value(clox_value_number_mul(left, right));
+        return true;
+
+    case TOKEN_KIND_SLASH:
+        if (!numbers) {
+            return false;
+        }
+        *out = literal_from_value(clox_value_number_div(left, right));
+        return true;
+
+    case TOKEN_KIND_GREATER:
+        if (!numbers) {
+            return false;
+        }
+        *out = literal_from_value(clox_value_bool(clox_value_number_less(right, left)));
+        return true;
+
+    case TOKEN_KIND_GREATER_EQUAL:
+        if (!numbers) {
+            return false;
+        }
+        *out = literal_from_value(clox_value_bool(clox_value_number_less_equal(right, left)));
+        return true;
+
+    case TOKEN_KIND_LESS:
+        if (!numbers) {
+            return false;
+        }
+        *out = literal_from_value(clox_value_bool(clox_value_number_less(left, right)));
+        return true;
+
+    case TOKEN_KIND_LESS_EQUAL:
+        if (!numbers) {
+            return false;
+        }
+        *out = literal_from_value(clox_value_bool(clox_value_number_less_equal(left, right)));
+        return true;
+
+    case TOKEN_KIND_BANG_EQUAL:
+        *out = literal_from_value(clox_value_bool(!clox_value_is_equal(left, right)));
+        return true;
+
+    case TOKEN_KIND_EQUAL_EQUAL:
+        *out = literal_from_value(clox_value_bool(clox_value_is_equal(left, right)));
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Gets the value a literal evaluates to. Strings are borrowed from the literal
+ */
+static struct clox_value literal_value(const struct clox_ast_expr_literal* lit) {
+    switch (lit->kind) {
+    case CLOX_AST_EXPR_LITERAL_KIND_NUMBER:
+        return clox_value_number_compact(lit->value.number.val);
+    case CLOX_AST_EXPR_LITERAL_KIND_STRING:
+        return clox_value_string(lit->value.string.val);
+    case CLOX_AST_EXPR_LITERAL_KIND_BOOL:
+        return clox_value_bool(lit->value.boolean.val);
+    case CLOX_AST_EXPR_LITERAL_KIND_NIL:
+        return clox_value_nil();
+    }
+    return clox_value_nil();
+}
+
+/**
+ * @brief The literal of a number, bool or nil value. Numbers get compacted back into integers when evaluated
+ */
+static struct clox_ast_expr_literal literal_from_value(struct clox_value val) {
+    switch (clox_value_get_kind(val)) {
+    case CLOX_VALUE_KIND_NUMBER:
+        return (struct clox_ast_expr_literal) {
+            .kind = CLOX_AST_EXPR_LITERAL_KIND_NUMBER,
+            .value.number.val = clox_value_as_number(val),
+        };
+    case CLOX_VALUE_KIND_BOOL:
+        return (struct clox_ast_expr_literal) {
+            .kind = CLOX_AST_EXPR_LITERAL_KIND_BOOL,
+            .value.boolean.val = clox_value_as_bool(val),
+        };
+    default:
+        assert(clox_value_is_nil(val) && "strings are folded into literals by rcstr");
+        return (struct clox_ast_expr_literal) { .kind = CLOX_AST_EXPR_LITERAL_KIND_NIL };
+    }
+}
+
+static struct clox_ast_expr_literal literal_dup(const struct clox_ast_expr_literal* lit) {
+    struct clox_ast_expr_literal dup = *lit;
+    if (dup.kind == CLOX_AST_EXPR_LITERAL_KIND_STRING) {
+        dup.value.string.val = rcstr_retain(dup.value.string.val);
+    }
+    return dup;
+}
+
+/**
+ * @brief Turns the expression into a literal in place, so its parent doesn't need to be patched. Its children
+ * are freed, the literal must not depend on them (strings hold their own reference).
+ */
+static void expr_replace_with_literal(struct clox_ast_expr* expr, struct clox_ast_expr_literal lit) {
+    struct clox_ast_expr* child;
+    for (size_t i = 0; (child = clox_ast_expr_child(expr, i)) != NULL; i++) {
+        clox_ast_expr_free(child);
+    }
+    *expr = (struct clox_ast_expr) {
+        .kind = CLOX_AST_EXPR_KIND_LITERAL,
+        .value.literal = lit,
+    };
+}
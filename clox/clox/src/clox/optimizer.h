@@ -0,0 +1,65 @@
+#ifndef CLOX_OPTIMIZER_H
+#define CLOX_OPTIMIZER_H
+
+#include <stddef.h>
+
+#include "strview.h"
+
+struct clox_ast_program;
+
+/**
+ * @brief What the optimizer did to a program
+ */
+struct clox_optimizer_report {
+    /**
+     * @brief Dynamic array (stb_ds) of the globals propagated as constants, in declaration order.
+     * They point to the program tokens lexemes, so the source must outlive them
+     */
+    struct strview* constant_globals;
+    /**
+     * @brief Reads of constant globals replaced by their literal value
+     */
+    size_t propagated;
+    /**
+     * @brief Operations on literals evaluated ahead of time
+     */
+    size_t folded;
+    /**
+     * @brief Chains of binary `+` nodes flattened into concat nodes
+     */
+    size_t concats;
+};
+
+/**
+ * @brief Propagates the globals which are never reassigned as constants, rewriting the program AST in place.
+ *
+ * A global is constant when it's declared only once, no assignment in the whole program targets it and its
+ * initializer folds into a literal. Reads of it placed after its declaration are replaced by that literal, and
+ * operations whose operands end up being literals are folded as well, following the interpreter semantics.
+ * Operations which would fail at runtime (e.g. `-"a"`) are left alone, so their errors are still reported when
+ * (and only if) they are executed.
+ *
+ * The analysis sees the whole program, so it's only sound for complete scripts: REPL lines must not be optimized,
+ * as later lines could assign the globals.
+ *
+ * @param prog
+ * @param report where the outcome is written to. It must be freed with clox_optimizer_report_free
+ */
+void clox_optimizer_propagate_constants(struct clox_ast_program* prog, struct clox_optimizer_report* report);
+
+/**
+ * @brief Flattens left-leaning chains of `+` with at least three operands, one of them being a string literal, into
+ * concat nodes (see struct clox_ast_expr_concat). Those chains can only result in a string, which concat nodes
+ * build with a single allocation instead of one per `+`.
+ * 
+ * Unlike clox_optimizer_propagate_constants, this only looks at each expression on its own, so it's sound for any
+ * program. Running it after propagation finds more string literals.
+ * 
+ * @param prog 
+ * @param report where the number of flattened chains is added to
+ */
+void clox_optimizer_flatten_concats(struct clox_ast_program* prog, struct clox_optimizer_report* report);
+
+void clox_optimizer_report_free(struct clox_optimizer_report* report);
+
+#endif
@@ -0,0 +1,171 @@
+// The checks call the code under test, so they must not be compiled out when NDEBUG is defined (e.g. release builds)
+#undef NDEBUG
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define STB_DS_IMPLEMENTATION
+#include <clox/stb_ds.h>
+
+#include "scanner.h"
+#include "parser.h"
+#include "ast/expr.h"
+#include "ast/statement.h"
+#include "ast/program.h"
+#include "interpreter.h"
+#include "optimizer.h"
+
+static bool is_literal_number(const struct clox_ast_expr* expr, double val) {
+    return expr->kind == CLOX_AST_EXPR_KIND_LITERAL
+        && expr->value.literal.kind == CLOX_AST_EXPR_LITERAL_KIND_NUMBER
+        && expr->value.literal.value.number.val == val;
+}
+
+static bool is_literal_string(const struct clox_ast_expr* expr, const char* val) {
+    if (expr->kind != CLOX_AST_EXPR_KIND_LITERAL || expr->value.literal.kind != CLOX_AST_EXPR_LITERAL_KIND_STRING) {
+        return false;
+    }
+    return strview_equals(rcstr_view(expr->value.literal.value.string.val), strview_from_cstr(val, strlen(val)));
+}
+
+static void test_propagation(void) {
+    const char src[] =
+        "var a = 2;\n"
+        "var b = (a * 3) + 1;\n"
+        "var s = \"con\" + \"st\";\n"
+        "var n;\n"
+        "var d = 1;\n"
+        "d = a;\n"
+        "var e = d + 1;\n"
+        "var t = 1;\n"
+        "var t = b;\n"
+        "{ var a = 5; print a + b; }\n"
+        "print s + \"!\";\n"
+        "print n == nil;\n";
+    struct scanner scanner = {0};
+    scanner_scan_all_from_cstr(&scanner, src, strlen(src));
+
+    struct parser parser;
+    parser_init(&parser, scanner.tokens);
+    struct clox_ast_program* prog = parser_parse(&parser);
+    assert(prog != NULL && arrlen(prog->statements) == 12);
+
+    struct clox_interpreter interpreter;
+    clox_interpreter_init(&interpreter);
+    clox_interpreter_optimize_program(&interpreter, prog);
+
+    // d is assigned, e depends on it and t is declared twice
+    struct strview* constants = interpreter.optimizations.constant_globals;
+    assert(arrlen(constants) == 4);
+    assert(strview_equals(constants[0], strview_from_cstr("a", 1)));
+    assert(strview_equals(constants[1], strview_from_cstr("b", 1)));
+    assert(strview_equals(constants[2], strview_from_cstr("s", 1)));
+    assert(strview_equals(constants[3], strview_from_cstr("n", 1)));
+
+    struct clox_ast_statement** stmts = prog->statements;
+    assert(is_literal_number(stmts[1]->as.var_statement.initializer, 7));
+    assert(is_literal_string(stmts[2]->as.var_statement.initializer, "const"));
+    assert(is_literal_number(stmts[5]->as.expr_statement.expr->value.assign.value, 2));
+    assert(stmts[6]->as.var_statement.initializer->kind == CLOX_AST_EXPR_KIND_BINARY);
+    assert(stmts[8]->as.var_statement.initializer->kind == CLOX_AST_EXPR_KIND_LITERAL);
+
+    // the local a shadows the constant one
+    struct clox_ast_expr* sum = stmts[9]->as.block_statement.statements[1]->as.print_statement.expr;
+    assert(sum->kind == CLOX_AST_EXPR_KIND_BINARY);
+    assert(sum->value.binary.left->kind == CLOX_AST_EXPR_KIND_VAR);
+    assert(is_literal_number(sum->value.binary.right, 7));
+
+    assert(is_literal_string(stmts[10]->as.print_statement.expr, "const!"));
+    struct clox_ast_expr* is_nil = stmts[11]->as.print_statement.expr;
+    assert(is_nil->kind == CLOX_AST_EXPR_KIND_LITERAL && is_nil->value.literal.value.boolean.val);
+
+    // a * 3, d = a, t = b, a + b, s + "!" and n == nil
+    assert(interpreter.optimizations.propagated == 6);
+
+    assert(clox_interpreter_exec_program(&interpreter, prog) == 0);
+    struct clox_value e;
+    assert(clox_env_get(&interpreter.env, strview_from_cstr("e", 1), &e) == 0);
+    assert(clox_value_as_number(e) == 3);
+
+    clox_interpreter_free(&interpreter);
+    clox_ast_program_free(prog);
+    scanner_free(&scanner);
+}
+
+static void test_runtime_errors_are_kept(void) {
+    const char src[] =
+        "print a;\n"
+        "var a = \"x\";\n"
+        "print -a;\n"
+        "print a + 1;\n";
+    struct scanner scanner = {0};
+    scanner_scan_all_from_cstr(&scanner, src, strlen(src));
+
+    struct parser parser;
+    parser_init(&parser, scanner.tokens);
+    struct clox_ast_program* prog = parser_parse(&parser);
+    assert(prog != NULL);
+
+    struct clox_optimizer_report report;
+    clox_optimizer_propagate_constants(prog, &report);
+    assert(arrlen(report.constant_globals) == 1 && report.propagated == 2 && report.folded == 0);
+
+    // reads before the declaration fail at runtime, and so do the operations on the wrong types
+    struct clox_ast_statement** stmts = prog->statements;
+    assert(stmts[0]->as.print_statement.expr->kind == CLOX_AST_EXPR_KIND_VAR);
+    assert(stmts[2]->as.print_statement.expr->kind == CLOX_AST_EXPR_KIND_UNARY);
+    assert(stmts[3]->as.print_statement.expr->kind == CLOX_AST_EXPR_KIND_BINARY);
+
+    clox_optimizer_report_free(&report);
+    clox_ast_program_free(prog);
+    scanner_free(&scanner);
+}
+
+static void test_concat_flattening(void) {
+    const char src[] =
+        "var x = \"a\";\n"
+        "x = \"b\";\n"
+        "var r = x + \"-\" + x + \"-\" + (x = \"c\");\n"
+        "var n = x + x + x;\n"
+        "var p = x + \"!\";\n";
+    struct scanner scanner = {0};
+    scanner_scan_all_from_cstr(&scanner, src, strlen(src));
+
+    struct parser parser;
+    parser_init(&parser, scanner.tokens);
+    struct clox_ast_program* prog = parser_parse(&parser);
+    assert(prog != NULL);
+
+    struct clox_interpreter interpreter;
+    clox_interpreter_init(&interpreter);
+    clox_interpreter_optimize_program(&interpreter, prog);
+    assert(interpreter.optimizations.concats == 1);
+
+    struct clox_ast_expr* concat = prog->statements[2]->as.var_statement.initializer;
+    assert(concat->kind == CLOX_AST_EXPR_KIND_CONCAT);
+    assert(arrlen(concat->value.concat.operands) == 5 && arrlen(concat->value.concat.operators) == 4);
+    assert(is_literal_string(concat->value.concat.operands[3], "-"));
+    assert(concat->value.concat.last_non_leaf == 4);
+
+    // no string literal, so its type isn't known
+    assert(prog->statements[3]->as.var_statement.initializer->kind == CLOX_AST_EXPR_KIND_BINARY);
+    // a single `+` doesn't need to be flattened
+    assert(prog->statements[4]->as.var_statement.initializer->kind == CLOX_AST_EXPR_KIND_BINARY);
+
+    assert(clox_interpreter_exec_program(&interpreter, prog) == 0);
+    struct clox_value r;
+    assert(clox_env_get(&interpreter.env, strview_from_cstr("r", 1), &r) == 0);
+    assert(strview_equals(clox_value_as_strview(&r), strview_from_cstr("b-b-c", 5)));
+
+    clox_interpreter_free(&interpreter);
+    clox_ast_program_free(prog);
+    scanner_free(&scanner);
+}
+
+int main() {
+    test_propagation();
+    test_runtime_errors_are_kept();
+    test_concat_flattening();
+
+    puts("optimizer.unit: ok");
+}
@@ -0,0 +1,102 @@
+#include "output.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// POSIX
+#include <unistd.h>
+
+#include "commons.h"
+
+static int write_all(int fd, const char* ptr, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(fd, ptr, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "error: failed to write output: %s\n", strerror(errno));
+            return 1;
+        }
+        ptr += written;
+        len -= (size_t) written;
+    }
+    return 0;
+}
+
+void clox_output_init(struct clox_output* out, int fd, size_t cap) {
+    if (cap == 0) {
+        cap = CLOX_OUTPUT_DEFAULT_CAP;
+    }
+
+    out->fd = fd;
+    out->buf = malloc(cap);
+    CLOX_ERR_PANIC_OOM_IF_NULL(out->buf);
+    out->cap = cap;
+    out->len = 0;
+    out->line_flush = isatty(fd);
+}
+
+void clox_output_free(struct clox_output* out) {
+    clox_output_flush(out);
+    free(out->buf);
+    out->buf = NULL;
+    out->cap = 0;
+}
+
+void clox_output_set_cap(struct clox_output* out, size_t cap) {
+    clox_output_flush(out);
+    free(out->buf);
+    clox_output_init(out, out->fd, cap);
+}
+
+void clox_output_write(struct clox_output* out, const char* ptr, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    if (out->len + len > out->cap) {
+        clox_output_flush(out);
+        // Too big to be buffered. It's written as is
+        if (len > out->cap) {
+            write_all(out->fd, ptr, len);
+            return;
+        }
+    }
+
+    memcpy(out->buf + out->len, ptr, len);
+    out->len += len;
+
+    if (out->line_flush && memchr(ptr, '\n', len) != NULL) {
+        clox_output_flush(out);
+    }
+}
+
+char* clox_output_reserve(struct clox_output* out, size_t len) {
+    if (len > out->cap) {
+        return NULL;
+    }
+    if (out->len + len > out->cap) {
+        clox_output_flush(out);
+    }
+    return out->buf + out->len;
+}
+
+void clox_output_commit(struct clox_output* out, size_t len) {
+    assert(out->len + len <= out->cap);
+
+    const char* committed = out->buf + out->len;
+    out->len += len;
+
+    if (out->line_flush && memchr(committed, '\n', len) != NULL) {
+        clox_output_flush(out);
+    }
+}
+
+int clox_output_flush(struct clox_output* out) {
+    int rc = write_all(out->fd, out->buf, out->len);
+    out->len = 0;
+    return rc;
+}
@@ -0,0 +1,74 @@
+#ifndef CLOX_OUTPUT_H
+#define CLOX_OUTPUT_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @brief Default output buffer size
+ */
+#define CLOX_OUTPUT_DEFAULT_CAP (64 * 1024)
+
+/**
+ * @brief A buffered output stream written straight to a file descriptor with write(2), bypassing stdio.
+ * 
+ * Output is accumulated in the buffer and written in big batches: when the buffer gets full, on clox_output_flush
+ * and on clox_output_free. When the fd is a terminal, it's also flushed at every line so interactive output
+ * shows up right away.
+ */
+struct clox_output {
+    int fd;
+    char* buf;
+    size_t cap;
+    size_t len;
+    /**
+     * @brief Flushes after every line. Set for terminals
+     */
+    bool line_flush;
+};
+
+/**
+ * @brief Initializes the output stream.
+ * 
+ * @param out 
+ * @param fd the file descriptor where the output goes to
+ * @param cap the buffer size. 0 means CLOX_OUTPUT_DEFAULT_CAP
+ */
+void clox_output_init(struct clox_output* out, int fd, size_t cap);
+
+/**
+ * @brief Flushes the pending output and releases the buffer. Further writes go unbuffered.
+ */
+void clox_output_free(struct clox_output* out);
+
+/**
+ * @brief Changes the buffer size, flushing the pending output first.
+ * 
+ * @param cap the new buffer size. 0 means CLOX_OUTPUT_DEFAULT_CAP
+ */
+void clox_output_set_cap(struct clox_output* out, size_t cap);
+
+void clox_output_write(struct clox_output* out, const char* ptr, size_t len);
+
+/**
+ * @brief Makes room for writing up to len bytes straight into the buffer, flushing the pending output if needed.
+ * The bytes actually written must be committed with clox_output_commit before any other write.
+ * 
+ * @return char* where to write to. NULL if the buffer can't hold len bytes at all, in which case clox_output_write
+ * must be used instead
+ */
+char* clox_output_reserve(struct clox_output* out, size_t len);
+
+/**
+ * @brief Appends the len bytes written into the space given by clox_output_reserve to the pending output.
+ */
+void clox_output_commit(struct clox_output* out, size_t len);
+
+/**
+ * @brief Writes all the pending output to the fd.
+ * 
+ * @return int 0 on success. non-zero if writing failed, in which case the pending output is discarded
+ */
+int clox_output_flush(struct clox_output* out);
+
+#endif
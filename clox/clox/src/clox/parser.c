@@ -16,6 +16,7 @@ static bool check(const struct parser* p, enum token_kind token_kind);
 static int consume(struct parser* p, enum token_kind token_kind, const char* msg);
 
 static void syncronize(struct parser* p);
+static int resolve_local(const struct parser* p, const struct token* name, int32_t* slot);
 
 static struct token advance(struct parser* p);
 static struct token peek(const struct parser* p);
@@ -25,6 +26,8 @@ static bool end_of_input(const struct parser* p);
 void parser_init(struct parser* p, struct token* tokens) {
     p->tokens = tokens;
     p->current = 0;
+    p->locals = NULL;
+    p->scope_depth = 0;
     
 #ifdef DEBUG_DUMP_TOKENS
     for (long int i = 0; i < arrlen(tokens); i++) {
@@ -44,11 +47,13 @@ struct clox_ast_program* parser_parse(struct parser* p) {
         if (stmt == NULL) {
             fprintf(stderr, "error: line %zu: failed to parse statement\n", peek(p).line);
             clox_ast_program_free(prog);
+            arrfree(p->locals);
             return NULL;
         }
         clox_ast_program_add_statement(prog, stmt);
     }
 
+    arrfree(p->locals);
     return prog;
 }
 
@@ -91,7 +96,11 @@ struct clox_ast_expr* parser_parse_expr_assignment(struct parser* p) {
 
         // Check if expr is a valid l-value
         if (expr->kind == CLOX_AST_EXPR_KIND_VAR) {
-            return clox_ast_expr_assign_new(expr->value.var.name, rvalue);
+            struct clox_ast_expr* assign = clox_ast_expr_assign_new(expr->value.var.name, rvalue);
+            assign->value.assign.slot = expr->value.var.slot;
+            // the target var expr is replaced by the assignment node
+            clox_ast_expr_free(expr);
+            return assign;
         }
 
         fprintf(stderr, "error: line: %zu: invalid l-value expression for assignment\n", equals_op.line);
@@ -252,7 +261,14 @@ struct clox_ast_expr* parser_parse_expr_primary(struct parser* p) {
         return clox_ast_expr_grouping_new(expr);
     }
     if (match(p, TOKEN_KIND_IDENTIFIER)) {
-        return clox_ast_expr_var_new(previous(p));
+        struct token name = previous(p);
+        int32_t slot;
+        if (resolve_local(p, &name, &slot) != 0) {
+            return NULL;
+        }
+        struct clox_ast_expr* expr = clox_ast_expr_var_new(name);
+        expr->value.var.slot = slot;
+        return expr;
     }
     struct token current_token = peek(p);
     fprintf(stderr, "error: line %zu: expecting a primary expression (a literal or an opening parentesis '('), got '%s'\n", current_token.line, token_to_cstr(&current_token));
@@ -263,6 +279,9 @@ struct clox_ast_statement* parser_parse_statement(struct parser* p) {
     if (match(p, TOKEN_KIND_PRINT)) {
         return parser_parse_print_statement(p);
     }
+    if (match(p, TOKEN_KIND_LEFT_BRACE)) {
+        return parser_parse_block_statement(p);
+    }
     return parser_parse_expr_statement(p);
 }
 
@@ -290,13 +309,92 @@ struct clox_ast_statement* parser_parse_var_declaration_statement(struct parser*
     consume(p, TOKEN_KIND_IDENTIFIER, "error: expecting variable name");
     struct token var_name = previous(p);
 
+    int32_t slot = CLOX_AST_SLOT_GLOBAL;
+    if (p->scope_depth > 0) {
+        for (long i = arrlen(p->locals) - 1; i >= 0 && p->locals[i].depth >= p->scope_depth; i--) {
+            if (strview_equals(p->locals[i].name, var_name.lexeme)) {
+                fprintf(stderr, "error: line %zu: a variable named '", var_name.line);
+                strview_fprint(var_name.lexeme, stderr);
+                fputs("' is already declared in this scope\n", stderr);
+                return NULL;
+            }
+        }
+        // Declared right away, so reading it from its own initializer can be told apart from reading a shadowed variable
+        slot = (int32_t) arrlen(p->locals);
+        arrpush(p->locals, ((struct parser_local) { .name = var_name.lexeme, .depth = -1 }));
+    }
+
     struct clox_ast_expr* initializer = NULL;
     if (match(p, TOKEN_KIND_EQUAL)) {
         initializer = parser_parse_expr(p);
+        if (initializer == NULL) {
+            return NULL;
+        }
+    }
+
+    if (slot != CLOX_AST_SLOT_GLOBAL) {
+        p->locals[slot].depth = p->scope_depth;
     }
 
     consume(p, TOKEN_KIND_SEMICOLON, "error: expecting ';' after variable declaration");
-    return clox_ast_statement_new_var(var_name, initializer);
+    struct clox_ast_statement* stmt = clox_ast_statement_new_var(var_name, initializer);
+    stmt->as.var_statement.slot = slot;
+    return stmt;
+}
+
+// block -> "{" declaration* "}"
+struct clox_ast_statement* parser_parse_block_statement(struct parser* p) {
+    const size_t first_slot = arrlen(p->locals);
+    struct clox_ast_statement** statements = NULL;
+    bool failed = false;
+
+    p->scope_depth++;
+    while (!check(p, TOKEN_KIND_RIGHT_BRACE) && !end_of_input(p)) {
+        struct clox_ast_statement* stmt = parser_parse_declaration(p);
+        if (stmt == NULL) {
+            failed = true;
+            break;
+        }
+        arrpush(statements, stmt);
+    }
+    p->scope_depth--;
+
+    const size_t slot_count = arrlen(p->locals) - first_slot;
+    // the block locals go out of scope
+    arrsetlen(p->locals, first_slot);
+
+    if (failed || consume(p, TOKEN_KIND_RIGHT_BRACE, "error: expecting '}' after block") != 0) {
+        for (long i = 0; i < arrlen(statements); i++) {
+            clox_ast_statement_free(statements[i]);
+        }
+        arrfree(statements);
+        return NULL;
+    }
+
+    return clox_ast_statement_new_block(statements, (uint32_t) first_slot, (uint32_t) slot_count);
+}
+
+/**
+ * @brief Resolves a variable name to the slot of the innermost local in scope with that name.
+ *
+ * @param slot set to the local slot, or CLOX_AST_SLOT_GLOBAL if no local has that name
+ * @return int non-zero if the name refers to a local being declared (i.e. it's read from its own initializer)
+ */
+static int resolve_local(const struct parser* p, const struct token* name, int32_t* slot) {
+    for (long i = arrlen(p->locals) - 1; i >= 0; i--) {
+        if (strview_equals(p->locals[i].name, name->lexeme)) {
+            if (p->locals[i].depth == -1) {
+                fprintf(stderr, "error: line %zu: can't read local variable '", name->line);
+                strview_fprint(name->lexeme, stderr);
+                fputs("' in its own initializer\n", stderr);
+                return 1;
+            }
+            *slot = (int32_t) i;
+            return 0;
+        }
+    }
+    *slot = CLOX_AST_SLOT_GLOBAL;
+    return 0;
 }
 
 static int consume(struct parser* p, enum token_kind token_kind, const char* msg) {
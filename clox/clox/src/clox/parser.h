@@ -2,14 +2,37 @@
 #define CLOX_PARSER_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+#include "strview.h"
 
 struct token;
 struct clox_ast_stmt;
 struct clox_ast_program;
 
+/**
+ * @brief A block local variable in scope while parsing
+ */
+struct parser_local {
+    struct strview name;
+    /**
+     * @brief Nesting depth of the block where it's declared. -1 while its own initializer is being parsed
+     */
+    int depth;
+};
+
 struct parser {
     struct token* tokens;
     size_t current;
+    /**
+     * @brief Dynamic array (stb_ds) of the locals in scope, innermost last. The index of a local is its slot
+     * in the interpreter locals stack
+     */
+    struct parser_local* locals;
+    /**
+     * @brief Current block nesting depth. 0 is the global scope
+     */
+    int scope_depth;
 };
 
 void parser_init(struct parser* p, struct token* tokens);
@@ -33,5 +56,6 @@ struct clox_ast_statement* parser_parse_statement(struct parser* p);
 struct clox_ast_statement* parser_parse_print_statement(struct parser* p);
 struct clox_ast_statement* parser_parse_expr_statement(struct parser* p);
 struct clox_ast_statement* parser_parse_var_declaration_statement(struct parser* p);
+struct clox_ast_statement* parser_parse_block_statement(struct parser* p);
 
 #endif
@@ -0,0 +1,272 @@
+#include "rcstr.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stb_ds.h"
+#include "mem.h"
+#include "region.h"
+
+struct rcstr_flatten_item {
+    struct rcstr* str;
+    char* dest;
+};
+
+// FNV-1a
+static uint32_t hash_bytes(const char* ptr, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t) ptr[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static size_t rcstr_flat_alloc_size(size_t len) {
+    return sizeof(struct rcstr) + len + 1; // '\0'
+}
+
+static char* rcstr_flat_chars(struct rcstr* str) {
+    return (char*) (str + 1);
+}
+
+/**
+ * @brief Leaves are the strings whose characters are already materialized: flat strings and flattened ropes
+ */
+static bool rcstr_is_leaf(const struct rcstr* str) {
+    return str->kind == RCSTR_KIND_FLAT || ((const struct rcstr_rope*) str)->chars != NULL;
+}
+
+static const char* rcstr_leaf_chars(struct rcstr* str) {
+    if (str->kind == RCSTR_KIND_FLAT) {
+        return rcstr_flat_chars(str);
+    }
+    return ((struct rcstr_rope*) str)->chars;
+}
+
+static void rcstr_check_len(size_t len) {
+    if (len > UINT32_MAX) {
+        fprintf(stderr, "error: %s:%d: string too long (%zu bytes)\n", __FILE__, __LINE__, len);
+        exit(1);
+    }
+}
+
+static struct rcstr* rcstr_flat_alloc(struct clox_region* region, size_t len) {
+    rcstr_check_len(len);
+
+    struct rcstr* str = (region != NULL)
+        ? clox_region_alloc(region, rcstr_flat_alloc_size(len))
+        : clox_mem_alloc(rcstr_flat_alloc_size(len));
+    *str = (struct rcstr) {
+        .refcount = 1,
+        .len = len,
+        .kind = RCSTR_KIND_FLAT,
+        .hashed = false,
+        .in_region = (region != NULL),
+    };
+    rcstr_flat_chars(str)[len] = '\0';
+    return str;
+}
+
+/**
+ * @brief Frees a string that is no longer referenced. Unflattened ropes children must be handled by the caller.
+ */
+static void rcstr_dealloc(struct rcstr* str) {
+    if (str->kind == RCSTR_KIND_FLAT) {
+        clox_mem_free(str, rcstr_flat_alloc_size(str->len));
+        return;
+    }
+    struct rcstr_rope* rope = (struct rcstr_rope*) str;
+    if (rope->chars != NULL) {
+        clox_mem_free(rope->chars, str->len + 1);
+    }
+    clox_mem_free(rope, sizeof(struct rcstr_rope));
+}
+
+struct rcstr* rcstr_new(const char* ptr, size_t len) {
+    struct rcstr* str = rcstr_flat_alloc(NULL, len);
+    memcpy(rcstr_flat_chars(str), ptr, len);
+    return str;
+}
+
+struct rcstr* rcstr_from_strview(struct strview sv) {
+    return rcstr_new(sv.ptr, sv.len);
+}
+
+struct rcstr* rcstr_new_concat(struct strview a, struct strview b) {
+    return rcstr_new_concat_in(NULL, a, b);
+}
+
+struct rcstr* rcstr_new_concat_in(struct clox_region* region, struct strview a, struct strview b) {
+    struct rcstr* str = rcstr_flat_alloc(region, a.len + b.len);
+    memcpy(rcstr_flat_chars(str), a.ptr, a.len);
+    memcpy(rcstr_flat_chars(str) + a.len, b.ptr, b.len);
+    return str;
+}
+
+struct rcstr* rcstr_new_concat_n_in(struct clox_region* region, const struct strview* parts, size_t count) {
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++) {
+        len += parts[i].len;
+    }
+
+    struct rcstr* str = rcstr_flat_alloc(region, len);
+    char* chars = rcstr_flat_chars(str);
+    for (size_t i = 0; i < count; i++) {
+        memcpy(chars, parts[i].ptr, parts[i].len);
+        chars += parts[i].len;
+    }
+    return str;
+}
+
+struct rcstr* rcstr_concat(struct rcstr* a, struct rcstr* b) {
+    size_t len = (size_t) a->len + b->len;
+    rcstr_check_len(len);
+
+    if (len < RCSTR_ROPE_MIN_LEN) {
+        return rcstr_new_concat(rcstr_view(a), rcstr_view(b));
+    }
+
+    struct rcstr_rope* rope = clox_mem_alloc(sizeof(struct rcstr_rope));
+    *rope = (struct rcstr_rope) {
+        .base = (struct rcstr) {
+            .refcount = 1,
+            .len = len,
+            .kind = RCSTR_KIND_ROPE,
+            .hashed = false,
+        },
+        .chars = NULL,
+        .left = a->in_region ? rcstr_promote(a) : rcstr_retain(a),
+        .right = b->in_region ? rcstr_promote(b) : rcstr_retain(b),
+    };
+    return &rope->base;
+}
+
+struct rcstr* rcstr_promote(struct rcstr* str) {
+    if (!str->in_region) {
+        return str;
+    }
+    // only flat strings live in regions
+    return rcstr_new(rcstr_flat_chars(str), str->len);
+}
+
+struct rcstr* rcstr_retain(struct rcstr* str) {
+    str->refcount++;
+    return str;
+}
+
+// Ropes built by repeated concatenation can be very deep, so neither release nor flatten may recurse.
+// Both walk the rope iteratively, continuing into the child which is still a rope and only queueing
+// work when both children are ropes. Degenerated (left or right leaning) ropes never queue anything.
+
+void rcstr_release(struct rcstr* str) {
+    struct rcstr** pending = NULL;
+
+    while (str != NULL) {
+        struct rcstr* next = NULL;
+
+        // region strings are released along with their region
+        if (!str->in_region && --str->refcount == 0) {
+            if (!rcstr_is_leaf(str)) {
+                struct rcstr_rope* rope = (struct rcstr_rope*) str;
+                if (rcstr_is_leaf(rope->left)) {
+                    rcstr_release(rope->left);
+                    next = rope->right;
+                } else if (rcstr_is_leaf(rope->right)) {
+                    rcstr_release(rope->right);
+                    next = rope->left;
+                } else {
+                    arrpush(pending, rope->right);
+                    next = rope->left;
+                }
+            }
+            rcstr_dealloc(str);
+        }
+
+        if (next == NULL && arrlen(pending) > 0) {
+            next = arrpop(pending);
+        }
+        str = next;
+    }
+
+    arrfree(pending);
+}
+
+static void rcstr_flatten(struct rcstr_rope* rope) {
+    char* chars = clox_mem_alloc(rope->base.len + 1);
+    chars[rope->base.len] = '\0';
+
+    struct rcstr_flatten_item* pending = NULL;
+    struct rcstr_flatten_item item = { .str = &rope->base, .dest = chars };
+
+    while (item.str != NULL) {
+        struct rcstr_flatten_item next = {0};
+
+        if (rcstr_is_leaf(item.str)) {
+            memcpy(item.dest, rcstr_leaf_chars(item.str), item.str->len);
+        } else {
+            struct rcstr_rope* node = (struct rcstr_rope*) item.str;
+            struct rcstr_flatten_item left = { .str = node->left, .dest = item.dest };
+            struct rcstr_flatten_item right = { .str = node->right, .dest = item.dest + node->left->len };
+
+            if (rcstr_is_leaf(left.str)) {
+                memcpy(left.dest, rcstr_leaf_chars(left.str), left.str->len);
+                next = right;
+            } else if (rcstr_is_leaf(right.str)) {
+                memcpy(right.dest, rcstr_leaf_chars(right.str), right.str->len);
+                next = left;
+            } else {
+                arrpush(pending, right);
+                next = left;
+            }
+        }
+
+        if (next.str == NULL && arrlen(pending) > 0) {
+            next = arrpop(pending);
+        }
+        item = next;
+    }
+
+    arrfree(pending);
+
+    struct rcstr* left = rope->left;
+    struct rcstr* right = rope->right;
+    rope->chars = chars;
+    rope->left = rope->right = NULL;
+
+    rcstr_release(left);
+    rcstr_release(right);
+}
+
+const char* rcstr_chars(struct rcstr* str) {
+    if (!rcstr_is_leaf(str)) {
+        rcstr_flatten((struct rcstr_rope*) str);
+    }
+    return rcstr_leaf_chars(str);
+}
+
+struct strview rcstr_view(struct rcstr* str) {
+    return strview_from_cstr(rcstr_chars(str), str->len);
+}
+
+uint32_t rcstr_hash(struct rcstr* str) {
+    if (!str->hashed) {
+        str->hash = hash_bytes(rcstr_chars(str), str->len);
+        str->hashed = true;
+    }
+    return str->hash;
+}
+
+bool rcstr_equals(struct rcstr* a, struct rcstr* b) {
+    if (a == b) {
+        return true;
+    }
+    if (a->len != b->len) {
+        return false;
+    }
+    if (a->hashed && b->hashed && a->hash != b->hash) {
+        return false;
+    }
+    return memcmp(rcstr_chars(a), rcstr_chars(b), a->len) == 0;
+}
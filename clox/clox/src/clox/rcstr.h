@@ -0,0 +1,126 @@
+#ifndef CLOX_RCSTR_H
+#define CLOX_RCSTR_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "strview.h"
+
+struct clox_region;
+
+/**
+ * @brief Concatenations shorter than this are just copied. Ropes only pay off for long strings.
+ */
+#define RCSTR_ROPE_MIN_LEN 256
+
+enum rcstr_kind {
+    /**
+     * @brief The characters are stored inline, right after the header
+     */
+    RCSTR_KIND_FLAT,
+    /**
+     * @brief A lazy concatenation of two other strings (see struct rcstr_rope)
+     */
+    RCSTR_KIND_ROPE,
+};
+
+/**
+ * @brief An immutable, reference counted string.
+ * 
+ * Flat strings keep the header and the characters in the same allocation. Sharing a string (between the AST,
+ * values and the environment) costs just a reference count increment.
+ * 
+ * Concatenations of long strings are ropes: they just reference both operands, so `s = s + piece` is O(1).
+ * The characters are materialized (flattened) only when they're actually needed, through rcstr_chars.
+ * 
+ * Temporary flat strings may live in a region instead (see rcstr_new_concat_in). Those aren't reference counted:
+ * they die all at once when the region is reset, so they must be promoted (see rcstr_promote) to outlive it.
+ */
+struct rcstr {
+    uint32_t refcount;
+    /**
+     * @brief The cached hash. Only valid if hashed is true. Use rcstr_hash
+     */
+    uint32_t hash;
+    uint32_t len;
+    uint8_t kind;
+    bool hashed;
+    /**
+     * @brief Whether the string was allocated in a region. Releasing those is a noop
+     */
+    bool in_region;
+};
+
+struct rcstr_rope {
+    struct rcstr base;
+    /**
+     * @brief The '\0' terminated characters once flattened, or NULL if not flattened yet
+     */
+    char* chars;
+    /**
+     * @brief The concatenation operands. Both are released when the rope gets flattened
+     */
+    struct rcstr* left;
+    struct rcstr* right;
+};
+
+/**
+ * @brief Creates a new string copying len bytes from ptr. Its reference count starts at 1.
+ */
+struct rcstr* rcstr_new(const char* ptr, size_t len);
+struct rcstr* rcstr_from_strview(struct strview sv);
+
+/**
+ * @brief Creates a new flat string with the contents of a followed by the contents of b. Its reference count starts at 1.
+ */
+struct rcstr* rcstr_new_concat(struct strview a, struct strview b);
+
+/**
+ * @brief Same as rcstr_new_concat, but allocating from region when it's not NULL.
+ */
+struct rcstr* rcstr_new_concat_in(struct clox_region* region, struct strview a, struct strview b);
+
+/**
+ * @brief Creates a new flat string with the contents of all parts, in order, allocating from region when it's not
+ * NULL. It's allocated once, with its final size. Its reference count starts at 1.
+ */
+struct rcstr* rcstr_new_concat_n_in(struct clox_region* region, const struct strview* parts, size_t count);
+
+/**
+ * @brief Creates a new string with the contents of a followed by the contents of b. Its reference count starts at 1.
+ * 
+ * Short results are copied into a new flat string. Long ones become a rope referencing both a and b.
+ * Ropes always live in the heap, so operands living in a region are copied out of it.
+ */
+struct rcstr* rcstr_concat(struct rcstr* a, struct rcstr* b);
+
+/**
+ * @brief Makes sure the string outlives any region.
+ * 
+ * @return struct rcstr* str itself if it isn't in a region. Otherwise a heap copy of it, owned by the caller
+ */
+struct rcstr* rcstr_promote(struct rcstr* str);
+
+/**
+ * @brief Acquires a new reference to the string.
+ * 
+ * @return struct rcstr* the same string, for convenience
+ */
+struct rcstr* rcstr_retain(struct rcstr* str);
+
+/**
+ * @brief Drops a reference to the string, freeing it when it was the last one. NULL is a noop.
+ */
+void rcstr_release(struct rcstr* str);
+
+/**
+ * @brief Gets the '\0' terminated characters of the string, flattening it first if it's a rope.
+ */
+const char* rcstr_chars(struct rcstr* str);
+struct strview rcstr_view(struct rcstr* str);
+uint32_t rcstr_hash(struct rcstr* str);
+
+bool rcstr_equals(struct rcstr* a, struct rcstr* b);
+
+#endif
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define STB_DS_IMPLEMENTATION
+#include <clox/stb_ds.h>
+
+#include "rcstr.h"
+#include "mem.h"
+#include "region.h"
+
+int main() {
+    struct rcstr* hello = rcstr_new("hello, ", 7);
+    struct rcstr* world = rcstr_from_strview(strview_from_cstr("world", 5));
+    assert(hello->refcount == 1);
+    assert(rcstr_chars(hello)[hello->len] == '\0');
+
+    struct rcstr* greeting = rcstr_concat(hello, world);
+    assert(greeting->len == 12);
+    assert(strcmp(rcstr_chars(greeting), "hello, world") == 0);
+
+    // sharing doesn't allocate
+    size_t allocs = clox_mem_stats()->allocs;
+    struct rcstr* shared = rcstr_retain(greeting);
+    assert(shared == greeting);
+    assert(greeting->refcount == 2);
+    assert(clox_mem_stats()->allocs == allocs);
+
+    struct rcstr* other = rcstr_new("hello, world", 12);
+    assert(rcstr_equals(greeting, other));
+    assert(rcstr_hash(greeting) == rcstr_hash(other));
+    assert(!rcstr_equals(greeting, hello));
+
+    struct rcstr* empty = rcstr_new("", 0);
+    assert(empty->len == 0 && rcstr_chars(empty)[0] == '\0');
+
+    // long concatenations are ropes, which are flattened on demand
+    struct rcstr* piece = rcstr_new("0123456789abcdef", 16);
+    struct rcstr* left_leaning = rcstr_retain(piece);
+    struct rcstr* right_leaning = rcstr_retain(piece);
+    const size_t pieces = 100000;
+    for (size_t i = 1; i < pieces; i++) {
+        struct rcstr* l = rcstr_concat(left_leaning, piece);
+        rcstr_release(left_leaning);
+        left_leaning = l;
+
+        struct rcstr* r = rcstr_concat(piece, right_leaning);
+        rcstr_release(right_leaning);
+        right_leaning = r;
+    }
+    assert(left_leaning->kind == RCSTR_KIND_ROPE);
+    assert(left_leaning->len == pieces * piece->len);
+    assert(memcmp(rcstr_chars(left_leaning) + 1600, rcstr_chars(piece), piece->len) == 0);
+    assert(rcstr_equals(left_leaning, right_leaning));
+
+    struct rcstr* balanced = rcstr_concat(left_leaning, right_leaning);
+    assert(balanced->len == 2 * pieces * piece->len);
+    assert(rcstr_chars(balanced)[balanced->len - 1] == 'f');
+
+    // never flattened ropes must be released without recursion as well
+    struct rcstr* deep = rcstr_retain(piece);
+    for (size_t i = 1; i < pieces; i++) {
+        struct rcstr* d = rcstr_concat(deep, piece);
+        rcstr_release(deep);
+        deep = d;
+    }
+    rcstr_release(deep);
+
+    // region strings are released in bulk and promoted when they must outlive the region
+    struct clox_region region;
+    clox_region_init(&region);
+    struct rcstr* temp = rcstr_new_concat_in(&region, rcstr_view(hello), rcstr_view(world));
+    assert(temp->in_region && rcstr_equals(temp, greeting));
+    rcstr_release(temp);
+    struct rcstr* promoted = rcstr_promote(temp);
+    assert(promoted != temp && !promoted->in_region && rcstr_equals(promoted, greeting));
+    assert(rcstr_promote(promoted) == promoted);
+    char xs[RCSTR_ROPE_MIN_LEN];
+    memset(xs, 'x', sizeof(xs));
+    struct rcstr* long_temp = rcstr_new_concat_in(&region, strview_from_cstr(xs, sizeof(xs)), strview_from_cstr("y", 1));
+    struct rcstr* long_rope = rcstr_concat(long_temp, long_temp);
+    assert(long_rope->kind == RCSTR_KIND_ROPE);
+    clox_region_reset(&region);
+    // the rope children were copied out of the region
+    assert(long_rope->len == 2 * (sizeof(xs) + 1) && rcstr_chars(long_rope)[sizeof(xs)] == 'y');
+    assert(rcstr_chars(long_rope)[long_rope->len - 1] == 'y');
+    rcstr_release(long_rope);
+    rcstr_release(promoted);
+    clox_region_free(&region);
+
+    rcstr_release(balanced);
+    rcstr_release(right_leaning);
+    rcstr_release(left_leaning);
+    rcstr_release(piece);
+    rcstr_release(empty);
+    rcstr_release(other);
+    rcstr_release(shared);
+    rcstr_release(greeting);
+    rcstr_release(world);
+    rcstr_release(hello);
+
+    assert(clox_mem_stats()->allocs == clox_mem_stats()->frees);
+    assert(clox_mem_stats()->live_bytes == 0);
+
+    puts("rcstr.unit: ok");
+}
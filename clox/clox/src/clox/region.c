@@ -0,0 +1,70 @@
+#include "region.h"
+
+#include <stdalign.h>
+#include <stddef.h>
+
+#include "mem.h"
+
+struct clox_region_chunk {
+    struct clox_region_chunk* next;
+    size_t cap;
+    size_t used;
+    alignas(max_align_t) unsigned char data[];
+};
+
+static size_t align_up(size_t size) {
+    const size_t align = alignof(max_align_t);
+    return (size + align - 1) & ~(align - 1);
+}
+
+static void chunk_free(struct clox_region_chunk* chunk) {
+    clox_mem_free(chunk, sizeof(struct clox_region_chunk) + chunk->cap);
+}
+
+void clox_region_init(struct clox_region* region) {
+    region->head = NULL;
+}
+
+void clox_region_free(struct clox_region* region) {
+    struct clox_region_chunk* chunk = region->head;
+    while (chunk != NULL) {
+        struct clox_region_chunk* next = chunk->next;
+        chunk_free(chunk);
+        chunk = next;
+    }
+    region->head = NULL;
+}
+
+void* clox_region_alloc(struct clox_region* region, size_t size) {
+    size = align_up(size);
+
+    struct clox_region_chunk* chunk = region->head;
+    if (chunk == NULL || chunk->cap - chunk->used < size) {
+        size_t cap = (size > CLOX_REGION_CHUNK_SIZE) ? size : CLOX_REGION_CHUNK_SIZE;
+        chunk = clox_mem_alloc(sizeof(struct clox_region_chunk) + cap);
+        chunk->next = region->head;
+        chunk->cap = cap;
+        chunk->used = 0;
+        region->head = chunk;
+    }
+
+    void* ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+void clox_region_reset(struct clox_region* region) {
+    struct clox_region_chunk* chunk = region->head;
+    if (chunk == NULL) {
+        return;
+    }
+
+    // Keeps only the oldest chunk, which is always a regular sized one unless the very first allocation was huge
+    while (chunk->next != NULL) {
+        struct clox_region_chunk* next = chunk->next;
+        chunk_free(chunk);
+        chunk = next;
+    }
+    chunk->used = 0;
+    region->head = chunk;
+}
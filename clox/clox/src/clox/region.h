@@ -0,0 +1,48 @@
+#ifndef CLOX_REGION_H
+#define CLOX_REGION_H
+
+#include <stddef.h>
+
+/**
+ * @brief Default size of the region chunks. Bigger allocations get a chunk of their own
+ */
+#define CLOX_REGION_CHUNK_SIZE (64 * 1024)
+
+struct clox_region_chunk;
+
+/**
+ * @brief A region (a.k.a. arena) allocator.
+ * 
+ * Allocations are bumped out of big chunks and can't be released individually. Instead, everything is released
+ * at once by clox_region_reset. The first chunk is kept around after a reset, so a region that is reset regularly
+ * (e.g. after each statement) stops hitting the system allocator at all.
+ * 
+ * A zeroed region is an empty region.
+ */
+struct clox_region {
+    /**
+     * @brief The chunk being allocated from. Older chunks are linked from it
+     */
+    struct clox_region_chunk* head;
+};
+
+void clox_region_init(struct clox_region* region);
+
+/**
+ * @brief Releases every chunk of the region.
+ */
+void clox_region_free(struct clox_region* region);
+
+/**
+ * @brief Allocates size bytes of uninitialized memory, suitably aligned for any type. Panics on out of memory.
+ * 
+ * @return void* the memory, valid until the next reset
+ */
+void* clox_region_alloc(struct clox_region* region, size_t size);
+
+/**
+ * @brief Releases all the allocations made so far, at once.
+ */
+void clox_region_reset(struct clox_region* region);
+
+#endif
@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include "commons.h"
+#include "mem.h"
 
 struct str str_empty(void) {
     return (struct str) {
@@ -23,8 +24,7 @@ struct str str_dup(struct str str) {
         return str_empty();
     }
 
-    char* ptr = calloc(str.cap, sizeof(char));
-    CLOX_ERR_PANIC_OOM_IF_NULL(ptr);
+    char* ptr = clox_mem_calloc(str.cap, sizeof(char));
 
     memcpy(ptr, str.ptr, str.len);
 
@@ -37,7 +37,7 @@ struct str str_dup(struct str str) {
 
 void str_free(struct str* str) {
     if (str->ptr) {
-        free(str->ptr);
+        clox_mem_free(str->ptr, str->cap);
         str->ptr = NULL;
     }
     str->cap = str->len = 0;
@@ -56,8 +56,7 @@ struct str str_concat(struct str a, struct str b) {
     str.len = a.len + b.len;
     str.cap = str.len + 1; // '\0'
 
-    str.ptr = calloc(str.cap, sizeof(char));
-    CLOX_ERR_PANIC_OOM_IF_NULL(str.ptr);
+    str.ptr = clox_mem_calloc(str.cap, sizeof(char));
 
     memcpy(str.ptr, a.ptr, a.len);
     memcpy(str.ptr + a.len, b.ptr, b.len);
@@ -1,6 +1,7 @@
 #include "strview.h"
 
 #include <assert.h>
+#include <string.h>
 
 struct strview strview_empty() {
     return (struct strview) {
@@ -28,6 +29,10 @@ bool strview_is_empty(struct strview sv) {
     return sv.len == 0;
 }
 
+bool strview_equals(struct strview a, struct strview b) {
+    return a.len == b.len && memcmp(a.ptr, b.ptr, a.len) == 0;
+}
+
 void strview_print(struct strview sv) {
     strview_fprint(sv, stdin);
 }
@@ -19,5 +19,6 @@ void strview_print(struct strview sv);
 void strview_fprint(struct strview sv, FILE* file);
 
 bool strview_is_empty(struct strview sv);
+bool strview_equals(struct strview a, struct strview b);
 
 #endif
@@ -4,6 +4,8 @@
 #include <string.h>
 #include <assert.h>
 
+#include "dtoa.h"
+
 struct token token_new_eof(size_t line) {
     return (struct token) {
         .kind = TOKEN_KIND_EOF,
@@ -77,8 +79,9 @@ const char* token_kind_to_cstr(enum token_kind kind) {
 void token_fprint(FILE* file, const struct token* token) {
     switch(token->kind) {
     case TOKEN_KIND_NUMBER: {
-        double val = token->value.number.val;
-        fprintf(file, "<%s(%lf)>", token_to_cstr(token), val);
+        fprintf(file, "<%s(", token_to_cstr(token));
+        clox_dtoa_fprint(file, token->value.number.val);
+        fputs(")>", file);
     } break;
     case TOKEN_KIND_STRING: {
         struct strview sv = token->value.string.val;
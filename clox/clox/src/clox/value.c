@@ -1,7 +1,11 @@
 #include "value.h"
+#include "output.h"
+#include "dtoa.h"
 
 #include <assert.h>
 #include <math.h>
+#include <stdint.h>
+#include <string.h>
 
 const char* clox_value_kind_to_cstr(enum clox_value_kind kind) {
     switch (kind) {
@@ -13,80 +17,229 @@ const char* clox_value_kind_to_cstr(enum clox_value_kind kind) {
     return NULL;
 }
 
-struct clox_value clox_value_bool(bool val) {
-    return (struct clox_value) {
-        .kind = CLOX_VALUE_KIND_BOOL,
-        .as.boolean = val,
-    };
+#ifdef CLOX_NAN_BOXING
+
+static struct rcstr* clox_value_as_rcstr(const struct clox_value* val) {
+    return (struct rcstr*) (uintptr_t) (val->bits & ~(CLOX_VALUE_SIGN_BIT | CLOX_VALUE_QNAN));
 }
 
-struct clox_value clox_value_nil(void) {
-    return (struct clox_value) {
-        .kind = CLOX_VALUE_KIND_NIL,
-        .as = {0}
-    };
+static bool clox_value_is_heap_string(const struct clox_value* val) {
+    return clox_value_is_string(*val);
 }
 
-struct clox_value clox_value_number(double val) {
-    return (struct clox_value) {
-        .kind = CLOX_VALUE_KIND_NUMBER,
-        .as.number = val,
-    };
+static size_t clox_value_string_len(const struct clox_value* val) {
+    return clox_value_as_rcstr(val)->len;
 }
 
-struct clox_value clox_value_dup(struct clox_value val) {
-    if (val.kind == CLOX_VALUE_KIND_STRING) {
-        return clox_value_string_str_dup(val.as.string);
+struct clox_value clox_value_string(struct rcstr* val) {
+    uint64_t ptr = (uint64_t) (uintptr_t) val;
+    assert((ptr & (CLOX_VALUE_SIGN_BIT | CLOX_VALUE_QNAN)) == 0 && "pointer doesn't fit in a NaN payload");
+    return (struct clox_value) { CLOX_VALUE_SIGN_BIT | CLOX_VALUE_QNAN | ptr };
+}
+
+struct clox_value clox_value_string_from_strview(struct strview sv) {
+    return clox_value_string(rcstr_from_strview(sv));
+}
+
+#else
+
+static struct rcstr* clox_value_as_rcstr(const struct clox_value* val) {
+    return val->as.string;
+}
+
+static bool clox_value_is_heap_string(const struct clox_value* val) {
+    return val->kind == CLOX_VALUE_KIND_STRING && val->string_repr == CLOX_VALUE_STRING_REPR_HEAP;
+}
+
+static size_t clox_value_string_len(const struct clox_value* val) {
+    if (val->string_repr == CLOX_VALUE_STRING_REPR_SMALL) {
+        return val->as.small_string.len;
     }
-    return val;
+    return val->as.string->len;
 }
 
-struct clox_value clox_value_string_str_dup(struct str val) {
+struct clox_value clox_value_string(struct rcstr* val) {
     return (struct clox_value) {
         .kind = CLOX_VALUE_KIND_STRING,
-        .as.string = str_dup(val),
+        .string_repr = CLOX_VALUE_STRING_REPR_HEAP,
+        .as.string = val,
     };
 }
 
-struct clox_value clox_value_string_str_borrow(struct str val) {
-    return (struct clox_value) {
+static struct clox_value clox_value_small_string_concat(struct strview a, struct strview b) {
+    assert(a.len + b.len <= CLOX_VALUE_SMALL_STRING_MAX);
+
+    struct clox_value val = {
         .kind = CLOX_VALUE_KIND_STRING,
-        .as.string = val,
+        .string_repr = CLOX_VALUE_STRING_REPR_SMALL,
+        .as.small_string = {{0}},
     };
+    memcpy(val.as.small_string.chars, a.ptr, a.len);
+    memcpy(val.as.small_string.chars + a.len, b.ptr, b.len);
+    val.as.small_string.len = a.len + b.len;
+    return val;
+}
+
+struct clox_value clox_value_string_from_strview(struct strview sv) {
+    if (sv.len <= CLOX_VALUE_SMALL_STRING_MAX) {
+        return clox_value_small_string_concat(sv, strview_empty());
+    }
+    return clox_value_string(rcstr_from_strview(sv));
+}
+
+#endif
+
+struct clox_value clox_value_dup(struct clox_value val) {
+    if (clox_value_is_heap_string(&val)) {
+        rcstr_retain(clox_value_as_rcstr(&val));
+    }
+    return val;
+}
+
+struct clox_value clox_value_string_concat(struct clox_region* region, struct clox_value* left, struct clox_value* right) {
+    assert(clox_value_is_string(*left) && clox_value_is_string(*right));
+
+    // NOTE the operands may be ropes. They must not be flattened just to know their length
+    size_t len = clox_value_string_len(left) + clox_value_string_len(right);
+
+#ifndef CLOX_NAN_BOXING
+    if (len <= CLOX_VALUE_SMALL_STRING_MAX) {
+        return clox_value_small_string_concat(clox_value_as_strview(left), clox_value_as_strview(right));
+    }
+#endif
+    if (len < RCSTR_ROPE_MIN_LEN) {
+        return clox_value_string(rcstr_new_concat_in(region, clox_value_as_strview(left), clox_value_as_strview(right)));
+    }
+
+    // Long enough to become a rope, which needs both operands on the heap
+    struct rcstr* left_str = clox_value_is_heap_string(left)
+        ? rcstr_retain(clox_value_as_rcstr(left))
+        : rcstr_from_strview(clox_value_as_strview(left));
+    struct rcstr* right_str = clox_value_is_heap_string(right)
+        ? rcstr_retain(clox_value_as_rcstr(right))
+        : rcstr_from_strview(clox_value_as_strview(right));
+    struct rcstr* concatenation = rcstr_concat(left_str, right_str);
+    rcstr_release(right_str);
+    rcstr_release(left_str);
+
+    return clox_value_string(concatenation);
+}
+
+struct clox_value clox_value_string_concat_n(struct clox_region* region, const struct strview* parts, size_t count) {
+#ifndef CLOX_NAN_BOXING
+    size_t len = 0;
+    for (size_t i = 0; i < count && len <= CLOX_VALUE_SMALL_STRING_MAX; i++) {
+        len += parts[i].len;
+    }
+    if (len <= CLOX_VALUE_SMALL_STRING_MAX) {
+        struct clox_value val = clox_value_small_string_concat(strview_empty(), strview_empty());
+        for (size_t i = 0; i < count; i++) {
+            memcpy(val.as.small_string.chars + val.as.small_string.len, parts[i].ptr, parts[i].len);
+            val.as.small_string.len += parts[i].len;
+        }
+        return val;
+    }
+#endif
+    return clox_value_string(rcstr_new_concat_n_in(region, parts, count));
+}
+
+struct clox_value clox_value_promote(struct clox_value val) {
+    if (clox_value_is_heap_string(&val)) {
+        struct rcstr* str = clox_value_as_rcstr(&val);
+        if (str->in_region) {
+            return clox_value_string(rcstr_promote(str));
+        }
+    }
+    return val;
+}
+
+struct strview clox_value_as_strview(struct clox_value* val) {
+    assert(clox_value_is_string(*val));
+
+#ifndef CLOX_NAN_BOXING
+    if (val->string_repr == CLOX_VALUE_STRING_REPR_SMALL) {
+        return strview_from_cstr(val->as.small_string.chars, val->as.small_string.len);
+    }
+#endif
+    return rcstr_view(clox_value_as_rcstr(val));
 }
 
 void clox_value_free(struct clox_value* val) {
-    if (val->kind == CLOX_VALUE_KIND_STRING) {
-        str_free(&val->as.string);
+    if (clox_value_is_heap_string(val)) {
+        rcstr_release(clox_value_as_rcstr(val));
     }
     *val = clox_value_nil();
 }
 
 void clox_value_fprintln(FILE* file, struct clox_value val) {
-    switch (val.kind) {
+    switch (clox_value_get_kind(val)) {
     case CLOX_VALUE_KIND_BOOL:
-        fprintf(file, "%s\n", (val.as.boolean) ? "true" : "false");
+        fprintf(file, "%s\n", clox_value_as_bool(val) ? "true" : "false");
         break;
 
     case CLOX_VALUE_KIND_NIL:
         fputs("nil\n", file);
         break;
 
-    case CLOX_VALUE_KIND_NUMBER:
-        fprintf(file, "%lf\n", val.as.number);
+    case CLOX_VALUE_KIND_NUMBER: {
+        char number[CLOX_DTOA_BUF_SIZE + 1];
+        size_t len = clox_dtoa(clox_value_as_number(val), number);
+        number[len++] = '\n';
+        fwrite(number, 1, len, file);
         break;
+    }
 
     case CLOX_VALUE_KIND_STRING:
         //FIXME this is spefic to the repl mode. this doesn't make sense for scripting mode
-        fprintf(file, "\"%s\"\n", val.as.string.ptr);
+        fprintf(file, "\"%s\"\n", clox_value_as_strview(&val).ptr);
         break;
     }
 }
 
+void clox_value_println(struct clox_output* out, struct clox_value val) {
+    switch (clox_value_get_kind(val)) {
+    case CLOX_VALUE_KIND_BOOL:
+        if (clox_value_as_bool(val)) {
+            clox_output_write(out, "true\n", 5);
+        } else {
+            clox_output_write(out, "false\n", 6);
+        }
+        break;
+
+    case CLOX_VALUE_KIND_NIL:
+        clox_output_write(out, "nil\n", 4);
+        break;
+
+    case CLOX_VALUE_KIND_NUMBER: {
+        // formatted in place, unless the output is unbuffered
+        char number[CLOX_DTOA_BUF_SIZE + 1];
+        char* dest = clox_output_reserve(out, sizeof(number));
+        size_t len = clox_dtoa(clox_value_as_number(val), (dest != NULL) ? dest : number);
+        if (dest != NULL) {
+            dest[len++] = '\n';
+            clox_output_commit(out, len);
+        } else {
+            number[len++] = '\n';
+            clox_output_write(out, number, len);
+        }
+        break;
+    }
+
+    case CLOX_VALUE_KIND_STRING: {
+        //FIXME this is spefic to the repl mode. this doesn't make sense for scripting mode
+        struct strview sv = clox_value_as_strview(&val);
+        clox_output_write(out, "\"", 1);
+        clox_output_write(out, sv.ptr, sv.len);
+        clox_output_write(out, "\"\n", 2);
+        break;
+    }
+    }
+}
+
 void clox_value_fdump(FILE* file, struct clox_value val) {
-    switch (val.kind) {
+    switch (clox_value_get_kind(val)) {
     case CLOX_VALUE_KIND_BOOL:
-        fprintf(file, "%s", (val.as.boolean) ? "true" : "false");
+        fprintf(file, "%s", clox_value_as_bool(val) ? "true" : "false");
         break;
 
     case CLOX_VALUE_KIND_NIL:
@@ -94,23 +247,23 @@ void clox_value_fdump(FILE* file, struct clox_value val) {
         break;
 
     case CLOX_VALUE_KIND_NUMBER:
-        fprintf(file, "%lf", val.as.number);
+        clox_dtoa_fprint(file, clox_value_as_number(val));
         break;
 
     case CLOX_VALUE_KIND_STRING:
         //FIXME this is spefic to the repl mode. this doesn't make sense for scripting mode
-        fprintf(file, "%s", val.as.string.ptr);
+        fputs(clox_value_as_strview(&val).ptr, file);
         break;
     }
 }
 
 bool clox_value_is_truthy(struct clox_value value) {
-    switch (value.kind) {
+    switch (clox_value_get_kind(value)) {
     case CLOX_VALUE_KIND_NIL:
         return false;
         
     case CLOX_VALUE_KIND_BOOL:
-        return value.as.boolean;
+        return clox_value_as_bool(value);
 
     default:
         return true;
@@ -118,24 +271,33 @@ bool clox_value_is_truthy(struct clox_value value) {
 }
 
 bool clox_value_is_equal(struct clox_value left, struct clox_value right) {
-    if (left.kind != right.kind) {
+    if (clox_value_get_kind(left) != clox_value_get_kind(right)) {
         return false;
     }
 
-    switch (left.kind) {
+    switch (clox_value_get_kind(left)) {
     case CLOX_VALUE_KIND_BOOL:
-        return left.as.boolean == right.as.boolean;
+        return clox_value_as_bool(left) == clox_value_as_bool(right);
         
     case CLOX_VALUE_KIND_NIL:
         return true;
 
     case CLOX_VALUE_KIND_NUMBER: {
+        if (clox_value_is_integer(left) && clox_value_is_integer(right)) {
+            return clox_value_as_integer(left) == clox_value_as_integer(right);
+        }
         static const double epsilon = 0.00000001;
-        return fabs(left.as.number - right.as.number) <= epsilon;
+        return fabs(clox_value_as_number(left) - clox_value_as_number(right)) <= epsilon;
     }
 
-    case CLOX_VALUE_KIND_STRING:
-        return str_equals(left.as.string, right.as.string);
+    case CLOX_VALUE_KIND_STRING: {
+        if (clox_value_is_heap_string(&left) && clox_value_is_heap_string(&right)) {
+            return rcstr_equals(clox_value_as_rcstr(&left), clox_value_as_rcstr(&right));
+        }
+        struct strview left_sv = clox_value_as_strview(&left);
+        struct strview right_sv = clox_value_as_strview(&right);
+        return left_sv.len == right_sv.len && memcmp(left_sv.ptr, right_sv.ptr, left_sv.len) == 0;
+    }
     }
 
     return false;
@@ -1,10 +1,17 @@
 #ifndef CLOX_VALUE_H
 #define CLOX_VALUE_H
 
+#include <math.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
-#include "str.h"
+#include "rcstr.h"
+#include "strview.h"
+
+struct clox_region;
+struct clox_output;
 
 enum clox_value_kind {
     CLOX_VALUE_KIND_BOOL,
@@ -13,41 +20,390 @@ enum clox_value_kind {
     CLOX_VALUE_KIND_STRING,
 };
 
+#ifdef CLOX_NAN_BOXING
+
+// NaN-boxed layout (-DCLOX_NAN_BOXING=ON).
+//
+// Every value is a single 64 bits word. Numbers are stored as plain doubles. Everything else is hidden in the
+// payload of quiet NaNs, which are never produced by arithmetic:
+// - nil, false and true are quiet NaNs tagged in the lowest bits;
+// - strings are quiet NaNs with the sign bit set and a pointer to a heap rcstr in the lowest 48 bits;
+// - integer numbers (see clox_value_integer) are quiet NaNs tagged in bit 48, holding an int32 in the lowest 32 bits.
+// There is no room for inline strings in this layout, so strings always live in a rcstr.
+
+#define CLOX_VALUE_SIGN_BIT ((uint64_t) 0x8000000000000000)
+#define CLOX_VALUE_QNAN     ((uint64_t) 0x7ffc000000000000)
+
+#define CLOX_VALUE_TAG_NIL   1
+#define CLOX_VALUE_TAG_FALSE 2
+#define CLOX_VALUE_TAG_TRUE  3
+#define CLOX_VALUE_TAG_INTEGER ((uint64_t) 0x0001000000000000)
+
+// symmetric, so negating an integer never overflows
+#define CLOX_VALUE_INTEGER_MIN (-INT32_MAX)
+#define CLOX_VALUE_INTEGER_MAX INT32_MAX
+
+struct clox_value {
+    uint64_t bits;
+};
+
+static inline struct clox_value clox_value_bool(bool val) {
+    return (struct clox_value) { CLOX_VALUE_QNAN | (val ? CLOX_VALUE_TAG_TRUE : CLOX_VALUE_TAG_FALSE) };
+}
+
+static inline struct clox_value clox_value_nil(void) {
+    return (struct clox_value) { CLOX_VALUE_QNAN | CLOX_VALUE_TAG_NIL };
+}
+
+static inline struct clox_value clox_value_number(double val) {
+    struct clox_value value;
+    memcpy(&value.bits, &val, sizeof(double));
+    return value;
+}
+
+static inline struct clox_value clox_value_integer(int64_t val) {
+    return (struct clox_value) { CLOX_VALUE_QNAN | CLOX_VALUE_TAG_INTEGER | (uint32_t) (int32_t) val };
+}
+
+static inline bool clox_value_is_integer(struct clox_value val) {
+    return (val.bits & (CLOX_VALUE_SIGN_BIT | CLOX_VALUE_QNAN | CLOX_VALUE_TAG_INTEGER)) == (CLOX_VALUE_QNAN | CLOX_VALUE_TAG_INTEGER);
+}
+
+static inline bool clox_value_is_number(struct clox_value val) {
+    return (val.bits & CLOX_VALUE_QNAN) != CLOX_VALUE_QNAN || clox_value_is_integer(val);
+}
+
+static inline bool clox_value_is_nil(struct clox_value val) {
+    return val.bits == (CLOX_VALUE_QNAN | CLOX_VALUE_TAG_NIL);
+}
+
+static inline bool clox_value_is_bool(struct clox_value val) {
+    return (val.bits | 1) == (CLOX_VALUE_QNAN | CLOX_VALUE_TAG_TRUE);
+}
+
+static inline bool clox_value_is_string(struct clox_value val) {
+    return (val.bits & (CLOX_VALUE_QNAN | CLOX_VALUE_SIGN_BIT)) == (CLOX_VALUE_QNAN | CLOX_VALUE_SIGN_BIT);
+}
+
+static inline int64_t clox_value_as_integer(struct clox_value val) {
+    return (int32_t) (uint32_t) val.bits;
+}
+
+static inline double clox_value_as_number(struct clox_value val) {
+    if (clox_value_is_integer(val)) {
+        return (double) clox_value_as_integer(val);
+    }
+    double number;
+    memcpy(&number, &val.bits, sizeof(double));
+    return number;
+}
+
+static inline bool clox_value_as_bool(struct clox_value val) {
+    return val.bits == (CLOX_VALUE_QNAN | CLOX_VALUE_TAG_TRUE);
+}
+
+#else
+
+// Tagged union layout (the default).
+//
+// A kind plus a union of the payloads. It's 32 bytes wide so short strings fit inline, without any heap allocation.
+// Integer numbers (see clox_value_integer) are kept in an int64, limited to the integers a double holds exactly.
+
+/**
+ * @brief Strings up to this length are stored inline in the value, without any heap allocation
+ */
+#define CLOX_VALUE_SMALL_STRING_MAX 22
+
+enum clox_value_string_repr {
+    /**
+     * @brief as.string is a shared reference to a heap allocated rcstr
+     */
+    CLOX_VALUE_STRING_REPR_HEAP,
+    /**
+     * @brief as.small_string holds the characters inline
+     */
+    CLOX_VALUE_STRING_REPR_SMALL,
+};
+
+/**
+ * @brief Integers are exact in a double only up to 2^53, so that's the limit of the integer representation
+ */
+#define CLOX_VALUE_INTEGER_MIN (-INT64_C(9007199254740991))
+#define CLOX_VALUE_INTEGER_MAX INT64_C(9007199254740991)
+
+enum clox_value_number_repr {
+    /**
+     * @brief as.number holds a double
+     */
+    CLOX_VALUE_NUMBER_REPR_DOUBLE,
+    /**
+     * @brief as.integer holds an integer between CLOX_VALUE_INTEGER_MIN and CLOX_VALUE_INTEGER_MAX
+     */
+    CLOX_VALUE_NUMBER_REPR_INTEGER,
+};
+
+struct clox_value_small_string {
+    char chars[CLOX_VALUE_SMALL_STRING_MAX + 1]; // '\0'
+    uint8_t len;
+};
+
 struct clox_value {
     enum clox_value_kind kind;
+    /**
+     * @brief How a string is stored (see enum clox_value_string_repr). Meaningless for other kinds
+     */
+    uint8_t string_repr;
+    /**
+     * @brief How a number is stored (see enum clox_value_number_repr). Meaningless for other kinds
+     */
+    uint8_t number_repr;
     union {
         bool boolean;
         double number;
-        struct str string;
+        int64_t integer;
+        struct rcstr* string;
+        struct clox_value_small_string small_string;
     } as;
 };
 
+static inline struct clox_value clox_value_bool(bool val) {
+    return (struct clox_value) {
+        .kind = CLOX_VALUE_KIND_BOOL,
+        .as.boolean = val,
+    };
+}
+
+static inline struct clox_value clox_value_nil(void) {
+    return (struct clox_value) {
+        .kind = CLOX_VALUE_KIND_NIL,
+        .as = {0}
+    };
+}
+
+static inline struct clox_value clox_value_number(double val) {
+    return (struct clox_value) {
+        .kind = CLOX_VALUE_KIND_NUMBER,
+        .as.number = val,
+    };
+}
+
+static inline struct clox_value clox_value_integer(int64_t val) {
+    return (struct clox_value) {
+        .kind = CLOX_VALUE_KIND_NUMBER,
+        .number_repr = CLOX_VALUE_NUMBER_REPR_INTEGER,
+        .as.integer = val,
+    };
+}
+
+static inline bool clox_value_is_number(struct clox_value val) {
+    return val.kind == CLOX_VALUE_KIND_NUMBER;
+}
+
+static inline bool clox_value_is_integer(struct clox_value val) {
+    return val.kind == CLOX_VALUE_KIND_NUMBER && val.number_repr == CLOX_VALUE_NUMBER_REPR_INTEGER;
+}
+
+static inline bool clox_value_is_nil(struct clox_value val) {
+    return val.kind == CLOX_VALUE_KIND_NIL;
+}
+
+static inline bool clox_value_is_bool(struct clox_value val) {
+    return val.kind == CLOX_VALUE_KIND_BOOL;
+}
+
+static inline bool clox_value_is_string(struct clox_value val) {
+    return val.kind == CLOX_VALUE_KIND_STRING;
+}
+
+static inline int64_t clox_value_as_integer(struct clox_value val) {
+    return val.as.integer;
+}
+
+static inline double clox_value_as_number(struct clox_value val) {
+    if (val.number_repr == CLOX_VALUE_NUMBER_REPR_INTEGER) {
+        return (double) val.as.integer;
+    }
+    return val.as.number;
+}
+
+static inline bool clox_value_as_bool(struct clox_value val) {
+    return val.as.boolean;
+}
+
+#endif
+
+static inline enum clox_value_kind clox_value_get_kind(struct clox_value val) {
+    if (clox_value_is_number(val)) {
+        return CLOX_VALUE_KIND_NUMBER;
+    }
+    if (clox_value_is_string(val)) {
+        return CLOX_VALUE_KIND_STRING;
+    }
+    if (clox_value_is_bool(val)) {
+        return CLOX_VALUE_KIND_BOOL;
+    }
+    return CLOX_VALUE_KIND_NIL;
+}
+
+// Integers are a hidden representation of numbers. Integral numbers in range are kept as integers so the most
+// common arithmetic runs on integer instructions, but they're numbers just like doubles: every number operation
+// accepts both and the results are exactly the ones doubles would give.
+
+/**
+ * @brief Whether val is in the range of the integer representation. clox_value_integer requires it.
+ */
+static inline bool clox_value_integer_fits(int64_t val) {
+    return val >= CLOX_VALUE_INTEGER_MIN && val <= CLOX_VALUE_INTEGER_MAX;
+}
+
+/**
+ * @brief Creates a number value, using the integer representation when val is an integer in range.
+ * Unlike clox_value_number, which always stores a double. -0 is kept as a double.
+ */
+static inline struct clox_value clox_value_number_compact(double val) {
+    if (val >= CLOX_VALUE_INTEGER_MIN && val <= CLOX_VALUE_INTEGER_MAX) {
+        int64_t integer = (int64_t) val;
+        if ((double) integer == val && (integer != 0 || !signbit(val))) {
+            return clox_value_integer(integer);
+        }
+    }
+    return clox_value_number(val);
+}
+
+static inline struct clox_value clox_value_number_add(struct clox_value left, struct clox_value right) {
+    if (clox_value_is_integer(left) && clox_value_is_integer(right)) {
+        // can't overflow: integers have at most 53 bits
+        int64_t sum = clox_value_as_integer(left) + clox_value_as_integer(right);
+        if (clox_value_integer_fits(sum)) {
+            return clox_value_integer(sum);
+        }
+    }
+    return clox_value_number(clox_value_as_number(left) + clox_value_as_number(right));
+}
+
+static inline struct clox_value clox_value_number_sub(struct clox_value left, struct clox_value right) {
+    if (clox_value_is_integer(left) && clox_value_is_integer(right)) {
+        int64_t difference = clox_value_as_integer(left) - clox_value_as_integer(right);
+        if (clox_value_integer_fits(difference)) {
+            return clox_value_integer(difference);
+        }
+    }
+    return clox_value_number(clox_value_as_number(left) - clox_value_as_number(right));
+}
+
+static inline struct clox_value clox_value_number_mul(struct clox_value left, struct clox_value right) {
+    if (clox_value_is_integer(left) && clox_value_is_integer(right)) {
+        int64_t a = clox_value_as_integer(left);
+        int64_t b = clox_value_as_integer(right);
+        int64_t product;
+        // a zero product of a negative operand is -0, which only a double holds
+        if (!__builtin_mul_overflow(a, b, &product) && clox_value_integer_fits(product) && (product != 0 || (a >= 0 && b >= 0))) {
+            return clox_value_integer(product);
+        }
+    }
+    return clox_value_number(clox_value_as_number(left) * clox_value_as_number(right));
+}
+
+static inline struct clox_value clox_value_number_div(struct clox_value left, struct clox_value right) {
+    return clox_value_number(clox_value_as_number(left) / clox_value_as_number(right));
+}
+
+static inline struct clox_value clox_value_number_negate(struct clox_value val) {
+    // the integer range is symmetric, but -0 is a double
+    if (clox_value_is_integer(val) && clox_value_as_integer(val) != 0) {
+        return clox_value_integer(-clox_value_as_integer(val));
+    }
+    return clox_value_number(-clox_value_as_number(val));
+}
+
+static inline bool clox_value_number_less(struct clox_value left, struct clox_value right) {
+    if (clox_value_is_integer(left) && clox_value_is_integer(right)) {
+        return clox_value_as_integer(left) < clox_value_as_integer(right);
+    }
+    return clox_value_as_number(left) < clox_value_as_number(right);
+}
+
+static inline bool clox_value_number_less_equal(struct clox_value left, struct clox_value right) {
+    if (clox_value_is_integer(left) && clox_value_is_integer(right)) {
+        return clox_value_as_integer(left) <= clox_value_as_integer(right);
+    }
+    return clox_value_as_number(left) <= clox_value_as_number(right);
+}
+
 const char* clox_value_kind_to_cstr(enum clox_value_kind kind);
 
-struct clox_value clox_value_bool(bool val);
-struct clox_value clox_value_nil(void);
-struct clox_value clox_value_number(double val);
+/**
+ * @brief Duplicates a value. Strings are shared, so this costs at most a reference count increment.
+ * 
+ * @param val 
+ * @return struct clox_value 
+ */
 struct clox_value clox_value_dup(struct clox_value val);
 
 /**
- * @brief Creates a new clox string value. The underlying str is allocated and duplicated, so it should be freed.
+ * @brief Creates a new clox string value. The value takes over the given string reference,
+ * which is dropped by clox_value_free.
  * 
  * @param val 
  * @return struct clox_value 
  */
-struct clox_value clox_value_string_str_dup(struct str val);
+struct clox_value clox_value_string(struct rcstr* val);
 
 /**
- * @brief Creates a new clox string value. The underlying str is borrowed. os it must not outlive its reference
+ * @brief Creates a new clox string value with a copy of sv. Short strings don't allocate.
  * 
- * @param val 
+ * @param sv 
+ * @return struct clox_value 
+ */
+struct clox_value clox_value_string_from_strview(struct strview sv);
+
+/**
+ * @brief Creates a new clox string value with the concatenation of two string values. Short results don't allocate.
+ * 
+ * @param region where the result is allocated, if it's a flat string. NULL allocates it in the heap
+ * @param left 
+ * @param right 
  * @return struct clox_value 
  */
-struct clox_value clox_value_string_str_borrow(struct str val);
+struct clox_value clox_value_string_concat(struct clox_region* region, struct clox_value* left, struct clox_value* right);
+
+/**
+ * @brief Creates a new clox string value with the concatenation of many strings at once. Unlike chaining
+ * clox_value_string_concat, the result is allocated only once (or not at all if it's short) and it's never a rope.
+ * 
+ * @param region where the result is allocated. NULL allocates it in the heap
+ * @param parts the contents of the strings, in order
+ * @param count 
+ * @return struct clox_value 
+ */
+struct clox_value clox_value_string_concat_n(struct clox_region* region, const struct strview* parts, size_t count);
+
+/**
+ * @brief Makes sure the value outlives any region, moving it into the heap if needed. Meant for values being stored.
+ * 
+ * @param val an owned value
+ * @return struct clox_value the same value or its heap copy, owned by the caller
+ */
+struct clox_value clox_value_promote(struct clox_value val);
+
+/**
+ * @brief Gets the characters of a string value, whatever its representation is.
+ * 
+ * The view points into the value itself for short strings, so it's valid only as long as val is.
+ * 
+ * @param val a string value
+ * @return struct strview 
+ */
+struct strview clox_value_as_strview(struct clox_value* val);
 
 void clox_value_free(struct clox_value* val);
 
 void clox_value_fprintln(FILE* file, struct clox_value val);
+
+/**
+ * @brief Same as clox_value_fprintln, but writing to a buffered output stream.
+ */
+void clox_value_println(struct clox_output* out, struct clox_value val);
 void clox_value_fdump(FILE* file, struct clox_value val);
 
 bool clox_value_is_truthy(struct clox_value value);
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#define STB_DS_IMPLEMENTATION
+#include <clox/stb_ds.h>
+
+#include "value.h"
+
+static void assert_number(struct clox_value val, double expected, bool integer) {
+    assert(clox_value_is_number(val));
+    assert(clox_value_get_kind(val) == CLOX_VALUE_KIND_NUMBER);
+    assert(clox_value_is_integer(val) == integer);
+    double number = clox_value_as_number(val);
+    // compares bits, so -0 and 0 are told apart
+    assert(memcmp(&number, &expected, sizeof(double)) == 0);
+}
+
+int main() {
+    // integral numbers in range are compacted into integers, everything else stays a double
+    assert_number(clox_value_number_compact(42), 42, true);
+    assert_number(clox_value_number_compact(-7), -7, true);
+    assert_number(clox_value_number_compact(0), 0, true);
+    assert_number(clox_value_number_compact(-0.0), -0.0, false);
+    assert_number(clox_value_number_compact(1.5), 1.5, false);
+    assert_number(clox_value_number_compact(CLOX_VALUE_INTEGER_MAX), CLOX_VALUE_INTEGER_MAX, true);
+    assert_number(clox_value_number_compact((double) CLOX_VALUE_INTEGER_MAX + 1), (double) CLOX_VALUE_INTEGER_MAX + 1, false);
+    assert_number(clox_value_number_compact(INFINITY), INFINITY, false);
+    assert_number(clox_value_number_compact(NAN), clox_value_as_number(clox_value_number(NAN)), false);
+    assert_number(clox_value_number(3), 3, false);
+
+    struct clox_value two = clox_value_integer(2);
+    struct clox_value three = clox_value_integer(3);
+    struct clox_value max = clox_value_integer(CLOX_VALUE_INTEGER_MAX);
+    struct clox_value min = clox_value_integer(CLOX_VALUE_INTEGER_MIN);
+
+    assert_number(clox_value_number_add(two, three), 5, true);
+    assert_number(clox_value_number_sub(two, three), -1, true);
+    assert_number(clox_value_number_mul(two, three), 6, true);
+    assert_number(clox_value_number_negate(three), -3, true);
+    // division always goes through doubles
+    assert_number(clox_value_number_div(clox_value_integer(6), three), 2, false);
+    assert_number(clox_value_number_div(two, three), 2.0 / 3.0, false);
+
+    // overflows promote to doubles
+    assert_number(clox_value_number_add(max, clox_value_integer(1)), (double) CLOX_VALUE_INTEGER_MAX + 1, false);
+    assert_number(clox_value_number_sub(min, clox_value_integer(1)), (double) CLOX_VALUE_INTEGER_MIN - 1, false);
+    assert_number(clox_value_number_mul(max, max), (double) CLOX_VALUE_INTEGER_MAX * CLOX_VALUE_INTEGER_MAX, false);
+    assert_number(clox_value_number_negate(min), -(double) CLOX_VALUE_INTEGER_MIN, true);
+
+    // -0 only exists as a double
+    assert_number(clox_value_number_mul(clox_value_integer(0), clox_value_integer(-5)), -0.0, false);
+    assert_number(clox_value_number_negate(clox_value_integer(0)), -0.0, false);
+    assert_number(clox_value_number_sub(two, two), 0, true);
+
+    // mixed operands are doubles
+    assert_number(clox_value_number_add(two, clox_value_number(0.5)), 2.5, false);
+    assert_number(clox_value_number_add(two, clox_value_number(1)), 3, false);
+
+    assert(clox_value_number_less(two, three));
+    assert(!clox_value_number_less(three, two));
+    assert(clox_value_number_less_equal(two, clox_value_number(2)));
+    assert(!clox_value_number_less(clox_value_number(NAN), two));
+
+    // integers and doubles are numbers alike
+    assert(clox_value_is_equal(two, clox_value_number(2)));
+    assert(clox_value_is_equal(max, max));
+    assert(!clox_value_is_equal(max, clox_value_integer(CLOX_VALUE_INTEGER_MAX - 1)));
+    assert(!clox_value_is_equal(two, clox_value_bool(true)));
+    assert(!clox_value_is_equal(two, clox_value_nil()));
+    assert(clox_value_is_truthy(clox_value_integer(0)));
+
+    puts("value.unit: ok");
+}